@@ -0,0 +1,486 @@
+#include "AlphaMask.h"
+#include "../Convert/Convert.h"
+#include "../DXTn/DXTn.h"
+#include "../FileFormat/Parser.h"
+#include "../Util/Parallel.h"
+#include "../Util/SIMD.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <vector>
+
+using namespace AlphaMask;
+
+namespace
+{
+	// Bounds of one block before the next blocks' first row and column are added
+	struct BlockStats
+	{
+		Node block;
+		Node firstColumn;
+		Node firstRow;
+		uint8_t firstTexel;
+	};
+
+	// Inclusive range of texels or nodes on one axis
+	struct Range
+	{
+		int32_t first, last;
+	};
+}
+
+static inline Node Combine(Node a, Node b)
+{
+	return Node{ std::min(a.min, b.min), std::max(a.max, b.max) };
+}
+
+// Smallest 8 bit unorm that passes the threshold, compared as floats exactly as a sampled alpha would be
+static int CalcPassByte(float threshold)
+{
+	if (!(threshold > 0.f)) return 0;
+	if (threshold > 1.f) return 256;
+
+	int passByte = static_cast<int>(ceilf(threshold * 255.f));
+	while (passByte > 0 && (passByte - 1) / 255.f >= threshold) passByte--;
+	while (passByte < 256 && passByte / 255.f < threshold) passByte++;
+	return passByte;
+}
+
+static ALPHA_COVERAGE ClassifyNode(Node node, int passByte, uint8_t tolerance)
+{
+	if (passByte == 0) return ALPHA_COVERAGE::ALL_OPAQUE;
+	if (node.min - tolerance >= passByte) return ALPHA_COVERAGE::ALL_OPAQUE;
+	if (node.max + tolerance < passByte) return ALPHA_COVERAGE::ALL_TRANSPARENT;
+	return ALPHA_COVERAGE::MIXED;
+}
+
+Layout AlphaMask::CalcLayout(uint16_t width, uint16_t height)
+{
+	Layout layout;
+	layout.width = width;
+	layout.height = height;
+
+	uint32_t levelWidth = (width + ALPHA_MASK_BLOCK_SIZE - 1) / ALPHA_MASK_BLOCK_SIZE;
+	uint32_t levelHeight = (height + ALPHA_MASK_BLOCK_SIZE - 1) / ALPHA_MASK_BLOCK_SIZE;
+	size_t nodeCount = 0;
+	while (layout.levelCount < ALPHA_MASK_MAX_LEVELS) {
+		layout.levelWidths[layout.levelCount] = levelWidth;
+		layout.levelHeights[layout.levelCount] = levelHeight;
+		layout.levelOffsets[layout.levelCount] = nodeCount;
+		layout.levelCount++;
+
+		nodeCount += static_cast<size_t>(levelWidth) * levelHeight;
+		if (levelWidth <= 1 && levelHeight <= 1) break;
+
+		levelWidth = (levelWidth + 1) / 2;
+		levelHeight = (levelHeight + 1) / 2;
+	}
+
+	layout.maskOffset = nodeCount * sizeof(Node);
+	layout.maskPitch = (static_cast<size_t>(width) + 7) / 8;
+	layout.size = layout.maskOffset + layout.maskPitch * height;
+	return layout;
+}
+
+uint8_t AlphaMask::GetTolerance(IMAGE_FORMAT format)
+{
+	return format == IMAGE_FORMAT::RGBA16161616 || format == IMAGE_FORMAT::RGBA16161616F ? 1 : 0;
+}
+
+#ifdef VTF_SSE2
+// Bounds of the 4 bytes of each 32 bit lane, in the lane's first byte (the other bytes are left over)
+static inline __m128i ReduceLanesMin(__m128i bytes)
+{
+	bytes = _mm_min_epu8(bytes, _mm_srli_epi32(bytes, 8));
+	return _mm_min_epu8(bytes, _mm_srli_epi32(bytes, 16));
+}
+
+static inline __m128i ReduceLanesMax(__m128i bytes)
+{
+	bytes = _mm_max_epu8(bytes, _mm_srli_epi32(bytes, 8));
+	return _mm_max_epu8(bytes, _mm_srli_epi32(bytes, 16));
+}
+#endif
+
+// Sets the bit of every texel in a row at or above passByte, the row's mask bytes must be zeroed
+static void SetMaskBits(const uint8_t* pAlpha, uint32_t width, int passByte, uint8_t* pMaskRow)
+{
+	if (passByte > UINT8_MAX) return;
+
+	uint32_t x = 0;
+
+#ifdef VTF_SSE2
+	// x >= passByte is max(x, passByte) == x for unsigned bytes, and movemask packs 16 comparisons into 2 mask bytes
+	const __m128i threshold = _mm_set1_epi8(static_cast<char>(passByte));
+	for (; x + 16 <= width; x += 16) {
+		const __m128i texels = _mm_loadu_si128(reinterpret_cast<const __m128i*>(pAlpha + x));
+		const int bits = _mm_movemask_epi8(_mm_cmpeq_epi8(_mm_max_epu8(texels, threshold), texels));
+		pMaskRow[x / 8] = static_cast<uint8_t>(bits);
+		pMaskRow[x / 8 + 1] = static_cast<uint8_t>(bits >> 8);
+	}
+#endif
+
+	for (; x < width; x++) {
+		if (pAlpha[x] >= passByte) pMaskRow[x / 8] |= 1 << (x % 8);
+	}
+}
+
+// Builds a mask from rows of 8 bit alpha, fillRows(blockY, rows, pAlpha, pMaskRows) writes the alpha of a row of blocks
+// (width bytes per row) and returns whether it also wrote the bit mask, otherwise it's set from the alpha bytes
+template<typename F>
+static void Build(const Layout& layout, float maskThreshold, uint8_t* pDst, F&& fillRows)
+{
+	const uint32_t blocksWide = layout.levelWidths[0], blocksHigh = layout.levelHeights[0];
+	const uint32_t width = layout.width, height = layout.height;
+	const int passByte = CalcPassByte(maskThreshold);
+
+	uint8_t* pMask = pDst + layout.maskOffset;
+	memset(pMask, 0, layout.maskPitch * height);
+
+	std::vector<BlockStats> stats(static_cast<size_t>(blocksWide) * blocksHigh);
+
+	const size_t minBlockRows = std::max<size_t>((1 << 16) / (static_cast<size_t>(width) * ALPHA_MASK_BLOCK_SIZE), 1);
+	VTFUtil::ParallelFor(blocksHigh, minBlockRows, [&](size_t begin, size_t end) {
+		std::vector<uint8_t> alpha(static_cast<size_t>(width) * ALPHA_MASK_BLOCK_SIZE);
+		std::vector<uint8_t> columnMins(width), columnMaxs(width);
+
+		for (size_t blockY = begin; blockY < end; blockY++) {
+			const uint32_t y0 = static_cast<uint32_t>(blockY) * ALPHA_MASK_BLOCK_SIZE;
+			const uint32_t rows = std::min<uint32_t>(ALPHA_MASK_BLOCK_SIZE, height - y0);
+			uint8_t* pMaskRows = pMask + y0 * layout.maskPitch;
+
+			if (!fillRows(static_cast<uint32_t>(blockY), rows, alpha.data(), pMaskRows)) {
+				for (uint32_t row = 0; row < rows; row++)
+					SetMaskBits(alpha.data() + row * width, width, passByte, pMaskRows + row * layout.maskPitch);
+			}
+
+			BlockStats* pStats = stats.data() + blockY * blocksWide;
+			uint32_t blockX = 0;
+
+#ifdef VTF_SSE2
+			// 4 whole blocks at a time, one per 32 bit lane: bounds of each column over the rows, then of the 4 columns in each lane
+			for (; (blockX + 4) * ALPHA_MASK_BLOCK_SIZE <= width; blockX += 4) {
+				const uint8_t* pTexels = alpha.data() + blockX * ALPHA_MASK_BLOCK_SIZE;
+				const __m128i firstRow = _mm_loadu_si128(reinterpret_cast<const __m128i*>(pTexels));
+				__m128i columnMin = firstRow, columnMax = firstRow;
+				for (uint32_t row = 1; row < rows; row++) {
+					const __m128i texels = _mm_loadu_si128(reinterpret_cast<const __m128i*>(pTexels + row * width));
+					columnMin = _mm_min_epu8(columnMin, texels);
+					columnMax = _mm_max_epu8(columnMax, texels);
+				}
+
+				alignas(16) uint8_t bounds[6][16];
+				_mm_store_si128(reinterpret_cast<__m128i*>(bounds[0]), ReduceLanesMin(columnMin));
+				_mm_store_si128(reinterpret_cast<__m128i*>(bounds[1]), ReduceLanesMax(columnMax));
+				_mm_store_si128(reinterpret_cast<__m128i*>(bounds[2]), columnMin);
+				_mm_store_si128(reinterpret_cast<__m128i*>(bounds[3]), columnMax);
+				_mm_store_si128(reinterpret_cast<__m128i*>(bounds[4]), ReduceLanesMin(firstRow));
+				_mm_store_si128(reinterpret_cast<__m128i*>(bounds[5]), ReduceLanesMax(firstRow));
+
+				// The reduced bounds are in the first byte of each lane
+				for (int lane = 0; lane < 4; lane++) {
+					BlockStats& block = pStats[blockX + lane];
+					block.block = Node{ bounds[0][lane * 4], bounds[1][lane * 4] };
+					block.firstColumn = Node{ bounds[2][lane * 4], bounds[3][lane * 4] };
+					block.firstRow = Node{ bounds[4][lane * 4], bounds[5][lane * 4] };
+					block.firstTexel = pTexels[lane * 4];
+				}
+			}
+#endif
+
+			// Bounds of each remaining column over the rows first, so each block only reduces 4 columns
+			for (uint32_t x = blockX * ALPHA_MASK_BLOCK_SIZE; x < width; x++) {
+				columnMins[x] = columnMaxs[x] = alpha[x];
+				for (uint32_t row = 1; row < rows; row++) {
+					columnMins[x] = std::min(columnMins[x], alpha[row * width + x]);
+					columnMaxs[x] = std::max(columnMaxs[x], alpha[row * width + x]);
+				}
+			}
+
+			for (; blockX < blocksWide; blockX++) {
+				const uint32_t x0 = blockX * ALPHA_MASK_BLOCK_SIZE;
+				const uint32_t columns = std::min<uint32_t>(ALPHA_MASK_BLOCK_SIZE, width - x0);
+
+				BlockStats& block = pStats[blockX];
+				block.firstTexel = alpha[x0];
+				block.firstColumn = Node{ columnMins[x0], columnMaxs[x0] };
+				block.firstRow = Node{ alpha[x0], alpha[x0] };
+				block.block = block.firstColumn;
+				for (uint32_t column = 1; column < columns; column++) {
+					block.firstRow = Combine(block.firstRow, Node{ alpha[x0 + column], alpha[x0 + column] });
+					block.block = Combine(block.block, Node{ columnMins[x0 + column], columnMaxs[x0 + column] });
+				}
+			}
+		}
+	});
+
+	// Each block also covers the first column of the block to its right, the first row of the block below, and the first texel diagonally,
+	// (wrapping at the edges, which is a superset of clamping) so both taps on each axis of a bilinear lookup are inside the first tap's block
+	Node* pNodes = reinterpret_cast<Node*>(pDst);
+	for (uint32_t blockY = 0; blockY < blocksHigh; blockY++) {
+		const uint32_t nextY = blockY + 1 < blocksHigh ? blockY + 1 : 0;
+		for (uint32_t blockX = 0; blockX < blocksWide; blockX++) {
+			const uint32_t nextX = blockX + 1 < blocksWide ? blockX + 1 : 0;
+			const uint8_t diagonal = stats[nextY * blocksWide + nextX].firstTexel;
+
+			Node node = stats[blockY * blocksWide + blockX].block;
+			node = Combine(node, stats[blockY * blocksWide + nextX].firstColumn);
+			node = Combine(node, stats[nextY * blocksWide + blockX].firstRow);
+			pNodes[blockY * blocksWide + blockX] = Combine(node, Node{ diagonal, diagonal });
+		}
+	}
+
+	for (uint32_t level = 1; level < layout.levelCount; level++) {
+		const uint32_t childWidth = layout.levelWidths[level - 1], childHeight = layout.levelHeights[level - 1];
+		const Node* pChildren = pNodes + layout.levelOffsets[level - 1];
+		Node* pLevel = pNodes + layout.levelOffsets[level];
+
+		for (uint32_t y = 0; y < layout.levelHeights[level]; y++) {
+			for (uint32_t x = 0; x < layout.levelWidths[level]; x++) {
+				const uint32_t x0 = x * 2, y0 = y * 2;
+				const uint32_t x1 = std::min(x0 + 1, childWidth - 1), y1 = std::min(y0 + 1, childHeight - 1);
+				pLevel[y * layout.levelWidths[level] + x] = Combine(
+					Combine(pChildren[y0 * childWidth + x0], pChildren[y0 * childWidth + x1]),
+					Combine(pChildren[y1 * childWidth + x0], pChildren[y1 * childWidth + x1])
+				);
+			}
+		}
+	}
+}
+
+void AlphaMask::BuildFromPixels(const uint8_t* pData, IMAGE_FORMAT format, const Layout& layout, float maskThreshold, uint8_t* pDst)
+{
+	const uint32_t width = layout.width;
+	const size_t rowSize = static_cast<size_t>(width) * VTFParser::GetImageFormatInfo(format).bytesPerPixel;
+
+	if (GetTolerance(format) != 0) {
+		// 16 bit alpha is rounded to 8 bits for the nodes, but the bit mask compares the exact value like a sample would
+		Build(layout, maskThreshold, pDst, [&](uint32_t blockY, uint32_t rows, uint8_t* pAlpha, uint8_t* pMaskRows) {
+			for (uint32_t row = 0; row < rows; row++) {
+				const uint8_t* pRow = pData + (static_cast<size_t>(blockY) * ALPHA_MASK_BLOCK_SIZE + row) * rowSize;
+				for (uint32_t x = 0; x < width; x++) {
+					uint16_t channel;
+					memcpy(&channel, pRow + x * 8 + 6, 2);
+					pAlpha[row * width + x] = static_cast<uint8_t>((channel * 255u + UINT16_MAX / 2) / UINT16_MAX);
+					if (static_cast<float>(channel) / static_cast<float>(UINT16_MAX) >= maskThreshold)
+						pMaskRows[row * layout.maskPitch + x / 8] |= 1 << (x % 8);
+				}
+			}
+			return true;
+		});
+		return;
+	}
+
+	// Everything else has alpha that's exactly an 8 bit unorm, so convert to RGBA8 in chunks and keep the alpha bytes
+	Build(layout, maskThreshold, pDst, [&](uint32_t blockY, uint32_t rows, uint8_t* pAlpha, uint8_t*) {
+		const size_t CHUNK_SIZE = 256;
+		const uint32_t pixelSize = VTFParser::GetImageFormatInfo(format).bytesPerPixel;
+		uint8_t rgba[CHUNK_SIZE * 4];
+
+		for (uint32_t row = 0; row < rows; row++) {
+			const uint8_t* pRow = pData + (static_cast<size_t>(blockY) * ALPHA_MASK_BLOCK_SIZE + row) * rowSize;
+			for (size_t begin = 0; begin < width; begin += CHUNK_SIZE) {
+				const size_t chunk = std::min<size_t>(CHUNK_SIZE, width - begin);
+				Convert::ConvertPixels(pRow + begin * pixelSize, format, rgba, PIXEL_FORMAT::RGBA8, chunk);
+				for (size_t i = 0; i < chunk; i++) pAlpha[row * width + begin + i] = rgba[i * 4 + 3];
+			}
+		}
+		return false;
+	});
+}
+
+// Alpha of the 16 texels of a block, identical to the decompressors
+static void DecodeBlockAlpha(const uint8_t* pBlock, IMAGE_FORMAT format, uint8_t* pAlpha)
+{
+	switch (format) {
+	case IMAGE_FORMAT::DXT1:
+	case IMAGE_FORMAT::DXT1_ONEBITALPHA:
+	{
+		uint16_t colour0, colour1;
+		uint32_t indices;
+		memcpy(&colour0, pBlock, 2);
+		memcpy(&colour1, pBlock + 2, 2);
+		memcpy(&indices, pBlock + 4, 4);
+
+		// Only index 3 of 3 colour blocks is transparent
+		if (colour0 > colour1) {
+			memset(pAlpha, 0xff, 16);
+			return;
+		}
+
+		for (int i = 0; i < 16; i++)
+			pAlpha[i] = ((indices >> (i * 2)) & 0x3) == 3 ? 0 : 255;
+		return;
+	}
+	case IMAGE_FORMAT::DXT3:
+		for (int i = 0; i < 16; i++) {
+			const uint8_t nibble = (pBlock[i / 2] >> ((i % 2) * 4)) & 0xf;
+			pAlpha[i] = nibble | (nibble << 4);
+		}
+		return;
+	case IMAGE_FORMAT::DXT5:
+		DXTn::DecodeAlphaBlock(pBlock, pAlpha);
+		return;
+	default:
+		memset(pAlpha, 0xff, 16);
+		return;
+	}
+}
+
+bool AlphaMask::BuildFromBlocks(const uint8_t* pBlocks, IMAGE_FORMAT format, const Layout& layout, float maskThreshold, uint8_t* pDst)
+{
+	if (format != IMAGE_FORMAT::DXT1 && format != IMAGE_FORMAT::DXT1_ONEBITALPHA && format != IMAGE_FORMAT::DXT3 && format != IMAGE_FORMAT::DXT5)
+		return false;
+
+	const uint32_t width = layout.width, blocksWide = layout.levelWidths[0];
+	const size_t blockSize = format == IMAGE_FORMAT::DXT3 || format == IMAGE_FORMAT::DXT5 ? 16 : 8;
+
+	Build(layout, maskThreshold, pDst, [&](uint32_t blockY, uint32_t rows, uint8_t* pAlpha, uint8_t*) {
+		uint8_t blockAlpha[16];
+		for (uint32_t blockX = 0; blockX < blocksWide; blockX++) {
+			DecodeBlockAlpha(pBlocks + (static_cast<size_t>(blockY) * blocksWide + blockX) * blockSize, format, blockAlpha);
+
+			const uint32_t x0 = blockX * ALPHA_MASK_BLOCK_SIZE;
+			const uint32_t columns = std::min<uint32_t>(ALPHA_MASK_BLOCK_SIZE, width - x0);
+			if (columns == ALPHA_MASK_BLOCK_SIZE) {
+				for (uint32_t row = 0; row < rows; row++)
+					memcpy(pAlpha + row * width + x0, blockAlpha + row * ALPHA_MASK_BLOCK_SIZE, ALPHA_MASK_BLOCK_SIZE);
+			} else {
+				for (uint32_t row = 0; row < rows; row++)
+					memcpy(pAlpha + row * width + x0, blockAlpha + row * ALPHA_MASK_BLOCK_SIZE, columns);
+			}
+		}
+		return false;
+	});
+
+	return true;
+}
+
+// Both taps of a bilinear lookup on one axis, exactly as the bilinear filter picks them
+static void CalcTaps(float t, uint16_t size, bool clamp, int32_t* pTap0, int32_t* pTap1)
+{
+	if (clamp)
+		t = std::clamp(t, 0.f, 0.9999f);
+	else
+		t -= floorf(t);
+
+	const int32_t i = static_cast<int32_t>(floorf(t * size - 0.5f));
+	if (clamp) {
+		*pTap0 = std::clamp(i, 0, size - 1);
+		*pTap1 = std::clamp(i + 1, 0, size - 1);
+	} else {
+		*pTap0 = (i % size + size) % size;
+		*pTap1 = ((i + 1) % size + size) % size;
+	}
+}
+
+ALPHA_COVERAGE AlphaMask::ClassifyLookup(const Image& image, bool clampX, bool clampY, float u, float v, float threshold, bool useBitMask)
+{
+	const Layout& layout = *image.pLayout;
+
+	int32_t x0, x1, y0, y1;
+	CalcTaps(u, layout.width, clampX, &x0, &x1);
+	CalcTaps(v, layout.height, clampY, &y0, &y1);
+
+	const Node* pNodes = reinterpret_cast<const Node*>(image.pData);
+	const Node block = pNodes[(y0 / ALPHA_MASK_BLOCK_SIZE) * layout.levelWidths[0] + x0 / ALPHA_MASK_BLOCK_SIZE];
+	const ALPHA_COVERAGE coverage = ClassifyNode(block, CalcPassByte(threshold), image.tolerance);
+	if (coverage != ALPHA_COVERAGE::MIXED || !useBitMask || threshold != image.maskThreshold) return coverage;
+
+	// A bilinear blend of taps that all pass (or all fail) does too
+	const uint8_t* pMask = image.pData + layout.maskOffset;
+	const uint8_t* pRow0 = pMask + y0 * layout.maskPitch;
+	const uint8_t* pRow1 = pMask + y1 * layout.maskPitch;
+	const int bits =
+		((pRow0[x0 / 8] >> (x0 % 8)) & 1) + ((pRow0[x1 / 8] >> (x1 % 8)) & 1) +
+		((pRow1[x0 / 8] >> (x0 % 8)) & 1) + ((pRow1[x1 / 8] >> (x1 % 8)) & 1);
+
+	if (bits == 4) return ALPHA_COVERAGE::ALL_OPAQUE;
+	if (bits == 0) return ALPHA_COVERAGE::ALL_TRANSPARENT;
+	return ALPHA_COVERAGE::MIXED;
+}
+
+// Texels whose bilinear lookups start inside a range of coordinates on one axis, split in 2 if it wraps around the edge
+static int CalcTexelRanges(float tMin, float tMax, uint16_t size, bool clamp, Range* pRanges)
+{
+	if (tMax < tMin) std::swap(tMin, tMax);
+
+	if (clamp) {
+		int32_t tap1;
+		CalcTaps(tMin, size, true, &pRanges[0].first, &tap1);
+		CalcTaps(tMax, size, true, &pRanges[0].last, &tap1);
+		return 1;
+	}
+
+	if (!(tMax - tMin < 1.f)) {
+		pRanges[0] = Range{ 0, size - 1 };
+		return 1;
+	}
+
+	const float shift = floorf(tMin);
+	const int32_t first = static_cast<int32_t>(floorf((tMin - shift) * size - 0.5f));
+	const int32_t last = static_cast<int32_t>(floorf((tMax - shift) * size - 0.5f));
+	if (last - first + 1 >= size) {
+		pRanges[0] = Range{ 0, size - 1 };
+		return 1;
+	}
+
+	if (first < 0) {
+		pRanges[0] = Range{ first + size, size - 1 };
+		pRanges[1] = Range{ 0, last };
+		return last < 0 ? 1 : 2;
+	}
+
+	if (last >= size) {
+		pRanges[0] = Range{ first, size - 1 };
+		pRanges[1] = Range{ 0, last - size };
+		return 2;
+	}
+
+	pRanges[0] = Range{ first, last };
+	return 1;
+}
+
+// Bounds of a rectangle of blocks from the smallest level where it spans at most 2x2 nodes
+static Node CalcBlockBounds(const Layout& layout, const Node* pNodes, Range blocksX, Range blocksY)
+{
+	uint32_t level = 0;
+	while (level + 1 < layout.levelCount &&
+		((blocksX.last >> level) - (blocksX.first >> level) > 1 || (blocksY.last >> level) - (blocksY.first >> level) > 1))
+		level++;
+
+	const Node* pLevel = pNodes + layout.levelOffsets[level];
+	const uint32_t levelWidth = layout.levelWidths[level];
+	const int32_t x0 = blocksX.first >> level, x1 = blocksX.last >> level;
+	const int32_t y0 = blocksY.first >> level, y1 = blocksY.last >> level;
+
+	return Combine(
+		Combine(pLevel[y0 * levelWidth + x0], pLevel[y0 * levelWidth + x1]),
+		Combine(pLevel[y1 * levelWidth + x0], pLevel[y1 * levelWidth + x1])
+	);
+}
+
+ALPHA_COVERAGE AlphaMask::ClassifyFootprint(
+	const Image& image, bool clampX, bool clampY,
+	float uMin, float vMin, float uMax, float vMax, float threshold
+)
+{
+	const Layout& layout = *image.pLayout;
+	const Node* pNodes = reinterpret_cast<const Node*>(image.pData);
+
+	Range rangesX[2], rangesY[2];
+	const int countX = CalcTexelRanges(uMin, uMax, layout.width, clampX, rangesX);
+	const int countY = CalcTexelRanges(vMin, vMax, layout.height, clampY, rangesY);
+
+	Node bounds = Node{ UINT8_MAX, 0 };
+	for (int iy = 0; iy < countY; iy++) {
+		for (int ix = 0; ix < countX; ix++) {
+			const Range blocksX = { rangesX[ix].first / ALPHA_MASK_BLOCK_SIZE, rangesX[ix].last / ALPHA_MASK_BLOCK_SIZE };
+			const Range blocksY = { rangesY[iy].first / ALPHA_MASK_BLOCK_SIZE, rangesY[iy].last / ALPHA_MASK_BLOCK_SIZE };
+			bounds = Combine(bounds, CalcBlockBounds(layout, pNodes, blocksX, blocksY));
+		}
+	}
+
+	return ClassifyNode(bounds, CalcPassByte(threshold), image.tolerance);
+}
@@ -0,0 +1,110 @@
+#pragma once
+
+#include "../FileFormat/Structs.h"
+
+#include <cstddef>
+#include <cstdint>
+
+#define ALPHA_MASK_BLOCK_SIZE 4
+#define ALPHA_MASK_MAX_LEVELS 16
+
+/// <summary>
+/// Conservative alpha bounds of a single image, to skip sampling when alpha testing regions that are entirely opaque or transparent
+/// Made up of a 1 bit mask (alpha at or above a threshold chosen when building) and a min/max pyramid over 4x4 texel blocks,
+/// where each block also covers the first row and column of the next blocks, so the 2x2 taps of any bilinear lookup fall inside one block
+/// </summary>
+namespace AlphaMask
+{
+	/// <summary>
+	/// Alpha bounds of a block or a group of blocks, as 8 bit unorms
+	/// </summary>
+	struct Node
+	{
+		uint8_t min;
+		uint8_t max;
+	};
+
+	/// <summary>
+	/// Where each part of the mask of an image is, nodes of every level come first (largest level first) followed by the bit mask
+	/// </summary>
+	struct Layout
+	{
+		uint16_t width = 0;
+		uint16_t height = 0;
+
+		uint32_t levelCount = 0;
+		uint32_t levelWidths[ALPHA_MASK_MAX_LEVELS] = {};
+		uint32_t levelHeights[ALPHA_MASK_MAX_LEVELS] = {};
+		size_t levelOffsets[ALPHA_MASK_MAX_LEVELS] = {}; // Index of the level's first node
+
+		size_t maskOffset = 0; // Bytes from the start to the bit mask
+		size_t maskPitch = 0;  // Bytes per row of the bit mask, bits are ordered least significant first
+		size_t size = 0;       // Total bytes
+	};
+
+	/// <summary>
+	/// A built mask and how to compare against it
+	/// </summary>
+	struct Image
+	{
+		const Layout* pLayout = nullptr;
+		const uint8_t* pData = nullptr;
+		float maskThreshold = 0.5f; // Threshold the bit mask was built with
+		uint8_t tolerance = 0;      // Amount node bounds may be off by, when the image's alpha isn't exactly an 8 bit unorm
+	};
+
+	/// <summary>
+	/// Calculates the layout of the mask of an image
+	/// </summary>
+	Layout CalcLayout(uint16_t width, uint16_t height);
+
+	/// <summary>
+	/// Gets the tolerance to build and compare masks of a format with
+	/// </summary>
+	/// <returns>1 for 16 bit per channel formats, 0 for anything else</returns>
+	uint8_t GetTolerance(IMAGE_FORMAT format);
+
+	/// <summary>
+	/// Builds the mask of an image from its pixels, rows of blocks are spread across threads
+	/// </summary>
+	/// <param name="pData">Pixel data of the image</param>
+	/// <param name="format">Format of the pixel data (must not be block compressed)</param>
+	/// <param name="layout">Layout from CalcLayout</param>
+	/// <param name="maskThreshold">Alpha at or above which a texel is set in the bit mask</param>
+	/// <param name="pDst">Buffer of layout.size bytes to write the mask to</param>
+	void BuildFromPixels(const uint8_t* pData, IMAGE_FORMAT format, const Layout& layout, float maskThreshold, uint8_t* pDst);
+
+	/// <summary>
+	/// Builds the mask of an image straight from its DXT blocks, only the alpha of each block is decoded
+	/// </summary>
+	/// <param name="pBlocks">Compressed data of the image</param>
+	/// <param name="format">DXT1, DXT1_ONEBITALPHA, DXT3 or DXT5</param>
+	/// <returns>Whether the format is supported and the mask was written</returns>
+	bool BuildFromBlocks(const uint8_t* pBlocks, IMAGE_FORMAT format, const Layout& layout, float maskThreshold, uint8_t* pDst);
+
+	/// <summary>
+	/// Classifies the bilinear lookup at a coordinate, from its block and (if the threshold is the mask's) the bit mask of its 4 taps
+	/// </summary>
+	/// <param name="image">Mask to read</param>
+	/// <param name="clampX">Clamp instead of wrapping at the horizontal edges</param>
+	/// <param name="clampY">Clamp instead of wrapping at the vertical edges</param>
+	/// <param name="u">U coordinate</param>
+	/// <param name="v">V coordinate</param>
+	/// <param name="threshold">Alpha at or above which a sample passes</param>
+	/// <param name="useBitMask">Whether the bit mask may be read, the taps are only those of a bilinear lookup</param>
+	/// <returns>Classification of the lookup</returns>
+	ALPHA_COVERAGE ClassifyLookup(const Image& image, bool clampX, bool clampY, float u, float v, float threshold, bool useBitMask);
+
+	/// <summary>
+	/// Classifies every lookup inside a rectangle of uvs from the smallest pyramid level covering it with 2x2 nodes
+	/// </summary>
+	/// <param name="uMin">Lowest U coordinate</param>
+	/// <param name="vMin">Lowest V coordinate</param>
+	/// <param name="uMax">Highest U coordinate</param>
+	/// <param name="vMax">Highest V coordinate</param>
+	/// <returns>Classification of the footprint</returns>
+	ALPHA_COVERAGE ClassifyFootprint(
+		const Image& image, bool clampX, bool clampY,
+		float uMin, float vMin, float uMax, float vMax, float threshold
+	);
+}
@@ -0,0 +1,1049 @@
+#include "Corpus.h"
+#include "PerfCounters.h"
+#include "VPKFixture.h"
+#include "../VTFParser.h"
+#include "../VTFTexturePool.h"
+#include "../FileFormat/Parser.h"
+#include "../DXTn/DXTn.h"
+#include "../Convert/Convert.h"
+
+#include <algorithm>
+#include <cctype>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <functional>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace VTFBench;
+
+struct BenchConfig
+{
+	uint16_t maxSize = 8192;
+	uint64_t maxBytes = 64ull << 20;
+	double minSeconds = 0.1;
+	uint64_t seed = 1;
+	uint32_t maxThreads = 0; // 0 for the number of hardware threads
+	std::string filter;
+	std::string outputPath;
+	bool stress4GiB = false; // Run the checks across the 4 GiB image data boundary instead of the benchmarks
+};
+
+struct BenchResult
+{
+	std::string benchmark;
+	std::string subject;
+	uint64_t iterations;
+	double secondsPerIteration;
+	uint64_t bytesPerIteration;   // Bytes processed, 0 if throughput in MB/s doesn't apply
+	uint64_t samplesPerIteration; // Pixels or samples produced, 0 if Msamples/s doesn't apply
+
+	uint32_t threads = 0;               // Threads sharing the work, 0 for single threaded benchmarks
+	double speedup = 0.0;               // Throughput relative to 1 thread, 0 if not a scaling benchmark
+	double cacheMissesPerSample = -1.0; // From perf counters, -1 if unavailable
+	double cacheMissRate = -1.0;        // Misses per cache reference, -1 if unavailable
+};
+
+// Accumulates results of the benchmarked calls so the optimiser can't remove them
+static volatile float gSink = 0.f;
+
+/// <summary>
+/// Runs fn once to warm up, then in growing batches until a batch takes at least minSeconds
+/// </summary>
+template<typename F>
+static void Measure(double minSeconds, F&& fn, uint64_t& iterations, double& secondsPerIteration)
+{
+	using Clock = std::chrono::steady_clock;
+
+	fn();
+
+	for (uint64_t batch = 1;; batch *= 2) {
+		Clock::time_point start = Clock::now();
+		for (uint64_t i = 0; i < batch; i++) fn();
+		double elapsed = std::chrono::duration<double>(Clock::now() - start).count();
+
+		if (elapsed >= minSeconds || batch >= (1ull << 40)) {
+			iterations = batch;
+			secondsPerIteration = elapsed / batch;
+			return;
+		}
+	}
+}
+
+class Bench
+{
+private:
+	BenchConfig mConfig;
+	std::vector<BenchResult> mResults;
+	std::vector<std::string> mFailures;
+
+	bool Selected(const std::string& benchmark, const std::string& subject) const
+	{
+		if (mConfig.filter.empty()) return true;
+		return (benchmark + '/' + subject).find(mConfig.filter) != std::string::npos;
+	}
+
+public:
+	explicit Bench(const BenchConfig& config) : mConfig(config) {}
+
+	template<typename F>
+	void Run(const std::string& benchmark, const std::string& subject, uint64_t bytes, uint64_t samples, F&& fn)
+	{
+		if (!Selected(benchmark, subject)) return;
+
+		BenchResult result{ benchmark, subject, 0, 0.0, bytes, samples };
+		Measure(mConfig.minSeconds, fn, result.iterations, result.secondsPerIteration);
+		mResults.push_back(result);
+
+		fprintf(stderr, "%-24s %-40s %12.1f ns/iter\n", benchmark.c_str(), subject.c_str(), result.secondsPerIteration * 1e9);
+	}
+
+	/// <summary>
+	/// Runs fn(threadCount) at each thread count, where every thread does samplesPerThread samples of the same work (weak scaling),
+	/// reporting the speedup in throughput over the first count and cache misses per sample if perf counters are available
+	/// </summary>
+	template<typename F>
+	void RunScaling(const std::string& benchmark, const std::string& subject, const std::vector<uint32_t>& threadCounts, uint64_t samplesPerThread, F&& fn)
+	{
+		double baseline = 0.0; // Samples per second at the first thread count
+		for (uint32_t threadCount : threadCounts) {
+			const std::string threadSubject = subject + "_t" + std::to_string(threadCount);
+			if (!Selected(benchmark, threadSubject)) continue;
+
+			BenchResult result{ benchmark, threadSubject, 0, 0.0, 0, samplesPerThread * threadCount };
+			result.threads = threadCount;
+
+			// Count every call Measure makes, warm up included, so the counters divide out exactly
+			PerfCounters counters;
+			uint64_t calls = 0;
+			counters.Start();
+			Measure(mConfig.minSeconds, [&]() { fn(threadCount); calls++; }, result.iterations, result.secondsPerIteration);
+			counters.Stop();
+
+			const double samplesPerSecond = result.samplesPerIteration / result.secondsPerIteration;
+			if (threadCount == threadCounts.front()) baseline = samplesPerSecond;
+			if (baseline > 0.0) result.speedup = samplesPerSecond / baseline;
+
+			if (counters.IsAvailable() && calls != 0) {
+				const uint64_t references = counters.GetCacheReferences();
+				result.cacheMissesPerSample = static_cast<double>(counters.GetCacheMisses()) / (static_cast<double>(calls) * result.samplesPerIteration);
+				if (references != 0) result.cacheMissRate = static_cast<double>(counters.GetCacheMisses()) / references;
+			}
+			mResults.push_back(result);
+
+			fprintf(stderr, "%-24s %-40s %12.1f ns/iter %6.2fx", benchmark.c_str(), threadSubject.c_str(), result.secondsPerIteration * 1e9, result.speedup);
+			if (result.cacheMissesPerSample >= 0.0) fprintf(stderr, " %8.3f misses/sample", result.cacheMissesPerSample);
+			fprintf(stderr, "\n");
+		}
+	}
+
+	/// <summary>
+	/// Records a benchmark whose results didn't match, which makes the run fail
+	/// </summary>
+	void Fail(const std::string& message)
+	{
+		fprintf(stderr, "FAILED: %s\n", message.c_str());
+		mFailures.push_back(message);
+	}
+
+	size_t GetFailureCount() const { return mFailures.size(); }
+
+	void WriteJSON(FILE* pFile) const
+	{
+		fprintf(pFile, "{\n");
+		fprintf(pFile, "  \"schema\": 1,\n");
+		fprintf(pFile, "  \"config\": {\n");
+		fprintf(pFile, "    \"max_size\": %u,\n", mConfig.maxSize);
+		fprintf(pFile, "    \"max_bytes\": %llu,\n", static_cast<unsigned long long>(mConfig.maxBytes));
+		fprintf(pFile, "    \"min_seconds\": %g,\n", mConfig.minSeconds);
+		fprintf(pFile, "    \"seed\": %llu,\n", static_cast<unsigned long long>(mConfig.seed));
+		fprintf(pFile, "    \"max_threads\": %u,\n", mConfig.maxThreads);
+		fprintf(pFile, "    \"hardware_threads\": %u\n", std::thread::hardware_concurrency());
+		fprintf(pFile, "  },\n");
+		fprintf(pFile, "  \"failures\": %zu,\n", mFailures.size());
+		fprintf(pFile, "  \"results\": [");
+
+		for (size_t i = 0; i < mResults.size(); i++) {
+			const BenchResult& result = mResults[i];
+			fprintf(pFile, "%s\n    {", i == 0 ? "" : ",");
+			fprintf(pFile, "\"benchmark\": \"%s\", \"subject\": \"%s\", ", result.benchmark.c_str(), result.subject.c_str());
+			fprintf(pFile, "\"iterations\": %llu, \"ns_per_iter\": %.3f", static_cast<unsigned long long>(result.iterations), result.secondsPerIteration * 1e9);
+			if (result.bytesPerIteration != 0)
+				fprintf(pFile, ", \"mb_per_s\": %.3f", result.bytesPerIteration / result.secondsPerIteration / 1e6);
+			if (result.samplesPerIteration != 0)
+				fprintf(pFile, ", \"msamples_per_s\": %.3f", result.samplesPerIteration / result.secondsPerIteration / 1e6);
+			if (result.threads != 0)
+				fprintf(pFile, ", \"threads\": %u, \"speedup\": %.3f", result.threads, result.speedup);
+			if (result.cacheMissesPerSample >= 0.0)
+				fprintf(pFile, ", \"cache_misses_per_sample\": %.4f", result.cacheMissesPerSample);
+			if (result.cacheMissRate >= 0.0)
+				fprintf(pFile, ", \"cache_miss_rate\": %.4f", result.cacheMissRate);
+			fprintf(pFile, "}");
+		}
+
+		fprintf(pFile, "\n  ]\n}\n");
+	}
+};
+
+static void BenchTexture(Bench& bench, const CorpusSpec& spec, const std::vector<uint8_t>& file, uint64_t seed)
+{
+	const std::string name = spec.Name();
+
+	bench.Run("parse_header", name, 80, 0, [&]() {
+		VTFHeader header;
+		gSink = gSink + VTFParser::ParseHeader(file.data(), file.size(), &header);
+	});
+
+	VTFHeader header;
+	if (!VTFParser::ParseHeader(file.data(), file.size(), &header)) return;
+
+	bench.Run("parse_image_data", name, file.size() - 80, 0, [&]() {
+		uint8_t* pImageData = nullptr;
+		size_t imageDataSize = 0;
+		if (VTFParser::ParseImageData(file.data(), file.size(), &header, &pImageData, &imageDataSize)) {
+			gSink = gSink + pImageData[0];
+			free(pImageData);
+		}
+	});
+
+	bench.Run("load", name, file.size(), 0, [&]() {
+		VTFTexture texture(file.data(), file.size());
+		gSink = gSink + texture.IsValid();
+	});
+
+	VTFTexture texture(file.data(), file.size());
+	if (!texture.IsValid()) return;
+
+	// Raster order over (up to) the first 256K pixels of the largest MIP
+	const uint32_t width = texture.GetWidth(), height = texture.GetHeight();
+	const uint32_t coherentCount = std::min<uint32_t>(width * height, 1u << 18);
+
+	bench.Run("get_pixel_coherent", name, 0, coherentCount, [&]() {
+		float sum = 0.f;
+		for (uint32_t i = 0; i < coherentCount; i++)
+			sum += texture.GetPixel(i % width, i / width, 0, 0, 0, 0).r;
+		gSink = gSink + sum;
+	});
+
+	bench.Run("sample_coherent", name, 0, coherentCount, [&]() {
+		float sum = 0.f;
+		for (uint32_t i = 0; i < coherentCount; i++)
+			sum += texture.Sample((i % width + 0.5f) / width, (i / width + 0.5f) / height, 0, 0.f, 0, 0).r;
+		gSink = gSink + sum;
+	});
+
+	// Bulk export of the largest MIP, and of all the image data
+	const size_t regionPixels = static_cast<size_t>(width) * height;
+	std::vector<uint8_t> exported(regionPixels * Convert::GetPixelSize(PIXEL_FORMAT::RGBA32F));
+	bench.Run("read_region_rgba8", name, regionPixels * 4, regionPixels, [&]() {
+		gSink = gSink + texture.ReadRegion(0, 0, 0, 0, 0, 0, width, height, PIXEL_FORMAT::RGBA8, exported.data(), 0);
+	});
+
+	bench.Run("read_region_rgba32f", name, regionPixels * 16, regionPixels, [&]() {
+		gSink = gSink + texture.ReadRegion(0, 0, 0, 0, 0, 0, width, height, PIXEL_FORMAT::RGBA32F, exported.data(), 0);
+	});
+
+	bench.Run("convert_to_rgba16f", name, 0, 0, [&]() {
+		std::vector<uint8_t> converted;
+		gSink = gSink + texture.ConvertTo(PIXEL_FORMAT::RGBA16F, converted);
+	});
+
+	// Random UVs and fractional LODs, generated up front so the generator isn't measured
+	const uint32_t randomCount = 1u << 16;
+	std::vector<float> uvl(randomCount * 3);
+	Random random(seed);
+	for (uint32_t i = 0; i < randomCount; i++) {
+		uvl[i * 3 + 0] = random.NextFloat();
+		uvl[i * 3 + 1] = random.NextFloat();
+		uvl[i * 3 + 2] = random.NextFloat() * (texture.GetMIPLevels() - 1);
+	}
+
+	bench.Run("sample_random", name, 0, randomCount, [&]() {
+		float sum = 0.f;
+		for (uint32_t i = 0; i < randomCount; i++)
+			sum += texture.Sample(uvl[i * 3 + 0], uvl[i * 3 + 1], 0, uvl[i * 3 + 2], 0, 0).r;
+		gSink = gSink + sum;
+	});
+
+	// Same lookups as sample_random, each prefetched a few lookups ahead of being sampled
+	bench.Run("sample_random_prefetched", name, 0, randomCount, [&]() {
+		const uint32_t PREFETCH_DISTANCE = 8;
+		float sum = 0.f;
+		for (uint32_t i = 0; i < randomCount; i++) {
+			const uint32_t ahead = i + PREFETCH_DISTANCE;
+			if (ahead < randomCount) texture.Prefetch(uvl[ahead * 3 + 0], uvl[ahead * 3 + 1], 0, uvl[ahead * 3 + 2], 0, 0);
+			sum += texture.Sample(uvl[i * 3 + 0], uvl[i * 3 + 1], 0, uvl[i * 3 + 2], 0, 0).r;
+		}
+		gSink = gSink + sum;
+	});
+
+	bench.Run("sample_nearest_random", name, 0, randomCount, [&]() {
+		float sum = 0.f;
+		for (uint32_t i = 0; i < randomCount; i++)
+			sum += texture.SampleNearest(uvl[i * 3 + 0], uvl[i * 3 + 1], 0, uvl[i * 3 + 2], 0, 0).r;
+		gSink = gSink + sum;
+	});
+
+	std::vector<float> nearestU(randomCount), nearestV(randomCount);
+	std::vector<VTFPixel> nearestOut(randomCount);
+	for (uint32_t i = 0; i < randomCount; i++) {
+		nearestU[i] = uvl[i * 3 + 0];
+		nearestV[i] = uvl[i * 3 + 1];
+	}
+
+	bench.Run("sample_nearest_batch", name, 0, randomCount, [&]() {
+		texture.SampleNearestBatch(nearestU.data(), nearestV.data(), 0.f, 0, randomCount, nearestOut.data());
+		gSink = gSink + nearestOut[0].r;
+	});
+
+	bench.Run("sample_normal_random", name, 0, randomCount, [&]() {
+		float sum = 0.f;
+		for (uint32_t i = 0; i < randomCount; i++)
+			sum += texture.SampleNormal(uvl[i * 3 + 0], uvl[i * 3 + 1], 0, uvl[i * 3 + 2], 0, 0).x;
+		gSink = gSink + sum;
+	});
+
+	// DXT, ATI1N and ATI2N are also loaded and sampled straight from their blocks
+	if (VTFParser::CanSampleBlocks(spec.format) && spec.depth == 1) {
+		VTFLoadOptions blockOptions;
+		blockOptions.sampleBlocks = true;
+		bench.Run("load_blocks", name, file.size(), 0, [&]() {
+			VTFTexture blocks(file.data(), file.size(), blockOptions);
+			gSink = gSink + blocks.IsBlockCompressed();
+		});
+
+		const VTFTexture blocks(file.data(), file.size(), blockOptions);
+		bench.Run("sample_random_blocks", name, 0, randomCount, [&]() {
+			float sum = 0.f;
+			for (uint32_t i = 0; i < randomCount; i++)
+				sum += blocks.Sample(uvl[i * 3 + 0], uvl[i * 3 + 1], 0, uvl[i * 3 + 2], 0, 0).r;
+			gSink = gSink + sum;
+		});
+
+		bench.Run("sample_normal_random_blocks", name, 0, randomCount, [&]() {
+			float sum = 0.f;
+			for (uint32_t i = 0; i < randomCount; i++)
+				sum += blocks.SampleNormal(uvl[i * 3 + 0], uvl[i * 3 + 1], 0, uvl[i * 3 + 2], 0, 0).x;
+			gSink = gSink + sum;
+		});
+	}
+
+	// Uncompressed colour textures are also encoded to DXT at load, then sampled from the blocks
+	VTFLoadOptions transcodeOptions;
+	transcodeOptions.transcodeToDXT = true;
+	transcodeOptions.transcodeMinPixels = 0;
+	const VTFTexture transcoded(file.data(), file.size(), transcodeOptions);
+	if (transcoded.IsTranscoded()) {
+		fprintf(stderr, "%-24s %-40s %12.2f dB\n", "transcode_psnr", name.c_str(), transcoded.GetTranscodePSNR());
+
+		bench.Run("load_transcode", name, file.size(), 0, [&]() {
+			VTFTexture texture(file.data(), file.size(), transcodeOptions);
+			gSink = gSink + texture.IsTranscoded();
+		});
+
+		bench.Run("sample_random_transcoded", name, 0, randomCount, [&]() {
+			float sum = 0.f;
+			for (uint32_t i = 0; i < randomCount; i++)
+				sum += transcoded.Sample(uvl[i * 3 + 0], uvl[i * 3 + 1], 0, uvl[i * 3 + 2], 0, 0).r;
+			gSink = gSink + sum;
+		});
+	}
+
+	// Envmaps are also sampled by direction, projected onto spherical harmonics, prefiltered and unwrapped
+	if (texture.IsEnvmap()) {
+		std::vector<float> dirs(randomCount * 3);
+		Random dirRandom(seed + 1);
+		for (float& component : dirs) component = dirRandom.NextFloat() * 2.f - 1.f;
+
+		bench.Run("sample_cube_random", name, 0, randomCount, [&]() {
+			float sum = 0.f;
+			for (uint32_t i = 0; i < randomCount; i++)
+				sum += texture.SampleCube(dirs[i * 3 + 0], dirs[i * 3 + 1], dirs[i * 3 + 2], uvl[i * 3 + 2]).r;
+			gSink = gSink + sum;
+		});
+
+		Envmap::SH sh;
+		const uint64_t texels = static_cast<uint64_t>(width) * height * ENVMAP_FACES;
+		bench.Run("project_sh3", name, 0, texels, [&]() {
+			gSink = gSink + texture.ProjectSH(0, 0, 3, sh);
+		});
+
+		bench.Run("eval_irradiance_random", name, 0, randomCount, [&]() {
+			float sum = 0.f;
+			for (uint32_t i = 0; i < randomCount; i++)
+				sum += Envmap::EvalIrradiance(sh, dirs[i * 3 + 0], dirs[i * 3 + 1], dirs[i * 3 + 2]).r;
+			gSink = gSink + sum;
+		});
+
+		Envmap::PrefilterOptions prefilterOptions;
+		prefilterOptions.size = 32;
+		prefilterOptions.levelCount = 6;
+		std::vector<float> prefiltered;
+		for (Envmap::FILTER filter : { Envmap::FILTER::IRRADIANCE, Envmap::FILTER::GGX }) {
+			prefilterOptions.filter = filter;
+			bench.Run(filter == Envmap::FILTER::GGX ? "prefilter_ggx" : "prefilter_irradiance", name, 0, 0, [&]() {
+				gSink = gSink + texture.PrefilterEnvmap(prefilterOptions, 0, prefiltered);
+			});
+		}
+
+		// Twice as wide as a face so the image has about as many texels as the cube
+		Envmap::UnwrapOptions unwrapOptions;
+		unwrapOptions.width = static_cast<uint16_t>(std::min<uint32_t>(width * 2, UINT16_MAX));
+		unwrapOptions.height = static_cast<uint16_t>(width);
+		const uint64_t unwrapTexels = static_cast<uint64_t>(unwrapOptions.width) * unwrapOptions.height;
+		std::vector<float> unwrapped;
+		for (Envmap::LAYOUT layout : { Envmap::LAYOUT::EQUIRECTANGULAR, Envmap::LAYOUT::OCTAHEDRAL }) {
+			unwrapOptions.layout = layout;
+			unwrapOptions.filter = Envmap::RESAMPLE::BILINEAR;
+			bench.Run(layout == Envmap::LAYOUT::OCTAHEDRAL ? "unwrap_octahedral" : "unwrap_equirect", name, 0, unwrapTexels, [&]() {
+				gSink = gSink + texture.UnwrapEnvmap(unwrapOptions, 0, 0, unwrapped);
+			});
+		}
+
+		unwrapOptions.layout = Envmap::LAYOUT::EQUIRECTANGULAR;
+		unwrapOptions.filter = Envmap::RESAMPLE::BOX;
+		bench.Run("unwrap_equirect_box", name, 0, unwrapTexels, [&]() {
+			gSink = gSink + texture.UnwrapEnvmap(unwrapOptions, 0, 0, unwrapped);
+		});
+	}
+
+	// Alpha testing through the mask, only for textures with alpha (the corpus is noise, so most lookups still sample)
+	VTFLoadOptions maskOptions;
+	maskOptions.buildAlphaMask = true;
+	bench.Run("load_alpha_mask", name, file.size(), 0, [&]() {
+		VTFTexture masked(file.data(), file.size(), maskOptions);
+		gSink = gSink + masked.HasAlphaMask();
+	});
+
+	const VTFTexture masked(file.data(), file.size(), maskOptions);
+	if (masked.HasAlphaMask()) {
+		bench.Run("alpha_test_random", name, 0, randomCount, [&]() {
+			uint32_t passed = 0;
+			for (uint32_t i = 0; i < randomCount; i++)
+				passed += masked.AlphaTest(uvl[i * 3 + 0], uvl[i * 3 + 1], 0.5f);
+			gSink = gSink + passed;
+		});
+	}
+
+	if (texture.GetDepth() <= 1) return;
+
+	// Volumes are also sampled in 3D like a colour grading LUT, from linear slices and from bricks
+	std::vector<float> u(randomCount), v(randomCount), w(randomCount);
+	std::vector<VTFPixel> out(randomCount);
+	for (uint32_t i = 0; i < randomCount; i++) {
+		u[i] = random.NextFloat();
+		v[i] = random.NextFloat();
+		w[i] = random.NextFloat();
+	}
+
+	VTFLoadOptions brickOptions;
+	brickOptions.brickVolumes = true;
+	const VTFTexture bricked(file.data(), file.size(), brickOptions);
+
+	const VTFTexture* ppTextures[2] = { &texture, &bricked };
+	for (const VTFTexture* pTexture : ppTextures) {
+		const std::string suffix = pTexture->IsBricked() ? "_bricked" : "";
+
+		bench.Run("sample3d_random" + suffix, name, 0, randomCount, [&]() {
+			float sum = 0.f;
+			for (uint32_t i = 0; i < randomCount; i++)
+				sum += pTexture->Sample3D(u[i], v[i], w[i], 0.f).r;
+			gSink = gSink + sum;
+		});
+
+		bench.Run("sample3d_batch" + suffix, name, 0, randomCount, [&]() {
+			pTexture->Sample3DBatch(u.data(), v.data(), w.data(), 0.f, 0, randomCount, out.data());
+			gSink = gSink + out[0].r;
+		});
+	}
+}
+
+// Many small textures sampled with a random texture per lane, separate VTFTextures against one VTFTexturePool
+static void BenchPool(Bench& bench, const BenchConfig& config)
+{
+	std::vector<std::unique_ptr<VTFTexture>> textures;
+	VTFTexturePool pool;
+
+	std::vector<uint8_t> file;
+	for (const CorpusSpec& spec : BuildCorpus(std::min<uint16_t>(config.maxSize, 256), config.maxBytes)) {
+		if (spec.format != IMAGE_FORMAT::DXT1 && spec.format != IMAGE_FORMAT::BGRA8888 && spec.format != IMAGE_FORMAT::RGBA8888) continue;
+		if (!GenerateVTF(spec, config.seed, file)) continue;
+
+		std::unique_ptr<VTFTexture> pTexture = std::make_unique<VTFTexture>(file.data(), file.size());
+		if (!pTexture->IsValid() || pool.Add(*pTexture) == VTF_POOL_INVALID_HANDLE) continue;
+		textures.push_back(std::move(pTexture));
+	}
+	if (textures.empty()) return;
+
+	const uint32_t laneCount = 1u << 16;
+	std::vector<VTFPoolHandle> handles(laneCount);
+	std::vector<float> u(laneCount), v(laneCount), lod(laneCount);
+	Random random(config.seed);
+	for (uint32_t i = 0; i < laneCount; i++) {
+		handles[i] = static_cast<VTFPoolHandle>(random.Next() % textures.size());
+		u[i] = random.NextFloat();
+		v[i] = random.NextFloat();
+		lod[i] = random.NextFloat() * 2.f;
+	}
+
+	const std::string subject = std::to_string(textures.size()) + "_textures";
+	bench.Run("texture_sample_lanes", subject, 0, laneCount, [&]() {
+		float sum = 0.f;
+		for (uint32_t i = 0; i < laneCount; i++)
+			sum += textures[handles[i]]->Sample(u[i], v[i], lod[i]).r;
+		gSink = gSink + sum;
+	});
+
+	std::vector<VTFPixel> out(laneCount);
+	bench.Run("pool_sample_batch", subject, 0, laneCount, [&]() {
+		pool.SampleBatch(handles.data(), u.data(), v.data(), lod.data(), laneCount, out.data());
+		gSink = gSink + out[0].r;
+	});
+
+	// Every texture added twice, so each subimage is hashed twice and the second copies are all shared
+	size_t imageBytes = 0;
+	for (const std::unique_ptr<VTFTexture>& pTexture : textures) imageBytes += pTexture->GetImageDataSize();
+
+	VTFTexturePool duplicates;
+	duplicates.Reserve(imageBytes, textures.size() * 2);
+	bench.Run("pool_add_duplicates", subject, imageBytes * 2, 0, [&]() {
+		duplicates.Clear();
+		for (int copy = 0; copy < 2; copy++) {
+			for (const std::unique_ptr<VTFTexture>& pTexture : textures) duplicates.Add(*pTexture);
+		}
+		gSink = gSink + duplicates.GetCount();
+	});
+	if (duplicates.GetCount() != 0)
+		fprintf(stderr, "%-24s %-40s %12zu bytes saved\n", "pool_dedup", subject.c_str(), duplicates.GetDedupStats().savedBytes);
+	if (duplicates.GetCount() != textures.size() * 2) return;
+
+	// Removing both copies of every other texture frees their blocks, moving the rest down, which must still read the same texels
+	const size_t singleArenaSize = pool.GetArenaSize();
+	for (size_t i = 0; i < textures.size(); i += 2) {
+		duplicates.Remove(static_cast<VTFPoolHandle>(i));
+		duplicates.Remove(static_cast<VTFPoolHandle>(textures.size() + i));
+	}
+	if (duplicates.GetCount() != textures.size() / 2 * 2 || duplicates.GetArenaSize() > singleArenaSize)
+		bench.Fail("pool_remove/" + subject + " didn't free the removed textures");
+
+	for (size_t i = 1; i < textures.size(); i += 2) {
+		const VTFTexture& texture = *textures[i];
+		for (uint8_t mip = 0; mip < texture.GetMIPLevels(); mip++) {
+			const uint16_t x = texture.GetWidth(mip) - 1, y = texture.GetHeight(mip) / 2;
+			const VTFPixel expected = texture.GetPixel(x, y, mip);
+			const VTFPixel pixel = duplicates.GetPixel(static_cast<VTFPoolHandle>(i), x, y, 0, mip, 0, 0);
+			const VTFPixel copy = duplicates.GetPixel(static_cast<VTFPoolHandle>(textures.size() + i), x, y, 0, mip, 0, 0);
+			if (memcmp(&expected, &pixel, sizeof(VTFPixel)) != 0 || memcmp(&expected, &copy, sizeof(VTFPixel)) != 0) {
+				bench.Fail("pool_remove/" + subject + " moved a subimage incorrectly");
+				return;
+			}
+		}
+	}
+
+	for (size_t i = 1; i < textures.size(); i += 2) {
+		duplicates.Remove(static_cast<VTFPoolHandle>(i));
+		duplicates.Remove(static_cast<VTFPoolHandle>(textures.size() + i));
+	}
+	if (duplicates.GetCount() != 0 || duplicates.GetArenaSize() != 0 || !duplicates.GetBlocks().empty())
+		bench.Fail("pool_remove/" + subject + " didn't free every block");
+}
+
+static void BenchDXTn(Bench& bench, const BenchConfig& config)
+{
+	struct Codec
+	{
+		const char* name;
+		void (*decompress)(const uint8_t*, uint8_t*, uint32_t, uint32_t);
+	};
+	const Codec codecs[] = {
+		{ "dxt1", DXTn::DecompressDXT1 },
+		{ "dxt3", DXTn::DecompressDXT3 },
+		{ "dxt5", DXTn::DecompressDXT5 },
+		{ "ati1n", DXTn::DecompressATI1N },
+		{ "ati2n", DXTn::DecompressATI2N }
+	};
+
+	const struct
+	{
+		const char* name;
+		DXTn::QUALITY quality;
+		uint16_t maxSize; // Cluster fit is orders of magnitude slower, keep its runs short
+	} qualities[] = {
+		{ "bounding_box", DXTn::QUALITY::BOUNDING_BOX, 4096 },
+		{ "range_fit", DXTn::QUALITY::RANGE_FIT, 4096 },
+		{ "cluster_fit", DXTn::QUALITY::CLUSTER_FIT, 256 }
+	};
+
+	const uint16_t sizes[] = { 64, 256, 1024, 4096 };
+	for (uint16_t size : sizes) {
+		if (size > config.maxSize) break;
+
+		const std::string subject = std::to_string(size) + 'x' + std::to_string(size);
+		const uint64_t pixels = static_cast<uint64_t>(size) * size;
+
+		// Random blocks to decompress, and a noisy gradient to compress
+		Random random(config.seed + size);
+		std::vector<uint8_t> blocks(pixels);
+		for (size_t i = 0; i + 8 <= blocks.size(); i += 8) {
+			uint64_t bits = random.Next();
+			memcpy(blocks.data() + i, &bits, 8);
+		}
+
+		std::vector<uint8_t> rgba(pixels * 4);
+		for (uint32_t y = 0; y < size; y++) {
+			for (uint32_t x = 0; x < size; x++) {
+				uint64_t noise = random.Next();
+				uint8_t* pPixel = rgba.data() + (static_cast<size_t>(y) * size + x) * 4;
+				pPixel[0] = static_cast<uint8_t>(x * 255 / size + (noise & 15));
+				pPixel[1] = static_cast<uint8_t>(y * 255 / size + ((noise >> 4) & 15));
+				pPixel[2] = static_cast<uint8_t>((x + y) * 127 / size + ((noise >> 8) & 15));
+				pPixel[3] = static_cast<uint8_t>(255 - x * 255 / size);
+			}
+		}
+
+		std::vector<uint8_t> decoded(pixels * 4);
+		for (const Codec& codec : codecs) {
+			bench.Run(std::string("decompress_") + codec.name, subject, pixels * 4, pixels, [&]() {
+				codec.decompress(blocks.data(), decoded.data(), size, size);
+				gSink = gSink + decoded[0];
+			});
+		}
+
+		for (const auto& quality : qualities) {
+			if (size > quality.maxSize) continue;
+
+			bench.Run(std::string("compress_dxt1_") + quality.name, subject, pixels * 4, pixels, [&]() {
+				DXTn::CompressDXT1(rgba.data(), blocks.data(), size, size, quality.quality);
+				gSink = gSink + blocks[0];
+			});
+			bench.Run(std::string("compress_dxt3_") + quality.name, subject, pixels * 4, pixels, [&]() {
+				DXTn::CompressDXT3(rgba.data(), blocks.data(), size, size, quality.quality);
+				gSink = gSink + blocks[0];
+			});
+			bench.Run(std::string("compress_dxt5_") + quality.name, subject, pixels * 4, pixels, [&]() {
+				DXTn::CompressDXT5(rgba.data(), blocks.data(), size, size, quality.quality);
+				gSink = gSink + blocks[0];
+			});
+		}
+	}
+}
+
+/// <summary>
+/// Runs work(thread) on each of threadCount threads (the calling thread is thread 0) and checks every thread's result against expected
+/// </summary>
+/// <returns>Whether every thread returned exactly what it did when run alone</returns>
+template<typename F>
+static bool RunThreads(uint32_t threadCount, const std::vector<float>& expected, F&& work)
+{
+	// One cache line per thread, so the results themselves don't false share
+	struct alignas(64) Slot
+	{
+		float sum;
+	};
+	std::vector<Slot> slots(threadCount);
+
+	std::vector<std::thread> threads;
+	threads.reserve(threadCount - 1);
+	for (uint32_t thread = 1; thread < threadCount; thread++)
+		threads.emplace_back([&, thread]() { slots[thread].sum = work(thread); });
+	slots[0].sum = work(0);
+	for (std::thread& thread : threads) thread.join();
+
+	bool matched = true;
+	for (uint32_t thread = 0; thread < threadCount; thread++) matched &= slots[thread].sum == expected[thread];
+	gSink = gSink + slots[0].sum;
+	return matched;
+}
+
+// Shared const textures read from 1 to N threads, every thread doing the same amount of work on its own lanes,
+// with coherent lanes (a raster walk over a band of rows per thread) and incoherent lanes (random uvs)
+static void BenchThreads(Bench& bench, const BenchConfig& config)
+{
+	const uint32_t maxThreads = config.maxThreads != 0 ? config.maxThreads : std::max(std::thread::hardware_concurrency(), 1u);
+	std::vector<uint32_t> threadCounts;
+	for (uint32_t count = 1; count < maxThreads; count *= 2) threadCounts.push_back(count);
+	threadCounts.push_back(maxThreads);
+
+	const uint32_t laneCount = 1u << 14; // Per thread
+	const uint16_t size = std::min<uint16_t>(config.maxSize, 1024);
+
+	std::vector<uint8_t> file;
+	for (IMAGE_FORMAT format : { IMAGE_FORMAT::RGBA8888, IMAGE_FORMAT::RGBA16161616 }) {
+		CorpusSpec spec;
+		spec.format = format;
+		spec.width = spec.height = size;
+		spec.mipmapCount = Mipmaps::CalcFullChainLength(size, size, 1);
+		if (!GenerateVTF(spec, config.seed, file)) continue;
+
+		VTFTexture texture(file.data(), file.size());
+		VTFTexturePool pool;
+		const VTFPoolHandle handle = pool.Add(texture);
+		if (!texture.IsValid() || handle == VTF_POOL_INVALID_HANDLE) continue;
+
+		for (bool coherent : { true, false }) {
+			const std::string subject = spec.Name() + (coherent ? "_coherent" : "_incoherent");
+
+			std::vector<std::vector<uint16_t>> xs(maxThreads), ys(maxThreads);
+			std::vector<std::vector<float>> us(maxThreads), vs(maxThreads);
+			Random random(config.seed + 7);
+			for (uint32_t thread = 0; thread < maxThreads; thread++) {
+				const uint32_t firstRow = static_cast<uint32_t>(static_cast<uint64_t>(thread) * size / maxThreads);
+				for (uint32_t i = 0; i < laneCount; i++) {
+					const uint32_t x = coherent ? i % size : static_cast<uint32_t>(random.Next() % size);
+					const uint32_t y = coherent ? (firstRow + i / size) % size : static_cast<uint32_t>(random.Next() % size);
+					xs[thread].push_back(static_cast<uint16_t>(x));
+					ys[thread].push_back(static_cast<uint16_t>(y));
+					us[thread].push_back((x + 0.5f) / size);
+					vs[thread].push_back((y + 0.5f) / size);
+				}
+			}
+
+			// Every thread has its own output buffers, reads of the texture are the only shared accesses
+			std::vector<std::vector<VTFPixel>> outs(maxThreads, std::vector<VTFPixel>(laneCount));
+			const std::vector<VTFPoolHandle> handles(laneCount, handle);
+			const std::vector<float> lods(laneCount, 0.f);
+
+			const std::pair<const char*, std::function<float(uint32_t)>> paths[] = {
+				{ "threads_get_pixel", [&](uint32_t thread) {
+					float sum = 0.f;
+					for (uint32_t i = 0; i < laneCount; i++) sum += texture.GetPixel(xs[thread][i], ys[thread][i], 0, 0, 0, 0).r;
+					return sum;
+				} },
+				{ "threads_sample", [&](uint32_t thread) {
+					float sum = 0.f;
+					for (uint32_t i = 0; i < laneCount; i++) sum += texture.Sample(us[thread][i], vs[thread][i], 0, 0.f, 0, 0).r;
+					return sum;
+				} },
+				{ "threads_sample_nearest_batch", [&](uint32_t thread) {
+					texture.SampleNearestBatch(us[thread].data(), vs[thread].data(), 0.f, 0, laneCount, outs[thread].data());
+					float sum = 0.f;
+					for (const VTFPixel& pixel : outs[thread]) sum += pixel.r;
+					return sum;
+				} },
+				{ "threads_pool_sample_batch", [&](uint32_t thread) {
+					pool.SampleBatch(handles.data(), us[thread].data(), vs[thread].data(), lods.data(), laneCount, outs[thread].data());
+					float sum = 0.f;
+					for (const VTFPixel& pixel : outs[thread]) sum += pixel.r;
+					return sum;
+				} }
+			};
+
+			for (const auto& path : paths) {
+				// What each thread's lanes give when run alone, every run on more threads has to match it exactly
+				std::vector<float> expected(maxThreads);
+				for (uint32_t thread = 0; thread < maxThreads; thread++) expected[thread] = path.second(thread);
+
+				bool matched = true;
+				bench.RunScaling(path.first, subject, threadCounts, laneCount, [&](uint32_t threadCount) {
+					matched &= RunThreads(threadCount, expected, path.second);
+				});
+				if (!matched) bench.Fail(std::string(path.first) + '/' + subject + " returned different results on multiple threads");
+			}
+
+			// Counters are sharded per thread, check none of the increments were lost
+			const VTFStats::Snapshot before = texture.GetStats();
+			if (before.enabled) {
+				RunThreads(maxThreads, std::vector<float>(maxThreads), paths[1].second);
+				const VTFStats::Snapshot after = texture.GetStats();
+				if (after.sampleCalls - before.sampleCalls != static_cast<uint64_t>(maxThreads) * laneCount)
+					bench.Fail("threads_sample/" + subject + " lost sample counter increments");
+			}
+		}
+	}
+}
+
+/// <summary>
+/// Checks image data past 4 GiB is addressed correctly: a 32768x32769 DXT1 texture decodes to 4 GiB + 128 KiB of RGBA8888,
+/// whose last row starts exactly at the 4 GiB offset, and a truncated file claiming 8 GiB of image data has to be rejected.
+/// Needs about 5 GiB of memory, so it only runs with --stress-4gib
+/// </summary>
+static void Stress4GiB(Bench& bench, const BenchConfig& config)
+{
+	const uint32_t STRESS_WIDTH = 32768, STRESS_HEIGHT = 32769;
+
+	CorpusSpec spec;
+	spec.format = IMAGE_FORMAT::DXT1;
+	spec.width = STRESS_WIDTH;
+	spec.height = STRESS_HEIGHT;
+
+	std::vector<uint8_t> file;
+	if (!GenerateVTF(spec, config.seed, file)) {
+		bench.Fail("stress_4gib/" + spec.Name() + " couldn't be generated");
+		return;
+	}
+
+	// Decode the first and last row of blocks by hand, the last row of texels is the only one past 4 GiB
+	const size_t blockRowSize = STRESS_WIDTH / 4 * 8;
+	const uint32_t rows[] = { 0, STRESS_HEIGHT - 1 };
+	std::vector<uint8_t> expected[2];
+	for (int i = 0; i < 2; i++) {
+		expected[i].resize(static_cast<size_t>(STRESS_WIDTH) * 4);
+		DXTn::DecompressDXT1(file.data() + 80 + rows[i] / 4 * blockRowSize, expected[i].data(), STRESS_WIDTH, 1);
+	}
+
+	{
+		VTFTexture texture(file.data(), file.size());
+		std::vector<uint8_t>().swap(file);
+
+		const size_t rowSize = static_cast<size_t>(STRESS_WIDTH) * 4;
+		if (!texture.IsValid()) {
+			bench.Fail("stress_4gib/" + spec.Name() + " failed to load");
+		} else if (texture.GetImageDataSize() != rowSize * STRESS_HEIGHT || rowSize * rows[1] != (1ull << 32)) {
+			bench.Fail("stress_4gib/" + spec.Name() + " decoded to the wrong size");
+		} else {
+			for (int i = 0; i < 2; i++) {
+				const uint8_t* pRow = texture.GetImageData() + rowSize * rows[i];
+				bool matched = memcmp(pRow, expected[i].data(), rowSize) == 0;
+
+				for (uint32_t x = 0; x < STRESS_WIDTH; x += 4093) {
+					const VTFPixel pixel = texture.GetPixel(static_cast<uint16_t>(x), static_cast<uint16_t>(rows[i]), 0);
+					matched &= static_cast<uint8_t>(pixel.r * 255.f + 0.5f) == expected[i][x * 4];
+				}
+
+				if (!matched) bench.Fail("stress_4gib/" + spec.Name() + " row " + std::to_string(rows[i]) + " doesn't match its blocks");
+			}
+		}
+	}
+
+	// Header claiming 32768x32768 RGBA16161616F (8 GiB) in front of a single texel
+	CorpusSpec truncated;
+	truncated.format = IMAGE_FORMAT::RGBA16161616F;
+	GenerateVTF(truncated, config.seed, file);
+
+	VTFHeader header;
+	memcpy(&header, file.data(), 80);
+	header.width = header.height = 32768;
+	memcpy(file.data(), &header, 80);
+
+	VTFTexture texture(file.data(), file.size());
+	if (texture.IsValid()) bench.Fail("stress_4gib/truncated_8gib loaded past the end of the file");
+
+	fprintf(stderr, "%-24s %-40s %12s\n", "stress_4gib", spec.Name().c_str(), bench.GetFailureCount() == 0 ? "passed" : "failed");
+}
+
+/// <summary>
+/// Checks VPKArchive against version 1 and 2 fixtures written to the temporary directory, covering files in chunks, embedded in the directory file,
+/// preload only, split between preload bytes and a chunk and without an extension, a missing chunk, and trees that are truncated or corrupt
+/// </summary>
+static void CheckVPK(Bench& bench, const BenchConfig& config)
+{
+	const std::filesystem::path directory = std::filesystem::temp_directory_path() / "vtfparser_bench_vpk";
+	std::error_code error;
+	std::filesystem::create_directories(directory, error);
+
+	CorpusSpec spec;
+	spec.format = IMAGE_FORMAT::DXT1;
+	spec.width = spec.height = 64;
+	spec.mipmapCount = 7;
+
+	std::vector<VPKFixtureFile> files(6);
+	files[0].path = "materials/brick/wall.vtf";
+	files[0].archiveIndex = 0;
+	GenerateVTF(spec, config.seed, files[0].data);
+	files[1].path = "materials/brick/wall_detail.vtf";
+	files[1].archiveIndex = 2; // Chunk 1 is never referenced, so isn't written
+	GenerateVTF(spec, config.seed + 1, files[1].data);
+	files[2].path = "materials/embedded.vmt";
+	files[2].data.assign(200, 'e');
+	files[3].path = "scripts/preload.txt";
+	files[3].data.assign(48, 'p');
+	files[3].preloadBytes = 48;
+	files[4].path = "materials/split.vtf";
+	files[4].archiveIndex = 0;
+	files[4].preloadBytes = 80; // The header, so the preload bytes alone make a header only texture
+	GenerateVTF(spec, config.seed + 2, files[4].data);
+	files[5].path = "README";
+	files[5].data.assign(33, 'r');
+
+	for (uint32_t version = 1; version <= 2; version++) {
+		const std::string name = "vpk/v" + std::to_string(version);
+		const std::string prefix = (directory / ("pak" + std::to_string(version) + "_")).string();
+
+		VPKFixture fixture;
+		if (!BuildVPK(files, version, fixture) || !WriteVPK(fixture, prefix)) {
+			bench.Fail(name + " fixture couldn't be written to " + directory.string());
+			continue;
+		}
+
+		{
+			VPKArchive archive(prefix + "dir.vpk");
+			if (!archive.IsValid() || archive.GetVersion() != version || archive.GetCount() != files.size()) {
+				bench.Fail(name + " failed to open");
+				continue;
+			}
+
+			for (const VPKFixtureFile& file : files) {
+				const VPKEntry* pEntry = archive.Find(file.path);
+				std::vector<uint8_t> data;
+				std::string path = file.path;
+				std::transform(path.begin(), path.end(), path.begin(), [](char c) { return static_cast<char>(tolower(c)); });
+				if (pEntry == nullptr || archive.GetPath(*pEntry) != path || !archive.ReadData(*pEntry, data) || data != file.data) {
+					bench.Fail(name + '/' + file.path + " didn't read back");
+					continue;
+				}
+
+				// Only files stored in one piece have a span
+				VPKSpan span;
+				const bool contiguous = file.preloadBytes == 0 || file.preloadBytes == file.data.size();
+				if (archive.GetData(*pEntry, &span) != contiguous || (contiguous && (span.size != data.size() || memcmp(span.pData, data.data(), data.size()) != 0)))
+					bench.Fail(name + '/' + file.path + " span doesn't match");
+
+				const VPKSpan preload = archive.GetPreload(*pEntry);
+				if (preload.size != file.preloadBytes || (preload.size != 0 && memcmp(preload.pData, data.data(), preload.size) != 0))
+					bench.Fail(name + '/' + file.path + " preload bytes don't match");
+			}
+
+			if (archive.Find("MATERIALS\\Brick\\WALL.vtf") != archive.Find("materials/brick/wall.vtf"))
+				bench.Fail(name + " lookups aren't case and slash insensitive");
+
+			VPKSpan span;
+			VTFLoadOptions headerOnly;
+			headerOnly.headerOnly = true;
+			const VPKSpan preload = archive.GetPreload(*archive.Find("materials/split.vtf"));
+			if (!archive.GetData(*archive.Find("materials/brick/wall.vtf"), &span) || !VTFTexture(span.pData, span.size).IsValid() ||
+				!VTFTexture(preload.pData, preload.size, headerOnly).IsValid())
+				bench.Fail(name + " textures can't be loaded from spans");
+
+			const std::string_view paths[] = { "scripts/preload.txt", "missing.vtf", "readme", "materials/embedded.vmt" };
+			VPKSpan spans[4];
+			if (archive.GetDataMany(paths, 4, spans) != 3 || spans[1].pData != nullptr)
+				bench.Fail(name + " GetDataMany found the wrong paths");
+		}
+
+		// A missing chunk leaves the archive valid but its files unreadable
+		std::filesystem::remove(prefix + "002.vpk", error);
+		{
+			VPKArchive archive(prefix + "dir.vpk");
+			std::vector<uint8_t> data;
+			VPKSpan span;
+			const VPKEntry* pEntry = archive.Find("materials/brick/wall_detail.vtf");
+			if (!archive.IsValid() || pEntry == nullptr || archive.ReadData(*pEntry, data) || archive.GetData(*pEntry, &span))
+				bench.Fail(name + " reads from a missing chunk");
+		}
+
+		// Corruptions that have to be rejected, offsets are into the first entry of the tree (the extensionless README in the root)
+		const size_t entryOffset = fixture.headerSize + strlen(" ") + 1 + strlen(" ") + 1 + strlen("README") + 1;
+		const auto corrupt = [&](const char* pCase, const std::function<void(std::vector<uint8_t>&)>& modify) {
+			std::vector<uint8_t> bytes = fixture.directory;
+			modify(bytes);
+
+			VPKFixture corrupted;
+			corrupted.directory = bytes;
+			if (!WriteVPK(corrupted, prefix + "bad_") || VPKArchive(prefix + "bad_dir.vpk").IsValid())
+				bench.Fail(name + '/' + pCase + " wasn't rejected");
+		};
+
+		corrupt("truncated_tree", [&](std::vector<uint8_t>& bytes) {
+			// Tree ends inside the last directory's terminators
+			const uint32_t treeSize = static_cast<uint32_t>(fixture.treeSize - 2);
+			memcpy(bytes.data() + 8, &treeSize, 4);
+		});
+		corrupt("truncated_entry", [&](std::vector<uint8_t>& bytes) {
+			const uint32_t treeSize = static_cast<uint32_t>(entryOffset - fixture.headerSize + 10);
+			memcpy(bytes.data() + 8, &treeSize, 4);
+		});
+		corrupt("bad_terminator", [&](std::vector<uint8_t>& bytes) { bytes[entryOffset + 16] = 0; });
+		corrupt("preload_past_tree", [&](std::vector<uint8_t>& bytes) { bytes[entryOffset + 4] = bytes[entryOffset + 5] = 0xff; });
+		corrupt("truncated_file", [&](std::vector<uint8_t>& bytes) { bytes.resize(fixture.headerSize + fixture.treeSize / 2); });
+		corrupt("bad_signature", [&](std::vector<uint8_t>& bytes) { bytes[0] ^= 0xff; });
+		corrupt("bad_version", [&](std::vector<uint8_t>& bytes) { bytes[4] = 3; });
+	}
+
+	std::filesystem::remove_all(directory, error);
+}
+
+static void PrintUsage(const char* pName)
+{
+	fprintf(stderr,
+		"Usage: %s [options]\n"
+		"  --max-size N     Largest texture width and height to generate (default 8192)\n"
+		"  --max-bytes N    Skip textures with more image data than this (default 67108864)\n"
+		"  --min-time MS    Minimum measured time per benchmark in milliseconds (default 100)\n"
+		"  --seed N         Seed for the generated corpus (default 1)\n"
+		"  --threads N      Most threads to run the scaling benchmarks on (default: hardware threads)\n"
+		"  --filter TEXT    Only run benchmarks whose \"benchmark/subject\" contains TEXT\n"
+		"  --output PATH    Write the JSON report to PATH instead of stdout\n"
+		"  --stress-4gib    Only check decoding past 4 GiB of image data (needs about 5 GiB of memory), exits with 1 on failure\n",
+		pName
+	);
+}
+
+int main(int argc, char** argv)
+{
+	BenchConfig config;
+
+	for (int i = 1; i < argc; i++) {
+		const char* pArg = argv[i];
+		const char* pValue = i + 1 < argc ? argv[i + 1] : nullptr;
+
+		if (strcmp(pArg, "--help") == 0) {
+			PrintUsage(argv[0]);
+			return 0;
+		}
+		if (strcmp(pArg, "--stress-4gib") == 0) {
+			config.stress4GiB = true;
+			continue;
+		}
+		if (pValue == nullptr) {
+			PrintUsage(argv[0]);
+			return 1;
+		}
+
+		if (strcmp(pArg, "--max-size") == 0)
+			config.maxSize = static_cast<uint16_t>(std::clamp(atoi(pValue), 1, 32768));
+		else if (strcmp(pArg, "--max-bytes") == 0)
+			config.maxBytes = strtoull(pValue, nullptr, 10);
+		else if (strcmp(pArg, "--min-time") == 0)
+			config.minSeconds = atof(pValue) / 1000.0;
+		else if (strcmp(pArg, "--seed") == 0)
+			config.seed = strtoull(pValue, nullptr, 10);
+		else if (strcmp(pArg, "--threads") == 0)
+			config.maxThreads = static_cast<uint32_t>(std::clamp(atoi(pValue), 1, 1024));
+		else if (strcmp(pArg, "--filter") == 0)
+			config.filter = pValue;
+		else if (strcmp(pArg, "--output") == 0)
+			config.outputPath = pValue;
+		else {
+			PrintUsage(argv[0]);
+			return 1;
+		}
+		i++;
+	}
+
+	Bench bench(config);
+
+	if (config.stress4GiB) {
+		Stress4GiB(bench, config);
+		return bench.GetFailureCount() == 0 ? 0 : 1;
+	}
+
+	std::vector<uint8_t> file;
+	for (const CorpusSpec& spec : BuildCorpus(config.maxSize, config.maxBytes)) {
+		if (!GenerateVTF(spec, config.seed, file)) continue;
+		BenchTexture(bench, spec, file, config.seed);
+	}
+
+	BenchPool(bench, config);
+	BenchDXTn(bench, config);
+	BenchThreads(bench, config);
+	CheckVPK(bench, config);
+
+	FILE* pFile = stdout;
+	if (!config.outputPath.empty()) {
+		pFile = fopen(config.outputPath.c_str(), "w");
+		if (pFile == nullptr) {
+			fprintf(stderr, "Failed to open %s\n", config.outputPath.c_str());
+			return 1;
+		}
+	}
+
+	bench.WriteJSON(pFile);
+	if (pFile != stdout) fclose(pFile);
+
+	return bench.GetFailureCount() == 0 ? 0 : 1;
+}
@@ -0,0 +1,160 @@
+#include "Corpus.h"
+#include "../FileFormat/Parser.h"
+#include "../FileFormat/Structs.h"
+
+#include <algorithm>
+#include <cstring>
+
+using namespace VTFBench;
+
+static bool IsBlockCompressed(IMAGE_FORMAT format)
+{
+	return VTFParser::GetImageFormatInfo(format).isCompressed;
+}
+
+static uint64_t CalcSubimageSize(uint16_t width, uint16_t height, uint16_t depth, IMAGE_FORMAT format)
+{
+	if (IsBlockCompressed(format)) {
+		uint64_t blockSize = VTFParser::GetImageFormatInfo(format).bitsPerPixel * 2; // 16 texels per block
+		return ((width + 3) / 4) * static_cast<uint64_t>((height + 3) / 4) * blockSize * depth;
+	}
+	return static_cast<uint64_t>(width) * height * depth * VTFParser::GetImageFormatInfo(format).bytesPerPixel;
+}
+
+std::string CorpusSpec::Name() const
+{
+	std::string name = VTFParser::GetImageFormatInfo(format).name;
+	name += '_' + std::to_string(width) + 'x' + std::to_string(height) + 'x' + std::to_string(depth);
+	name += "_m" + std::to_string(mipmapCount);
+	name += "_f" + std::to_string(frames);
+	name += "_c" + std::to_string(faces);
+	return name;
+}
+
+uint64_t CorpusSpec::ImageDataSize() const
+{
+	uint64_t size = 0;
+	for (uint8_t mip = 0; mip < mipmapCount; mip++) {
+		size += CalcSubimageSize(
+			std::max(width >> mip, 1), std::max(height >> mip, 1), std::max(depth >> mip, 1), format
+		);
+	}
+	return size * frames * faces;
+}
+
+bool VTFBench::GenerateVTF(const CorpusSpec& spec, uint64_t seed, std::vector<uint8_t>& out)
+{
+	if (spec.width == 0 || spec.height == 0 || spec.depth == 0 || spec.frames == 0 || spec.mipmapCount == 0) return false;
+	if (spec.faces != 1 && spec.faces != 6 && spec.faces != 7) return false;
+
+	const uint64_t imageDataSize = spec.ImageDataSize();
+	if (imageDataSize + 80 > UINT32_MAX) return false;
+
+	VTFHeader header;
+	memset(&header, 0, sizeof(VTFHeader));
+	memcpy(header.signature, "VTF\0", 4);
+	header.version[0] = 7;
+	header.version[1] = 2;
+	header.headerSize = 80;
+	header.width = spec.width;
+	header.height = spec.height;
+	header.depth = spec.depth;
+	header.flags = spec.flags;
+	header.frames = spec.frames;
+	header.mipmapCount = spec.mipmapCount;
+	header.highResImageFormat = spec.format;
+	header.lowResImageFormat = IMAGE_FORMAT::NONE;
+	header.bumpmapScale = 1.f;
+	header.reflectivity[0] = header.reflectivity[1] = header.reflectivity[2] = 0.5f;
+
+	// On 7.2 a first frame of 0xffff means 6 faces, anything else means 7 (the extra sphere map)
+	if (spec.faces != 1) {
+		header.flags |= static_cast<uint32_t>(TEXTURE_FLAGS::ENVMAP);
+		header.firstFrame = spec.faces == 6 ? 0xffff : 0;
+	}
+
+	out.assign(80 + imageDataSize, 0);
+	memcpy(out.data(), &header, 80);
+
+	Random random(seed);
+	uint8_t* pDst = out.data() + 80;
+
+	if (IsBlockCompressed(spec.format)) {
+		uint8_t* pEnd = pDst + imageDataSize;
+		for (; pDst + 8 <= pEnd; pDst += 8) {
+			uint64_t bits = random.Next();
+			memcpy(pDst, &bits, 8);
+		}
+		return true;
+	}
+
+	// Stored smallest to largest, then by frame, face and z slice
+	const uint32_t pixelSize = VTFParser::GetImageFormatInfo(spec.format).bytesPerPixel;
+	for (int mip = spec.mipmapCount - 1; mip >= 0; mip--) {
+		const uint32_t width = std::max(spec.width >> mip, 1);
+		const uint32_t height = std::max(spec.height >> mip, 1);
+		const uint32_t depth = std::max(spec.depth >> mip, 1);
+		const uint32_t slices = static_cast<uint32_t>(spec.frames) * spec.faces * depth;
+
+		for (uint32_t slice = 0; slice < slices; slice++) {
+			for (uint32_t y = 0; y < height; y++) {
+				for (uint32_t x = 0; x < width; x++) {
+					uint64_t noise = random.Next();
+					for (uint32_t channel = 0; channel < pixelSize; channel++) {
+						uint32_t gradient = channel % 3 == 0 ? x * 255 / width : (channel % 3 == 1 ? y * 255 / height : slice * 37);
+						*pDst++ = static_cast<uint8_t>(gradient + ((noise >> (channel * 4)) & 15));
+					}
+				}
+			}
+		}
+	}
+
+	return true;
+}
+
+std::vector<CorpusSpec> VTFBench::BuildCorpus(uint16_t maxSize, uint64_t maxBytes)
+{
+	const uint16_t sizes[] = { 4, 16, 64, 256, 1024, 4096, 8192 };
+
+	std::vector<CorpusSpec> corpus;
+	auto add = [&](const CorpusSpec& spec) {
+		if (spec.ImageDataSize() <= maxBytes) corpus.push_back(spec);
+	};
+
+	for (int32_t format = 0; format <= static_cast<int32_t>(IMAGE_FORMAT::ATI1N); format++) {
+		// Depth buffer formats can't be loaded
+		if (format > static_cast<int32_t>(IMAGE_FORMAT::UVLX8888) && !VTFParser::GetImageFormatInfo(static_cast<IMAGE_FORMAT>(format)).isSupported) continue;
+
+		for (uint16_t size : sizes) {
+			if (size > maxSize) break;
+
+			CorpusSpec spec;
+			spec.format = static_cast<IMAGE_FORMAT>(format);
+			spec.width = spec.height = size;
+			spec.mipmapCount = 1;
+			for (uint16_t s = size; s > 1; s >>= 1) spec.mipmapCount++;
+			add(spec);
+		}
+
+		CorpusSpec variant;
+		variant.format = static_cast<IMAGE_FORMAT>(format);
+		variant.width = variant.height = 64;
+		variant.mipmapCount = 7;
+
+		CorpusSpec animated = variant;
+		animated.frames = 8;
+		add(animated);
+
+		CorpusSpec envmap = variant;
+		envmap.faces = 6;
+		add(envmap);
+		envmap.faces = 7;
+		add(envmap);
+
+		CorpusSpec volume = variant;
+		volume.depth = 64;
+		add(volume);
+	}
+
+	return corpus;
+}
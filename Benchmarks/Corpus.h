@@ -0,0 +1,77 @@
+#pragma once
+
+#include "../FileFormat/Enums.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+/// <summary>
+/// Deterministic in memory VTF generator for the benchmarks
+/// </summary>
+namespace VTFBench
+{
+	struct CorpusSpec
+	{
+		IMAGE_FORMAT format = IMAGE_FORMAT::RGBA8888;
+		uint16_t width = 1;
+		uint16_t height = 1;
+		uint16_t depth = 1;
+		uint8_t mipmapCount = 1;
+		uint16_t frames = 1;
+		uint8_t faces = 1;  // 6 or 7 makes an envmap
+		uint32_t flags = 0; // Extra TEXTURE_FLAGS (ENVMAP is managed from the face count)
+
+		/// <summary>
+		/// Short unique name used as the key in the JSON report, e.g. DXT1_256x256x1_m9_f1_c1
+		/// </summary>
+		std::string Name() const;
+
+		/// <summary>
+		/// Size of the high res image data in bytes, in 64 bit so oversized specs can be filtered out
+		/// </summary>
+		uint64_t ImageDataSize() const;
+	};
+
+	/// <summary>
+	/// Small xorshift generator so the corpus is identical on every platform and standard library
+	/// </summary>
+	class Random
+	{
+	private:
+		uint64_t mState;
+
+	public:
+		explicit Random(uint64_t seed) : mState(seed ? seed : 0x9E3779B97F4A7C15ull) {}
+
+		uint64_t Next()
+		{
+			mState ^= mState << 13;
+			mState ^= mState >> 7;
+			mState ^= mState << 17;
+			return mState;
+		}
+
+		float NextFloat() { return static_cast<float>(Next() >> 40) / static_cast<float>(1 << 24); }
+	};
+
+	/// <summary>
+	/// Builds a version 7.2 VTF (80 byte header, no thumbnail) around seeded pixel data
+	/// Uncompressed formats get smooth gradients with noise so sampling isn't degenerate,
+	/// block compressed formats get random blocks, which are always valid
+	/// </summary>
+	/// <param name="spec">Description of the texture</param>
+	/// <param name="seed">Seed for the pixel data</param>
+	/// <param name="out">Vector to replace the contents of with the file</param>
+	/// <returns>False if the spec isn't representable (e.g. image data over 4 GiB)</returns>
+	bool GenerateVTF(const CorpusSpec& spec, uint64_t seed, std::vector<uint8_t>& out);
+
+	/// <summary>
+	/// Builds the standard corpus: every IMAGE_FORMAT with a full MIP chain at 4, 16, 64, 256, 1024, 4096 and 8192 squared,
+	/// plus animated, envmap (6 and 7 face) and volume variants at 64x64
+	/// </summary>
+	/// <param name="maxSize">Largest width and height to include</param>
+	/// <param name="maxBytes">Specs with more image data than this are skipped</param>
+	std::vector<CorpusSpec> BuildCorpus(uint16_t maxSize, uint64_t maxBytes);
+}
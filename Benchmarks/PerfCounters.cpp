@@ -0,0 +1,97 @@
+#include "PerfCounters.h"
+
+#include <initializer_list>
+
+#ifdef __linux__
+#  include <linux/perf_event.h>
+#  include <sys/ioctl.h>
+#  include <sys/syscall.h>
+#  include <unistd.h>
+#  include <cstring>
+#endif
+
+using namespace VTFBench;
+
+#ifdef __linux__
+static int OpenCounter(uint64_t config)
+{
+	perf_event_attr attr;
+	memset(&attr, 0, sizeof(attr));
+	attr.size = sizeof(attr);
+	attr.type = PERF_TYPE_HARDWARE;
+	attr.config = config;
+	attr.disabled = 1;
+	attr.inherit = 1; // Count threads started while counting, their counts are added back when they exit
+	attr.exclude_kernel = 1;
+	attr.exclude_hv = 1;
+
+	return static_cast<int>(syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0));
+}
+
+static uint64_t ReadCounter(int fd)
+{
+	uint64_t value = 0;
+	if (fd < 0 || read(fd, &value, sizeof(value)) != static_cast<ssize_t>(sizeof(value))) return 0;
+	return value;
+}
+#endif
+
+PerfCounters::PerfCounters()
+{
+#ifdef __linux__
+	mMissesFd = OpenCounter(PERF_COUNT_HW_CACHE_MISSES);
+	mReferencesFd = OpenCounter(PERF_COUNT_HW_CACHE_REFERENCES);
+	if (mMissesFd < 0 || mReferencesFd < 0) {
+		if (mMissesFd >= 0) close(mMissesFd);
+		if (mReferencesFd >= 0) close(mReferencesFd);
+		mMissesFd = mReferencesFd = -1;
+	}
+#endif
+}
+
+PerfCounters::~PerfCounters()
+{
+#ifdef __linux__
+	if (mMissesFd >= 0) close(mMissesFd);
+	if (mReferencesFd >= 0) close(mReferencesFd);
+#endif
+}
+
+bool PerfCounters::IsAvailable() const { return mMissesFd >= 0; }
+
+void PerfCounters::Start()
+{
+#ifdef __linux__
+	if (!IsAvailable()) return;
+	for (int fd : { mMissesFd, mReferencesFd }) {
+		ioctl(fd, PERF_EVENT_IOC_RESET, 0);
+		ioctl(fd, PERF_EVENT_IOC_ENABLE, 0);
+	}
+#endif
+}
+
+void PerfCounters::Stop()
+{
+#ifdef __linux__
+	if (!IsAvailable()) return;
+	for (int fd : { mMissesFd, mReferencesFd }) ioctl(fd, PERF_EVENT_IOC_DISABLE, 0);
+#endif
+}
+
+uint64_t PerfCounters::GetCacheMisses() const
+{
+#ifdef __linux__
+	return ReadCounter(mMissesFd);
+#else
+	return 0;
+#endif
+}
+
+uint64_t PerfCounters::GetCacheReferences() const
+{
+#ifdef __linux__
+	return ReadCounter(mReferencesFd);
+#else
+	return 0;
+#endif
+}
@@ -0,0 +1,42 @@
+#pragma once
+
+#include <cstdint>
+
+namespace VTFBench
+{
+	/// <summary>
+	/// Hardware cache counters of this process and the threads it starts while counting, through perf_event_open on Linux
+	/// Unavailable elsewhere, or when the kernel doesn't allow it (e.g. perf_event_paranoid, containers, virtual machines without a PMU)
+	/// </summary>
+	class PerfCounters
+	{
+	private:
+		int mMissesFd = -1;
+		int mReferencesFd = -1;
+
+	public:
+		PerfCounters();
+		~PerfCounters();
+
+		PerfCounters(const PerfCounters&) = delete;
+		PerfCounters& operator=(const PerfCounters&) = delete;
+
+		/// <summary>
+		/// Returns whether the counters could be opened, if not every other call does nothing and reads 0
+		/// </summary>
+		bool IsAvailable() const;
+
+		/// <summary>
+		/// Zeroes and starts the counters, only threads started after this are counted
+		/// </summary>
+		void Start();
+
+		/// <summary>
+		/// Stops the counters, threads that were started have to be joined first for their counts to be included
+		/// </summary>
+		void Stop();
+
+		uint64_t GetCacheMisses() const;
+		uint64_t GetCacheReferences() const;
+	};
+}
@@ -0,0 +1,117 @@
+#include "VPKFixture.h"
+
+#include <cstdio>
+#include <cstring>
+#include <map>
+
+using namespace VTFBench;
+
+static void WriteString(std::vector<uint8_t>& out, const std::string& str)
+{
+	out.insert(out.end(), str.begin(), str.end());
+	out.push_back('\0');
+}
+
+template<typename T>
+static void WriteLE(std::vector<uint8_t>& out, T value)
+{
+	uint8_t bytes[sizeof(T)];
+	memcpy(bytes, &value, sizeof(T));
+	out.insert(out.end(), bytes, bytes + sizeof(T));
+}
+
+static bool WriteFile(const std::string& path, const std::vector<uint8_t>& data)
+{
+	FILE* pFile = fopen(path.c_str(), "wb");
+	if (pFile == nullptr) return false;
+
+	const bool written = data.empty() || fwrite(data.data(), 1, data.size(), pFile) == data.size();
+	return fclose(pFile) == 0 && written;
+}
+
+bool VTFBench::BuildVPK(const std::vector<VPKFixtureFile>& files, uint32_t version, VPKFixture& out)
+{
+	if (version != 1 && version != 2) return false;
+
+	// Extension, then directory, then the indices of the files in it (a single space stands for none or the root)
+	std::map<std::string, std::map<std::string, std::vector<size_t>>> groups;
+	for (size_t i = 0; i < files.size(); i++) {
+		const VPKFixtureFile& file = files[i];
+		if (file.preloadBytes > file.data.size() || file.data.size() - file.preloadBytes > UINT32_MAX) return false;
+
+		const size_t slash = file.path.rfind('/');
+		const std::string directory = slash == std::string::npos ? " " : file.path.substr(0, slash);
+		const std::string name = slash == std::string::npos ? file.path : file.path.substr(slash + 1);
+
+		const size_t dot = name.rfind('.');
+		const std::string extension = dot == std::string::npos ? " " : name.substr(dot + 1);
+		groups[extension][directory].push_back(i);
+	}
+
+	out = VPKFixture{};
+	std::vector<uint8_t> tree, embedded;
+	for (const auto& extension : groups) {
+		WriteString(tree, extension.first);
+		for (const auto& directory : extension.second) {
+			WriteString(tree, directory.first);
+			for (size_t i : directory.second) {
+				const VPKFixtureFile& file = files[i];
+				const size_t slash = file.path.rfind('/');
+				std::string name = slash == std::string::npos ? file.path : file.path.substr(slash + 1);
+				if (extension.first != " ") name.resize(name.size() - extension.first.size() - 1);
+				WriteString(tree, name);
+
+				// The rest of the file goes to the end of its chunk, or of the data after the tree
+				const uint32_t length = static_cast<uint32_t>(file.data.size() - file.preloadBytes);
+				std::vector<uint8_t>* pArchive = &embedded;
+				if (file.archiveIndex != VPK_DIR_ARCHIVE_INDEX) {
+					if (out.chunks.size() <= file.archiveIndex) out.chunks.resize(file.archiveIndex + 1);
+					pArchive = &out.chunks[file.archiveIndex];
+				}
+				const uint32_t offset = length != 0 ? static_cast<uint32_t>(pArchive->size()) : 0;
+				pArchive->insert(pArchive->end(), file.data.begin() + file.preloadBytes, file.data.end());
+
+				WriteLE<uint32_t>(tree, 0);
+				WriteLE<uint16_t>(tree, file.preloadBytes);
+				WriteLE<uint16_t>(tree, file.archiveIndex);
+				WriteLE<uint32_t>(tree, offset);
+				WriteLE<uint32_t>(tree, length);
+				WriteLE<uint16_t>(tree, 0xffff);
+				tree.insert(tree.end(), file.data.begin(), file.data.begin() + file.preloadBytes);
+			}
+			WriteString(tree, "");
+		}
+		WriteString(tree, "");
+	}
+	WriteString(tree, "");
+
+	WriteLE<uint32_t>(out.directory, VPK_SIGNATURE);
+	WriteLE<uint32_t>(out.directory, version);
+	WriteLE<uint32_t>(out.directory, static_cast<uint32_t>(tree.size()));
+	if (version == 2) {
+		WriteLE<uint32_t>(out.directory, static_cast<uint32_t>(embedded.size())); // File data section
+		WriteLE<uint32_t>(out.directory, 0);                                      // Archive MD5 section
+		WriteLE<uint32_t>(out.directory, 0);                                      // Other MD5 section
+		WriteLE<uint32_t>(out.directory, 0);                                      // Signature section
+	}
+
+	out.headerSize = out.directory.size();
+	out.treeSize = tree.size();
+	out.directory.insert(out.directory.end(), tree.begin(), tree.end());
+	out.directory.insert(out.directory.end(), embedded.begin(), embedded.end());
+	return true;
+}
+
+bool VTFBench::WriteVPK(const VPKFixture& fixture, const std::string& prefix)
+{
+	if (!WriteFile(prefix + "dir.vpk", fixture.directory)) return false;
+
+	for (size_t i = 0; i < fixture.chunks.size(); i++) {
+		if (fixture.chunks[i].empty()) continue;
+
+		char suffix[16];
+		snprintf(suffix, sizeof(suffix), "%03u.vpk", static_cast<unsigned int>(i));
+		if (!WriteFile(prefix + suffix, fixture.chunks[i])) return false;
+	}
+	return true;
+}
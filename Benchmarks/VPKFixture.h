@@ -0,0 +1,49 @@
+#pragma once
+
+#include "../VPK/VPKArchive.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+/// <summary>
+/// Writer for small VPK archives the benchmark checks VPKArchive against
+/// </summary>
+namespace VTFBench
+{
+	struct VPKFixtureFile
+	{
+		std::string path;                // e.g. materials/brick/wall.vtf, no slash for the root directory and no dot for no extension
+		std::vector<uint8_t> data;
+		uint16_t preloadBytes = 0;       // Leading bytes stored in the tree after the entry, all of them for a preload only file
+		uint16_t archiveIndex = VPK_DIR_ARCHIVE_INDEX; // Chunk the rest of the file goes in, or embedded in the directory file after the tree
+	};
+
+	struct VPKFixture
+	{
+		std::vector<uint8_t> directory;          // name_dir.vpk
+		std::vector<std::vector<uint8_t>> chunks; // name_000.vpk, name_001.vpk, etc. (empty for indices no file uses)
+
+		size_t headerSize = 0;
+		size_t treeSize = 0;
+	};
+
+	/// <summary>
+	/// Builds a version 1 or 2 archive in memory, grouping the tree by extension then directory as Valve's tools do
+	/// CRCs are left 0, as VPKArchive doesn't check them
+	/// </summary>
+	/// <param name="files">Files to store, in the order they should appear within their directory</param>
+	/// <param name="version">1 or 2 (2 adds the section sizes to the header, but no MD5 or signature sections)</param>
+	/// <param name="out">Fixture to replace the contents of</param>
+	/// <returns>False if the version isn't supported or a file doesn't fit its entry (more than 65535 preload bytes or 4 GiB)</returns>
+	bool BuildVPK(const std::vector<VPKFixtureFile>& files, uint32_t version, VPKFixture& out);
+
+	/// <summary>
+	/// Writes a fixture to prefix_dir.vpk and prefix_000.vpk, prefix_001.vpk, etc.
+	/// </summary>
+	/// <param name="fixture">Fixture to write</param>
+	/// <param name="prefix">Path up to and including the underscore, e.g. /tmp/pak01_</param>
+	/// <returns>Whether every file was written</returns>
+	bool WriteVPK(const VPKFixture& fixture, const std::string& prefix);
+}
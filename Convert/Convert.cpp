@@ -0,0 +1,289 @@
+#include "Convert.h"
+#include "../FileFormat/Parser.h"
+#include "../Util/SIMD.h"
+
+#include <algorithm>
+#include <cstring>
+
+uint32_t Convert::GetPixelSize(PIXEL_FORMAT format)
+{
+	switch (format) {
+	case PIXEL_FORMAT::RGBA8:
+	case PIXEL_FORMAT::BGRA8:
+		return 4;
+	case PIXEL_FORMAT::RGBA16F:
+		return 8;
+	case PIXEL_FORMAT::RGBA32F:
+		return 16;
+	default:
+		return 0;
+	}
+}
+
+uint16_t Convert::FloatToHalf(float value)
+{
+	uint32_t bits;
+	memcpy(&bits, &value, 4);
+
+	const uint16_t sign = static_cast<uint16_t>((bits >> 16) & 0x8000);
+	const int exponent = static_cast<int>((bits >> 23) & 0xff) - 127 + 15;
+	uint32_t mantissa = bits & 0x7fffff;
+
+	// Infinity and NaN (keeping NaNs quiet)
+	if (exponent == 0xff - 127 + 15) return sign | 0x7c00 | (mantissa != 0 ? 0x200 : 0);
+	if (exponent >= 31) return sign | 0x7c00;
+
+	// Below the smallest normal half, shift the implicit bit into a denormal
+	uint32_t shift = 13;
+	uint32_t half = static_cast<uint32_t>(exponent) << 10;
+	if (exponent <= 0) {
+		if (exponent < -10) return sign;
+		mantissa |= 0x800000;
+		shift = 14 - exponent;
+		half = 0;
+	}
+
+	// Round to nearest even, a carry out of the mantissa correctly steps up the exponent (or to infinity)
+	half |= mantissa >> shift;
+	const uint32_t remainder = mantissa & ((1u << shift) - 1), halfway = 1u << (shift - 1);
+	if (remainder > halfway || (remainder == halfway && (half & 1) != 0)) half++;
+
+	return sign | static_cast<uint16_t>(half);
+}
+
+#define CHANNEL_ZERO 0xfe // Channel is always 0
+#define CHANNEL_FULL 0xff // Channel is always 255
+
+namespace
+{
+	// Where each channel of a format with 8 bit channels comes from, matching ParsePixel
+	struct ByteLayout
+	{
+		uint32_t pixelSize;
+		uint8_t channels[4]; // Byte index of red, green, blue and alpha in the pixel, or CHANNEL_ZERO / CHANNEL_FULL
+	};
+}
+
+static bool GetByteLayout(IMAGE_FORMAT format, ByteLayout* pLayout)
+{
+	switch (format) {
+	case IMAGE_FORMAT::RGBA8888:
+	case IMAGE_FORMAT::UVWQ8888:
+	case IMAGE_FORMAT::UVLX8888:
+		*pLayout = ByteLayout{ 4, { 0, 1, 2, 3 } };
+		return true;
+	case IMAGE_FORMAT::ABGR8888:
+		*pLayout = ByteLayout{ 4, { 3, 2, 1, 0 } };
+		return true;
+	case IMAGE_FORMAT::ARGB8888:
+		*pLayout = ByteLayout{ 4, { 1, 2, 3, 0 } };
+		return true;
+	case IMAGE_FORMAT::BGRA8888:
+	case IMAGE_FORMAT::BGRX8888:
+		*pLayout = ByteLayout{ 4, { 2, 1, 0, 3 } };
+		return true;
+	case IMAGE_FORMAT::RGB888:
+	case IMAGE_FORMAT::RGB888_BLUESCREEN:
+		*pLayout = ByteLayout{ 3, { 0, 1, 2, CHANNEL_FULL } };
+		return true;
+	case IMAGE_FORMAT::BGR888:
+	case IMAGE_FORMAT::BGR888_BLUESCREEN:
+		*pLayout = ByteLayout{ 3, { 2, 1, 0, CHANNEL_FULL } };
+		return true;
+	case IMAGE_FORMAT::I8:
+		*pLayout = ByteLayout{ 1, { 0, 0, 0, CHANNEL_FULL } };
+		return true;
+	case IMAGE_FORMAT::IA88:
+		*pLayout = ByteLayout{ 2, { 0, 0, 0, 1 } };
+		return true;
+	case IMAGE_FORMAT::A8:
+		*pLayout = ByteLayout{ 1, { CHANNEL_ZERO, CHANNEL_ZERO, CHANNEL_ZERO, 0 } };
+		return true;
+	case IMAGE_FORMAT::UV88:
+		*pLayout = ByteLayout{ 2, { 0, 1, CHANNEL_ZERO, CHANNEL_FULL } };
+		return true;
+	default:
+		return false;
+	}
+}
+
+// Gathers pixels of a byte layout into RGBA8, or BGRA8 if swapRedBlue
+static void GatherBytes(const uint8_t* pSrc, uint8_t* pDst, const ByteLayout& layout, bool swapRedBlue, size_t count)
+{
+	uint8_t channels[4];
+	for (int c = 0; c < 4; c++) channels[c] = layout.channels[swapRedBlue && c != 3 ? 2 - c : c];
+
+	const bool isIdentity = layout.pixelSize == 4 && channels[0] == 0 && channels[1] == 1 && channels[2] == 2 && channels[3] == 3;
+	if (isIdentity) {
+		memcpy(pDst, pSrc, count * 4);
+		return;
+	}
+
+	size_t i = 0;
+
+#ifdef VTF_SSE2
+	// 4 byte pixels are a permutation of their bytes, done for 4 pixels at a time with shifts and masks
+	if (layout.pixelSize == 4) {
+		const __m128i byteMask = _mm_set1_epi32(0xff);
+		__m128i srcShifts[4], dstShifts[4];
+		for (int c = 0; c < 4; c++) {
+			srcShifts[c] = _mm_cvtsi32_si128(channels[c] * 8);
+			dstShifts[c] = _mm_cvtsi32_si128(c * 8);
+		}
+
+		for (; i + 4 <= count; i += 4) {
+			const __m128i pixels = _mm_loadu_si128(reinterpret_cast<const __m128i*>(pSrc + i * 4));
+
+			__m128i swizzled = _mm_setzero_si128();
+			for (int c = 0; c < 4; c++)
+				swizzled = _mm_or_si128(swizzled, _mm_sll_epi32(_mm_and_si128(_mm_srl_epi32(pixels, srcShifts[c]), byteMask), dstShifts[c]));
+
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(pDst + i * 4), swizzled);
+		}
+	}
+#endif
+
+	// Constant channels read from a 2 byte table instead of branching per channel
+	const uint8_t constants[2] = { 0, 255 };
+	const uint8_t* pChannels[4];
+	size_t strides[4];
+	for (int c = 0; c < 4; c++) {
+		const bool isConstant = channels[c] == CHANNEL_ZERO || channels[c] == CHANNEL_FULL;
+		pChannels[c] = isConstant ? constants + (channels[c] == CHANNEL_FULL) : pSrc + channels[c];
+		strides[c] = isConstant ? 0 : layout.pixelSize;
+	}
+
+	for (; i < count; i++) {
+		for (int c = 0; c < 4; c++)
+			pDst[i * 4 + c] = pChannels[c][i * strides[c]];
+	}
+}
+
+// Converts RGBA8 pixels to floats, dividing like ParsePixel so the results are identical
+static void WidenBytesToFloat(const uint8_t* pSrc, uint8_t* pDst, size_t count)
+{
+	size_t i = 0;
+
+#ifdef VTF_SSE2
+	const __m128i zero = _mm_setzero_si128();
+	const __m128 scale = _mm_set1_ps(255.f);
+	for (; i + 4 <= count; i += 4) {
+		const __m128i pixels = _mm_loadu_si128(reinterpret_cast<const __m128i*>(pSrc + i * 4));
+		const __m128i low = _mm_unpacklo_epi8(pixels, zero), high = _mm_unpackhi_epi8(pixels, zero);
+
+		_mm_storeu_ps(reinterpret_cast<float*>(pDst + i * 16 + 0), _mm_div_ps(_mm_cvtepi32_ps(_mm_unpacklo_epi16(low, zero)), scale));
+		_mm_storeu_ps(reinterpret_cast<float*>(pDst + i * 16 + 16), _mm_div_ps(_mm_cvtepi32_ps(_mm_unpackhi_epi16(low, zero)), scale));
+		_mm_storeu_ps(reinterpret_cast<float*>(pDst + i * 16 + 32), _mm_div_ps(_mm_cvtepi32_ps(_mm_unpacklo_epi16(high, zero)), scale));
+		_mm_storeu_ps(reinterpret_cast<float*>(pDst + i * 16 + 48), _mm_div_ps(_mm_cvtepi32_ps(_mm_unpackhi_epi16(high, zero)), scale));
+	}
+#endif
+
+	for (i *= 4; i < count * 4; i++) {
+		const float channel = pSrc[i] / 255.f;
+		memcpy(pDst + i * 4, &channel, 4);
+	}
+}
+
+// Converts 16 bit unorm channels to floats (RGBA16161616 and RGBA16161616F, which ParsePixel reads identically)
+static void WidenShortsToFloat(const uint8_t* pSrc, uint8_t* pDst, size_t count)
+{
+	size_t i = 0;
+
+#ifdef VTF_SSE2
+	const __m128i zero = _mm_setzero_si128();
+	const __m128 scale = _mm_set1_ps(static_cast<float>(UINT16_MAX));
+	for (; i + 2 <= count; i += 2) {
+		const __m128i pixels = _mm_loadu_si128(reinterpret_cast<const __m128i*>(pSrc + i * 8));
+		_mm_storeu_ps(reinterpret_cast<float*>(pDst + i * 16 + 0), _mm_div_ps(_mm_cvtepi32_ps(_mm_unpacklo_epi16(pixels, zero)), scale));
+		_mm_storeu_ps(reinterpret_cast<float*>(pDst + i * 16 + 16), _mm_div_ps(_mm_cvtepi32_ps(_mm_unpackhi_epi16(pixels, zero)), scale));
+	}
+#endif
+
+	for (i *= 4; i < count * 4; i++) {
+		uint16_t channel;
+		memcpy(&channel, pSrc + i * 2, 2);
+		const float value = static_cast<float>(channel) / static_cast<float>(UINT16_MAX);
+		memcpy(pDst + i * 4, &value, 4);
+	}
+}
+
+namespace
+{
+	// Half float of every 8 bit channel value, so bytes convert with a lookup
+	struct HalfTable
+	{
+		uint16_t values[256];
+
+		HalfTable()
+		{
+			for (int i = 0; i < 256; i++) values[i] = Convert::FloatToHalf(i / 255.f);
+		}
+	};
+}
+
+static void WriteConvertedPixel(const VTFPixel& pixel, uint8_t* pDst, PIXEL_FORMAT format)
+{
+	const float channels[4] = { pixel.r, pixel.g, pixel.b, pixel.a };
+
+	switch (format) {
+	case PIXEL_FORMAT::RGBA8:
+	case PIXEL_FORMAT::BGRA8:
+	{
+		const bool swap = format == PIXEL_FORMAT::BGRA8;
+		for (int c = 0; c < 4; c++) {
+			const int dst = swap && c != 3 ? 2 - c : c;
+			pDst[dst] = static_cast<uint8_t>(std::clamp(channels[c], 0.f, 1.f) * 255.f + 0.5f);
+		}
+		return;
+	}
+	case PIXEL_FORMAT::RGBA16F:
+		for (int c = 0; c < 4; c++) {
+			const uint16_t half = Convert::FloatToHalf(channels[c]);
+			memcpy(pDst + c * 2, &half, 2);
+		}
+		return;
+	case PIXEL_FORMAT::RGBA32F:
+		memcpy(pDst, channels, 16);
+		return;
+	}
+}
+
+void Convert::ConvertPixels(const uint8_t* pSrc, IMAGE_FORMAT srcFormat, uint8_t* pDst, PIXEL_FORMAT dstFormat, size_t count)
+{
+	ByteLayout layout;
+	if (GetByteLayout(srcFormat, &layout)) {
+		if (dstFormat == PIXEL_FORMAT::RGBA8 || dstFormat == PIXEL_FORMAT::BGRA8) {
+			GatherBytes(pSrc, pDst, layout, dstFormat == PIXEL_FORMAT::BGRA8, count);
+			return;
+		}
+
+		// Gather and widen in chunks through a stack buffer, so the source is only read once
+		static const HalfTable halfTable;
+		const size_t CHUNK_SIZE = 256;
+		uint8_t gathered[CHUNK_SIZE * 4];
+		for (size_t begin = 0; begin < count; begin += CHUNK_SIZE) {
+			const size_t chunk = std::min(CHUNK_SIZE, count - begin);
+			GatherBytes(pSrc + begin * layout.pixelSize, gathered, layout, false, chunk);
+
+			if (dstFormat == PIXEL_FORMAT::RGBA32F) {
+				WidenBytesToFloat(gathered, pDst + begin * 16, chunk);
+			} else {
+				uint16_t halves[CHUNK_SIZE * 4];
+				for (size_t i = 0; i < chunk * 4; i++) halves[i] = halfTable.values[gathered[i]];
+				memcpy(pDst + begin * 8, halves, chunk * 8);
+			}
+		}
+		return;
+	}
+
+	if ((srcFormat == IMAGE_FORMAT::RGBA16161616 || srcFormat == IMAGE_FORMAT::RGBA16161616F) && dstFormat == PIXEL_FORMAT::RGBA32F) {
+		WidenShortsToFloat(pSrc, pDst, count);
+		return;
+	}
+
+	// Packed 16 bit formats and 16 bit channels to 8 bit or half float
+	const uint32_t srcSize = VTFParser::GetImageFormatInfo(srcFormat).bytesPerPixel;
+	const uint32_t dstSize = GetPixelSize(dstFormat);
+	for (size_t i = 0; i < count; i++)
+		WriteConvertedPixel(VTFParser::ParsePixel(pSrc + i * srcSize, srcFormat), pDst + i * dstSize, dstFormat);
+}
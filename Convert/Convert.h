@@ -0,0 +1,36 @@
+#pragma once
+
+#include "../FileFormat/Structs.h"
+
+#include <cstddef>
+#include <cstdint>
+
+/// <summary>
+/// Bulk conversion of pixel data from a VTF image format to an export layout (PIXEL_FORMAT)
+/// </summary>
+namespace Convert
+{
+	/// <summary>
+	/// Gets the size of one pixel in a layout
+	/// </summary>
+	/// <returns>Bytes per pixel</returns>
+	uint32_t GetPixelSize(PIXEL_FORMAT format);
+
+	/// <summary>
+	/// Converts a contiguous run of pixels, producing exactly what ParsePixel returns for each pixel in the destination layout
+	/// (8 bit channels are clamped and rounded, half floats are rounded to nearest even)
+	/// Formats with 8 bit channels are gathered straight from their bytes (4 byte formats 4 pixels at a time with SSE2),
+	/// as is RGBA16161616 to RGBA32F, every other combination goes through ParsePixel
+	/// </summary>
+	/// <param name="pSrc">Pixel data to convert</param>
+	/// <param name="srcFormat">Format of the pixel data (must not be block compressed)</param>
+	/// <param name="pDst">Buffer of count * GetPixelSize(dstFormat) bytes to write to</param>
+	/// <param name="dstFormat">Layout to convert to</param>
+	/// <param name="count">Number of pixels</param>
+	void ConvertPixels(const uint8_t* pSrc, IMAGE_FORMAT srcFormat, uint8_t* pDst, PIXEL_FORMAT dstFormat, size_t count);
+
+	/// <summary>
+	/// Converts a float to the nearest IEEE half float (overflowing to infinity)
+	/// </summary>
+	uint16_t FloatToHalf(float value);
+}
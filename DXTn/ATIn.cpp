@@ -0,0 +1,123 @@
+#include "DXTn.h"
+#include "../Util/SIMD.h"
+
+#include <cstring>
+
+/*
+	ATI1N (BC4) and ATI2N (BC5) are one and two DXT5 alpha blocks per 4x4 texels,
+	so both are decoded with DecodeAlphaBlock
+*/
+
+// Copies a decoded 4x4 block of RGBA8888 pixels into an image, skipping texels past the edges of partial blocks
+static void WriteBlock(const uint8_t* rgba, uint8_t* dst, uint32_t width, uint32_t height, uint32_t x, uint32_t y)
+{
+	const size_t pitch = static_cast<size_t>(width) * 4;
+	if (x + 4 <= width && y + 4 <= height) {
+		for (uint32_t row = 0; row < 4; row++)
+			memcpy(dst + (y + row) * pitch + x * 4, rgba + row * 16, 16);
+		return;
+	}
+
+	for (uint32_t row = 0; row < 4 && y + row < height; row++) {
+		for (uint32_t column = 0; column < 4 && x + column < width; column++)
+			memcpy(dst + (y + row) * pitch + (x + column) * 4, rgba + (row * 4 + column) * 4, 4);
+	}
+}
+
+void DXTn::DecompressATI1N(const uint8_t* src, uint8_t* dst, uint32_t width, uint32_t height)
+{
+	alignas(16) uint8_t values[16];
+	alignas(16) uint8_t rgba[64];
+
+	for (uint32_t y = 0; y < height; y += 4) {
+		for (uint32_t x = 0; x < width; x += 4, src += 8) {
+			DecodeAlphaBlock(src, values);
+
+#ifdef VTF_SSE2
+			// Replicate each value to 3 bytes of its pixel and fill alpha
+			const __m128i v = _mm_load_si128(reinterpret_cast<const __m128i*>(values));
+			const __m128i alpha = _mm_set1_epi32(static_cast<int>(0xff000000));
+			const __m128i pairs[2] = { _mm_unpacklo_epi8(v, v), _mm_unpackhi_epi8(v, v) };
+			for (int i = 0; i < 2; i++) {
+				_mm_store_si128(reinterpret_cast<__m128i*>(rgba + i * 32), _mm_or_si128(_mm_unpacklo_epi16(pairs[i], pairs[i]), alpha));
+				_mm_store_si128(reinterpret_cast<__m128i*>(rgba + i * 32 + 16), _mm_or_si128(_mm_unpackhi_epi16(pairs[i], pairs[i]), alpha));
+			}
+#else
+			for (int i = 0; i < 16; i++) {
+				rgba[i * 4 + 0] = rgba[i * 4 + 1] = rgba[i * 4 + 2] = values[i];
+				rgba[i * 4 + 3] = 0xff;
+			}
+#endif
+
+			WriteBlock(rgba, dst, width, height, x, y);
+		}
+	}
+}
+
+#ifdef VTF_SSE2
+// Same as ReconstructNormalZ for 16 texels
+static __m128i ReconstructNormalZ16(__m128i x, __m128i y)
+{
+	const __m128i zero = _mm_setzero_si128();
+	const __m128i full = _mm_set1_epi16(255);
+
+	__m128i z[2];
+	for (int half = 0; half < 2; half++) {
+		// x * 255 and y * 255 interleaved, so one multiply add gives x^2 + y^2
+		const __m128i x16 = half == 0 ? _mm_unpacklo_epi8(x, zero) : _mm_unpackhi_epi8(x, zero);
+		const __m128i y16 = half == 0 ? _mm_unpacklo_epi8(y, zero) : _mm_unpackhi_epi8(y, zero);
+		const __m128i x255 = _mm_sub_epi16(_mm_add_epi16(x16, x16), full);
+		const __m128i y255 = _mm_sub_epi16(_mm_add_epi16(y16, y16), full);
+
+		__m128i quarters[2];
+		for (int quarter = 0; quarter < 2; quarter++) {
+			const __m128i xy = quarter == 0 ? _mm_unpacklo_epi16(x255, y255) : _mm_unpackhi_epi16(x255, y255);
+			__m128i zSquared = _mm_sub_epi32(_mm_set1_epi32(255 * 255), _mm_madd_epi16(xy, xy));
+			zSquared = _mm_andnot_si128(_mm_cmplt_epi32(zSquared, zero), zSquared);
+
+			const __m128 root = _mm_sqrt_ps(_mm_cvtepi32_ps(zSquared));
+			quarters[quarter] = _mm_cvttps_epi32(_mm_add_ps(_mm_mul_ps(root, _mm_set1_ps(0.5f)), _mm_set1_ps(128.f)));
+		}
+		z[half] = _mm_packs_epi32(quarters[0], quarters[1]);
+	}
+
+	return _mm_packus_epi16(z[0], z[1]);
+}
+#endif
+
+void DXTn::DecompressATI2N(const uint8_t* src, uint8_t* dst, uint32_t width, uint32_t height)
+{
+	alignas(16) uint8_t xs[16], ys[16];
+	alignas(16) uint8_t rgba[64];
+
+	for (uint32_t y = 0; y < height; y += 4) {
+		for (uint32_t x = 0; x < width; x += 4, src += 16) {
+			DecodeAlphaBlock(src, xs);
+			DecodeAlphaBlock(src + 8, ys);
+
+#ifdef VTF_SSE2
+			const __m128i xv = _mm_load_si128(reinterpret_cast<const __m128i*>(xs));
+			const __m128i yv = _mm_load_si128(reinterpret_cast<const __m128i*>(ys));
+			const __m128i zv = ReconstructNormalZ16(xv, yv);
+			const __m128i full = _mm_set1_epi8(static_cast<char>(0xff));
+
+			// Interleave x with y and z with alpha, then the pairs into pixels
+			const __m128i xy[2] = { _mm_unpacklo_epi8(xv, yv), _mm_unpackhi_epi8(xv, yv) };
+			const __m128i za[2] = { _mm_unpacklo_epi8(zv, full), _mm_unpackhi_epi8(zv, full) };
+			for (int i = 0; i < 2; i++) {
+				_mm_store_si128(reinterpret_cast<__m128i*>(rgba + i * 32), _mm_unpacklo_epi16(xy[i], za[i]));
+				_mm_store_si128(reinterpret_cast<__m128i*>(rgba + i * 32 + 16), _mm_unpackhi_epi16(xy[i], za[i]));
+			}
+#else
+			for (int i = 0; i < 16; i++) {
+				rgba[i * 4 + 0] = xs[i];
+				rgba[i * 4 + 1] = ys[i];
+				rgba[i * 4 + 2] = ReconstructNormalZ(xs[i], ys[i]);
+				rgba[i * 4 + 3] = 0xff;
+			}
+#endif
+
+			WriteBlock(rgba, dst, width, height, x, y);
+		}
+	}
+}
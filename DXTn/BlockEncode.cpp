@@ -0,0 +1,488 @@
+#include "DXTn.h"
+#include "../Util/SIMD.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+/*
+	DXTn block encoders
+	Colour endpoints are found by a bounding box, a principal axis range fit, or a cluster fit over every ordered partition
+	of the block (as popularised by squish), then indices are chosen against the quantised palette
+*/
+
+namespace
+{
+	struct ColourPoints
+	{
+		// SoA layout so 4 pixels can be compared against a palette entry at once
+		alignas(16) float r[16];
+		alignas(16) float g[16];
+		alignas(16) float b[16];
+		bool transparent[16];
+		int opaqueCount;
+	};
+
+	struct Endpoints
+	{
+		float a[3]; // Endpoint with weight 1 at index 0
+		float b[3]; // Endpoint with weight 1 at index 1
+	};
+}
+
+static uint16_t Pack565(const float* colour)
+{
+	int r = static_cast<int>(std::clamp(colour[0], 0.f, 255.f) * (31.f / 255.f) + 0.5f);
+	int g = static_cast<int>(std::clamp(colour[1], 0.f, 255.f) * (63.f / 255.f) + 0.5f);
+	int b = static_cast<int>(std::clamp(colour[2], 0.f, 255.f) * (31.f / 255.f) + 0.5f);
+	return static_cast<uint16_t>((r << 11) | (g << 5) | b);
+}
+
+static void Unpack565(uint16_t packed, int* colour)
+{
+	int r = (packed >> 11) & 0x1F, g = (packed >> 5) & 0x3F, b = packed & 0x1F;
+	colour[0] = (r << 3) | (r >> 2);
+	colour[1] = (g << 2) | (g >> 4);
+	colour[2] = (b << 3) | (b >> 2);
+}
+
+static void BuildPalette(uint16_t c0, uint16_t c1, bool fourColour, float palette[4][3])
+{
+	int e0[3], e1[3];
+	Unpack565(c0, e0);
+	Unpack565(c1, e1);
+
+	for (int c = 0; c < 3; c++) {
+		palette[0][c] = static_cast<float>(e0[c]);
+		palette[1][c] = static_cast<float>(e1[c]);
+		if (fourColour) {
+			palette[2][c] = static_cast<float>((2 * e0[c] + e1[c] + 1) / 3);
+			palette[3][c] = static_cast<float>((e0[c] + 2 * e1[c] + 1) / 3);
+		} else {
+			palette[2][c] = static_cast<float>((e0[c] + e1[c]) / 2);
+			palette[3][c] = 0.f;
+		}
+	}
+}
+
+// Picks the nearest of the first paletteSize entries for each pixel, returns the summed squared error of opaque pixels
+static float AssignIndices(const ColourPoints& points, const float palette[4][3], int paletteSize, uint8_t* indices)
+{
+	float errors[16];
+
+#ifdef VTF_SSE2
+	for (int i = 0; i < 16; i += 4) {
+		__m128 r = _mm_load_ps(points.r + i), g = _mm_load_ps(points.g + i), b = _mm_load_ps(points.b + i);
+
+		__m128 best = _mm_set1_ps(INFINITY);
+		__m128i bestIndex = _mm_setzero_si128();
+		for (int k = 0; k < paletteSize; k++) {
+			__m128 dr = _mm_sub_ps(r, _mm_set1_ps(palette[k][0]));
+			__m128 dg = _mm_sub_ps(g, _mm_set1_ps(palette[k][1]));
+			__m128 db = _mm_sub_ps(b, _mm_set1_ps(palette[k][2]));
+			__m128 dist = _mm_add_ps(_mm_add_ps(_mm_mul_ps(dr, dr), _mm_mul_ps(dg, dg)), _mm_mul_ps(db, db));
+
+			__m128i closer = _mm_castps_si128(_mm_cmplt_ps(dist, best));
+			best = _mm_min_ps(dist, best);
+			bestIndex = _mm_or_si128(_mm_and_si128(closer, _mm_set1_epi32(k)), _mm_andnot_si128(closer, bestIndex));
+		}
+
+		alignas(16) int32_t laneIndices[4];
+		_mm_store_si128(reinterpret_cast<__m128i*>(laneIndices), bestIndex);
+		_mm_storeu_ps(errors + i, best);
+		for (int lane = 0; lane < 4; lane++) indices[i + lane] = static_cast<uint8_t>(laneIndices[lane]);
+	}
+#else
+	for (int i = 0; i < 16; i++) {
+		errors[i] = INFINITY;
+		for (int k = 0; k < paletteSize; k++) {
+			float dr = points.r[i] - palette[k][0], dg = points.g[i] - palette[k][1], db = points.b[i] - palette[k][2];
+			float dist = dr * dr + dg * dg + db * db;
+			if (dist < errors[i]) {
+				errors[i] = dist;
+				indices[i] = static_cast<uint8_t>(k);
+			}
+		}
+	}
+#endif
+
+	float error = 0.f;
+	for (int i = 0; i < 16; i++) {
+		if (points.transparent[i]) {
+			indices[i] = 3;
+			continue;
+		}
+		error += errors[i];
+	}
+	return error;
+}
+
+static void ComputePrincipalAxis(const ColourPoints& points, float* mean, float* axis)
+{
+	mean[0] = mean[1] = mean[2] = 0.f;
+	for (int i = 0; i < 16; i++) {
+		if (points.transparent[i]) continue;
+		mean[0] += points.r[i];
+		mean[1] += points.g[i];
+		mean[2] += points.b[i];
+	}
+	for (int c = 0; c < 3; c++) mean[c] /= points.opaqueCount;
+
+	// Covariance matrix (symmetric, so only 6 unique entries)
+	float cov[6] = { 0, 0, 0, 0, 0, 0 };
+	for (int i = 0; i < 16; i++) {
+		if (points.transparent[i]) continue;
+		float dr = points.r[i] - mean[0], dg = points.g[i] - mean[1], db = points.b[i] - mean[2];
+		cov[0] += dr * dr; cov[1] += dr * dg; cov[2] += dr * db;
+		cov[3] += dg * dg; cov[4] += dg * db;
+		cov[5] += db * db;
+	}
+
+	// Power iteration, starting from the largest diagonal so a single dominant channel converges immediately
+	axis[0] = cov[0]; axis[1] = cov[3]; axis[2] = cov[5];
+	for (int iteration = 0; iteration < 8; iteration++) {
+		float x = cov[0] * axis[0] + cov[1] * axis[1] + cov[2] * axis[2];
+		float y = cov[1] * axis[0] + cov[3] * axis[1] + cov[4] * axis[2];
+		float z = cov[2] * axis[0] + cov[4] * axis[1] + cov[5] * axis[2];
+
+		float largest = std::max({ fabsf(x), fabsf(y), fabsf(z) });
+		if (largest < 1e-6f) {
+			axis[0] = axis[1] = axis[2] = 0.57735f;
+			return;
+		}
+
+		axis[0] = x / largest;
+		axis[1] = y / largest;
+		axis[2] = z / largest;
+	}
+
+	float length = sqrtf(axis[0] * axis[0] + axis[1] * axis[1] + axis[2] * axis[2]);
+	for (int c = 0; c < 3; c++) axis[c] /= length;
+}
+
+static Endpoints FitBoundingBox(const ColourPoints& points)
+{
+	float min[3] = { 255.f, 255.f, 255.f }, max[3] = { 0.f, 0.f, 0.f }, mean[3] = { 0.f, 0.f, 0.f };
+	for (int i = 0; i < 16; i++) {
+		if (points.transparent[i]) continue;
+		const float colour[3] = { points.r[i], points.g[i], points.b[i] };
+		for (int c = 0; c < 3; c++) {
+			min[c] = std::min(min[c], colour[c]);
+			max[c] = std::max(max[c], colour[c]);
+			mean[c] += colour[c];
+		}
+	}
+	for (int c = 0; c < 3; c++) mean[c] /= points.opaqueCount;
+
+	// Pick the box diagonal that follows the sign of the green/red and blue/red covariance
+	float covRG = 0.f, covRB = 0.f;
+	for (int i = 0; i < 16; i++) {
+		if (points.transparent[i]) continue;
+		covRG += (points.r[i] - mean[0]) * (points.g[i] - mean[1]);
+		covRB += (points.r[i] - mean[0]) * (points.b[i] - mean[2]);
+	}
+	if (covRG < 0.f) std::swap(min[1], max[1]);
+	if (covRB < 0.f) std::swap(min[2], max[2]);
+
+	// Inset by 1/16th of the range, as the extremes are rarely worth a full palette entry
+	Endpoints endpoints;
+	for (int c = 0; c < 3; c++) {
+		float inset = (max[c] - min[c]) / 16.f;
+		endpoints.a[c] = max[c] - inset;
+		endpoints.b[c] = min[c] + inset;
+	}
+	return endpoints;
+}
+
+static Endpoints FitRange(const ColourPoints& points)
+{
+	float mean[3], axis[3];
+	ComputePrincipalAxis(points, mean, axis);
+
+	float minProj = INFINITY, maxProj = -INFINITY;
+	for (int i = 0; i < 16; i++) {
+		if (points.transparent[i]) continue;
+		float proj = (points.r[i] - mean[0]) * axis[0] + (points.g[i] - mean[1]) * axis[1] + (points.b[i] - mean[2]) * axis[2];
+		minProj = std::min(minProj, proj);
+		maxProj = std::max(maxProj, proj);
+	}
+
+	Endpoints endpoints;
+	for (int c = 0; c < 3; c++) {
+		endpoints.a[c] = mean[c] + axis[c] * maxProj;
+		endpoints.b[c] = mean[c] + axis[c] * minProj;
+	}
+	return endpoints;
+}
+
+static Endpoints FitCluster(const ColourPoints& points, bool fourColour)
+{
+	float mean[3], axis[3];
+	ComputePrincipalAxis(points, mean, axis);
+
+	// Order the opaque points along the principal axis
+	int order[16], count = 0;
+	float proj[16];
+	for (int i = 0; i < 16; i++) {
+		if (points.transparent[i]) continue;
+		proj[i] = points.r[i] * axis[0] + points.g[i] * axis[1] + points.b[i] * axis[2];
+		order[count++] = i;
+	}
+	std::sort(order, order + count, [&](int l, int r) { return proj[l] > proj[r]; });
+
+	// Prefix sums so each partition's least squares system can be built in constant time
+	alignas(16) float prefix[17][4] = {};
+	for (int i = 0; i < count; i++) {
+		prefix[i + 1][0] = prefix[i][0] + points.r[order[i]];
+		prefix[i + 1][1] = prefix[i][1] + points.g[order[i]];
+		prefix[i + 1][2] = prefix[i][2] + points.b[order[i]];
+	}
+
+	Endpoints best = FitRange(points);
+	float bestError = INFINITY;
+
+	// Cluster weights along the a -> b line
+	const float w2 = fourColour ? 2.f / 3.f : 0.5f;
+	const float w3 = fourColour ? 1.f / 3.f : 0.5f;
+
+	auto evaluate = [&](int i, int j, int k) {
+		// [0, i) -> a, [i, j) -> w2, [j, k) -> w3, [k, count) -> b
+		float n2 = static_cast<float>(j - i), n3 = static_cast<float>(k - j);
+		float alpha2 = i + n2 * w2 * w2 + n3 * w3 * w3;
+		float beta2 = (count - k) + n2 * (1 - w2) * (1 - w2) + n3 * (1 - w3) * (1 - w3);
+		float alphaBeta = n2 * w2 * (1 - w2) + n3 * w3 * (1 - w3);
+
+		float det = alpha2 * beta2 - alphaBeta * alphaBeta;
+		if (fabsf(det) < 1e-6f) return;
+		float invDet = 1.f / det;
+
+#ifdef VTF_SSE2
+		// All 3 channels at once, the 4th lane is always 0
+		__m128 x0 = _mm_load_ps(prefix[i]);
+		__m128 x2 = _mm_sub_ps(_mm_load_ps(prefix[j]), x0);
+		__m128 x3 = _mm_sub_ps(_mm_load_ps(prefix[k]), _mm_load_ps(prefix[j]));
+		__m128 x1 = _mm_sub_ps(_mm_load_ps(prefix[count]), _mm_load_ps(prefix[k]));
+
+		__m128 alphaX = _mm_add_ps(x0, _mm_add_ps(_mm_mul_ps(x2, _mm_set1_ps(w2)), _mm_mul_ps(x3, _mm_set1_ps(w3))));
+		__m128 betaX = _mm_add_ps(x1, _mm_add_ps(_mm_mul_ps(x2, _mm_set1_ps(1 - w2)), _mm_mul_ps(x3, _mm_set1_ps(1 - w3))));
+
+		const __m128 zero = _mm_setzero_ps(), max = _mm_set1_ps(255.f);
+		__m128 a = _mm_mul_ps(_mm_sub_ps(_mm_mul_ps(alphaX, _mm_set1_ps(beta2)), _mm_mul_ps(betaX, _mm_set1_ps(alphaBeta))), _mm_set1_ps(invDet));
+		__m128 b = _mm_mul_ps(_mm_sub_ps(_mm_mul_ps(betaX, _mm_set1_ps(alpha2)), _mm_mul_ps(alphaX, _mm_set1_ps(alphaBeta))), _mm_set1_ps(invDet));
+		a = _mm_min_ps(_mm_max_ps(a, zero), max);
+		b = _mm_min_ps(_mm_max_ps(b, zero), max);
+
+		// Squared error minus the constant sum of x^2
+		__m128 e = _mm_add_ps(_mm_mul_ps(_mm_mul_ps(a, a), _mm_set1_ps(alpha2)), _mm_mul_ps(_mm_mul_ps(b, b), _mm_set1_ps(beta2)));
+		__m128 cross = _mm_sub_ps(_mm_mul_ps(_mm_mul_ps(a, b), _mm_set1_ps(alphaBeta)), _mm_add_ps(_mm_mul_ps(a, alphaX), _mm_mul_ps(b, betaX)));
+		e = _mm_add_ps(e, _mm_add_ps(cross, cross));
+		e = _mm_add_ps(e, _mm_movehl_ps(e, e));
+		e = _mm_add_ss(e, _mm_shuffle_ps(e, e, 1));
+
+		float error = _mm_cvtss_f32(e);
+		if (error < bestError) {
+			bestError = error;
+
+			alignas(16) float lanes[2][4];
+			_mm_store_ps(lanes[0], a);
+			_mm_store_ps(lanes[1], b);
+			memcpy(best.a, lanes[0], sizeof(best.a));
+			memcpy(best.b, lanes[1], sizeof(best.b));
+		}
+#else
+		float a[3], b[3], error = 0.f;
+		for (int c = 0; c < 3; c++) {
+			float x0 = prefix[i][c], x2 = prefix[j][c] - prefix[i][c], x3 = prefix[k][c] - prefix[j][c], x1 = prefix[count][c] - prefix[k][c];
+			float alphaX = x0 + x2 * w2 + x3 * w3;
+			float betaX = x1 + x2 * (1 - w2) + x3 * (1 - w3);
+
+			a[c] = std::clamp((alphaX * beta2 - betaX * alphaBeta) * invDet, 0.f, 255.f);
+			b[c] = std::clamp((betaX * alpha2 - alphaX * alphaBeta) * invDet, 0.f, 255.f);
+
+			// Squared error minus the constant sum of x^2
+			error += a[c] * a[c] * alpha2 + b[c] * b[c] * beta2 + 2.f * (a[c] * b[c] * alphaBeta - a[c] * alphaX - b[c] * betaX);
+		}
+
+		if (error < bestError) {
+			bestError = error;
+			memcpy(best.a, a, sizeof(a));
+			memcpy(best.b, b, sizeof(b));
+		}
+#endif
+	};
+
+	for (int i = 0; i <= count; i++) {
+		for (int j = i; j <= count; j++) {
+			if (fourColour) {
+				for (int k = j; k <= count; k++) evaluate(i, j, k);
+			} else {
+				evaluate(i, j, j);
+			}
+		}
+	}
+
+	return best;
+}
+
+// Quantises the endpoints for the requested mode and writes the block, returns the squared error
+static float WriteColourBlock(const ColourPoints& points, const Endpoints& endpoints, bool fourColour, uint8_t* dst)
+{
+	uint16_t c0 = Pack565(endpoints.a), c1 = Pack565(endpoints.b);
+
+	// c0 > c1 selects four colour mode, c0 <= c1 selects three colour + transparent
+	if (fourColour ? c0 < c1 : c0 > c1) std::swap(c0, c1);
+
+	float palette[4][3];
+	BuildPalette(c0, c1, fourColour, palette);
+
+	uint8_t indices[16];
+	float error;
+	if (fourColour && c0 == c1) {
+		// Can't express four colour mode with equal endpoints, so only use the first entry
+		error = AssignIndices(points, palette, 1, indices);
+	} else {
+		error = AssignIndices(points, palette, fourColour ? 4 : 3, indices);
+	}
+
+	uint32_t bitmask = 0;
+	for (int i = 0; i < 16; i++) bitmask |= static_cast<uint32_t>(indices[i]) << (i * 2);
+
+	memcpy(dst, &c0, 2);
+	memcpy(dst + 2, &c1, 2);
+	memcpy(dst + 4, &bitmask, 4);
+	return error;
+}
+
+void DXTn::EncodeColourBlock(const uint8_t* rgba, uint8_t* dst, QUALITY quality, bool allowTransparent)
+{
+	ColourPoints points;
+	points.opaqueCount = 0;
+	for (int i = 0; i < 16; i++) {
+		points.r[i] = rgba[i * 4 + 0];
+		points.g[i] = rgba[i * 4 + 1];
+		points.b[i] = rgba[i * 4 + 2];
+		points.transparent[i] = allowTransparent && rgba[i * 4 + 3] < 128;
+		if (!points.transparent[i]) points.opaqueCount++;
+	}
+
+	if (points.opaqueCount == 0) {
+		// Equal endpoints select three colour mode, where index 3 is transparent
+		memset(dst, 0, 4);
+		memset(dst + 4, 0xFF, 4);
+		return;
+	}
+
+	const bool fourColour = points.opaqueCount == 16;
+
+	Endpoints endpoints;
+	switch (quality) {
+	case QUALITY::BOUNDING_BOX:
+		endpoints = FitBoundingBox(points);
+		break;
+	case QUALITY::RANGE_FIT:
+		endpoints = FitRange(points);
+		break;
+	case QUALITY::CLUSTER_FIT:
+	default:
+		endpoints = FitCluster(points, fourColour);
+		break;
+	}
+
+	float error = WriteColourBlock(points, endpoints, fourColour, dst);
+
+	// Quantisation can make the cluster fit lose to the plain range fit, so keep whichever is actually better
+	if (quality == QUALITY::CLUSTER_FIT && error > 0.f) {
+		uint8_t candidate[8];
+		if (WriteColourBlock(points, FitRange(points), fourColour, candidate) < error)
+			memcpy(dst, candidate, sizeof(candidate));
+	}
+}
+
+static int BuildAlphaPalette(int a0, int a1, int* palette)
+{
+	palette[0] = a0;
+	palette[1] = a1;
+	if (a0 > a1) {
+		for (int i = 1; i < 7; i++) palette[i + 1] = ((7 - i) * a0 + i * a1 + 3) / 7;
+		return 8;
+	}
+
+	for (int i = 1; i < 5; i++) palette[i + 1] = ((5 - i) * a0 + i * a1 + 2) / 5;
+	palette[6] = 0;
+	palette[7] = 255;
+	return 8;
+}
+
+static int WriteAlphaBlock(const uint8_t* rgba, int a0, int a1, uint8_t* dst)
+{
+	int palette[8];
+	BuildAlphaPalette(a0, a1, palette);
+
+	uint64_t bits = 0;
+	int error = 0;
+	for (int i = 0; i < 16; i++) {
+		int alpha = rgba[i * 4 + 3], bestIndex = 0, bestError = 256 * 256;
+		for (int k = 0; k < 8; k++) {
+			int diff = alpha - palette[k];
+			if (diff * diff < bestError) {
+				bestError = diff * diff;
+				bestIndex = k;
+			}
+		}
+		error += bestError;
+		bits |= static_cast<uint64_t>(bestIndex) << (i * 3);
+	}
+
+	dst[0] = static_cast<uint8_t>(a0);
+	dst[1] = static_cast<uint8_t>(a1);
+	for (int i = 0; i < 6; i++) dst[2 + i] = static_cast<uint8_t>(bits >> (i * 8));
+	return error;
+}
+
+void DXTn::EncodeAlphaBlock(const uint8_t* rgba, uint8_t* dst, QUALITY quality)
+{
+	int min = 255, max = 0, innerMin = 255, innerMax = 0;
+	for (int i = 0; i < 16; i++) {
+		int alpha = rgba[i * 4 + 3];
+		min = std::min(min, alpha);
+		max = std::max(max, alpha);
+		if (alpha != 0 && alpha != 255) {
+			innerMin = std::min(innerMin, alpha);
+			innerMax = std::max(innerMax, alpha);
+		}
+	}
+
+	// Eight value mode spanning the whole range
+	int error = WriteAlphaBlock(rgba, max, min, dst);
+	if (quality == QUALITY::BOUNDING_BOX || error == 0) return;
+
+	// Six value mode has exact 0 and 255 entries, so it only needs to span the values in between
+	if (innerMin > innerMax) innerMin = innerMax = min;
+	uint8_t candidate[8];
+	if (WriteAlphaBlock(rgba, innerMin, innerMax, candidate) < error)
+		memcpy(dst, candidate, sizeof(candidate));
+}
+
+void DXTn::EncodeExplicitAlphaBlock(const uint8_t* rgba, uint8_t* dst)
+{
+	for (int row = 0; row < 4; row++) {
+		uint16_t word = 0;
+		for (int i = 0; i < 4; i++) {
+			uint16_t alpha = (rgba[(row * 4 + i) * 4 + 3] + 8) / 17;
+			word |= alpha << (i * 4);
+		}
+		memcpy(dst + row * 2, &word, 2);
+	}
+}
+
+void DXTn::ExtractBlock(const uint8_t* src, uint32_t width, uint32_t height, uint32_t x, uint32_t y, uint8_t* rgba)
+{
+	// Pixels outside of the image repeat the last row/column so they don't skew the endpoints
+	for (uint32_t j = 0; j < 4; j++) {
+		uint32_t sy = std::min(y + j, height - 1);
+		for (uint32_t i = 0; i < 4; i++) {
+			uint32_t sx = std::min(x + i, width - 1);
+			memcpy(rgba + (j * 4 + i) * 4, src + (static_cast<size_t>(sy) * width + sx) * 4, 4);
+		}
+	}
+}
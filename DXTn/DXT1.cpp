@@ -1,17 +1,19 @@
 #include "DXTn.h"
+#include "../Util/Parallel.h"
 
 /*
 	Modified versions of VTFLib's DXTn decompression functions
 	All credit goes to https://github.com/NeilJed/VTFLib
 */
 
-void DXTn::DecompressDXT1(uint8_t* src, uint8_t* dst, uint32_t width, uint32_t height)
+void DXTn::DecompressDXT1(const uint8_t* src, uint8_t* dst, uint32_t width, uint32_t height)
 {
 	uint32_t       x, y, i, j, k, Select;
-	uint8_t*       Temp;
+	const uint8_t* Temp;
 	Colour565*     color_0, * color_1;
 	Colour8888     colours[4], * col;
-	uint32_t       bitmask, Offset;
+	uint32_t       bitmask;
+	size_t         Offset;
 
 	uint8_t  nBpp = 4;                   // bytes per pixel (4 channels (RGBA))
 	uint8_t  nBpc = 1;                   // bytes per channel (1 byte per channel)
@@ -73,7 +75,7 @@ void DXTn::DecompressDXT1(uint8_t* src, uint8_t* dst, uint32_t width, uint32_t h
 					col = &colours[Select];
 
 					if (((x + i) < width) && ((y + j) < height)) {
-						Offset = (y + j) * iBps + (x + i) * nBpp;
+						Offset = static_cast<size_t>(y + j) * iBps + (x + i) * nBpp;
 						dst[Offset + 0] = col->r;
 						dst[Offset + 1] = col->g;
 						dst[Offset + 2] = col->b;
@@ -84,3 +86,72 @@ void DXTn::DecompressDXT1(uint8_t* src, uint8_t* dst, uint32_t width, uint32_t h
 		}
 	}
 }
+
+void DXTn::DecodeColourTexel(const uint8_t* block, uint32_t texel, bool allowTransparent, uint8_t* rgba)
+{
+	const uint16_t col0 = static_cast<uint16_t>(block[0] | block[1] << 8);
+	const uint16_t col1 = static_cast<uint16_t>(block[2] | block[3] << 8);
+	const uint32_t select = (block[4 + texel / 4] >> (texel % 4) * 2) & 0x03;
+
+	const uint8_t colours[2][3] = {
+		{ static_cast<uint8_t>((col0 >> 11) << 3), static_cast<uint8_t>(((col0 >> 5) & 0x3F) << 2), static_cast<uint8_t>((col0 & 0x1F) << 3) },
+		{ static_cast<uint8_t>((col1 >> 11) << 3), static_cast<uint8_t>(((col1 >> 5) & 0x3F) << 2), static_cast<uint8_t>((col1 & 0x1F) << 3) }
+	};
+
+	rgba[3] = 0xFF;
+	if (select < 2) {
+		for (int i = 0; i < 3; i++) rgba[i] = colours[select][i];
+	} else if (!allowTransparent || col0 > col1) {
+		// Four-color block, 10 and 11 are a third and two thirds of the way to color_1
+		for (int i = 0; i < 3; i++)
+			rgba[i] = static_cast<uint8_t>(select == 2 ? (2 * colours[0][i] + colours[1][i] + 1) / 3 : (colours[0][i] + 2 * colours[1][i] + 1) / 3);
+	} else if (select == 2) {
+		// Three-color block, 10 is the midpoint
+		for (int i = 0; i < 3; i++) rgba[i] = static_cast<uint8_t>((colours[0][i] + colours[1][i]) / 2);
+	} else {
+		// and 11 is transparent (keeping the colour DecompressDXT1 writes)
+		for (int i = 0; i < 3; i++) rgba[i] = static_cast<uint8_t>((colours[0][i] + 2 * colours[1][i] + 1) / 3);
+		rgba[3] = 0x00;
+	}
+}
+
+void DXTn::DecodeColourPalette(const uint8_t* block, bool allowTransparent, uint8_t* palette)
+{
+	const uint16_t col0 = static_cast<uint16_t>(block[0] | block[1] << 8);
+	const uint16_t col1 = static_cast<uint16_t>(block[2] | block[3] << 8);
+
+	palette[0] = static_cast<uint8_t>((col0 >> 11) << 3);
+	palette[1] = static_cast<uint8_t>(((col0 >> 5) & 0x3F) << 2);
+	palette[2] = static_cast<uint8_t>((col0 & 0x1F) << 3);
+	palette[4] = static_cast<uint8_t>((col1 >> 11) << 3);
+	palette[5] = static_cast<uint8_t>(((col1 >> 5) & 0x3F) << 2);
+	palette[6] = static_cast<uint8_t>((col1 & 0x1F) << 3);
+	palette[3] = palette[7] = palette[11] = palette[15] = 0xFF;
+
+	for (int i = 0; i < 3; i++) {
+		if (!allowTransparent || col0 > col1) {
+			palette[8 + i] = static_cast<uint8_t>((2 * palette[i] + palette[4 + i] + 1) / 3);
+		} else {
+			palette[8 + i] = static_cast<uint8_t>((palette[i] + palette[4 + i]) / 2);
+		}
+		palette[12 + i] = static_cast<uint8_t>((palette[i] + 2 * palette[4 + i] + 1) / 3);
+	}
+
+	if (allowTransparent && col0 <= col1) palette[15] = 0x00;
+}
+
+void DXTn::CompressDXT1(const uint8_t* src, uint8_t* dst, uint32_t width, uint32_t height, QUALITY quality, bool oneBitAlpha)
+{
+	const uint32_t blocksWide = (width + 3) / 4, blocksHigh = (height + 3) / 4;
+
+	VTFUtil::ParallelFor(blocksHigh, 16, [&](size_t begin, size_t end) {
+		uint8_t rgba[64];
+		for (uint32_t by = static_cast<uint32_t>(begin); by < end; by++) {
+			for (uint32_t bx = 0; bx < blocksWide; bx++) {
+				uint8_t* block = dst + (static_cast<size_t>(by) * blocksWide + bx) * 8;
+				ExtractBlock(src, width, height, bx * 4, by * 4, rgba);
+				EncodeColourBlock(rgba, block, quality, oneBitAlpha);
+			}
+		}
+	});
+}
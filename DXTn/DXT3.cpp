@@ -1,17 +1,19 @@
 #include "DXTn.h"
+#include "../Util/Parallel.h"
 
 /*
 	Modified versions of VTFLib's DXTn decompression functions
 	All credit goes to https://github.com/NeilJed/VTFLib
 */
 
-void DXTn::DecompressDXT3(uint8_t* src, uint8_t* dst, uint32_t width, uint32_t height)
+void DXTn::DecompressDXT3(const uint8_t* src, uint8_t* dst, uint32_t width, uint32_t height)
 {
 	uint32_t               x, y, i, j, k, Select;
-	uint8_t*               Temp;
+	const uint8_t*         Temp;
 	Colour565*             color_0, * color_1;
 	Colour8888             colours[4], * col;
-	uint32_t               bitmask, Offset;
+	uint32_t               bitmask;
+	size_t                 Offset;
 	uint16_t               word;
 	DXTAlphaBlockExplicit* alpha;
 
@@ -61,7 +63,7 @@ void DXTn::DecompressDXT3(uint8_t* src, uint8_t* dst, uint32_t width, uint32_t h
 					col = &colours[Select];
 
 					if (((x + i) < width) && ((y + j) < height)) {
-						Offset = (y + j) * iBps + (x + i) * nBpp;
+						Offset = static_cast<size_t>(y + j) * iBps + (x + i) * nBpp;
 						dst[Offset + 0] = col->r;
 						dst[Offset + 1] = col->g;
 						dst[Offset + 2] = col->b;
@@ -73,7 +75,7 @@ void DXTn::DecompressDXT3(uint8_t* src, uint8_t* dst, uint32_t width, uint32_t h
 				word = alpha->row[j];
 				for (i = 0; i < 4; i++) {
 					if (((x + i) < width) && ((y + j) < height)) {
-						Offset = (y + j) * iBps + (x + i) * nBpp + 3;
+						Offset = static_cast<size_t>(y + j) * iBps + (x + i) * nBpp + 3;
 						dst[Offset] = word & 0x0F;
 						dst[Offset] = dst[Offset] | (dst[Offset] << 4);
 					}
@@ -84,3 +86,20 @@ void DXTn::DecompressDXT3(uint8_t* src, uint8_t* dst, uint32_t width, uint32_t h
 		}
 	}
 }
+
+void DXTn::CompressDXT3(const uint8_t* src, uint8_t* dst, uint32_t width, uint32_t height, QUALITY quality)
+{
+	const uint32_t blocksWide = (width + 3) / 4, blocksHigh = (height + 3) / 4;
+
+	VTFUtil::ParallelFor(blocksHigh, 16, [&](size_t begin, size_t end) {
+		uint8_t rgba[64];
+		for (uint32_t by = static_cast<uint32_t>(begin); by < end; by++) {
+			for (uint32_t bx = 0; bx < blocksWide; bx++) {
+				uint8_t* block = dst + (static_cast<size_t>(by) * blocksWide + bx) * 16;
+				ExtractBlock(src, width, height, bx * 4, by * 4, rgba);
+				EncodeExplicitAlphaBlock(rgba, block);
+				EncodeColourBlock(rgba, block + 8, quality, false);
+			}
+		}
+	});
+}
@@ -1,20 +1,24 @@
 #include "DXTn.h"
+#include "../Util/Parallel.h"
+#include "../Util/SIMD.h"
+
+#include <cstring>
 
 /*
 	Modified versions of VTFLib's DXTn decompression functions
 	All credit goes to https://github.com/NeilJed/VTFLib
 */
 
-void DXTn::DecompressDXT5(uint8_t* src, uint8_t* dst, uint32_t width, uint32_t height)
+void DXTn::DecompressDXT5(const uint8_t* src, uint8_t* dst, uint32_t width, uint32_t height)
 {
 	uint32_t         x, y, i, j, k, Select;
-	uint8_t*         Temp;
+	const uint8_t*   Temp;
 	Colour565*       color_0, * color_1;
 	Colour8888       colours[4], * col;
-	uint32_t         bitmask, Offset;
-	uint8_t          alphas[8];
-	uint8_t*         alphamask;
-	uint32_t         bits;
+	uint32_t         bitmask;
+	size_t           Offset;
+	uint8_t          alphas[16];
+	const uint8_t*   alphablock;
 
 	uint8_t nBpp = 4;                    // bytes per pixel (4 channels (RGBA))
 	uint8_t nBpc = 1;                    // bytes per channel (1 byte per channel)
@@ -27,9 +31,7 @@ void DXTn::DecompressDXT5(uint8_t* src, uint8_t* dst, uint32_t width, uint32_t h
 			//if (y >= uiHeight || x >= uiWidth)
 			//		break;
 
-			alphas[0] = Temp[0];
-			alphas[1] = Temp[1];
-			alphamask = Temp + 2;
+			alphablock = Temp;
 			Temp += 8;
 			color_0 = ((Colour565*)Temp);
 			color_1 = ((Colour565*)(Temp + 2));
@@ -68,7 +70,7 @@ void DXTn::DecompressDXT5(uint8_t* src, uint8_t* dst, uint32_t width, uint32_t h
 
 					// only put pixels out < width or height
 					if (((x + i) < width) && ((y + j) < height)) {
-						Offset = (y + j) * iBps + (x + i) * nBpp;
+						Offset = static_cast<size_t>(y + j) * iBps + (x + i) * nBpp;
 						dst[Offset + 0] = col->r;
 						dst[Offset + 1] = col->g;
 						dst[Offset + 2] = col->b;
@@ -76,55 +78,130 @@ void DXTn::DecompressDXT5(uint8_t* src, uint8_t* dst, uint32_t width, uint32_t h
 				}
 			}
 
-			// 8-alpha or 6-alpha block?    
-			if (alphas[0] > alphas[1]) {
-				// 8-alpha block:  derive the other six alphas.    
-				// Bit code 000 = alpha_0, 001 = alpha_1, others are interpolated.
-				alphas[2] = (6 * alphas[0] + 1 * alphas[1] + 3) / 7;	// bit code 010
-				alphas[3] = (5 * alphas[0] + 2 * alphas[1] + 3) / 7;	// bit code 011
-				alphas[4] = (4 * alphas[0] + 3 * alphas[1] + 3) / 7;	// bit code 100
-				alphas[5] = (3 * alphas[0] + 4 * alphas[1] + 3) / 7;	// bit code 101
-				alphas[6] = (2 * alphas[0] + 5 * alphas[1] + 3) / 7;	// bit code 110
-				alphas[7] = (1 * alphas[0] + 6 * alphas[1] + 3) / 7;	// bit code 111  
-			} else {
-				// 6-alpha block.    
-				// Bit code 000 = alpha_0, 001 = alpha_1, others are interpolated.
-				alphas[2] = (4 * alphas[0] + 1 * alphas[1] + 2) / 5;	// Bit code 010
-				alphas[3] = (3 * alphas[0] + 2 * alphas[1] + 2) / 5;	// Bit code 011
-				alphas[4] = (2 * alphas[0] + 3 * alphas[1] + 2) / 5;	// Bit code 100
-				alphas[5] = (1 * alphas[0] + 4 * alphas[1] + 2) / 5;	// Bit code 101
-				alphas[6] = 0x00;										// Bit code 110
-				alphas[7] = 0xFF;										// Bit code 111
-			}
-
-			// Note: Have to separate the next two loops,
-			//	it operates on a 6-byte system.
-
-			// First three bytes
-			bits = *((int*)alphamask);
-			for (j = 0; j < 2; j++) {
+			// Alpha block is shared with ATI1N and ATI2N
+			DecodeAlphaBlock(alphablock, alphas);
+			for (j = 0; j < 4; j++) {
 				for (i = 0; i < 4; i++) {
 					// only put pixels out < width or height
 					if (((x + i) < width) && ((y + j) < height)) {
-						Offset = (y + j) * iBps + (x + i) * nBpp + 3;
-						dst[Offset] = alphas[bits & 0x07];
+						Offset = static_cast<size_t>(y + j) * iBps + (x + i) * nBpp + 3;
+						dst[Offset] = alphas[j * 4 + i];
 					}
-					bits >>= 3;
 				}
 			}
+		}
+	}
+}
 
-			// Last three bytes
-			bits = *((int*)&alphamask[3]);
-			for (j = 2; j < 4; j++) {
-				for (i = 0; i < 4; i++) {
-					// only put pixels out < width or height
-					if (((x + i) < width) && ((y + j) < height)) {
-						Offset = (y + j) * iBps + (x + i) * nBpp + 3;
-						dst[Offset] = alphas[bits & 0x07];
-					}
-					bits >>= 3;
-				}
-			}
+#ifdef VTF_SSE2
+// Weight of the second endpoint for 8 indices, index 0 is the first endpoint, 1 the second and the rest step between them in order
+static inline __m128i CalcAlphaWeights(__m128i indices, int16_t steps)
+{
+	const __m128i one = _mm_set1_epi16(1);
+	const __m128i isFirst = _mm_cmpeq_epi16(indices, _mm_setzero_si128());
+	const __m128i isSecond = _mm_cmpeq_epi16(indices, one);
+	return _mm_andnot_si128(isFirst, _mm_or_si128(_mm_sub_epi16(indices, one), _mm_and_si128(isSecond, _mm_set1_epi16(steps))));
+}
+
+void DXTn::DecodeAlphaBlock(const uint8_t* block, uint8_t* values)
+{
+	const int16_t alpha0 = block[0], alpha1 = block[1];
+
+	// 16 bit window of the block starting at each byte, the index bytes start at byte 2
+	const __m128i bytes = _mm_loadl_epi64(reinterpret_cast<const __m128i*>(block));
+	const __m128i windows = _mm_unpacklo_epi16(bytes, _mm_srli_si128(bytes, 1));
+
+	// Texel k is at bit 3k of the indices, so broadcast the window holding each texel (byte 3k / 8)
+	// then multiply its bits up to the top of the lane (shifting by 3k % 8 varies per lane)
+	__m128i halves[2];
+	halves[0] = _mm_shuffle_epi32(windows, _MM_SHUFFLE(2, 1, 1, 1));
+	halves[0] = _mm_shufflehi_epi16(_mm_shufflelo_epi16(halves[0], _MM_SHUFFLE(1, 0, 0, 0)), _MM_SHUFFLE(2, 2, 1, 1));
+	halves[1] = _mm_shuffle_epi32(windows, _MM_SHUFFLE(3, 3, 3, 2));
+	halves[1] = _mm_shufflehi_epi16(_mm_shufflelo_epi16(halves[1], _MM_SHUFFLE(2, 1, 1, 1)), _MM_SHUFFLE(1, 1, 0, 0));
+
+	const __m128i shifts = _mm_setr_epi16(1 << 13, 1 << 10, 1 << 7, 1 << 12, 1 << 9, 1 << 6, 1 << 11, 1 << 8);
+
+	// 8 value blocks divide by 7 and 6 value blocks by 5, both with a multiply that's exact for every sum
+	const bool eightValues = alpha0 > alpha1;
+	const int16_t steps = eightValues ? 7 : 5;
+	const __m128i reciprocal = _mm_set1_epi16(eightValues ? 9363 : 13108);
+	const __m128i bias = _mm_set1_epi16(steps / 2);
+	const __m128i first = _mm_set1_epi16(alpha0), second = _mm_set1_epi16(alpha1);
+
+	__m128i results[2];
+	for (int half = 0; half < 2; half++) {
+		const __m128i indices = _mm_srli_epi16(_mm_mullo_epi16(halves[half], shifts), 13);
+		const __m128i weights = CalcAlphaWeights(indices, steps);
+
+		const __m128i sum = _mm_add_epi16(
+			_mm_add_epi16(_mm_mullo_epi16(_mm_sub_epi16(_mm_set1_epi16(steps), weights), first), _mm_mullo_epi16(weights, second)),
+			bias
+		);
+		results[half] = _mm_mulhi_epu16(sum, reciprocal);
+
+		// Indices 6 and 7 of 6 value blocks are 0 and 255
+		if (!eightValues) {
+			const __m128i isFixed = _mm_cmpgt_epi16(indices, _mm_set1_epi16(5));
+			const __m128i isFull = _mm_cmpeq_epi16(indices, _mm_set1_epi16(7));
+			results[half] = _mm_or_si128(_mm_andnot_si128(isFixed, results[half]), _mm_and_si128(isFull, _mm_set1_epi16(0xff)));
 		}
 	}
+
+	_mm_storeu_si128(reinterpret_cast<__m128i*>(values), _mm_packus_epi16(results[0], results[1]));
+}
+#else
+void DXTn::DecodeAlphaBlock(const uint8_t* block, uint8_t* values)
+{
+	uint8_t alphas[8];
+	alphas[0] = block[0];
+	alphas[1] = block[1];
+
+	// 8-alpha or 6-alpha block?
+	if (alphas[0] > alphas[1]) {
+		// 8-alpha block: derive the other six alphas.
+		// Bit code 000 = alpha_0, 001 = alpha_1, others are interpolated.
+		for (int i = 1; i < 7; i++) alphas[i + 1] = ((7 - i) * alphas[0] + i * alphas[1] + 3) / 7;
+	} else {
+		// 6-alpha block.
+		// Bit code 000 = alpha_0, 001 = alpha_1, others are interpolated.
+		for (int i = 1; i < 5; i++) alphas[i + 1] = ((5 - i) * alphas[0] + i * alphas[1] + 2) / 5;
+		alphas[6] = 0x00; // Bit code 110
+		alphas[7] = 0xFF; // Bit code 111
+	}
+
+	// 16 3 bit indices packed into 6 bytes
+	uint64_t indices = 0;
+	memcpy(&indices, block + 2, 6);
+	for (int i = 0; i < 16; i++) values[i] = alphas[(indices >> (i * 3)) & 0x7];
+}
+#endif
+
+uint8_t DXTn::DecodeAlphaTexel(const uint8_t* block, uint32_t texel)
+{
+	uint64_t indices = 0;
+	memcpy(&indices, block + 2, 6);
+	const uint32_t index = (indices >> (texel * 3)) & 0x7;
+	if (index < 2) return block[index];
+
+	const uint32_t alpha0 = block[0], alpha1 = block[1];
+	if (alpha0 > alpha1) return static_cast<uint8_t>(((8 - index) * alpha0 + (index - 1) * alpha1 + 3) / 7);
+	if (index >= 6) return index == 6 ? 0x00 : 0xFF;
+	return static_cast<uint8_t>(((6 - index) * alpha0 + (index - 1) * alpha1 + 2) / 5);
+}
+
+void DXTn::CompressDXT5(const uint8_t* src, uint8_t* dst, uint32_t width, uint32_t height, QUALITY quality)
+{
+	const uint32_t blocksWide = (width + 3) / 4, blocksHigh = (height + 3) / 4;
+
+	VTFUtil::ParallelFor(blocksHigh, 16, [&](size_t begin, size_t end) {
+		uint8_t rgba[64];
+		for (uint32_t by = static_cast<uint32_t>(begin); by < end; by++) {
+			for (uint32_t bx = 0; bx < blocksWide; bx++) {
+				uint8_t* block = dst + (static_cast<size_t>(by) * blocksWide + bx) * 16;
+				ExtractBlock(src, width, height, bx * 4, by * 4, rgba);
+				EncodeAlphaBlock(rgba, block, quality);
+				EncodeColourBlock(rgba, block + 8, quality, false);
+			}
+		}
+	});
 }
@@ -1,5 +1,7 @@
 #pragma once
 
+#include <cmath>
+#include <cstddef>
 #include <cstdint>
 
 /// <summary>
@@ -53,7 +55,99 @@ namespace DXTn
 		int8_t stuff[6];
 	};
 
-	void DecompressDXT1(uint8_t* src, uint8_t* dst, uint32_t width, uint32_t height);
-	void DecompressDXT3(uint8_t* src, uint8_t* dst, uint32_t width, uint32_t height);
-	void DecompressDXT5(uint8_t* src, uint8_t* dst, uint32_t width, uint32_t height);
+	/// <summary>
+	/// Endpoint search used when compressing, from fastest to highest quality
+	/// </summary>
+	enum class QUALITY
+	{
+		BOUNDING_BOX, // Inset bounding box of the block's colours
+		RANGE_FIT,    // Extremes of the block's colours along their principal axis
+		CLUSTER_FIT   // Least squares fit over every ordered clustering along the principal axis
+	};
+
+	void DecompressDXT1(const uint8_t* src, uint8_t* dst, uint32_t width, uint32_t height);
+	void DecompressDXT3(const uint8_t* src, uint8_t* dst, uint32_t width, uint32_t height);
+	void DecompressDXT5(const uint8_t* src, uint8_t* dst, uint32_t width, uint32_t height);
+
+	/// <summary>
+	/// Decompresses ATI1N (BC4) blocks to RGBA8888, the single channel is replicated to red, green and blue
+	/// </summary>
+	void DecompressATI1N(const uint8_t* src, uint8_t* dst, uint32_t width, uint32_t height);
+
+	/// <summary>
+	/// Decompresses ATI2N (BC5) blocks to RGBA8888, x from the first half of each block to red, y from the second half to green,
+	/// and z reconstructed from them (see ReconstructNormalZ) to blue
+	/// </summary>
+	void DecompressATI2N(const uint8_t* src, uint8_t* dst, uint32_t width, uint32_t height);
+
+	/// <summary>
+	/// Decodes the 16 values of an 8 byte interpolated alpha block (DXT5 alpha, and each channel of ATI1N and ATI2N),
+	/// indices are unpacked and interpolated 8 texels at a time with SSE2
+	/// </summary>
+	/// <param name="block">Block to decode</param>
+	/// <param name="values">Array of 16 values to populate in row order</param>
+	void DecodeAlphaBlock(const uint8_t* block, uint8_t* values);
+
+	/// <summary>
+	/// Decodes a single texel of an interpolated alpha block, identical to DecodeAlphaBlock
+	/// </summary>
+	/// <param name="block">Block to decode</param>
+	/// <param name="texel">Index of the texel in row order (0-15)</param>
+	uint8_t DecodeAlphaTexel(const uint8_t* block, uint32_t texel);
+
+	/// <summary>
+	/// Decodes a single texel of an 8 byte colour block, identical to DecompressDXT1 (allowTransparent) or the colour of DecompressDXT3 and DecompressDXT5
+	/// </summary>
+	/// <param name="block">Block to decode</param>
+	/// <param name="texel">Index of the texel in row order (0-15)</param>
+	/// <param name="allowTransparent">Whether blocks with the first endpoint not above the second are 3 colour with transparent black (DXT1)</param>
+	/// <param name="rgba">Array of 4 bytes to write the texel to</param>
+	void DecodeColourTexel(const uint8_t* block, uint32_t texel, bool allowTransparent, uint8_t* rgba);
+
+	/// <summary>
+	/// Decodes the 4 RGBA8888 colours an 8 byte colour block's 2 bit indices select from, identical to DecodeColourTexel
+	/// </summary>
+	/// <param name="block">Block to decode</param>
+	/// <param name="allowTransparent">Whether blocks with the first endpoint not above the second are 3 colour with transparent black (DXT1)</param>
+	/// <param name="palette">Array of 16 bytes to write the colours to in index order</param>
+	void DecodeColourPalette(const uint8_t* block, bool allowTransparent, uint8_t* palette);
+
+	/// <summary>
+	/// Reconstructs the z of a unit normal from its x and y stored as 8 bit unorms
+	/// Works on the integer x * 255 and y * 255 so the only rounded step is the square root, which SIMD paths can match exactly
+	/// </summary>
+	/// <returns>z as an 8 bit unorm</returns>
+	inline uint8_t ReconstructNormalZ(uint8_t x, uint8_t y)
+	{
+		const int32_t x255 = 2 * x - 255, y255 = 2 * y - 255;
+		const int32_t zSquared = 255 * 255 - x255 * x255 - y255 * y255;
+		return static_cast<uint8_t>(sqrtf(static_cast<float>(zSquared > 0 ? zSquared : 0)) * 0.5f + 128.f);
+	}
+
+	/// <summary>
+	/// Copies a 4x4 block of RGBA8888 pixels out of an image, repeating the edge for partial blocks
+	/// </summary>
+	void ExtractBlock(const uint8_t* src, uint32_t width, uint32_t height, uint32_t x, uint32_t y, uint8_t* rgba);
+
+	/// <summary>
+	/// Encodes 16 RGBA8888 pixels into an 8 byte colour block (alpha below 128 is transparent if allowed)
+	/// </summary>
+	void EncodeColourBlock(const uint8_t* rgba, uint8_t* dst, QUALITY quality, bool allowTransparent);
+
+	/// <summary>
+	/// Encodes the alpha of 16 RGBA8888 pixels into an 8 byte interpolated (DXT5) alpha block
+	/// </summary>
+	void EncodeAlphaBlock(const uint8_t* rgba, uint8_t* dst, QUALITY quality);
+
+	/// <summary>
+	/// Encodes the alpha of 16 RGBA8888 pixels into an 8 byte explicit (DXT3) alpha block
+	/// </summary>
+	void EncodeExplicitAlphaBlock(const uint8_t* rgba, uint8_t* dst);
+
+	/// <summary>
+	/// Compresses RGBA8888 pixels into DXT blocks, rows of blocks are spread across threads
+	/// </summary>
+	void CompressDXT1(const uint8_t* src, uint8_t* dst, uint32_t width, uint32_t height, QUALITY quality, bool oneBitAlpha = false);
+	void CompressDXT3(const uint8_t* src, uint8_t* dst, uint32_t width, uint32_t height, QUALITY quality);
+	void CompressDXT5(const uint8_t* src, uint8_t* dst, uint32_t width, uint32_t height, QUALITY quality);
 }
@@ -0,0 +1,691 @@
+#include "Envmap.h"
+#include "../Util/Parallel.h"
+#include "../Util/SIMD.h"
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+#define PI 3.14159265358979323846f
+#define UNWRAP_MAX_BOX_SAMPLES 8
+
+using namespace Envmap;
+
+namespace
+{
+	// Direction through a GGX sample in the tangent frame of the lobe's centre, and the source MIP to read it from
+	struct LobeSample
+	{
+		float x, y, z;
+		float mipLevel;
+	};
+
+	// A source face downsampled to every size down to 1x1, largest first
+	struct Chain
+	{
+		std::vector<std::vector<float>> levels[ENVMAP_FACES];
+		const float* ppLevels[ENVMAP_FACES][16] = {};
+		uint32_t sizes[16] = {};
+		uint32_t levelCount = 0;
+	};
+}
+
+// Each axis of the direction through a face as a weight of s, t and 1, where s and t are the face's u and v mapped to -1 to 1
+static const float FACE_AXES[ENVMAP_FACES][3][3] = {
+	{ {  0,  0,  1 }, {  0, -1,  0 }, { -1,  0,  0 } }, // +X
+	{ {  0,  0, -1 }, {  0, -1,  0 }, {  1,  0,  0 } }, // -X
+	{ {  1,  0,  0 }, {  0,  0,  1 }, {  0,  1,  0 } }, // +Y
+	{ {  1,  0,  0 }, {  0,  0, -1 }, {  0, -1,  0 } }, // -Y
+	{ {  1,  0,  0 }, {  0, -1,  0 }, {  0,  0,  1 } }, // +Z
+	{ { -1,  0,  0 }, {  0, -1,  0 }, {  0,  0, -1 } }  // -Z
+};
+
+// Normalisation constants of the real spherical harmonics basis
+static const float SH_Y00 = 0.282094792f;
+static const float SH_Y1 = 0.488602512f;
+static const float SH_Y2 = 1.092548431f;
+static const float SH_Y20 = 0.315391565f;
+static const float SH_Y22 = 0.546274215f;
+
+// Cosine lobe convolution of each band, divided by pi
+static const float IRRADIANCE_BANDS[ENVMAP_MAX_SH_ORDER] = { 1.f, 2.f / 3.f, 1.f / 4.f };
+
+static uint32_t CalcChainLength(uint32_t size)
+{
+	uint32_t length = 1;
+	while (size > 1) {
+		size >>= 1;
+		length++;
+	}
+	return length;
+}
+
+void Envmap::FaceToDirection(uint8_t face, float u, float v, float* pDir)
+{
+	const float s = u * 2.f - 1.f, t = v * 2.f - 1.f;
+	const float(*axes)[3] = FACE_AXES[face];
+
+	float length = 0;
+	for (int axis = 0; axis < 3; axis++) {
+		pDir[axis] = axes[axis][0] * s + axes[axis][1] * t + axes[axis][2];
+		length += pDir[axis] * pDir[axis];
+	}
+
+	const float invLength = 1.f / sqrtf(length);
+	for (int axis = 0; axis < 3; axis++) pDir[axis] *= invLength;
+}
+
+uint8_t Envmap::DirectionToFace(float x, float y, float z, float* pU, float* pV)
+{
+	const float ax = fabsf(x), ay = fabsf(y), az = fabsf(z);
+
+	uint8_t face;
+	float s, t, major;
+	if (ax >= ay && ax >= az) {
+		face = x >= 0 ? 0 : 1;
+		s = x >= 0 ? -z : z;
+		t = -y;
+		major = ax;
+	} else if (ay >= az) {
+		face = y >= 0 ? 2 : 3;
+		s = x;
+		t = y >= 0 ? z : -z;
+		major = ay;
+	} else {
+		face = z >= 0 ? 4 : 5;
+		s = z >= 0 ? x : -x;
+		t = -y;
+		major = az;
+	}
+
+	if (major <= 0.f) major = 1.f;
+	*pU = (s / major + 1.f) * 0.5f;
+	*pV = (t / major + 1.f) * 0.5f;
+	return face;
+}
+
+void Envmap::LayoutToDirection(LAYOUT layout, float u, float v, float* pDir)
+{
+	if (layout == LAYOUT::EQUIRECTANGULAR) {
+		const float phi = (0.5f - u) * 2.f * PI, theta = v * PI;
+		const float sinTheta = sinf(theta);
+		pDir[0] = sinTheta * cosf(phi);
+		pDir[1] = sinTheta * sinf(phi);
+		pDir[2] = cosf(theta);
+		return;
+	}
+
+	// Points outside the inner diamond are the folded lower half
+	float x = u * 2.f - 1.f, y = v * 2.f - 1.f;
+	const float z = 1.f - fabsf(x) - fabsf(y);
+	const float fold = z < 0.f ? -z : 0.f;
+	x += x >= 0.f ? -fold : fold;
+	y += y >= 0.f ? -fold : fold;
+
+	const float invLength = 1.f / sqrtf(x * x + y * y + z * z);
+	pDir[0] = x * invLength;
+	pDir[1] = y * invLength;
+	pDir[2] = z * invLength;
+}
+
+void Envmap::DirectionToLayout(LAYOUT layout, float x, float y, float z, float* pU, float* pV)
+{
+	if (layout == LAYOUT::EQUIRECTANGULAR) {
+		const float length = sqrtf(x * x + y * y + z * z);
+		*pU = 0.5f - atan2f(y, x) / (2.f * PI);
+		*pV = length > 0.f ? acosf(std::clamp(z / length, -1.f, 1.f)) / PI : 0.5f;
+		return;
+	}
+
+	const float length = fabsf(x) + fabsf(y) + fabsf(z);
+	if (!(length > 0.f)) {
+		*pU = *pV = 0.5f;
+		return;
+	}
+
+	x /= length;
+	y /= length;
+	if (z < 0.f) {
+		const float foldedX = (1.f - fabsf(y)) * (x >= 0.f ? 1.f : -1.f);
+		const float foldedY = (1.f - fabsf(x)) * (y >= 0.f ? 1.f : -1.f);
+		x = foldedX;
+		y = foldedY;
+	}
+
+	*pU = x * 0.5f + 0.5f;
+	*pV = y * 0.5f + 0.5f;
+}
+
+void Envmap::EvalBasis(const float* pDir, uint8_t order, float* pBasis)
+{
+	const float x = pDir[0], y = pDir[1], z = pDir[2];
+
+	pBasis[0] = SH_Y00;
+	if (order < 2) return;
+
+	pBasis[1] = SH_Y1 * y;
+	pBasis[2] = SH_Y1 * z;
+	pBasis[3] = SH_Y1 * x;
+	if (order < 3) return;
+
+	pBasis[4] = SH_Y2 * x * y;
+	pBasis[5] = SH_Y2 * y * z;
+	pBasis[6] = SH_Y20 * (3.f * z * z - 1.f);
+	pBasis[7] = SH_Y2 * x * z;
+	pBasis[8] = SH_Y22 * (x * x - y * y);
+}
+
+void Envmap::ProjectRow(const float* pRGBA, uint8_t face, uint32_t size, uint32_t y, uint8_t order, double* pSums)
+{
+	const uint32_t coefficientCount = static_cast<uint32_t>(order) * order;
+	const float(*axes)[3] = FACE_AXES[face];
+	const float scale = 2.f / size;
+	const float t = (y + 0.5f) * scale - 1.f;
+
+	// The row's part of each axis, which only varies with s across it
+	float rowAxes[3];
+	for (int axis = 0; axis < 3; axis++) rowAxes[axis] = axes[axis][1] * t + axes[axis][2];
+
+	// Sums of the row in float, texels only differ by a small factor so the precision is fine for a row of any length
+	float sums[ENVMAP_MAX_SH_COEFFICIENTS * 3 + 1] = {};
+	uint32_t x = 0;
+
+#ifdef VTF_SSE2
+	__m128 acc[ENVMAP_MAX_SH_COEFFICIENTS * 3];
+	for (uint32_t i = 0; i < coefficientCount * 3; i++) acc[i] = _mm_setzero_ps();
+	__m128 accWeight = _mm_setzero_ps();
+
+	const __m128 one = _mm_set1_ps(1.f);
+	const __m128 tSquared = _mm_set1_ps(t * t + 1.f);
+	const __m128 centres = _mm_setr_ps(0.5f, 1.5f, 2.5f, 3.5f);
+
+	for (; x + 4 <= size; x += 4) {
+		const __m128 s = _mm_sub_ps(_mm_mul_ps(_mm_add_ps(_mm_set1_ps(static_cast<float>(x)), centres), _mm_set1_ps(scale)), one);
+
+		// The direction is (s, t, 1) through the face's axes, its length is the same for every face
+		const __m128 invLength = _mm_div_ps(one, _mm_sqrt_ps(_mm_add_ps(_mm_mul_ps(s, s), tSquared)));
+		const __m128 weight = _mm_mul_ps(_mm_mul_ps(invLength, invLength), invLength); // Solid angle of the texel, up to a constant
+		__m128 dir[3];
+		for (int axis = 0; axis < 3; axis++)
+			dir[axis] = _mm_mul_ps(_mm_add_ps(_mm_mul_ps(_mm_set1_ps(axes[axis][0]), s), _mm_set1_ps(rowAxes[axis])), invLength);
+
+		__m128 basis[ENVMAP_MAX_SH_COEFFICIENTS];
+		basis[0] = _mm_set1_ps(SH_Y00);
+		if (order >= 2) {
+			basis[1] = _mm_mul_ps(_mm_set1_ps(SH_Y1), dir[1]);
+			basis[2] = _mm_mul_ps(_mm_set1_ps(SH_Y1), dir[2]);
+			basis[3] = _mm_mul_ps(_mm_set1_ps(SH_Y1), dir[0]);
+		}
+		if (order >= 3) {
+			basis[4] = _mm_mul_ps(_mm_set1_ps(SH_Y2), _mm_mul_ps(dir[0], dir[1]));
+			basis[5] = _mm_mul_ps(_mm_set1_ps(SH_Y2), _mm_mul_ps(dir[1], dir[2]));
+			basis[6] = _mm_mul_ps(_mm_set1_ps(SH_Y20), _mm_sub_ps(_mm_mul_ps(_mm_set1_ps(3.f), _mm_mul_ps(dir[2], dir[2])), one));
+			basis[7] = _mm_mul_ps(_mm_set1_ps(SH_Y2), _mm_mul_ps(dir[0], dir[2]));
+			basis[8] = _mm_mul_ps(_mm_set1_ps(SH_Y22), _mm_sub_ps(_mm_mul_ps(dir[0], dir[0]), _mm_mul_ps(dir[1], dir[1])));
+		}
+
+		// Transpose 4 RGBA pixels to a register per channel
+		__m128 r = _mm_loadu_ps(pRGBA + x * 4);
+		__m128 g = _mm_loadu_ps(pRGBA + x * 4 + 4);
+		__m128 b = _mm_loadu_ps(pRGBA + x * 4 + 8);
+		__m128 a = _mm_loadu_ps(pRGBA + x * 4 + 12);
+		_MM_TRANSPOSE4_PS(r, g, b, a);
+
+		const __m128 colour[3] = { _mm_mul_ps(r, weight), _mm_mul_ps(g, weight), _mm_mul_ps(b, weight) };
+		for (uint32_t i = 0; i < coefficientCount; i++) {
+			for (int c = 0; c < 3; c++)
+				acc[i * 3 + c] = _mm_add_ps(acc[i * 3 + c], _mm_mul_ps(basis[i], colour[c]));
+		}
+		accWeight = _mm_add_ps(accWeight, weight);
+	}
+
+	alignas(16) float lanes[4];
+	for (uint32_t i = 0; i < coefficientCount * 3; i++) {
+		_mm_store_ps(lanes, acc[i]);
+		sums[i] = (lanes[0] + lanes[1]) + (lanes[2] + lanes[3]);
+	}
+	_mm_store_ps(lanes, accWeight);
+	sums[coefficientCount * 3] = (lanes[0] + lanes[1]) + (lanes[2] + lanes[3]);
+#endif
+
+	for (; x < size; x++) {
+		const float s = (x + 0.5f) * scale - 1.f;
+		const float invLength = 1.f / sqrtf(s * s + t * t + 1.f);
+		const float weight = invLength * invLength * invLength;
+
+		float dir[3], basis[ENVMAP_MAX_SH_COEFFICIENTS];
+		for (int axis = 0; axis < 3; axis++) dir[axis] = (axes[axis][0] * s + rowAxes[axis]) * invLength;
+		EvalBasis(dir, order, basis);
+
+		for (uint32_t i = 0; i < coefficientCount; i++) {
+			for (int c = 0; c < 3; c++) sums[i * 3 + c] += basis[i] * pRGBA[x * 4 + c] * weight;
+		}
+		sums[coefficientCount * 3] += weight;
+	}
+
+	for (uint32_t i = 0; i <= coefficientCount * 3; i++) pSums[i] += sums[i];
+}
+
+SH Envmap::ResolveProjection(const double* pSums, uint8_t order)
+{
+	SH sh;
+	sh.order = std::clamp<uint8_t>(order, 1, ENVMAP_MAX_SH_ORDER);
+
+	const uint32_t coefficientCount = static_cast<uint32_t>(sh.order) * sh.order;
+	const double totalWeight = pSums[coefficientCount * 3];
+	if (totalWeight <= 0) return sh;
+
+	// The weights are only proportional to each texel's solid angle, so scale their total to the sphere's
+	const double scale = 4.0 * 3.14159265358979323846 / totalWeight;
+	for (uint32_t i = 0; i < coefficientCount; i++) {
+		for (int c = 0; c < 3; c++) sh.coefficients[i][c] = static_cast<float>(pSums[i * 3 + c] * scale);
+	}
+
+	return sh;
+}
+
+static VTFPixel EvalWeighted(const SH& sh, float x, float y, float z, const float* pBandWeights)
+{
+	float dir[3] = { x, y, z };
+	const float length = sqrtf(x * x + y * y + z * z);
+	if (length > 0.f) {
+		for (int axis = 0; axis < 3; axis++) dir[axis] /= length;
+	}
+
+	const uint8_t order = std::min<uint8_t>(sh.order, ENVMAP_MAX_SH_ORDER);
+	float basis[ENVMAP_MAX_SH_COEFFICIENTS];
+	if (order > 0) EvalBasis(dir, order, basis);
+
+	float rgb[3] = { 0, 0, 0 };
+	for (uint8_t band = 0; band < order; band++) {
+		for (uint32_t i = band * band; i < static_cast<uint32_t>(band + 1) * (band + 1); i++) {
+			for (int c = 0; c < 3; c++) rgb[c] += sh.coefficients[i][c] * basis[i] * pBandWeights[band];
+		}
+	}
+
+	return VTFPixel{ rgb[0], rgb[1], rgb[2], 1.f };
+}
+
+VTFPixel Envmap::EvalRadiance(const SH& sh, float x, float y, float z)
+{
+	static const float bandWeights[ENVMAP_MAX_SH_ORDER] = { 1.f, 1.f, 1.f };
+	return EvalWeighted(sh, x, y, z, bandWeights);
+}
+
+VTFPixel Envmap::EvalIrradiance(const SH& sh, float x, float y, float z)
+{
+	return EvalWeighted(sh, x, y, z, IRRADIANCE_BANDS);
+}
+
+size_t Envmap::CalcPrefilteredSize(uint16_t size, uint8_t levelCount)
+{
+	size_t floats = 0;
+	for (uint8_t level = 0; level < levelCount; level++) {
+		const size_t levelSize = std::max(size >> level, 1);
+		floats += levelSize * levelSize * 4 * ENVMAP_FACES;
+	}
+	return floats;
+}
+
+static void BuildChain(const Cube& source, Chain& chain)
+{
+	chain.levelCount = std::min<uint32_t>(CalcChainLength(source.size), 16);
+	chain.sizes[0] = source.size;
+	for (int face = 0; face < ENVMAP_FACES; face++) {
+		chain.levels[face].resize(chain.levelCount);
+		chain.ppLevels[face][0] = source.ppFaces[face];
+	}
+
+	for (uint32_t level = 1; level < chain.levelCount; level++) {
+		const uint32_t size = std::max<uint32_t>(chain.sizes[level - 1] >> 1, 1), srcSize = chain.sizes[level - 1];
+		chain.sizes[level] = size;
+
+		for (int face = 0; face < ENVMAP_FACES; face++) {
+			std::vector<float>& dst = chain.levels[face][level];
+			dst.resize(static_cast<size_t>(size) * size * 4);
+			const float* pSrc = chain.ppLevels[face][level - 1];
+
+			// Faces are square powers of 2 down to 1x1, so every texel averages exactly 2x2 of the level above
+			VTFUtil::ParallelFor(size, std::max<size_t>((1 << 14) / size, 1), [&](size_t begin, size_t end) {
+				for (size_t y = begin; y < end; y++) {
+					for (uint32_t x = 0; x < size; x++) {
+						const uint32_t x0 = std::min(x * 2, srcSize - 1), x1 = std::min(x * 2 + 1, srcSize - 1);
+						const uint32_t y0 = std::min<uint32_t>(y * 2, srcSize - 1), y1 = std::min<uint32_t>(y * 2 + 1, srcSize - 1);
+						for (int c = 0; c < 4; c++) {
+							dst[(y * size + x) * 4 + c] = 0.25f * (
+								pSrc[(y0 * srcSize + x0) * 4 + c] + pSrc[(y0 * srcSize + x1) * 4 + c] +
+								pSrc[(y1 * srcSize + x0) * 4 + c] + pSrc[(y1 * srcSize + x1) * 4 + c]
+							);
+						}
+					}
+				}
+			});
+			chain.ppLevels[face][level] = dst.data();
+		}
+	}
+}
+
+// Bilinear lookup of one level of a face, clamped to the face's edges
+static void SampleFace(const float* pFace, uint32_t size, float u, float v, float* pOut)
+{
+	const float fx = std::clamp(u * size - 0.5f, 0.f, static_cast<float>(size - 1));
+	const float fy = std::clamp(v * size - 0.5f, 0.f, static_cast<float>(size - 1));
+	const uint32_t x0 = static_cast<uint32_t>(fx), y0 = static_cast<uint32_t>(fy);
+	const uint32_t x1 = std::min(x0 + 1, size - 1), y1 = std::min(y0 + 1, size - 1);
+	const float wx = fx - x0, wy = fy - y0;
+
+	for (int c = 0; c < 4; c++) {
+		const float top = pFace[(y0 * size + x0) * 4 + c] + (pFace[(y0 * size + x1) * 4 + c] - pFace[(y0 * size + x0) * 4 + c]) * wx;
+		const float bottom = pFace[(y1 * size + x0) * 4 + c] + (pFace[(y1 * size + x1) * 4 + c] - pFace[(y1 * size + x0) * 4 + c]) * wx;
+		pOut[c] = top + (bottom - top) * wy;
+	}
+}
+
+static void SampleChain(const Chain& chain, const float* pDir, float mipLevel, float* pOut)
+{
+	float u, v;
+	const uint8_t face = DirectionToFace(pDir[0], pDir[1], pDir[2], &u, &v);
+
+	mipLevel = std::clamp(mipLevel, 0.f, static_cast<float>(chain.levelCount - 1));
+	const uint32_t high = static_cast<uint32_t>(mipLevel);
+	const uint32_t low = std::min(high + 1, chain.levelCount - 1);
+	const float fract = mipLevel - high;
+
+	SampleFace(chain.ppLevels[face][high], chain.sizes[high], u, v, pOut);
+	if (low == high || fract <= 0.f) return;
+
+	float lowPixel[4];
+	SampleFace(chain.ppLevels[face][low], chain.sizes[low], u, v, lowPixel);
+	for (int c = 0; c < 4; c++) pOut[c] += (lowPixel[c] - pOut[c]) * fract;
+}
+
+// Importance samples the GGX distribution with a Hammersley sequence, reading each sample from the source MIP whose texels
+// cover about the solid angle the sample represents (filtered importance sampling), which hides the noise of few samples
+static std::vector<LobeSample> BuildLobe(float roughness, uint32_t sampleCount, uint32_t sourceSize)
+{
+	const float alpha = roughness * roughness;
+	const float alphaSquared = alpha * alpha;
+	const float texelSolidAngle = 4.f * PI / (ENVMAP_FACES * static_cast<float>(sourceSize) * sourceSize);
+
+	std::vector<LobeSample> samples;
+	samples.reserve(sampleCount);
+	for (uint32_t i = 0; i < sampleCount; i++) {
+		uint32_t bits = i;
+		bits = (bits << 16) | (bits >> 16);
+		bits = ((bits & 0x55555555u) << 1) | ((bits & 0xAAAAAAAAu) >> 1);
+		bits = ((bits & 0x33333333u) << 2) | ((bits & 0xCCCCCCCCu) >> 2);
+		bits = ((bits & 0x0F0F0F0Fu) << 4) | ((bits & 0xF0F0F0F0u) >> 4);
+		bits = ((bits & 0x00FF00FFu) << 8) | ((bits & 0xFF00FF00u) >> 8);
+		const float xi0 = (i + 0.5f) / sampleCount, xi1 = bits * 2.3283064365386963e-10f;
+
+		const float cosTheta = sqrtf((1.f - xi1) / (1.f + (alphaSquared - 1.f) * xi1));
+		const float sinTheta = sqrtf(std::max(1.f - cosTheta * cosTheta, 0.f));
+		const float phi = 2.f * PI * xi0;
+
+		// Reflect the view (the lobe's centre) about the half vector
+		const float hx = sinTheta * cosf(phi), hy = sinTheta * sinf(phi);
+		LobeSample sample{ 2.f * cosTheta * hx, 2.f * cosTheta * hy, 2.f * cosTheta * cosTheta - 1.f, 0.f };
+		if (sample.z <= 0.f) continue;
+
+		// With the view along the normal the pdf of the reflected direction is D / 4
+		const float d = cosTheta * cosTheta * (alphaSquared - 1.f) + 1.f;
+		const float pdf = alphaSquared / (PI * d * d) * 0.25f;
+		const float sampleSolidAngle = 1.f / (sampleCount * pdf + 1e-6f);
+		sample.mipLevel = std::max(0.5f * log2f(sampleSolidAngle / texelSolidAngle) + 1.f, 0.f);
+		samples.push_back(sample);
+	}
+
+	return samples;
+}
+
+static void FilterTexel(const Chain& chain, const std::vector<LobeSample>& lobe, const float* n, float* pOut)
+{
+	// Any frame around the normal works, the lobe is isotropic
+	const float up[3] = { fabsf(n[2]) < 0.999f ? 0.f : 1.f, 0.f, fabsf(n[2]) < 0.999f ? 1.f : 0.f };
+	float tangent[3] = { up[1] * n[2] - up[2] * n[1], up[2] * n[0] - up[0] * n[2], up[0] * n[1] - up[1] * n[0] };
+	const float invLength = 1.f / sqrtf(tangent[0] * tangent[0] + tangent[1] * tangent[1] + tangent[2] * tangent[2]);
+	for (int axis = 0; axis < 3; axis++) tangent[axis] *= invLength;
+	const float bitangent[3] = { n[1] * tangent[2] - n[2] * tangent[1], n[2] * tangent[0] - n[0] * tangent[2], n[0] * tangent[1] - n[1] * tangent[0] };
+
+	float sum[4] = { 0, 0, 0, 0 }, totalWeight = 0;
+	for (const LobeSample& sample : lobe) {
+		float dir[3], pixel[4];
+		for (int axis = 0; axis < 3; axis++) dir[axis] = tangent[axis] * sample.x + bitangent[axis] * sample.y + n[axis] * sample.z;
+
+		SampleChain(chain, dir, sample.mipLevel, pixel);
+		for (int c = 0; c < 4; c++) sum[c] += pixel[c] * sample.z;
+		totalWeight += sample.z;
+	}
+
+	for (int c = 0; c < 4; c++) pOut[c] = totalWeight > 0.f ? sum[c] / totalWeight : 0.f;
+}
+
+bool Envmap::Prefilter(const Cube& source, const SH& sh, const PrefilterOptions& options, float* pDst)
+{
+	if (pDst == nullptr || options.size == 0 || options.levelCount == 0) return false;
+	if (options.levelCount > CalcChainLength(options.size)) return false;
+
+	Chain chain;
+	if (options.filter == FILTER::GGX) {
+		if (source.size == 0 || options.sampleCount == 0) return false;
+		for (int face = 0; face < ENVMAP_FACES; face++) {
+			if (source.ppFaces[face] == nullptr) return false;
+		}
+		BuildChain(source, chain);
+	} else if (sh.order == 0) {
+		return false;
+	}
+
+	for (uint8_t level = 0; level < options.levelCount; level++) {
+		const uint32_t size = std::max(options.size >> level, 1);
+
+		std::vector<LobeSample> lobe;
+		float mirrorMip = 0.f;
+		if (options.filter == FILTER::GGX) {
+			const float roughness = options.levelCount > 1 ? static_cast<float>(level) / (options.levelCount - 1) : 0.f;
+			if (roughness > 0.f)
+				lobe = BuildLobe(roughness, options.sampleCount, source.size);
+			else
+				mirrorMip = std::max(log2f(static_cast<float>(source.size) / size), 0.f);
+		}
+
+		// Faces are independent, so every row of every face is a work item
+		VTFUtil::ParallelFor(static_cast<size_t>(size) * ENVMAP_FACES, std::max<size_t>(256 / size, 1), [&](size_t begin, size_t end) {
+			for (size_t row = begin; row < end; row++) {
+				const uint8_t face = static_cast<uint8_t>(row / size);
+				const uint32_t y = static_cast<uint32_t>(row % size);
+				float* pRow = pDst + row * size * 4;
+
+				for (uint32_t x = 0; x < size; x++) {
+					float n[3];
+					FaceToDirection(face, (x + 0.5f) / size, (y + 0.5f) / size, n);
+
+					if (options.filter == FILTER::IRRADIANCE) {
+						const VTFPixel irradiance = EvalIrradiance(sh, n[0], n[1], n[2]);
+						pRow[x * 4 + 0] = irradiance.r;
+						pRow[x * 4 + 1] = irradiance.g;
+						pRow[x * 4 + 2] = irradiance.b;
+						pRow[x * 4 + 3] = 1.f;
+					} else if (lobe.empty()) {
+						SampleChain(chain, n, mirrorMip, pRow + x * 4);
+					} else {
+						FilterTexel(chain, lobe, n, pRow + x * 4);
+					}
+				}
+			}
+		});
+
+		pDst += static_cast<size_t>(size) * size * 4 * ENVMAP_FACES;
+	}
+
+	return true;
+}
+
+#ifdef VTF_SSE2
+static inline __m128 Select(__m128 mask, __m128 a, __m128 b)
+{
+	return _mm_or_ps(_mm_and_ps(mask, a), _mm_andnot_ps(mask, b));
+}
+
+// DirectionToFace of 4 directions, with the same comparisons and arithmetic so every lane matches it exactly
+static void DirectionToFace4(__m128 x, __m128 y, __m128 z, int32_t* pFaces, float* pU, float* pV)
+{
+	const __m128 signMask = _mm_set1_ps(-0.f), zero = _mm_setzero_ps(), one = _mm_set1_ps(1.f);
+	const __m128 ax = _mm_andnot_ps(signMask, x), ay = _mm_andnot_ps(signMask, y), az = _mm_andnot_ps(signMask, z);
+
+	const __m128 isX = _mm_and_ps(_mm_cmpge_ps(ax, ay), _mm_cmpge_ps(ax, az));
+	const __m128 isY = _mm_andnot_ps(isX, _mm_cmpge_ps(ay, az));
+	const __m128 isZ = _mm_andnot_ps(_mm_or_ps(isX, isY), _mm_castsi128_ps(_mm_set1_epi32(-1)));
+	const __m128 xPositive = _mm_cmpge_ps(x, zero), yPositive = _mm_cmpge_ps(y, zero), zPositive = _mm_cmpge_ps(z, zero);
+
+	const __m128 negX = _mm_xor_ps(x, signMask), negY = _mm_xor_ps(y, signMask), negZ = _mm_xor_ps(z, signMask);
+	const __m128 s = Select(isX, Select(xPositive, negZ, z), Select(isY, x, Select(zPositive, x, negX)));
+	const __m128 t = Select(isY, Select(yPositive, z, negZ), negY);
+	__m128 major = Select(isX, ax, Select(isY, ay, az));
+	major = Select(_mm_cmple_ps(major, zero), one, major);
+
+	const __m128 half = _mm_set1_ps(0.5f);
+	_mm_storeu_ps(pU, _mm_mul_ps(_mm_add_ps(_mm_div_ps(s, major), one), half));
+	_mm_storeu_ps(pV, _mm_mul_ps(_mm_add_ps(_mm_div_ps(t, major), one), half));
+
+	// Faces come in positive and negative pairs along each axis
+	const __m128 positive = Select(isX, xPositive, Select(isY, yPositive, zPositive));
+	const __m128i pair = _mm_or_si128(
+		_mm_and_si128(_mm_castps_si128(isY), _mm_set1_epi32(2)),
+		_mm_and_si128(_mm_castps_si128(isZ), _mm_set1_epi32(4))
+	);
+	const __m128i negative = _mm_andnot_si128(_mm_castps_si128(positive), _mm_set1_epi32(1));
+	_mm_storeu_si128(reinterpret_cast<__m128i*>(pFaces), _mm_add_epi32(pair, negative));
+}
+#endif
+
+// Box samples per texel on each axis of a row, enough that every source texel under the texel's footprint is read
+static void CalcBoxSamples(const Cube& source, const UnwrapOptions& options, uint32_t y, uint32_t* pCountX, uint32_t* pCountY)
+{
+	*pCountX = *pCountY = 1;
+	if (options.filter != RESAMPLE::BOX) return;
+
+	// A source texel spans about (pi / 2) / size radians, a little less away from the centre of its face
+	const float texelAngle = 0.5f * PI / source.size;
+
+	float angleX, angleY;
+	if (options.layout == LAYOUT::EQUIRECTANGULAR) {
+		// Rows narrow towards the poles, so measure at the part of the row nearest the equator
+		const float theta = std::clamp(0.5f * PI, y * PI / options.height, (y + 1) * PI / options.height);
+		angleX = 2.f * PI / options.width * sinf(theta);
+		angleY = PI / options.height;
+	} else {
+		// Octahedral texels cover roughly equal solid angles
+		angleX = angleY = sqrtf(4.f * PI / (static_cast<float>(options.width) * options.height));
+	}
+
+	*pCountX = std::clamp(static_cast<uint32_t>(ceilf(angleX / texelAngle)), 1u, static_cast<uint32_t>(UNWRAP_MAX_BOX_SAMPLES));
+	*pCountY = std::clamp(static_cast<uint32_t>(ceilf(angleY / texelAngle)), 1u, static_cast<uint32_t>(UNWRAP_MAX_BOX_SAMPLES));
+}
+
+// Nearest lookup of a face, the box filter's samples are spread finely enough that interpolating between them adds nothing
+static void FetchFace(const float* pFace, uint32_t size, float u, float v, float* pOut)
+{
+	const uint32_t x = std::min(static_cast<uint32_t>(std::max(u * size, 0.f)), size - 1);
+	const uint32_t y = std::min(static_cast<uint32_t>(std::max(v * size, 0.f)), size - 1);
+	for (int c = 0; c < 4; c++) pOut[c] = pFace[(y * size + x) * 4 + c];
+}
+
+// Writes one row of the image, 4 texels at a time, table is scratch space reused between rows
+static void UnwrapRow(const Cube& source, const UnwrapOptions& options, uint32_t y, float* pRow, std::vector<float>& table)
+{
+	uint32_t countX, countY;
+	CalcBoxSamples(source, options, y, &countX, &countY);
+
+	const uint32_t width = options.width;
+	const uint32_t paddedWidth = (width + 3) & ~3u;
+	const float invCount = 1.f / (countX * countY);
+
+	// Equirectangular sample columns only vary in longitude, so their sines and cosines are shared by every sample row
+	// (stored by sample column then texel, so 4 neighbouring texels are contiguous)
+	const bool isEquirect = options.layout == LAYOUT::EQUIRECTANGULAR;
+	if (isEquirect) {
+		table.resize(static_cast<size_t>(paddedWidth) * countX * 2);
+		for (uint32_t i = 0; i < countX; i++) {
+			float* pCos = table.data() + static_cast<size_t>(i) * paddedWidth * 2;
+			for (uint32_t x = 0; x < paddedWidth; x++) {
+				const float phi = (0.5f - (x + (i + 0.5f) / countX) / width) * 2.f * PI;
+				pCos[x] = cosf(phi);
+				pCos[paddedWidth + x] = sinf(phi);
+			}
+		}
+	}
+
+	for (uint32_t x = 0; x < width; x += 4) {
+		const uint32_t laneCount = std::min(width - x, 4u);
+		float sums[4][4] = {};
+
+		for (uint32_t j = 0; j < countY; j++) {
+			const float v = (y + (j + 0.5f) / countY) / options.height;
+			const float sinTheta = sinf(v * PI), cosTheta = cosf(v * PI);
+
+			for (uint32_t i = 0; i < countX; i++) {
+				alignas(16) float dirs[3][4];
+				if (isEquirect) {
+					const float* pCos = table.data() + static_cast<size_t>(i) * paddedWidth * 2 + x;
+					const float* pSin = pCos + paddedWidth;
+					for (int lane = 0; lane < 4; lane++) {
+						dirs[0][lane] = sinTheta * pCos[lane];
+						dirs[1][lane] = sinTheta * pSin[lane];
+						dirs[2][lane] = cosTheta;
+					}
+				} else {
+					// Octahedral directions are left unnormalised, the face lookup doesn't need them to be
+					const float t = v * 2.f - 1.f;
+					for (int lane = 0; lane < 4; lane++) {
+						float s = (x + lane + (i + 0.5f) / countX) / width * 2.f - 1.f, tFolded = t;
+						const float z = 1.f - fabsf(s) - fabsf(t);
+						const float fold = z < 0.f ? -z : 0.f;
+						s += s >= 0.f ? -fold : fold;
+						tFolded += t >= 0.f ? -fold : fold;
+						dirs[0][lane] = s;
+						dirs[1][lane] = tFolded;
+						dirs[2][lane] = z;
+					}
+				}
+
+				int32_t faces[4];
+				float us[4], vs[4];
+#ifdef VTF_SSE2
+				DirectionToFace4(_mm_load_ps(dirs[0]), _mm_load_ps(dirs[1]), _mm_load_ps(dirs[2]), faces, us, vs);
+#else
+				for (int lane = 0; lane < 4; lane++) faces[lane] = DirectionToFace(dirs[0][lane], dirs[1][lane], dirs[2][lane], us + lane, vs + lane);
+#endif
+
+				for (uint32_t lane = 0; lane < laneCount; lane++) {
+					float pixel[4];
+					if (options.filter == RESAMPLE::BOX)
+						FetchFace(source.ppFaces[faces[lane]], source.size, us[lane], vs[lane], pixel);
+					else
+						SampleFace(source.ppFaces[faces[lane]], source.size, us[lane], vs[lane], pixel);
+					for (int c = 0; c < 4; c++) sums[lane][c] += pixel[c];
+				}
+			}
+		}
+
+		for (uint32_t lane = 0; lane < laneCount; lane++) {
+			for (int c = 0; c < 4; c++) pRow[(x + lane) * 4 + c] = sums[lane][c] * invCount;
+		}
+	}
+}
+
+bool Envmap::Unwrap(const Cube& source, const UnwrapOptions& options, float* pDst)
+{
+	if (pDst == nullptr || options.width == 0 || options.height == 0 || source.size == 0) return false;
+	for (int face = 0; face < ENVMAP_FACES; face++) {
+		if (source.ppFaces[face] == nullptr) return false;
+	}
+
+	VTFUtil::ParallelFor(options.height, std::max<size_t>((1 << 14) / options.width, 1), [&](size_t begin, size_t end) {
+		std::vector<float> table;
+		for (size_t y = begin; y < end; y++)
+			UnwrapRow(source, options, static_cast<uint32_t>(y), pDst + y * options.width * 4, table);
+	});
+
+	return true;
+}
@@ -0,0 +1,172 @@
+#pragma once
+
+#include "../FileFormat/Structs.h"
+
+#include <cstddef>
+#include <cstdint>
+
+#define ENVMAP_FACES 6
+#define ENVMAP_MAX_SH_ORDER 3
+#define ENVMAP_MAX_SH_COEFFICIENTS (ENVMAP_MAX_SH_ORDER * ENVMAP_MAX_SH_ORDER)
+
+/// <summary>
+/// Lighting integrals of cubemap envmaps, spherical harmonics projection, prefiltered irradiance and GGX MIP chains, and unwrapping to 2D layouts
+/// Faces are in the order VTF envmaps store them (right, left, back, front, up, down) as +X, -X, +Y, -Y, +Z and -Z,
+/// each oriented as a D3D cubemap face (the spheremap face of older envmaps is never read)
+/// </summary>
+namespace Envmap
+{
+	enum class FILTER
+	{
+		IRRADIANCE, // Cosine convolution for diffuse lighting, every level is evaluated from order 3 spherical harmonics
+		GGX         // GGX lobe per level for glossy reflections, roughness goes from 0 at the largest level to 1 at the smallest
+	};
+
+	enum class LAYOUT
+	{
+		EQUIRECTANGULAR, // Longitude across (+X in the centre, turning right as u increases), +Z at the top row and -Z at the bottom
+		OCTAHEDRAL       // The sphere projected onto an octahedron and unfolded, +Z in the centre and -Z at the corners, the same mapping as encoded normals
+	};
+
+	enum class RESAMPLE
+	{
+		BILINEAR, // One bilinear lookup at the centre of each texel
+		BOX       // Average of enough nearest lookups across each texel's footprint to hit every source texel it covers (up to 8x8)
+	};
+
+	/// <summary>
+	/// Options for Unwrap
+	/// </summary>
+	struct UnwrapOptions
+	{
+		LAYOUT layout = LAYOUT::EQUIRECTANGULAR;
+		RESAMPLE filter = RESAMPLE::BILINEAR;
+		uint16_t width = 512;  // Equirectangular images are usually twice as wide as they are tall, octahedral ones square
+		uint16_t height = 256;
+	};
+
+	/// <summary>
+	/// Options for Prefilter
+	/// </summary>
+	struct PrefilterOptions
+	{
+		FILTER filter = FILTER::GGX;
+		uint16_t size = 64;         // Width and height of each face of the largest level
+		uint8_t levelCount = 7;     // Number of levels, each half the size of the last (at most a full chain down to 1x1)
+		uint32_t sampleCount = 64;  // GGX samples per texel, each read from the source MIP matching its footprint so few are needed
+	};
+
+	/// <summary>
+	/// Real spherical harmonics coefficients of an RGB function over the sphere, ordered by band then -l to l
+	/// </summary>
+	struct SH
+	{
+		uint8_t order = 0; // Number of bands, order * order coefficients are used
+		float coefficients[ENVMAP_MAX_SH_COEFFICIENTS][3] = {};
+	};
+
+	/// <summary>
+	/// Float RGBA faces of one level of a cubemap
+	/// </summary>
+	struct Cube
+	{
+		const float* ppFaces[ENVMAP_FACES] = {};
+		uint32_t size = 0;
+	};
+
+	/// <summary>
+	/// Gets the unit direction through a point on a face
+	/// </summary>
+	/// <param name="face">Face index, 0 to 5</param>
+	/// <param name="u">U coordinate on the face, 0 to 1</param>
+	/// <param name="v">V coordinate on the face, 0 to 1</param>
+	/// <param name="pDir">Array of 3 floats to write the direction to</param>
+	void FaceToDirection(uint8_t face, float u, float v, float* pDir);
+
+	/// <summary>
+	/// Gets the face a direction points through and where on it (the direction doesn't need to be normalised)
+	/// </summary>
+	/// <param name="pU">Pointer to write the U coordinate on the face to</param>
+	/// <param name="pV">Pointer to write the V coordinate on the face to</param>
+	/// <returns>Face index, 0 to 5</returns>
+	uint8_t DirectionToFace(float x, float y, float z, float* pU, float* pV);
+
+	/// <summary>
+	/// Gets the unit direction through a point of a 2D layout
+	/// </summary>
+	/// <param name="u">U coordinate on the image, 0 to 1</param>
+	/// <param name="v">V coordinate on the image, 0 to 1</param>
+	/// <param name="pDir">Array of 3 floats to write the direction to</param>
+	void LayoutToDirection(LAYOUT layout, float u, float v, float* pDir);
+
+	/// <summary>
+	/// Gets where on a 2D layout a direction points (the direction doesn't need to be normalised)
+	/// </summary>
+	/// <param name="pU">Pointer to write the U coordinate on the image to</param>
+	/// <param name="pV">Pointer to write the V coordinate on the image to</param>
+	void DirectionToLayout(LAYOUT layout, float x, float y, float z, float* pU, float* pV);
+
+	/// <summary>
+	/// Evaluates the spherical harmonics basis functions at a unit direction
+	/// </summary>
+	/// <param name="pDir">Unit direction</param>
+	/// <param name="order">Number of bands, 1 to 3</param>
+	/// <param name="pBasis">Array of order * order floats to write the basis to</param>
+	void EvalBasis(const float* pDir, uint8_t order, float* pBasis);
+
+	/// <summary>
+	/// Accumulates one row of a face into a projection, weighting each texel by its solid angle
+	/// Texels are done 4 at a time with SSE2, rows are independent so they can be accumulated on any thread
+	/// </summary>
+	/// <param name="pRGBA">Float RGBA pixels of the row</param>
+	/// <param name="face">Face index, 0 to 5</param>
+	/// <param name="size">Width and height of the face</param>
+	/// <param name="y">Row of the face</param>
+	/// <param name="order">Number of bands, 1 to 3</param>
+	/// <param name="pSums">Array of order * order * 3 + 1 doubles to add the weighted sums and the total weight to</param>
+	void ProjectRow(const float* pRGBA, uint8_t face, uint32_t size, uint32_t y, uint8_t order, double* pSums);
+
+	/// <summary>
+	/// Turns the sums of every row of every face (see ProjectRow) into coefficients, normalising the solid angles to the sphere
+	/// </summary>
+	SH ResolveProjection(const double* pSums, uint8_t order);
+
+	/// <summary>
+	/// Reconstructs the projected function in a direction
+	/// </summary>
+	/// <returns>VTFPixel struct with the value in rgb and 1 in alpha</returns>
+	VTFPixel EvalRadiance(const SH& sh, float x, float y, float z);
+
+	/// <summary>
+	/// Evaluates the cosine convolution of the projected function around a normal, divided by pi,
+	/// so it's the diffuse lighting to multiply albedo by (a uniform white envmap gives 1)
+	/// </summary>
+	/// <returns>VTFPixel struct with the irradiance in rgb and 1 in alpha</returns>
+	VTFPixel EvalIrradiance(const SH& sh, float x, float y, float z);
+
+	/// <summary>
+	/// Calculates the number of floats of a prefiltered chain
+	/// </summary>
+	size_t CalcPrefilteredSize(uint16_t size, uint8_t levelCount);
+
+	/// <summary>
+	/// Builds a prefiltered chain, rows of each level are spread across threads
+	/// </summary>
+	/// <param name="source">Largest level of the source cubemap, in linear space</param>
+	/// <param name="sh">Order 3 projection of the source (only read when filtering irradiance)</param>
+	/// <param name="options">Size and filter of the chain</param>
+	/// <param name="pDst">Buffer of CalcPrefilteredSize floats to write RGBA faces to, largest level first then faces</param>
+	/// <returns>Whether the options are valid and the chain was written</returns>
+	bool Prefilter(const Cube& source, const SH& sh, const PrefilterOptions& options, float* pDst);
+
+	/// <summary>
+	/// Resamples a cubemap into one equirectangular or octahedral image, rows are spread across threads
+	/// Directions are worked out 4 texels at a time (equirectangular longitudes from a table shared by the row) and the faces they fall on with SSE2,
+	/// each face is clamped at its edges as in SampleCube
+	/// </summary>
+	/// <param name="source">Level of the cubemap to read</param>
+	/// <param name="options">Layout, size and filter of the image</param>
+	/// <param name="pDst">Buffer of width * height * 4 floats to write RGBA rows to, top row first</param>
+	/// <returns>Whether the options and source are valid and the image was written</returns>
+	bool Unwrap(const Cube& source, const UnwrapOptions& options, float* pDst);
+}
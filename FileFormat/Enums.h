@@ -31,7 +31,19 @@ enum class IMAGE_FORMAT : int32_t
 	UVWQ8888,
 	RGBA16161616F,
 	RGBA16161616,
-	UVLX8888
+	UVLX8888,
+	R32F,
+	RGB323232F,
+	RGBA32323232F,
+	NV_DST16,
+	NV_DST24,
+	NV_INTZ,
+	NV_RAWZ,
+	ATI_DST16,
+	ATI_DST24,
+	NV_NULL,
+	ATI2N,
+	ATI1N
 };
 
 enum class TEXTURE_FLAGS : uint32_t
@@ -78,3 +90,53 @@ enum class TEXTURE_FLAGS : uint32_t
 	UNUSED_40000000 = 0x40000000,
 	UNUSED_80000000 = 0x80000000
 };
+
+/// <summary>
+/// Known resource tags, packed from the 3 tag bytes of a ResourceEntryInfo (little-endian)
+/// </summary>
+enum class RESOURCE_TYPE : uint32_t
+{
+	LOWRES_IMAGE = 0x000001,  // "\x01\0\0" Low resolution (thumbnail) image data
+	SHEET = 0x000010,         // "\x10\0\0" Animated particle sheet data
+	HIGHRES_IMAGE = 0x000030, // "\x30\0\0" High resolution image data
+	CRC = 0x435243,           // "CRC" CRC32 of the source image (stored inline)
+	LOD = 0x444F4C,           // "LOD" U/V LOD clamp (stored inline)
+	TSO = 0x4F5354,           // "TSO" Extended texture settings flags (stored inline)
+	KVD = 0x44564B            // "KVD" Arbitrary key values text
+};
+
+enum class RESOURCE_FLAGS : uint8_t
+{
+	NO_DATA_CHUNK = 0x02 // The entry's data field holds the resource itself instead of an offset to it
+};
+
+/// <summary>
+/// Which channels of a normal map hold the tangent space vector, each unpacked from 0-1 to -1-1
+/// </summary>
+enum class NORMAL_SWIZZLE : uint8_t
+{
+	XYZ, // Red, green and blue
+	XY,  // Red and green, z is reconstructed
+	AG   // Alpha and green (DXT5 normal maps with x moved to the alpha block), z is reconstructed
+};
+
+/// <summary>
+/// Layouts pixels can be converted to for export (see VTFTexture::ReadRegion), channels are always in the listed order
+/// </summary>
+enum class PIXEL_FORMAT : uint8_t
+{
+	RGBA8,   // 8 bit unorm per channel
+	BGRA8,   // 8 bit unorm per channel
+	RGBA16F, // IEEE half float per channel
+	RGBA32F  // IEEE float per channel
+};
+
+/// <summary>
+/// What an alpha test is known to return over a footprint without sampling (see VTFTexture::ClassifyAlpha)
+/// </summary>
+enum class ALPHA_COVERAGE : uint8_t
+{
+	ALL_TRANSPARENT, // Every sample in the footprint fails the threshold
+	ALL_OPAQUE,      // Every sample in the footprint passes the threshold
+	MIXED            // Samples may pass or fail, the texture has to be sampled
+};
@@ -1,8 +1,19 @@
 #include "Parser.h"
+#include "Resources.h"
+#include "../DXTn/DXTn.h"
+#include "../Util/ColourSpace.h"
+#include "../Util/Octahedral.h"
+#include "../Util/SIMD.h"
 
+#include <algorithm>
+#include <cmath>
 #include <cstdlib>
 #include <cstring>
 
+inline int intmod(int a, int b) {
+	return (a % b + b) % b;
+}
+
 static ImageFormatInfo VTFImageFormatInfo[] = {
 	{ "RGBA8888",           32,  4,  8,  8,  8,  8, false,  true }, // IMAGE_FORMAT_RGBA8888,
 	{ "ABGR8888",           32,  4,  8,  8,  8,  8, false,  true }, // IMAGE_FORMAT_ABGR8888, 
@@ -30,48 +41,62 @@ static ImageFormatInfo VTFImageFormatInfo[] = {
 	{ "UVWQ8888",           32,  4,  8,  8,  8,  8, false,  true }, // IMAGE_FORMAT_UVWQ8899
 	{ "RGBA16161616F",      64,  8, 16, 16, 16, 16, false,  true }, // IMAGE_FORMAT_RGBA16161616F
 	{ "RGBA16161616",       64,  8, 16, 16, 16, 16, false,  true }, // IMAGE_FORMAT_RGBA16161616
-	{ "UVLX8888",           32,  4,  8,  8,  8,  8, false,  true }  // IMAGE_FORMAT_UVLX8888
+	{ "UVLX8888",           32,  4,  8,  8,  8,  8, false,  true }, // IMAGE_FORMAT_UVLX8888
+	{ "R32F",               32,  4, 32,  0,  0,  0, false,  true }, // IMAGE_FORMAT_R32F
+	{ "RGB323232F",         96, 12, 32, 32, 32,  0, false,  true }, // IMAGE_FORMAT_RGB323232F
+	{ "RGBA32323232F",     128, 16, 32, 32, 32, 32, false,  true }, // IMAGE_FORMAT_RGBA32323232F
+	{ "nVidia DST16",       16,  2,  0,  0,  0,  0, false, false }, // IMAGE_FORMAT_NV_DST16
+	{ "nVidia DST24",       32,  4,  0,  0,  0,  0, false, false }, // IMAGE_FORMAT_NV_DST24
+	{ "nVidia INTZ",        32,  4,  0,  0,  0,  0, false, false }, // IMAGE_FORMAT_NV_INTZ
+	{ "nVidia RAWZ",        32,  4,  0,  0,  0,  0, false, false }, // IMAGE_FORMAT_NV_RAWZ
+	{ "ATI DST16",          16,  2,  0,  0,  0,  0, false, false }, // IMAGE_FORMAT_ATI_DST16
+	{ "ATI DST24",          32,  4,  0,  0,  0,  0, false, false }, // IMAGE_FORMAT_ATI_DST24
+	{ "nVidia NULL",        32,  4,  0,  0,  0,  0, false, false }, // IMAGE_FORMAT_NV_NULL
+	{ "ATI2N",               8,  0,  0,  0,  0,  0,  true,  true }, // IMAGE_FORMAT_ATI2N
+	{ "ATI1N",               4,  0,  0,  0,  0,  0,  true,  true }  // IMAGE_FORMAT_ATI1N
 };
 
 ImageFormatInfo VTFParser::GetImageFormatInfo(IMAGE_FORMAT format)
 {
-	if (format <= IMAGE_FORMAT::NONE || format > IMAGE_FORMAT::UVLX8888)
+	if (format <= IMAGE_FORMAT::NONE || format > IMAGE_FORMAT::ATI1N)
 		return ImageFormatInfo{ "Invalid Format", 0, 0, 0, 0, 0, 0, false, false };
 
 	return VTFImageFormatInfo[static_cast<uint32_t>(format)];
 }
 
-uint32_t VTFParser::CalcImageSize(uint16_t width, uint16_t height, uint16_t depth, IMAGE_FORMAT format)
+uint64_t VTFParser::CalcImageSize(uint16_t width, uint16_t height, uint16_t depth, IMAGE_FORMAT format)
 {
 	switch (format) {
 	case IMAGE_FORMAT::DXT1:
 	case IMAGE_FORMAT::DXT1_ONEBITALPHA:
+	case IMAGE_FORMAT::ATI1N:
 		if (width < 4 && width > 0)
 			width = 4;
 
 		if (height < 4 && height > 0)
 			height = 4;
 
-		return ((width + 3) / 4) * ((height + 3) / 4) * 8 * depth;
+		return static_cast<uint64_t>((width + 3) / 4) * ((height + 3) / 4) * 8 * depth;
 	case IMAGE_FORMAT::DXT3:
 	case IMAGE_FORMAT::DXT5:
+	case IMAGE_FORMAT::ATI2N:
 		if (width < 4 && width > 0)
 			width = 4;
 
 		if (height < 4 && height > 0)
 			height = 4;
 
-		return ((width + 3) / 4) * ((height + 3) / 4) * 16 * depth;
+		return static_cast<uint64_t>((width + 3) / 4) * ((height + 3) / 4) * 16 * depth;
 	default:
-		return width * height * depth * VTFParser::GetImageFormatInfo(format).bytesPerPixel;
+		return static_cast<uint64_t>(width) * height * depth * VTFParser::GetImageFormatInfo(format).bytesPerPixel;
 	}
 }
 
-uint32_t VTFParser::CalcImageSize(uint16_t width, uint16_t height, uint16_t depth, uint8_t numMips, IMAGE_FORMAT format)
+uint64_t VTFParser::CalcImageSize(uint16_t width, uint16_t height, uint16_t depth, uint8_t numMips, IMAGE_FORMAT format)
 {
 	if (width == 0 || height == 0 || depth == 0 || numMips == 0) return 0;
 
-	uint32_t imageSize = 0;
+	uint64_t imageSize = 0;
 	for (uint8_t i = 0; i < numMips; i++) {
 		imageSize += VTFParser::CalcImageSize(width, height, depth, format);
 
@@ -107,6 +132,8 @@ bool VTFParser::ParseHeader(const uint8_t* pData, size_t size, VTFHeader* pHeade
 	memset(pHeader, 0, sizeof(VTFHeader));
 	memcpy(pHeader, pData, fileHeader.headerSize);
 	if (pHeader->highResImageFormat == IMAGE_FORMAT::NONE) return false;
+	if (pHeader->mipmapCount > VTF_MAX_MIPMAPS) return false;
+	if (static_cast<uint64_t>(pHeader->width) * pHeader->height * pHeader->depth > UINT32_MAX) return false;
 
 	if (fileHeader.version[1] < 2) pHeader->depth = 1;
 	if (fileHeader.version[1] < 3) pHeader->numResources = 0;
@@ -114,42 +141,32 @@ bool VTFParser::ParseHeader(const uint8_t* pData, size_t size, VTFHeader* pHeade
 	return true;
 }
 
-bool VTFParser::ParseImageData(const uint8_t* pData, size_t size, const VTFHeader* pHeader, uint8_t** ppImageData, uint32_t* pImageDataSize)
+bool VTFParser::ParseImageData(const uint8_t* pData, size_t size, const VTFHeader* pHeader, uint8_t** ppImageData, size_t* pImageDataSize)
 {
 	// Only need to check for null pointers here (just in case), everything else should be validated by ParseHeader
 	if (pData == nullptr || pHeader == nullptr || pImageDataSize == nullptr) return false;
 
-	uint32_t imageDataSize = CalcImageSize(
+	// Can't overflow, a face is at most 2^32 texels of 16 bytes, so every MIP, frame and face together is below 2^57
+	const uint64_t imageDataSize = CalcImageSize(
 		pHeader->width, pHeader->height,
 		pHeader->depth, pHeader->mipmapCount,
 		pHeader->highResImageFormat
 	) * pHeader->frames * VTFParser::GetFaceCount(pHeader);
 
-	uint32_t imageDataOffset = 0;
-	if (pHeader->numResources > 0) {
-		if (pHeader->numResources > VTF_MAX_RESOURCES) return false;
-
-		for (uint32_t i = 0; i < pHeader->numResources; i++) {
-			if (memcmp(pHeader->resourceInfos[i].tag, "\x30\0\0", 3) == 0) {
-				if (imageDataOffset != 0) return false;
-				imageDataOffset = pHeader->resourceInfos[i].data;
-			}
-		}
-	} else {
-		uint32_t lowResImageSize = 0;
-		if (pHeader->lowResImageFormat != IMAGE_FORMAT::NONE) {
-			lowResImageSize = VTFParser::CalcImageSize(pHeader->lowResImageWidth, pHeader->lowResImageHeight, 1, pHeader->lowResImageFormat);
-		}
+	VTFResources resources(pData, size, pHeader);
+	if (!resources.IsValid()) return false;
 
-		imageDataOffset = pHeader->headerSize + lowResImageSize;
-	}
+	const VTFResource* pHighRes = resources.Find(RESOURCE_TYPE::HIGHRES_IMAGE);
+	if (pHighRes == nullptr) return false;
+	const uint32_t imageDataOffset = pHighRes->offset;
 
-	if (imageDataOffset + imageDataSize > size) return false;
+	// Also rejects sizes that don't fit in a size_t, as the buffer is never larger than one
+	if (imageDataOffset > size || imageDataSize > size - imageDataOffset) return false;
 
-	*ppImageData = reinterpret_cast<uint8_t*>(malloc(imageDataSize));
+	*ppImageData = reinterpret_cast<uint8_t*>(malloc(static_cast<size_t>(imageDataSize)));
 	if (*ppImageData == nullptr) return false;
-	memcpy(*ppImageData, pData + imageDataOffset, imageDataSize);
-	*pImageDataSize = imageDataSize;
+	memcpy(*ppImageData, pData + imageDataOffset, static_cast<size_t>(imageDataSize));
+	*pImageDataSize = static_cast<size_t>(imageDataSize);
 
 	return true;
 }
@@ -269,7 +286,757 @@ VTFPixel VTFParser::ParsePixel(const uint8_t* pPixelData, IMAGE_FORMAT format)
 			static_cast<float>(*reinterpret_cast<const uint16_t*>(pPixelData + 4)) / static_cast<float>(UINT16_MAX),
 			static_cast<float>(*reinterpret_cast<const uint16_t*>(pPixelData + 6)) / static_cast<float>(UINT16_MAX)
 		};
+	// HDR float formats aren't clamped, alpha of the 3 channel formats is 1
+	case IMAGE_FORMAT::R32F:
+	case IMAGE_FORMAT::RGB323232F:
+	case IMAGE_FORMAT::RGBA32323232F:
+	{
+		float channels[4] = { 0.f, 0.f, 0.f, 1.f };
+		memcpy(channels, pPixelData, format == IMAGE_FORMAT::R32F ? 4 : (format == IMAGE_FORMAT::RGB323232F ? 12 : 16));
+		return VTFPixel{ channels[0], channels[1], channels[2], channels[3] };
+	}
+	// Block compressed formats are either decompressed on read or sampled with FetchBlockTexel
 	default:
 		return VTFPixel{};
 	}
 }
+
+bool VTFParser::CanSampleBlocks(IMAGE_FORMAT format)
+{
+	switch (format) {
+	case IMAGE_FORMAT::DXT1:
+	case IMAGE_FORMAT::DXT1_ONEBITALPHA:
+	case IMAGE_FORMAT::DXT3:
+	case IMAGE_FORMAT::DXT5:
+	case IMAGE_FORMAT::ATI1N:
+	case IMAGE_FORMAT::ATI2N:
+		return true;
+	default:
+		return false;
+	}
+}
+
+VTFPixel VTFParser::FetchBlockTexel(const uint8_t* pData, uint16_t width, uint32_t x, uint32_t y, IMAGE_FORMAT format)
+{
+	const size_t block = static_cast<size_t>(y / 4) * ((width + 3) / 4) + x / 4;
+	const uint32_t texel = (y % 4) * 4 + x % 4;
+
+	uint8_t rgba[4];
+	switch (format) {
+	case IMAGE_FORMAT::DXT1:
+	case IMAGE_FORMAT::DXT1_ONEBITALPHA:
+		DXTn::DecodeColourTexel(pData + block * 8, texel, true, rgba);
+		return VTFPixel{ rgba[0] / 255.f, rgba[1] / 255.f, rgba[2] / 255.f, rgba[3] / 255.f };
+	case IMAGE_FORMAT::DXT3:
+	{
+		// Explicit 4 bit alpha, two texels per byte
+		const uint8_t* pBlock = pData + block * 16;
+		const uint8_t alpha = (pBlock[texel / 2] >> (texel % 2) * 4) & 0x0F;
+		DXTn::DecodeColourTexel(pBlock + 8, texel, false, rgba);
+		return VTFPixel{ rgba[0] / 255.f, rgba[1] / 255.f, rgba[2] / 255.f, (alpha | alpha << 4) / 255.f };
+	}
+	case IMAGE_FORMAT::DXT5:
+	{
+		const uint8_t* pBlock = pData + block * 16;
+		DXTn::DecodeColourTexel(pBlock + 8, texel, false, rgba);
+		return VTFPixel{ rgba[0] / 255.f, rgba[1] / 255.f, rgba[2] / 255.f, DXTn::DecodeAlphaTexel(pBlock, texel) / 255.f };
+	}
+	case IMAGE_FORMAT::ATI1N:
+	{
+		const float value = DXTn::DecodeAlphaTexel(pData + block * 8, texel) / 255.f;
+		return VTFPixel{ value, value, value };
+	}
+	case IMAGE_FORMAT::ATI2N:
+	{
+		const uint8_t* pBlock = pData + block * 16;
+		const uint8_t normalX = DXTn::DecodeAlphaTexel(pBlock, texel), normalY = DXTn::DecodeAlphaTexel(pBlock + 8, texel);
+		return VTFPixel{ normalX / 255.f, normalY / 255.f, DXTn::ReconstructNormalZ(normalX, normalY) / 255.f };
+	}
+	default:
+		return VTFPixel{};
+	}
+}
+
+static inline uint32_t CountBits(uint32_t bits)
+{
+	bits = bits - ((bits >> 1) & 0x55555555);
+	bits = (bits & 0x33333333) + ((bits >> 2) & 0x33333333);
+	return (((bits + (bits >> 4)) & 0x0F0F0F0F) * 0x01010101) >> 24;
+}
+
+// Texels of a block to sum, as the lowest bit of each texel's index (or value) in each of the block layouts
+struct BlockMask
+{
+	uint32_t texelCount = 16;
+	uint32_t texels = 0xFFFF;                       // 1 bit per texel
+	uint32_t colour = 0x55555555;                   // 2 bit colour indices
+	uint64_t explicitAlpha = 0x1111111111111111ull; // 4 bit explicit alpha (DXT3)
+};
+
+// Adds the colour (and alpha if addAlpha) of the masked texels of a colour block to the sums,
+// weighting the 4 palette entries by how many texels select each, counted from the bit planes of the indices
+static void SumColourBlock(const uint8_t* pBlock, const BlockMask& mask, bool allowTransparent, bool addAlpha, uint64_t* pSums)
+{
+	uint8_t palette[16];
+	DXTn::DecodeColourPalette(pBlock, allowTransparent, palette);
+
+	const uint32_t indices = pBlock[4] | pBlock[5] << 8 | pBlock[6] << 16 | static_cast<uint32_t>(pBlock[7]) << 24;
+	const uint32_t low = indices & mask.colour, high = (indices >> 1) & mask.colour;
+
+	uint32_t counts[4];
+	counts[3] = CountBits(low & high);
+	counts[1] = CountBits(low) - counts[3];
+	counts[2] = CountBits(high) - counts[3];
+	counts[0] = mask.texelCount - counts[1] - counts[2] - counts[3];
+
+	for (int c = 0; c < (addAlpha ? 4 : 3); c++)
+		pSums[c] += counts[0] * palette[c] + counts[1] * palette[4 + c] + counts[2] * palette[8 + c] + counts[3] * palette[12 + c];
+}
+
+// Sums the masked texels of an interpolated alpha block
+// An 8 entry histogram costs more than decoding the 16 values with DecodeAlphaBlock, so they're decoded and added up instead
+static uint32_t SumAlphaBlock(const uint8_t* pBlock, const BlockMask& mask)
+{
+	alignas(16) uint8_t values[16];
+	DXTn::DecodeAlphaBlock(pBlock, values);
+
+#ifdef VTF_SSE2
+	if (mask.texelCount == 16) {
+		const __m128i sums = _mm_sad_epu8(_mm_load_si128(reinterpret_cast<const __m128i*>(values)), _mm_setzero_si128());
+		return static_cast<uint32_t>(_mm_cvtsi128_si32(sums) + _mm_extract_epi16(sums, 4));
+	}
+#endif
+
+	uint32_t sum = 0;
+	for (uint32_t texel = 0; texel < 16; texel++) {
+		if (mask.texels >> texel & 1) sum += values[texel];
+	}
+	return sum;
+}
+
+bool VTFParser::SumBlockTexels(const uint8_t* pData, uint16_t width, uint16_t height, IMAGE_FORMAT format, uint64_t* pSums)
+{
+	// ATI2N's z depends on both of its channels, so it can't be summed a channel at a time
+	if (!CanSampleBlocks(format) || format == IMAGE_FORMAT::ATI2N) return false;
+
+	const uint32_t blocksWide = (width + 3) / 4, blocksHigh = (height + 3) / 4;
+	const uint32_t blockSize = GetImageFormatInfo(format).bitsPerPixel * 2;
+
+	for (uint32_t blockY = 0; blockY < blocksHigh; blockY++) {
+		const uint32_t rows = std::min(height - blockY * 4, 4u);
+		for (uint32_t blockX = 0; blockX < blocksWide; blockX++, pData += blockSize) {
+			// Partial blocks at the edges only sum the texels inside the image
+			BlockMask mask;
+			const uint32_t columns = std::min(width - blockX * 4, 4u);
+			if (rows < 4 || columns < 4) {
+				mask = BlockMask{ rows * columns, 0, 0, 0 };
+				for (uint32_t row = 0; row < rows; row++) {
+					for (uint32_t column = 0; column < columns; column++) {
+						const uint32_t texel = row * 4 + column;
+						mask.texels |= 1u << texel;
+						mask.colour |= 1u << texel * 2;
+						mask.explicitAlpha |= 1ull << texel * 4;
+					}
+				}
+			}
+
+			switch (format) {
+			case IMAGE_FORMAT::DXT1:
+			case IMAGE_FORMAT::DXT1_ONEBITALPHA:
+				SumColourBlock(pData, mask, true, true, pSums);
+				break;
+			case IMAGE_FORMAT::DXT3:
+			{
+				// Explicit 4 bit alpha, two texels per byte, added up a byte of nibble pairs at a time (each is expanded by * 17)
+				uint64_t alphas;
+				memcpy(&alphas, pData, 8);
+				alphas &= mask.explicitAlpha * 0xF;
+				const uint64_t pairs = (alphas & 0x0F0F0F0F0F0F0F0Full) + ((alphas >> 4) & 0x0F0F0F0F0F0F0F0Full);
+				pSums[3] += ((pairs * 0x0101010101010101ull) >> 56) * 17;
+
+				SumColourBlock(pData + 8, mask, false, false, pSums);
+				break;
+			}
+			case IMAGE_FORMAT::DXT5:
+				pSums[3] += SumAlphaBlock(pData, mask);
+				SumColourBlock(pData + 8, mask, false, false, pSums);
+				break;
+			default: // ATI1N
+			{
+				const uint32_t sum = SumAlphaBlock(pData, mask);
+				pSums[0] += sum;
+				pSums[1] += sum;
+				pSums[2] += sum;
+				pSums[3] += mask.texelCount * 255u;
+				break;
+			}
+			}
+		}
+	}
+
+	return true;
+}
+
+static VTFNormal UnpackNormalPixel(const VTFPixel& pixel, NORMAL_SWIZZLE swizzle)
+{
+	VTFNormal normal;
+	normal.x = (swizzle == NORMAL_SWIZZLE::AG ? pixel.a : pixel.r) * 2.f - 1.f;
+	normal.y = pixel.g * 2.f - 1.f;
+	normal.z = swizzle == NORMAL_SWIZZLE::XYZ ?
+		pixel.b * 2.f - 1.f :
+		sqrtf(std::max(1.f - normal.x * normal.x - normal.y * normal.y, 0.f));
+	return normal;
+}
+
+VTFNormal VTFParser::UnpackNormal(const uint8_t* pPixelData, IMAGE_FORMAT format, NORMAL_SWIZZLE swizzle)
+{
+	return UnpackNormalPixel(ParsePixel(pPixelData, format), swizzle);
+}
+
+namespace
+{
+	// Texels and weights of a bilinear lookup
+	struct BilinearTaps
+	{
+		const uint8_t* pCorners[2][2];
+		uint32_t xs[2], ys[2]; // Texel coordinates of the corners, for formats read with FetchBlockTexel
+		const uint8_t* pData;
+		uint16_t width;
+		float uFract, vFract;
+		float uFractInv, vFractInv;
+	};
+}
+
+static BilinearTaps CalcBilinearTaps(
+	const uint8_t* pData, uint16_t width, uint16_t height, uint32_t pixelSize,
+	bool clampX, bool clampY, float u, float v
+)
+{
+	// Remap to 0-1
+	if (clampX)
+		u = std::clamp(u, 0.f, 0.9999f);
+	else
+		u -= floorf(u);
+
+	if (clampY)
+		v = std::clamp(v, 0.f, 0.9999f);
+	else
+		v -= floorf(v);
+
+	// Remap to pixel centres
+	u = u * width - 0.5f;
+	v = v * height - 0.5f;
+
+	// Floor to nearest pixel
+	int x = floorf(u);
+	int y = floorf(v);
+
+	// Calculate fractional coordinate and inverse
+	BilinearTaps taps;
+	taps.uFract = u - x;
+	taps.vFract = v - y;
+	taps.uFractInv = 1.f - taps.uFract;
+	taps.vFractInv = 1.f - taps.vFract;
+	taps.pData = pData;
+	taps.width = width;
+
+	for (int xOff = 0; xOff < 2; xOff++) {
+		for (int yOff = 0; yOff < 2; yOff++) {
+			int xCorner = x + xOff, yCorner = y + yOff;
+			if (clampX)
+				xCorner = std::clamp(xCorner, 0, static_cast<int>(width) - 1);
+			else
+				xCorner = intmod(xCorner, width);
+
+			if (clampY)
+				yCorner = std::clamp(yCorner, 0, static_cast<int>(height) - 1);
+			else
+				yCorner = intmod(yCorner, height);
+
+			taps.pCorners[xOff][yOff] = pData + static_cast<size_t>(static_cast<uint32_t>(yCorner) * width + xCorner) * pixelSize;
+			taps.xs[xOff] = xCorner;
+			taps.ys[yOff] = yCorner;
+		}
+	}
+
+	return taps;
+}
+
+// Parses the corners of a lookup, in an image offset from the one the taps were calculated for
+static void ParseCorners(const BilinearTaps& taps, IMAGE_FORMAT format, ptrdiff_t offset, VTFPixel corners[2][2])
+{
+	if (VTFParser::CanSampleBlocks(format)) {
+		for (int xOff = 0; xOff < 2; xOff++) {
+			for (int yOff = 0; yOff < 2; yOff++)
+				corners[xOff][yOff] = VTFParser::FetchBlockTexel(taps.pData + offset, taps.width, taps.xs[xOff], taps.ys[yOff], format);
+		}
+		return;
+	}
+
+	for (int xOff = 0; xOff < 2; xOff++) {
+		for (int yOff = 0; yOff < 2; yOff++)
+			corners[xOff][yOff] = VTFParser::ParsePixel(taps.pCorners[xOff][yOff] + offset, format);
+	}
+}
+
+static VTFPixel BlendBilinear(const VTFPixel corners[2][2], const BilinearTaps& taps)
+{
+	const float uFract = taps.uFract, vFract = taps.vFract;
+	const float uFractInv = taps.uFractInv, vFractInv = taps.vFractInv;
+
+	return VTFPixel{
+		(corners[0][0].r * uFractInv + corners[1][0].r * uFract) * vFractInv +
+		(corners[0][1].r * uFractInv + corners[1][1].r * uFract) * vFract,
+
+		(corners[0][0].g * uFractInv + corners[1][0].g * uFract)* vFractInv +
+		(corners[0][1].g * uFractInv + corners[1][1].g * uFract) * vFract,
+
+		(corners[0][0].b * uFractInv + corners[1][0].b * uFract)* vFractInv +
+		(corners[0][1].b * uFractInv + corners[1][1].b * uFract) * vFract,
+
+		(corners[0][0].a * uFractInv + corners[1][0].a * uFract)* vFractInv +
+		(corners[0][1].a * uFractInv + corners[1][1].a * uFract) * vFract,
+	};
+}
+
+VTFPixel VTFParser::FilterBilinear(
+	const uint8_t* pData, uint16_t width, uint16_t height, IMAGE_FORMAT format,
+	bool clampX, bool clampY, float u, float v
+)
+{
+	const BilinearTaps taps = CalcBilinearTaps(pData, width, height, GetImageFormatInfo(format).bytesPerPixel, clampX, clampY, u, v);
+
+	VTFPixel corners[2][2];
+	ParseCorners(taps, format, 0, corners);
+	return BlendBilinear(corners, taps);
+}
+
+void VTFParser::PrefetchBilinear(
+	const uint8_t* pData, uint16_t width, uint16_t height, IMAGE_FORMAT format,
+	bool clampX, bool clampY, float u, float v
+)
+{
+	const uint64_t MIN_PREFETCH_SIZE = 256 * 1024;
+	if (CalcImageSize(width, height, 1, format) < MIN_PREFETCH_SIZE) return;
+
+	const BilinearTaps taps = CalcBilinearTaps(pData, width, height, GetImageFormatInfo(format).bytesPerPixel, clampX, clampY, u, v);
+
+	if (CanSampleBlocks(format)) {
+		const size_t blockSize = static_cast<size_t>(CalcImageSize(4, 4, 1, format));
+		const size_t blocksWide = (width + 3) / 4;
+		for (int xOff = 0; xOff < 2; xOff++) {
+			for (int yOff = 0; yOff < 2; yOff++)
+				VTF_PREFETCH(pData + (taps.ys[yOff] / 4 * blocksWide + taps.xs[xOff] / 4) * blockSize);
+		}
+		return;
+	}
+
+	for (int xOff = 0; xOff < 2; xOff++) {
+		for (int yOff = 0; yOff < 2; yOff++)
+			VTF_PREFETCH(taps.pCorners[xOff][yOff]);
+	}
+}
+
+namespace
+{
+	// Fixed point mapping of coordinates to texels on one axis of an image
+	struct NearestAxis
+	{
+		uint32_t size;
+		uint32_t shift; // 24 - log2(size) for power of two sizes, which then map with a shift and wrap with a mask
+		bool isPow2;
+		bool clamp;
+	};
+}
+
+#define NEAREST_FIXED_BITS 24
+
+static NearestAxis MakeNearestAxis(uint16_t size, bool clamp)
+{
+	NearestAxis axis;
+	axis.size = size;
+	axis.isPow2 = (size & (size - 1)) == 0;
+	axis.clamp = clamp;
+
+	axis.shift = NEAREST_FIXED_BITS;
+	for (uint32_t remaining = size; remaining > 1; remaining >>= 1) axis.shift--;
+
+	return axis;
+}
+
+static inline uint32_t MapNearest(const NearestAxis& axis, float t)
+{
+	// Remap to 0-1 as in CalcBilinearTaps, then to 0.24 fixed point
+	if (axis.clamp)
+		t = std::clamp(t, 0.f, 0.9999f);
+	else
+		t -= floorf(t);
+	const uint32_t fixed = static_cast<uint32_t>(t * (1 << NEAREST_FIXED_BITS));
+
+	// Wrapping may round up to exactly 1, which is texel 0 again
+	if (axis.isPow2) return (fixed >> axis.shift) & (axis.size - 1);
+
+	const uint32_t texel = static_cast<uint32_t>((static_cast<uint64_t>(fixed) * axis.size) >> NEAREST_FIXED_BITS);
+	return texel < axis.size ? texel : 0;
+}
+
+VTFPixel VTFParser::FilterNearest(
+	const uint8_t* pData, uint16_t width, uint16_t height, IMAGE_FORMAT format,
+	bool clampX, bool clampY, float u, float v
+)
+{
+	const uint32_t x = MapNearest(MakeNearestAxis(width, clampX), u);
+	const uint32_t y = MapNearest(MakeNearestAxis(height, clampY), v);
+	if (CanSampleBlocks(format)) return FetchBlockTexel(pData, width, x, y, format);
+	return ParsePixel(pData + static_cast<size_t>(y * width + x) * GetImageFormatInfo(format).bytesPerPixel, format);
+}
+
+#ifdef VTF_SSE2
+// High bits of each lane's 32 x 32 bit product (SSE2 only multiplies the even lanes to 64 bit)
+static inline __m128i MulShift(__m128i a, __m128i b, int shift)
+{
+	const __m128i count = _mm_cvtsi32_si128(shift);
+	const __m128i even = _mm_srl_epi64(_mm_mul_epu32(a, b), count);
+	const __m128i odd = _mm_srl_epi64(_mm_mul_epu32(_mm_srli_epi64(a, 32), _mm_srli_epi64(b, 32)), count);
+	return _mm_unpacklo_epi32(_mm_shuffle_epi32(even, _MM_SHUFFLE(0, 0, 2, 0)), _mm_shuffle_epi32(odd, _MM_SHUFFLE(0, 0, 2, 0)));
+}
+
+// Same as MapNearest for 4 lanes
+static inline __m128i MapNearest4(const NearestAxis& axis, const float* pT)
+{
+	__m128 t = _mm_loadu_ps(pT);
+	if (axis.clamp)
+		t = _mm_min_ps(_mm_max_ps(t, _mm_setzero_ps()), _mm_set1_ps(0.9999f));
+	else
+		t = _mm_sub_ps(t, VTFUtil::Floor4(t));
+	const __m128i fixed = _mm_cvttps_epi32(_mm_mul_ps(t, _mm_set1_ps(1 << NEAREST_FIXED_BITS)));
+
+	const __m128i last = _mm_set1_epi32(axis.size - 1);
+	if (axis.isPow2) return _mm_and_si128(_mm_srl_epi32(fixed, _mm_cvtsi32_si128(axis.shift)), last);
+
+	const __m128i texel = MulShift(fixed, _mm_set1_epi32(axis.size), NEAREST_FIXED_BITS);
+	return _mm_andnot_si128(_mm_cmpgt_epi32(texel, last), texel);
+}
+#endif
+
+void VTFParser::FilterNearestBatch(
+	const uint8_t* pData, uint16_t width, uint16_t height, IMAGE_FORMAT format,
+	bool clampX, bool clampY, const float* pU, const float* pV, size_t count, VTFPixel* pOut
+)
+{
+	const NearestAxis xAxis = MakeNearestAxis(width, clampX), yAxis = MakeNearestAxis(height, clampY);
+	const bool isBlocks = CanSampleBlocks(format);
+	const uint32_t pixelSize = GetImageFormatInfo(format).bytesPerPixel;
+	const size_t blockSize = isBlocks ? static_cast<size_t>(CalcImageSize(4, 4, 1, format)) : 0;
+	const size_t blocksWide = (width + 3) / 4;
+
+	// Each chunk of lanes is mapped to texels and every texel prefetched before any is read, so the misses overlap
+	// (a multiple of 4 lanes, so the same lanes are mapped with SSE2 as if there were no chunks)
+	const size_t PREFETCH_CHUNK = 32;
+	alignas(16) uint32_t xs[PREFETCH_CHUNK], ys[PREFETCH_CHUNK];
+	for (size_t begin = 0; begin < count; begin += PREFETCH_CHUNK) {
+		const size_t chunk = std::min(PREFETCH_CHUNK, count - begin);
+		size_t i = 0;
+
+#ifdef VTF_SSE2
+		for (; i + 4 <= chunk; i += 4) {
+			_mm_store_si128(reinterpret_cast<__m128i*>(xs + i), MapNearest4(xAxis, pU + begin + i));
+			_mm_store_si128(reinterpret_cast<__m128i*>(ys + i), MapNearest4(yAxis, pV + begin + i));
+		}
+#endif
+
+		for (; i < chunk; i++) {
+			xs[i] = MapNearest(xAxis, pU[begin + i]);
+			ys[i] = MapNearest(yAxis, pV[begin + i]);
+		}
+
+		if (isBlocks) {
+			for (i = 0; i < chunk; i++) VTF_PREFETCH(pData + (ys[i] / 4 * blocksWide + xs[i] / 4) * blockSize);
+			for (i = 0; i < chunk; i++) pOut[begin + i] = FetchBlockTexel(pData, width, xs[i], ys[i], format);
+		} else {
+			for (i = 0; i < chunk; i++) VTF_PREFETCH(pData + static_cast<size_t>(ys[i] * width + xs[i]) * pixelSize);
+			for (i = 0; i < chunk; i++) pOut[begin + i] = ParsePixel(pData + static_cast<size_t>(ys[i] * width + xs[i]) * pixelSize, format);
+		}
+	}
+}
+
+VTFPixel VTFParser::FilterBilinearBlend(
+	const uint8_t* pData, const uint8_t* pDataOther, uint16_t width, uint16_t height, IMAGE_FORMAT format,
+	bool clampX, bool clampY, float u, float v, float blend
+)
+{
+	if (pDataOther == pData || blend <= 0.f) return FilterBilinear(pData, width, height, format, clampX, clampY, u, v);
+
+	// Both images share the same taps, offset by the distance between them
+	const BilinearTaps taps = CalcBilinearTaps(pData, width, height, GetImageFormatInfo(format).bytesPerPixel, clampX, clampY, u, v);
+	const ptrdiff_t otherOffset = pDataOther - pData;
+
+	VTFPixel corners[2][2], otherCorners[2][2];
+	ParseCorners(taps, format, 0, corners);
+	ParseCorners(taps, format, otherOffset, otherCorners);
+
+	const VTFPixel pixel = BlendBilinear(corners, taps), other = BlendBilinear(otherCorners, taps);
+	const float blendInv = 1.f - blend;
+
+	return VTFPixel{
+		pixel.r * blendInv + other.r * blend,
+		pixel.g * blendInv + other.g * blend,
+		pixel.b * blendInv + other.b * blend,
+		pixel.a * blendInv + other.a * blend
+	};
+}
+
+// Byte index of each channel for the 4 byte formats whose colour channels can be decoded straight from the LUT, or nullptr
+static const uint8_t* GetByteChannelOrder(IMAGE_FORMAT format)
+{
+	static const uint8_t RGBA[4] = { 0, 1, 2, 3 };
+	static const uint8_t ABGR[4] = { 3, 2, 1, 0 };
+	static const uint8_t ARGB[4] = { 1, 2, 3, 0 };
+	static const uint8_t BGRA[4] = { 2, 1, 0, 3 };
+
+	switch (format) {
+	case IMAGE_FORMAT::RGBA8888:
+		return RGBA;
+	case IMAGE_FORMAT::ABGR8888:
+		return ABGR;
+	case IMAGE_FORMAT::ARGB8888:
+		return ARGB;
+	case IMAGE_FORMAT::BGRA8888:
+	case IMAGE_FORMAT::BGRX8888:
+		return BGRA;
+	default:
+		return nullptr;
+	}
+}
+
+VTFPixel VTFParser::FilterBilinearSRGB(
+	const uint8_t* pData, uint16_t width, uint16_t height, IMAGE_FORMAT format,
+	bool clampX, bool clampY, float u, float v
+)
+{
+	const VTFUtil::ColourTables& tables = VTFUtil::GetColourTables();
+	const BilinearTaps taps = CalcBilinearTaps(pData, width, height, GetImageFormatInfo(format).bytesPerPixel, clampX, clampY, u, v);
+
+	const uint8_t* pOrder = GetByteChannelOrder(format);
+	if (pOrder != nullptr) {
+#ifdef VTF_SSE2
+		auto load = [&](const uint8_t* p) {
+			return _mm_setr_ps(tables.toLinear[p[pOrder[0]]], tables.toLinear[p[pOrder[1]]], tables.toLinear[p[pOrder[2]]], tables.toUnorm[p[pOrder[3]]]);
+		};
+
+		const __m128 uFract = _mm_set1_ps(taps.uFract), vFract = _mm_set1_ps(taps.vFract);
+		const __m128 uFractInv = _mm_set1_ps(taps.uFractInv), vFractInv = _mm_set1_ps(taps.vFractInv);
+
+		const __m128 top = _mm_add_ps(_mm_mul_ps(load(taps.pCorners[0][0]), uFractInv), _mm_mul_ps(load(taps.pCorners[1][0]), uFract));
+		const __m128 bottom = _mm_add_ps(_mm_mul_ps(load(taps.pCorners[0][1]), uFractInv), _mm_mul_ps(load(taps.pCorners[1][1]), uFract));
+
+		alignas(16) float result[4];
+		_mm_store_ps(result, _mm_add_ps(_mm_mul_ps(top, vFractInv), _mm_mul_ps(bottom, vFract)));
+		return VTFPixel{ result[0], result[1], result[2], result[3] };
+#else
+		VTFPixel corners[2][2];
+		for (int xOff = 0; xOff < 2; xOff++) {
+			for (int yOff = 0; yOff < 2; yOff++) {
+				const uint8_t* p = taps.pCorners[xOff][yOff];
+				corners[xOff][yOff] = VTFPixel{
+					tables.toLinear[p[pOrder[0]]], tables.toLinear[p[pOrder[1]]], tables.toLinear[p[pOrder[2]]], tables.toUnorm[p[pOrder[3]]]
+				};
+			}
+		}
+		return BlendBilinear(corners, taps);
+#endif
+	}
+
+	// Any other format is parsed and decoded by interpolating the table, which is exact for 8 bit channels
+	VTFPixel corners[2][2];
+	ParseCorners(taps, format, 0, corners);
+	for (int xOff = 0; xOff < 2; xOff++) {
+		for (int yOff = 0; yOff < 2; yOff++) {
+			const VTFPixel pixel = corners[xOff][yOff];
+			corners[xOff][yOff] = VTFPixel{
+				VTFUtil::DecodeSRGB(tables, pixel.r), VTFUtil::DecodeSRGB(tables, pixel.g), VTFUtil::DecodeSRGB(tables, pixel.b), pixel.a
+			};
+		}
+	}
+	return BlendBilinear(corners, taps);
+}
+
+// Corners of a bilinear lookup in the order their weights are returned by GetTapWeights
+static void GetTapTexels(const BilinearTaps& taps, const uint8_t* pTexels[4])
+{
+	pTexels[0] = taps.pCorners[0][0];
+	pTexels[1] = taps.pCorners[1][0];
+	pTexels[2] = taps.pCorners[0][1];
+	pTexels[3] = taps.pCorners[1][1];
+}
+
+// Parsed corners in the same order as GetTapTexels
+static void GetTapPixels(const BilinearTaps& taps, IMAGE_FORMAT format, VTFPixel pixels[4])
+{
+	VTFPixel corners[2][2];
+	ParseCorners(taps, format, 0, corners);
+	pixels[0] = corners[0][0];
+	pixels[1] = corners[1][0];
+	pixels[2] = corners[0][1];
+	pixels[3] = corners[1][1];
+}
+
+static void GetTapWeights(const BilinearTaps& taps, float weights[4])
+{
+	weights[0] = taps.uFractInv * taps.vFractInv;
+	weights[1] = taps.uFract * taps.vFractInv;
+	weights[2] = taps.uFractInv * taps.vFract;
+	weights[3] = taps.uFract * taps.vFract;
+}
+
+#ifdef VTF_SSE2
+// Weights the x, y and z of 4 texels (one texel per lane) and sums them into one vector
+static VTFNormal SumNormalTaps(__m128 x, __m128 y, __m128 z, __m128 weights)
+{
+	__m128 rows[4] = { _mm_mul_ps(x, weights), _mm_mul_ps(y, weights), _mm_mul_ps(z, weights), _mm_setzero_ps() };
+	_MM_TRANSPOSE4_PS(rows[0], rows[1], rows[2], rows[3]);
+
+	alignas(16) float sum[4];
+	_mm_store_ps(sum, _mm_add_ps(_mm_add_ps(rows[0], rows[1]), _mm_add_ps(rows[2], rows[3])));
+	return VTFNormal{ sum[0], sum[1], sum[2] };
+}
+#endif
+
+VTFNormal VTFParser::FilterBilinearNormal(
+	const uint8_t* pData, uint16_t width, uint16_t height, IMAGE_FORMAT format, NORMAL_SWIZZLE swizzle,
+	bool clampX, bool clampY, float u, float v
+)
+{
+	const BilinearTaps taps = CalcBilinearTaps(pData, width, height, GetImageFormatInfo(format).bytesPerPixel, clampX, clampY, u, v);
+
+	const uint8_t* pTexels[4];
+	alignas(16) float weights[4];
+	GetTapTexels(taps, pTexels);
+	GetTapWeights(taps, weights);
+
+#ifdef VTF_SSE2
+	// Gather each component of the 4 texels into a register, then unpack and reconstruct them together
+	alignas(16) float components[3][4];
+	float scale = 2.f;
+
+	const uint8_t* pOrder = GetByteChannelOrder(format);
+	if (pOrder != nullptr) {
+		const uint8_t xByte = pOrder[swizzle == NORMAL_SWIZZLE::AG ? 3 : 0], yByte = pOrder[1], zByte = pOrder[2];
+		for (int i = 0; i < 4; i++) {
+			components[0][i] = pTexels[i][xByte];
+			components[1][i] = pTexels[i][yByte];
+			components[2][i] = pTexels[i][zByte];
+		}
+		scale = 2.f / 255.f;
+	} else {
+		VTFPixel pixels[4];
+		GetTapPixels(taps, format, pixels);
+		for (int i = 0; i < 4; i++) {
+			const VTFPixel& pixel = pixels[i];
+			components[0][i] = swizzle == NORMAL_SWIZZLE::AG ? pixel.a : pixel.r;
+			components[1][i] = pixel.g;
+			components[2][i] = pixel.b;
+		}
+	}
+
+	const __m128 scales = _mm_set1_ps(scale), one = _mm_set1_ps(1.f);
+	const __m128 x = _mm_sub_ps(_mm_mul_ps(_mm_load_ps(components[0]), scales), one);
+	const __m128 y = _mm_sub_ps(_mm_mul_ps(_mm_load_ps(components[1]), scales), one);
+
+	__m128 z;
+	if (swizzle == NORMAL_SWIZZLE::XYZ) {
+		z = _mm_sub_ps(_mm_mul_ps(_mm_load_ps(components[2]), scales), one);
+	} else {
+		const __m128 zSquared = _mm_sub_ps(_mm_sub_ps(one, _mm_mul_ps(x, x)), _mm_mul_ps(y, y));
+		z = _mm_sqrt_ps(_mm_max_ps(zSquared, _mm_setzero_ps()));
+	}
+
+	return SumNormalTaps(x, y, z, _mm_load_ps(weights));
+#else
+	VTFPixel pixels[4];
+	GetTapPixels(taps, format, pixels);
+
+	VTFNormal sum{ 0.f, 0.f, 0.f };
+	for (int i = 0; i < 4; i++) {
+		const VTFNormal normal = UnpackNormalPixel(pixels[i], swizzle);
+		sum.x += normal.x * weights[i];
+		sum.y += normal.y * weights[i];
+		sum.z += normal.z * weights[i];
+	}
+	return sum;
+#endif
+}
+
+VTFNormal VTFParser::FilterBilinearOctahedral(
+	const uint32_t* pData, uint16_t width, uint16_t height,
+	bool clampX, bool clampY, float u, float v
+)
+{
+	const BilinearTaps taps = CalcBilinearTaps(reinterpret_cast<const uint8_t*>(pData), width, height, 4, clampX, clampY, u, v);
+
+	const uint8_t* pTexels[4];
+	alignas(16) float weights[4];
+	GetTapTexels(taps, pTexels);
+	GetTapWeights(taps, weights);
+
+	uint32_t packed[4];
+	for (int i = 0; i < 4; i++)
+		packed[i] = *reinterpret_cast<const uint32_t*>(pTexels[i]);
+
+#ifdef VTF_SSE2
+	// Same as VTFUtil::DecodeOctahedral for 4 texels
+	const __m128i texels = _mm_setr_epi32(
+		static_cast<int>(packed[0]), static_cast<int>(packed[1]), static_cast<int>(packed[2]), static_cast<int>(packed[3])
+	);
+
+	const __m128 scale = _mm_set1_ps(2.f / 65535.f), one = _mm_set1_ps(1.f), zero = _mm_setzero_ps();
+	const __m128 signMask = _mm_set1_ps(-0.f);
+
+	__m128 x = _mm_sub_ps(_mm_mul_ps(_mm_cvtepi32_ps(_mm_and_si128(texels, _mm_set1_epi32(0xffff))), scale), one);
+	__m128 y = _mm_sub_ps(_mm_mul_ps(_mm_cvtepi32_ps(_mm_srli_epi32(texels, 16)), scale), one);
+	const __m128 z = _mm_sub_ps(_mm_sub_ps(one, _mm_andnot_ps(signMask, x)), _mm_andnot_ps(signMask, y));
+
+	// Step x and y back towards 0 by the fold, decoded components are never exactly 0 so the sign is always set correctly
+	const __m128 fold = _mm_max_ps(_mm_sub_ps(zero, z), zero);
+	x = _mm_sub_ps(x, _mm_or_ps(fold, _mm_and_ps(x, signMask)));
+	y = _mm_sub_ps(y, _mm_or_ps(fold, _mm_and_ps(y, signMask)));
+
+	// Decoded vectors are 1 / sqrt(3) to 1 long, normalise them so every tap is weighted as an unpacked normal would be
+	const __m128 invLength = _mm_div_ps(one, _mm_sqrt_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(x, x), _mm_mul_ps(y, y)), _mm_mul_ps(z, z))));
+	return SumNormalTaps(_mm_mul_ps(x, invLength), _mm_mul_ps(y, invLength), _mm_mul_ps(z, invLength), _mm_load_ps(weights));
+#else
+	VTFNormal sum{ 0.f, 0.f, 0.f };
+	for (int i = 0; i < 4; i++) {
+		float x, y, z;
+		VTFUtil::DecodeOctahedral(packed[i], &x, &y, &z);
+
+		// Decoded vectors are 1 / sqrt(3) to 1 long, normalise them so every tap is weighted as an unpacked normal would be
+		const float invLength = 1.f / sqrtf(x * x + y * y + z * z);
+		sum.x += x * invLength * weights[i];
+		sum.y += y * invLength * weights[i];
+		sum.z += z * invLength * weights[i];
+	}
+	return sum;
+#endif
+}
+
+VTFNormal VTFParser::FilterNearestNormal(
+	const uint8_t* pData, uint16_t width, uint16_t height, IMAGE_FORMAT format, NORMAL_SWIZZLE swizzle,
+	bool clampX, bool clampY, float u, float v
+)
+{
+	return UnpackNormalPixel(FilterNearest(pData, width, height, format, clampX, clampY, u, v), swizzle);
+}
+
+VTFNormal VTFParser::FilterNearestOctahedral(
+	const uint32_t* pData, uint16_t width, uint16_t height,
+	bool clampX, bool clampY, float u, float v
+)
+{
+	const uint32_t x = MapNearest(MakeNearestAxis(width, clampX), u);
+	const uint32_t y = MapNearest(MakeNearestAxis(height, clampY), v);
+
+	VTFNormal normal;
+	VTFUtil::DecodeOctahedral(pData[static_cast<size_t>(y) * width + x], &normal.x, &normal.y, &normal.z);
+	return normal;
+}
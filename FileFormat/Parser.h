@@ -2,6 +2,7 @@
 
 #include "Enums.h"
 #include "Structs.h"
+#include <cstddef>
 #include <cstdint>
 
 namespace VTFParser
@@ -21,7 +22,7 @@ namespace VTFParser
 	/// <param name="depth">Depth of the image (volumetrics)</param>
 	/// <param name="format">Format of the image</param>
 	/// <returns>Size of the image block in bytes</returns>
-	uint32_t CalcImageSize(uint16_t width, uint16_t height, uint16_t depth, IMAGE_FORMAT format);
+	uint64_t CalcImageSize(uint16_t width, uint16_t height, uint16_t depth, IMAGE_FORMAT format);
 
 	/// <summary>
 	/// Calculates the size of an image block
@@ -32,7 +33,7 @@ namespace VTFParser
 	/// <param name="numMips">Number of MIP levels</param>
 	/// <param name="format">Format of the image</param>
 	/// <returns>Size of the image block in bytes</returns>
-	uint32_t CalcImageSize(uint16_t width, uint16_t height, uint16_t depth, uint8_t numMips, IMAGE_FORMAT format);
+	uint64_t CalcImageSize(uint16_t width, uint16_t height, uint16_t depth, uint8_t numMips, IMAGE_FORMAT format);
 
 	/// <summary>
 	/// Gets the number of faces in the image (only applicable to envmaps)
@@ -43,6 +44,8 @@ namespace VTFParser
 
 	/// <summary>
 	/// Parses a VTF's header and validates it
+	/// Each face of each MIP may have at most UINT32_MAX texels (any 2D image, or a volume of up to 4G texels),
+	/// so texels within a subimage can be addressed with 32 bit indices
 	/// </summary>
 	/// <param name="pData">Pointer to binary VTF data</param>
 	/// <param name="size">Size of the data in bytes</param>
@@ -58,8 +61,194 @@ namespace VTFParser
 	/// <param name="pHeader">Readonly pointer to the VTF's header</param>
 	/// <param name="pImageData">Pointer to char* that will be set to the image data</param>
 	/// <param name="pImageDataSize">Pointer to size_t that will be set to the size of the image data in bytes</param>
-	/// <returns>Whether the parse was successful</returns>
-	bool ParseImageData(const uint8_t* pData, size_t size, const VTFHeader* pHeader, uint8_t** ppImageData, uint32_t* pImageDataSize);
+	/// <returns>Whether the parse was successful (false if the image data doesn't fit in memory on this platform)</returns>
+	bool ParseImageData(const uint8_t* pData, size_t size, const VTFHeader* pHeader, uint8_t** ppImageData, size_t* pImageDataSize);
 
 	VTFPixel ParsePixel(const uint8_t* pPixelData, IMAGE_FORMAT format);
+
+	/// <summary>
+	/// Returns whether a block compressed format can be read a texel at a time with FetchBlockTexel (DXT1, DXT3, DXT5, ATI1N and ATI2N),
+	/// which the filtering functions below then do instead of requiring the image to be decompressed
+	/// </summary>
+	bool CanSampleBlocks(IMAGE_FORMAT format);
+
+	/// <summary>
+	/// Decodes a single texel of a block compressed image, identical to the texel of the image decompressed to RGBA8888
+	/// </summary>
+	/// <param name="pData">Pointer to the image's blocks</param>
+	/// <param name="width">Width of the image</param>
+	/// <param name="x">Coordinate of the texel on the x axis</param>
+	/// <param name="y">Coordinate of the texel on the y axis</param>
+	/// <param name="format">Format of the blocks (see CanSampleBlocks)</param>
+	/// <returns>VTFPixel struct with the texel</returns>
+	VTFPixel FetchBlockTexel(const uint8_t* pData, uint16_t width, uint32_t x, uint32_t y, IMAGE_FORMAT format);
+
+	/// <summary>
+	/// Sums each channel of a block compressed image without decompressing it, identical to summing the image decompressed to RGBA8888
+	/// Colour blocks weight their 4 palette entries by a histogram of their indices, alpha blocks are decoded and added up a block at a time
+	/// </summary>
+	/// <param name="pData">Pointer to the image's blocks</param>
+	/// <param name="width">Width of the image</param>
+	/// <param name="height">Height of the image</param>
+	/// <param name="format">Format of the blocks</param>
+	/// <param name="pSums">Array of 4 sums of 8 bit channel values to add to</param>
+	/// <returns>False if the format can't be summed per block (anything CanSampleBlocks rejects, and ATI2N, whose z depends on both channels)</returns>
+	bool SumBlockTexels(const uint8_t* pData, uint16_t width, uint16_t height, IMAGE_FORMAT format, uint64_t* pSums);
+
+	/// <summary>
+	/// Parses a normal map texel and unpacks it from 0-1 colour to a -1-1 vector, reconstructing z if the swizzle doesn't store it
+	/// </summary>
+	/// <param name="pPixelData">Pointer to the texel</param>
+	/// <param name="format">Format of the texel (must not be block compressed)</param>
+	/// <param name="swizzle">Channels holding the vector</param>
+	/// <returns>VTFNormal struct with the unpacked vector (not renormalised)</returns>
+	VTFNormal UnpackNormal(const uint8_t* pPixelData, IMAGE_FORMAT format, NORMAL_SWIZZLE swizzle);
+
+	/// <summary>
+	/// Bilinearly filters a single 2D image
+	/// </summary>
+	/// <param name="pData">Pointer to the image's pixel data</param>
+	/// <param name="width">Width of the image</param>
+	/// <param name="height">Height of the image</param>
+	/// <param name="format">Format of the pixel data (must not be block compressed, unless CanSampleBlocks)</param>
+	/// <param name="clampX">Clamp instead of wrapping at the horizontal edges</param>
+	/// <param name="clampY">Clamp instead of wrapping at the vertical edges</param>
+	/// <param name="u">U coordinate</param>
+	/// <param name="v">V coordinate</param>
+	/// <returns>VTFPixel struct with the filtered pixel</returns>
+	VTFPixel FilterBilinear(
+		const uint8_t* pData, uint16_t width, uint16_t height, IMAGE_FORMAT format,
+		bool clampX, bool clampY, float u, float v
+	);
+
+	/// <summary>
+	/// Hints that FilterBilinear is about to be called with the same arguments, prefetching the cache lines of its 4 texels (or blocks)
+	/// Does nothing for images small enough to stay cached, where working out the addresses costs more than the prefetch hides
+	/// </summary>
+	void PrefetchBilinear(
+		const uint8_t* pData, uint16_t width, uint16_t height, IMAGE_FORMAT format,
+		bool clampX, bool clampY, float u, float v
+	);
+
+	/// <summary>
+	/// Point samples a single 2D image, fetching only the texel containing the coordinate
+	/// Coordinates are mapped to texels in 0.24 fixed point, power of two sizes with a shift and a mask
+	/// </summary>
+	/// <param name="pData">Pointer to the image's pixel data</param>
+	/// <param name="width">Width of the image</param>
+	/// <param name="height">Height of the image</param>
+	/// <param name="format">Format of the pixel data (must not be block compressed, unless CanSampleBlocks)</param>
+	/// <param name="clampX">Clamp instead of wrapping at the horizontal edges</param>
+	/// <param name="clampY">Clamp instead of wrapping at the vertical edges</param>
+	/// <param name="u">U coordinate</param>
+	/// <param name="v">V coordinate</param>
+	/// <returns>VTFPixel struct with the texel</returns>
+	VTFPixel FilterNearest(
+		const uint8_t* pData, uint16_t width, uint16_t height, IMAGE_FORMAT format,
+		bool clampX, bool clampY, float u, float v
+	);
+
+	/// <summary>
+	/// Point samples many coordinates at once, identical to calling FilterNearest for each
+	/// Texel indices are computed 4 lanes at a time with SSE2, and the texels of each chunk of 32 lanes are prefetched before the first is read
+	/// </summary>
+	/// <param name="pU">Array of count U coordinates</param>
+	/// <param name="pV">Array of count V coordinates</param>
+	/// <param name="count">Number of lanes</param>
+	/// <param name="pOut">Array of count pixels to populate</param>
+	void FilterNearestBatch(
+		const uint8_t* pData, uint16_t width, uint16_t height, IMAGE_FORMAT format,
+		bool clampX, bool clampY, const float* pU, const float* pV, size_t count, VTFPixel* pOut
+	);
+
+	/// <summary>
+	/// Bilinearly filters the same coordinate in two 2D images of the same size and format (e.g. consecutive frames) and blends the results,
+	/// computing the texel offsets once for both
+	/// </summary>
+	/// <param name="pData">Pointer to the first image's pixel data</param>
+	/// <param name="pDataOther">Pointer to the second image's pixel data</param>
+	/// <param name="blend">Weight of the second image, 0 to 1</param>
+	/// <returns>VTFPixel struct with the blended pixel</returns>
+	VTFPixel FilterBilinearBlend(
+		const uint8_t* pData, const uint8_t* pDataOther, uint16_t width, uint16_t height, IMAGE_FORMAT format,
+		bool clampX, bool clampY, float u, float v, float blend
+	);
+
+	/// <summary>
+	/// Bilinearly filters a single 2D image with sRGB encoded colour channels, decoding each texel to linear before filtering
+	/// Decoding goes through a lookup table, with SSE2 blending for 4 byte per pixel formats
+	/// </summary>
+	/// <returns>VTFPixel struct with the filtered pixel in linear space (alpha is never encoded)</returns>
+	VTFPixel FilterBilinearSRGB(
+		const uint8_t* pData, uint16_t width, uint16_t height, IMAGE_FORMAT format,
+		bool clampX, bool clampY, float u, float v
+	);
+
+	/// <summary>
+	/// Bilinearly filters a single 2D normal map, unpacking each texel to a vector (see UnpackNormal) before filtering
+	/// The 4 texels are unpacked and weighted together with SSE2
+	/// </summary>
+	/// <returns>VTFNormal struct with the filtered vector, which is shorter than 1 where the texels diverge and must be renormalised</returns>
+	VTFNormal FilterBilinearNormal(
+		const uint8_t* pData, uint16_t width, uint16_t height, IMAGE_FORMAT format, NORMAL_SWIZZLE swizzle,
+		bool clampX, bool clampY, float u, float v
+	);
+
+	/// <summary>
+	/// Bilinearly filters a single 2D image of octahedral encoded normals (see VTFUtil::EncodeOctahedral), decoding and normalising each texel before filtering
+	/// </summary>
+	/// <returns>VTFNormal struct with the filtered vector (not renormalised)</returns>
+	VTFNormal FilterBilinearOctahedral(
+		const uint32_t* pData, uint16_t width, uint16_t height,
+		bool clampX, bool clampY, float u, float v
+	);
+
+	/// <summary>
+	/// Point samples a single 2D normal map, unpacking the texel FilterNearest fetches to a vector (see UnpackNormal)
+	/// </summary>
+	/// <returns>VTFNormal struct with the unpacked vector</returns>
+	VTFNormal FilterNearestNormal(
+		const uint8_t* pData, uint16_t width, uint16_t height, IMAGE_FORMAT format, NORMAL_SWIZZLE swizzle,
+		bool clampX, bool clampY, float u, float v
+	);
+
+	/// <summary>
+	/// Point samples a single 2D image of octahedral encoded normals (see VTFUtil::EncodeOctahedral), decoding the texel containing the coordinate
+	/// </summary>
+	/// <returns>VTFNormal struct with the decoded vector (not normalised)</returns>
+	VTFNormal FilterNearestOctahedral(
+		const uint32_t* pData, uint16_t width, uint16_t height,
+		bool clampX, bool clampY, float u, float v
+	);
+
+	/// <summary>
+	/// Blends the filtered pixels of 2 MIPs (or frames), as trilinear filtering does between the MIPs either side of a level
+	/// </summary>
+	/// <param name="high">Pixel from the larger MIP</param>
+	/// <param name="low">Pixel from the smaller MIP</param>
+	/// <param name="fract">Weight of the smaller MIP, 0 to 1</param>
+	/// <returns>VTFPixel struct with the blended pixel</returns>
+	inline VTFPixel LerpPixel(const VTFPixel& high, const VTFPixel& low, float fract)
+	{
+		const float fractInv = 1.f - fract;
+		return VTFPixel{
+			low.r * fract + high.r * fractInv,
+			low.g * fract + high.g * fractInv,
+			low.b * fract + high.b * fractInv,
+			low.a * fract + high.a * fractInv
+		};
+	}
+
+	/// <summary>
+	/// Blends the filtered vectors of 2 MIPs, the same as LerpPixel (the result is not renormalised)
+	/// </summary>
+	inline VTFNormal LerpNormal(const VTFNormal& high, const VTFNormal& low, float fract)
+	{
+		const float fractInv = 1.f - fract;
+		return VTFNormal{
+			low.x * fract + high.x * fractInv,
+			low.y * fract + high.y * fractInv,
+			low.z * fract + high.z * fractInv
+		};
+	}
 }
@@ -0,0 +1,152 @@
+#include "Resources.h"
+#include "Parser.h"
+
+#include <cstddef>
+#include <cstring>
+
+// Resources without the NO_DATA_CHUNK flag (other than images) are prefixed by their size
+static bool IsImageResource(RESOURCE_TYPE type)
+{
+	return type == RESOURCE_TYPE::LOWRES_IMAGE || type == RESOURCE_TYPE::HIGHRES_IMAGE;
+}
+
+static uint64_t CalcImageResourceSize(RESOURCE_TYPE type, const VTFHeader* pHeader)
+{
+	if (type == RESOURCE_TYPE::LOWRES_IMAGE) {
+		if (pHeader->lowResImageFormat == IMAGE_FORMAT::NONE) return 0;
+		return VTFParser::CalcImageSize(pHeader->lowResImageWidth, pHeader->lowResImageHeight, 1, pHeader->lowResImageFormat);
+	}
+
+	return VTFParser::CalcImageSize(
+		pHeader->width, pHeader->height,
+		pHeader->depth, pHeader->mipmapCount,
+		pHeader->highResImageFormat
+	) * pHeader->frames * VTFParser::GetFaceCount(pHeader);
+}
+
+static void SetResourceData(VTFResource& resource, const uint8_t* pData, size_t size)
+{
+	if (resource.offset <= size && resource.size <= size - resource.offset)
+		resource.pData = pData + resource.offset;
+	else
+		resource.pData = nullptr;
+}
+
+VTFResources::VTFResources(const uint8_t* pData, size_t size, const VTFHeader* pHeader)
+{
+	if (pData == nullptr || pHeader == nullptr) return;
+
+	if (pHeader->version[1] < 3 || pHeader->numResources == 0) {
+		// Legacy layout, header -> low res image -> high res image
+		const RESOURCE_TYPE legacyTypes[2] = { RESOURCE_TYPE::LOWRES_IMAGE, RESOURCE_TYPE::HIGHRES_IMAGE };
+
+		uint32_t offset = pHeader->headerSize;
+		for (RESOURCE_TYPE type : legacyTypes) {
+			VTFResource& resource = mResources[mCount++];
+			resource.type = type;
+			resource.flags = 0;
+			resource.offset = offset;
+			resource.size = CalcImageResourceSize(type, pHeader);
+			SetResourceData(resource, pData, size);
+
+			offset += static_cast<uint32_t>(resource.size);
+		}
+
+		mIsValid = true;
+		return;
+	}
+
+	if (pHeader->numResources > VTF_MAX_RESOURCES) return;
+
+	const uint32_t entriesOffset = static_cast<uint32_t>(
+		reinterpret_cast<const uint8_t*>(pHeader->resourceInfos) - reinterpret_cast<const uint8_t*>(pHeader)
+	);
+
+	bool hasHighRes = false;
+	for (uint32_t i = 0; i < pHeader->numResources; i++) {
+		const ResourceEntryInfo& info = pHeader->resourceInfos[i];
+		VTFResource& resource = mResources[mCount++];
+
+		resource.type = static_cast<RESOURCE_TYPE>(info.tag[0] | (info.tag[1] << 8) | (info.tag[2] << 16));
+		resource.flags = info.flags;
+
+		if (resource.type == RESOURCE_TYPE::HIGHRES_IMAGE) {
+			if (hasHighRes) return;
+			hasHighRes = true;
+		}
+
+		if (info.flags & static_cast<uint8_t>(RESOURCE_FLAGS::NO_DATA_CHUNK)) {
+			resource.offset = entriesOffset + i * sizeof(ResourceEntryInfo) + offsetof(ResourceEntryInfo, data);
+			resource.size = sizeof(ResourceEntryInfo::data);
+		} else if (IsImageResource(resource.type)) {
+			resource.offset = info.data;
+			resource.size = CalcImageResourceSize(resource.type, pHeader);
+		} else {
+			// Size prefixed chunk, only readable if the prefix is in the buffer
+			resource.offset = info.data + sizeof(uint32_t);
+			uint32_t chunkSize = 0;
+			if (static_cast<uint64_t>(info.data) + sizeof(uint32_t) <= size)
+				memcpy(&chunkSize, pData + info.data, sizeof(uint32_t));
+			resource.size = chunkSize;
+		}
+
+		SetResourceData(resource, pData, size);
+	}
+
+	mIsValid = true;
+}
+
+bool VTFResources::IsValid() const { return mIsValid; }
+
+uint32_t VTFResources::GetCount() const { return mCount; }
+
+const VTFResource& VTFResources::Get(uint32_t index) const
+{
+	return mResources[index];
+}
+
+const VTFResource* VTFResources::Find(RESOURCE_TYPE type) const
+{
+	for (uint32_t i = 0; i < mCount; i++) {
+		if (mResources[i].type == type) return &mResources[i];
+	}
+	return nullptr;
+}
+
+bool VTFResources::GetCRC(uint32_t* pCRC) const
+{
+	const VTFResource* pResource = Find(RESOURCE_TYPE::CRC);
+	if (pResource == nullptr || pResource->pData == nullptr || pResource->size < sizeof(uint32_t) || pCRC == nullptr) return false;
+
+	memcpy(pCRC, pResource->pData, sizeof(uint32_t));
+	return true;
+}
+
+bool VTFResources::GetLODClamp(uint8_t* pClampU, uint8_t* pClampV) const
+{
+	const VTFResource* pResource = Find(RESOURCE_TYPE::LOD);
+	if (pResource == nullptr || pResource->pData == nullptr || pResource->size < 2) return false;
+
+	if (pClampU != nullptr) *pClampU = pResource->pData[0];
+	if (pClampV != nullptr) *pClampV = pResource->pData[1];
+	return true;
+}
+
+bool VTFResources::GetTextureSettings(uint32_t* pFlags) const
+{
+	const VTFResource* pResource = Find(RESOURCE_TYPE::TSO);
+	if (pResource == nullptr || pResource->pData == nullptr || pResource->size < sizeof(uint32_t) || pFlags == nullptr) return false;
+
+	memcpy(pFlags, pResource->pData, sizeof(uint32_t));
+	return true;
+}
+
+bool VTFResources::GetKeyValues(const char** ppText, size_t* pLength) const
+{
+	const VTFResource* pResource = Find(RESOURCE_TYPE::KVD);
+	if (pResource == nullptr || pResource->pData == nullptr || ppText == nullptr || pLength == nullptr) return false;
+
+	*ppText = reinterpret_cast<const char*>(pResource->pData);
+	*pLength = static_cast<size_t>(pResource->size);
+	return true;
+}
@@ -0,0 +1,97 @@
+#pragma once
+
+#include "Enums.h"
+#include "Structs.h"
+#include <cstddef>
+#include <cstdint>
+
+/// <summary>
+/// A single resource from a VTF's resource directory
+/// </summary>
+struct VTFResource
+{
+	RESOURCE_TYPE type;    // Tag of the resource (may be a value not listed in RESOURCE_TYPE)
+	uint8_t flags;         // Resource entry flags
+	uint32_t offset;       // Offset of the resource's data in the file (of the inline data for NO_DATA_CHUNK resources)
+	uint64_t size;         // Size of the resource's data in bytes (the high res image may be larger than 4 GiB)
+	const uint8_t* pData;  // Pointer into the source buffer, or nullptr if the data lies outside of it
+};
+
+/// <summary>
+/// Zero-copy view over the resource directory of a VTF
+/// Version 7.2 and lower files are presented as having a low and high res image resource
+/// The source buffer must outlive this object
+/// </summary>
+class VTFResources
+{
+private:
+	VTFResource mResources[VTF_MAX_RESOURCES];
+	uint32_t mCount = 0;
+
+	bool mIsValid = false;
+
+public:
+	/// <summary>
+	/// Parses the resource directory of a VTF
+	/// </summary>
+	/// <param name="pData">Pointer to binary VTF data (may be truncated, resources outside of it will have no data pointer)</param>
+	/// <param name="size">Size of the data in bytes</param>
+	/// <param name="pHeader">Readonly pointer to the VTF's header, parsed from the same data</param>
+	VTFResources(const uint8_t* pData, size_t size, const VTFHeader* pHeader);
+
+	/// <summary>
+	/// Returns whether or not the resource directory is valid
+	/// </summary>
+	/// <returns>True if the directory was parsed successfully</returns>
+	bool IsValid() const;
+
+	/// <summary>
+	/// Gets the number of resources in the directory
+	/// </summary>
+	/// <returns>Number of resources</returns>
+	uint32_t GetCount() const;
+
+	/// <summary>
+	/// Gets a resource by index
+	/// </summary>
+	/// <param name="index">Index of the resource (must be less than GetCount)</param>
+	/// <returns>Readonly reference to the resource</returns>
+	const VTFResource& Get(uint32_t index) const;
+
+	/// <summary>
+	/// Finds a resource by its tag
+	/// </summary>
+	/// <param name="type">Tag of the resource to find</param>
+	/// <returns>Readonly pointer to the resource, or nullptr if it isn't present</returns>
+	const VTFResource* Find(RESOURCE_TYPE type) const;
+
+	/// <summary>
+	/// Gets the CRC32 stored in the CRC resource
+	/// </summary>
+	/// <param name="pCRC">Pointer to populate with the CRC</param>
+	/// <returns>Whether the resource was present</returns>
+	bool GetCRC(uint32_t* pCRC) const;
+
+	/// <summary>
+	/// Gets the LOD clamp stored in the LOD resource
+	/// </summary>
+	/// <param name="pClampU">Pointer to populate with the U clamp</param>
+	/// <param name="pClampV">Pointer to populate with the V clamp</param>
+	/// <returns>Whether the resource was present</returns>
+	bool GetLODClamp(uint8_t* pClampU, uint8_t* pClampV) const;
+
+	/// <summary>
+	/// Gets the extended texture settings flags stored in the TSO resource
+	/// </summary>
+	/// <param name="pFlags">Pointer to populate with the flags</param>
+	/// <returns>Whether the resource was present</returns>
+	bool GetTextureSettings(uint32_t* pFlags) const;
+
+	/// <summary>
+	/// Gets the key values text stored in the KVD resource (not null terminated)
+	/// </summary>
+	/// <param name="ppText">Pointer to set to the start of the text in the source buffer</param>
+	/// <param name="pLength">Pointer to populate with the length of the text</param>
+	/// <returns>Whether the resource was present and within the source buffer</returns>
+	bool GetKeyValues(const char** ppText, size_t* pLength) const;
+};
@@ -4,6 +4,7 @@
 #include <cstdint>
 
 #define VTF_MAX_RESOURCES 32
+#define VTF_MAX_MIPMAPS 16 // Full chain of a 65535 pixel image
 
 #if defined(__GNUC__) || defined(__clang__)
 #  define ALIGN(x) __attribute__ ((aligned(x)))
@@ -92,3 +93,13 @@ struct VTFPixel
 	float b = 0;
 	float a = 1;
 };
+
+/// <summary>
+/// Tangent space normal, or the weights of the 3 basis vectors of a self shadowing (SSBUMP) bumpmap
+/// </summary>
+struct VTFNormal
+{
+	float x = 0;
+	float y = 0;
+	float z = 1;
+};
@@ -0,0 +1,288 @@
+#include "Mipmaps.h"
+#include "../Util/ColourSpace.h"
+#include "../Util/Parallel.h"
+#include "../Util/SIMD.h"
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+#define KAISER_TAPS 6
+#define KAISER_WIDTH 3.f
+#define KAISER_ALPHA 4.f
+
+// One RGBA pixel in a register, levels are filtered in float so each one is built from the unquantised level above it
+#ifdef VTF_SSE2
+typedef __m128 Vec4;
+
+static inline Vec4 Zero() { return _mm_setzero_ps(); }
+static inline Vec4 Load(const float* p) { return _mm_loadu_ps(p); }
+static inline void Store(float* p, Vec4 v) { _mm_storeu_ps(p, v); }
+static inline Vec4 Add(Vec4 a, Vec4 b) { return _mm_add_ps(a, b); }
+static inline Vec4 Scale(Vec4 a, float s) { return _mm_mul_ps(a, _mm_set1_ps(s)); }
+static inline Vec4 Set(float r, float g, float b, float a) { return _mm_setr_ps(r, g, b, a); }
+#else
+struct Vec4 { float v[4]; };
+
+static inline Vec4 Zero() { return Vec4{ { 0.f, 0.f, 0.f, 0.f } }; }
+static inline Vec4 Load(const float* p) { return Vec4{ { p[0], p[1], p[2], p[3] } }; }
+static inline void Store(float* p, Vec4 v) { for (int c = 0; c < 4; c++) p[c] = v.v[c]; }
+static inline Vec4 Add(Vec4 a, Vec4 b) { return Vec4{ { a.v[0] + b.v[0], a.v[1] + b.v[1], a.v[2] + b.v[2], a.v[3] + b.v[3] } }; }
+static inline Vec4 Scale(Vec4 a, float s) { return Vec4{ { a.v[0] * s, a.v[1] * s, a.v[2] * s, a.v[3] * s } }; }
+static inline Vec4 Set(float r, float g, float b, float a) { return Vec4{ { r, g, b, a } }; }
+#endif
+
+namespace
+{
+	// Reads the RGBA8888 source level
+	struct ByteSource
+	{
+		const uint8_t* pData;
+		const float* pColourTable;
+
+		inline Vec4 operator()(size_t index) const
+		{
+			const uint8_t* p = pData + index * 4;
+			return Set(pColourTable[p[0]], pColourTable[p[1]], pColourTable[p[2]], p[3] / 255.f);
+		}
+	};
+
+	// Reads a previously generated float level
+	struct FloatSource
+	{
+		const float* pData;
+
+		inline Vec4 operator()(size_t index) const
+		{
+			return Load(pData + index * 4);
+		}
+	};
+
+	struct Kernel
+	{
+		float weights[KAISER_TAPS];
+	};
+}
+
+static float BesselI0(float x)
+{
+	float sum = 1.f, term = 1.f;
+	for (int k = 1; k < 16; k++) {
+		term *= (x / (2.f * k)) * (x / (2.f * k));
+		sum += term;
+	}
+	return sum;
+}
+
+static const Kernel& GetKaiserKernel()
+{
+	static const Kernel kernel = [] {
+		Kernel k;
+		float sum = 0.f;
+		for (int i = 0; i < KAISER_TAPS; i++) {
+			// Distance from the destination texel centre in destination texels
+			float x = (i - KAISER_TAPS / 2 + 0.5f) * 0.5f;
+			float sinc = x == 0.f ? 1.f : sinf(3.14159265f * x) / (3.14159265f * x);
+			float window = BesselI0(KAISER_ALPHA * sqrtf(std::max(0.f, 1.f - (x / KAISER_WIDTH) * (x / KAISER_WIDTH)))) / BesselI0(KAISER_ALPHA);
+			k.weights[i] = sinc * window;
+			sum += k.weights[i];
+		}
+		for (int i = 0; i < KAISER_TAPS; i++) k.weights[i] /= sum;
+		return k;
+	}();
+	return kernel;
+}
+
+static inline uint32_t WrapIndex(int i, uint32_t size, bool clamp)
+{
+	if (clamp) return static_cast<uint32_t>(std::clamp(i, 0, static_cast<int>(size) - 1));
+	return static_cast<uint32_t>((i % static_cast<int>(size) + static_cast<int>(size)) % static_cast<int>(size));
+}
+
+template<typename Source>
+static void DownsampleBox(const Source& src, uint32_t width, uint32_t height, uint32_t depth, float* dst, const Mipmaps::Options&)
+{
+	const uint32_t dstWidth = std::max(width >> 1, 1u), dstHeight = std::max(height >> 1, 1u), dstDepth = std::max(depth >> 1, 1u);
+
+	VTFUtil::ParallelFor(static_cast<size_t>(dstHeight) * dstDepth, 16, [&](size_t begin, size_t end) {
+		for (size_t row = begin; row < end; row++) {
+			uint32_t y = static_cast<uint32_t>(row % dstHeight), z = static_cast<uint32_t>(row / dstHeight);
+
+			// Axes with a size of 1 just sample the same texel twice
+			uint32_t y0 = std::min(y * 2, height - 1), y1 = std::min(y * 2 + 1, height - 1);
+			uint32_t z0 = std::min(z * 2, depth - 1), z1 = std::min(z * 2 + 1, depth - 1);
+			const size_t rows[4] = {
+				(static_cast<size_t>(z0) * height + y0) * width, (static_cast<size_t>(z0) * height + y1) * width,
+				(static_cast<size_t>(z1) * height + y0) * width, (static_cast<size_t>(z1) * height + y1) * width
+			};
+
+			for (uint32_t x = 0; x < dstWidth; x++) {
+				uint32_t x0 = std::min(x * 2, width - 1), x1 = std::min(x * 2 + 1, width - 1);
+
+				Vec4 sum = Zero();
+				for (size_t rowStart : rows) sum = Add(sum, Add(src(rowStart + x0), src(rowStart + x1)));
+				Store(dst + (row * dstWidth + x) * 4, Scale(sum, 0.125f));
+			}
+		}
+	});
+}
+
+template<typename Source>
+static void DownsampleKaiser(const Source& src, uint32_t width, uint32_t height, uint32_t depth, float* dst, const Mipmaps::Options& options)
+{
+	const Kernel& kernel = GetKaiserKernel();
+	const uint32_t dstWidth = std::max(width >> 1, 1u), dstHeight = std::max(height >> 1, 1u), dstDepth = std::max(depth >> 1, 1u);
+
+	// Horizontal pass into a dstWidth x height x depth buffer
+	std::vector<float> horizontal(static_cast<size_t>(dstWidth) * height * depth * 4);
+	VTFUtil::ParallelFor(static_cast<size_t>(height) * depth, 16, [&](size_t begin, size_t end) {
+		for (size_t row = begin; row < end; row++) {
+			for (uint32_t x = 0; x < dstWidth; x++) {
+				Vec4 sum = Zero();
+				if (width == 1) {
+					sum = src(row);
+				} else {
+					for (int tap = 0; tap < KAISER_TAPS; tap++) {
+						uint32_t sx = WrapIndex(static_cast<int>(x * 2) + tap - KAISER_TAPS / 2 + 1, width, options.clampS);
+						sum = Add(sum, Scale(src(row * width + sx), kernel.weights[tap]));
+					}
+				}
+				Store(horizontal.data() + (row * dstWidth + x) * 4, sum);
+			}
+		}
+	});
+
+	// Vertical pass, with a box filter across pairs of z slices
+	VTFUtil::ParallelFor(static_cast<size_t>(dstHeight) * dstDepth, 16, [&](size_t begin, size_t end) {
+		for (size_t row = begin; row < end; row++) {
+			uint32_t y = static_cast<uint32_t>(row % dstHeight), z = static_cast<uint32_t>(row / dstHeight);
+			const uint32_t slices[2] = { std::min(z * 2, depth - 1), std::min(z * 2 + 1, depth - 1) };
+
+			for (uint32_t x = 0; x < dstWidth; x++) {
+				Vec4 sum = Zero();
+				for (uint32_t slice : slices) {
+					const float* pSlice = horizontal.data() + static_cast<size_t>(slice) * height * dstWidth * 4;
+					if (height == 1) {
+						sum = Add(sum, Load(pSlice + x * 4));
+						continue;
+					}
+
+					for (int tap = 0; tap < KAISER_TAPS; tap++) {
+						uint32_t sy = WrapIndex(static_cast<int>(y * 2) + tap - KAISER_TAPS / 2 + 1, height, options.clampT);
+						sum = Add(sum, Scale(Load(pSlice + (static_cast<size_t>(sy) * dstWidth + x) * 4), kernel.weights[tap]));
+					}
+				}
+				Store(dst + (row * dstWidth + x) * 4, Scale(sum, 0.5f));
+			}
+		}
+	});
+}
+
+template<typename Source>
+static void Downsample(const Source& src, uint32_t width, uint32_t height, uint32_t depth, float* dst, const Mipmaps::Options& options)
+{
+	if (options.filter == Mipmaps::FILTER::KAISER)
+		DownsampleKaiser(src, width, height, depth, dst, options);
+	else
+		DownsampleBox(src, width, height, depth, dst, options);
+}
+
+static float CalcCoverage(const float* level, size_t pixelCount, float threshold, float scale)
+{
+	size_t covered = 0;
+	for (size_t i = 0; i < pixelCount; i++) {
+		if (level[i * 4 + 3] * scale > threshold) covered++;
+	}
+	return static_cast<float>(covered) / pixelCount;
+}
+
+static float FindCoverageScale(const float* level, size_t pixelCount, float threshold, float targetCoverage)
+{
+	// Coverage only grows with the scale, so binary search for the target
+	float low = 0.f, high = 4.f, scale = 1.f;
+	for (int i = 0; i < 10; i++) {
+		float coverage = CalcCoverage(level, pixelCount, threshold, scale);
+		if (coverage < targetCoverage)
+			low = scale;
+		else if (coverage > targetCoverage)
+			high = scale;
+		else
+			break;
+
+		scale = (low + high) * 0.5f;
+	}
+	return scale;
+}
+
+static void Quantise(const float* level, size_t pixelCount, bool sRGB, float alphaScale, uint8_t* dst)
+{
+	const VTFUtil::ColourTables& tables = VTFUtil::GetColourTables();
+
+	VTFUtil::ParallelFor(pixelCount, 1 << 14, [&](size_t begin, size_t end) {
+		for (size_t i = begin; i < end; i++) {
+			const float* p = level + i * 4;
+			for (int c = 0; c < 3; c++) {
+				float value = std::clamp(p[c], 0.f, 1.f);
+				if (sRGB)
+					dst[i * 4 + c] = tables.toSRGB[static_cast<int>(value * (SRGB_ENCODE_STEPS - 1) + 0.5f)];
+				else
+					dst[i * 4 + c] = static_cast<uint8_t>(value * 255.f + 0.5f);
+			}
+			dst[i * 4 + 3] = static_cast<uint8_t>(std::clamp(p[3] * alphaScale, 0.f, 1.f) * 255.f + 0.5f);
+		}
+	});
+}
+
+uint8_t Mipmaps::CalcFullChainLength(uint16_t width, uint16_t height, uint16_t depth)
+{
+	uint8_t levels = 1;
+	for (uint16_t size = std::max({ width, height, depth }); size > 1; size >>= 1) levels++;
+	return levels;
+}
+
+void Mipmaps::GenerateChain(const uint8_t* src, uint16_t width, uint16_t height, uint16_t depth, uint8_t levelCount, uint8_t* const* ppDst, const Options& options)
+{
+	if (src == nullptr || ppDst == nullptr || levelCount == 0 || width == 0 || height == 0 || depth == 0) return;
+
+	const VTFUtil::ColourTables& tables = VTFUtil::GetColourTables();
+
+	float targetCoverage = 0.f;
+	if (options.preserveAlphaCoverage) {
+		const size_t pixelCount = static_cast<size_t>(width) * height * depth;
+		const uint8_t threshold = static_cast<uint8_t>(std::clamp(options.alphaCoverageThreshold, 0.f, 1.f) * 255.f);
+
+		size_t covered = 0;
+		for (size_t i = 0; i < pixelCount; i++) {
+			if (src[i * 4 + 3] > threshold) covered++;
+		}
+		targetCoverage = static_cast<float>(covered) / pixelCount;
+	}
+
+	std::vector<float> previous, current;
+	uint32_t levelWidth = width, levelHeight = height, levelDepth = depth;
+
+	for (uint8_t level = 0; level < levelCount; level++) {
+		const uint32_t nextWidth = std::max(levelWidth >> 1, 1u), nextHeight = std::max(levelHeight >> 1, 1u), nextDepth = std::max(levelDepth >> 1, 1u);
+		const size_t pixelCount = static_cast<size_t>(nextWidth) * nextHeight * nextDepth;
+		current.resize(pixelCount * 4);
+
+		if (level == 0) {
+			ByteSource source{ src, options.sRGB ? tables.toLinear : tables.toUnorm };
+			Downsample(source, levelWidth, levelHeight, levelDepth, current.data(), options);
+		} else {
+			FloatSource source{ previous.data() };
+			Downsample(source, levelWidth, levelHeight, levelDepth, current.data(), options);
+		}
+
+		float alphaScale = 1.f;
+		if (options.preserveAlphaCoverage)
+			alphaScale = FindCoverageScale(current.data(), pixelCount, options.alphaCoverageThreshold, targetCoverage);
+
+		Quantise(current.data(), pixelCount, options.sRGB, alphaScale, ppDst[level]);
+
+		std::swap(previous, current);
+		levelWidth = nextWidth;
+		levelHeight = nextHeight;
+		levelDepth = nextDepth;
+	}
+}
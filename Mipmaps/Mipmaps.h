@@ -0,0 +1,45 @@
+#pragma once
+
+#include <cstdint>
+
+/// <summary>
+/// MIP chain generation for RGBA8888 images
+/// </summary>
+namespace Mipmaps
+{
+	enum class FILTER
+	{
+		BOX,   // 2x2(x2) average, fastest
+		KAISER // 6 tap Kaiser windowed sinc, sharper and with less aliasing
+	};
+
+	struct Options
+	{
+		FILTER filter = FILTER::BOX;
+
+		bool sRGB = false;       // Filter colour channels in linear space (alpha is always linear)
+		bool clampS = false;     // Clamp instead of wrapping at the horizontal edges
+		bool clampT = false;     // Clamp instead of wrapping at the vertical edges
+
+		bool preserveAlphaCoverage = false; // Scale alpha so each MIP passes the alpha test as often as the source
+		float alphaCoverageThreshold = 0.5f;
+	};
+
+	/// <summary>
+	/// Calculates the number of MIP levels in a full chain down to 1x1x1
+	/// </summary>
+	uint8_t CalcFullChainLength(uint16_t width, uint16_t height, uint16_t depth);
+
+	/// <summary>
+	/// Generates MIP levels from a source image, each level is filtered from the unquantised level above it
+	/// Rows of each level are spread across threads
+	/// </summary>
+	/// <param name="src">RGBA8888 pixels of the source level (every z slice)</param>
+	/// <param name="width">Width of the source level</param>
+	/// <param name="height">Height of the source level</param>
+	/// <param name="depth">Depth of the source level</param>
+	/// <param name="levelCount">Number of levels to generate below the source</param>
+	/// <param name="ppDst">Array of levelCount pointers to write each level to, largest first</param>
+	/// <param name="options">Filtering options</param>
+	void GenerateChain(const uint8_t* src, uint16_t width, uint16_t height, uint16_t depth, uint8_t levelCount, uint8_t* const* ppDst, const Options& options);
+}
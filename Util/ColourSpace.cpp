@@ -0,0 +1,28 @@
+#include "ColourSpace.h"
+
+#include <algorithm>
+#include <cmath>
+
+using namespace VTFUtil;
+
+ColourTables::ColourTables()
+{
+	for (int i = 0; i < 256; i++) {
+		float c = i / 255.f;
+		toLinear[i] = c <= 0.04045f ? c / 12.92f : powf((c + 0.055f) / 1.055f, 2.4f);
+		toUnorm[i] = c;
+		toLinear16[i] = static_cast<uint16_t>(toLinear[i] * 65535.f + 0.5f);
+	}
+
+	for (int i = 0; i < SRGB_ENCODE_STEPS; i++) {
+		float c = i / static_cast<float>(SRGB_ENCODE_STEPS - 1);
+		float encoded = c <= 0.0031308f ? c * 12.92f : 1.055f * powf(c, 1.f / 2.4f) - 0.055f;
+		toSRGB[i] = static_cast<uint8_t>(std::clamp(encoded, 0.f, 1.f) * 255.f + 0.5f);
+	}
+}
+
+const ColourTables& VTFUtil::GetColourTables()
+{
+	static const ColourTables tables;
+	return tables;
+}
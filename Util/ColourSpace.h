@@ -0,0 +1,37 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+
+#define SRGB_ENCODE_STEPS 4096
+
+namespace VTFUtil
+{
+	/// <summary>
+	/// Lookup tables for converting 8 bit channels, so sRGB decoding never calls powf per texel
+	/// </summary>
+	struct ColourTables
+	{
+		float toLinear[256];               // sRGB encoded byte to linear float
+		float toUnorm[256];                // Byte to float without decoding (matches ParsePixel)
+		uint16_t toLinear16[256];          // sRGB encoded byte to linear 16 bit unorm
+		uint8_t toSRGB[SRGB_ENCODE_STEPS]; // Linear float in SRGB_ENCODE_STEPS steps to sRGB encoded byte
+
+		ColourTables();
+	};
+
+	/// <summary>
+	/// Gets the shared tables, built on first use
+	/// </summary>
+	const ColourTables& GetColourTables();
+
+	/// <summary>
+	/// Decodes an sRGB encoded value in the range 0-1 by interpolating the 8 bit table (exact for values from 8 bit channels)
+	/// </summary>
+	inline float DecodeSRGB(const ColourTables& tables, float value)
+	{
+		const float x = std::clamp(value, 0.f, 1.f) * 255.f;
+		const int i = std::min(static_cast<int>(x), 254);
+		return tables.toLinear[i] + (tables.toLinear[i + 1] - tables.toLinear[i]) * (x - i);
+	}
+}
@@ -0,0 +1,129 @@
+#include "Hash.h"
+#include "SIMD.h"
+
+#include <cstring>
+
+#define HASH_STRIPE_SIZE 64
+#define HASH_STRIPES_PER_BLOCK 16
+
+static constexpr uint64_t PRIME32_1 = 0x9E3779B1ull;
+static constexpr uint64_t PRIME32_2 = 0x85EBCA77ull;
+static constexpr uint64_t PRIME32_3 = 0xC2B2AE3Dull;
+static constexpr uint64_t PRIME64_1 = 0x9E3779B185EBCA87ull;
+static constexpr uint64_t PRIME64_2 = 0xC2B2AE3D27D4EB4Full;
+static constexpr uint64_t PRIME64_3 = 0x165667B19E3779F9ull;
+static constexpr uint64_t PRIME64_4 = 0x85EBCA77C2B2AE63ull;
+static constexpr uint64_t PRIME64_5 = 0x27D4EB2F165667C5ull;
+
+// Key each lane's input is xored with, odd multiples of the primes so every bit of every lane is flipped by something
+static constexpr uint64_t SECRET[8] = {
+	PRIME64_1 * 3, PRIME64_2 * 5, PRIME64_3 * 7, PRIME64_4 * 9,
+	PRIME64_5 * 11, PRIME64_1 * 13, PRIME64_2 * 15, PRIME64_3 * 17
+};
+
+static inline uint64_t Read64(const uint8_t* p)
+{
+	uint64_t value;
+	memcpy(&value, p, 8);
+	return value;
+}
+
+static inline uint64_t RotateLeft(uint64_t value, int bits)
+{
+	return (value << bits) | (value >> (64 - bits));
+}
+
+#ifdef VTF_SSE2
+// Each 64 bit lane gets the product of the low and high halves of its keyed input, and its neighbour's unkeyed input
+static inline void AccumulateStripe(__m128i* acc, const uint8_t* pStripe, const __m128i* keys)
+{
+	for (int i = 0; i < 4; i++) {
+		const __m128i data = _mm_loadu_si128(reinterpret_cast<const __m128i*>(pStripe + i * 16));
+		const __m128i keyed = _mm_xor_si128(data, keys[i]);
+		const __m128i product = _mm_mul_epu32(keyed, _mm_shuffle_epi32(keyed, _MM_SHUFFLE(0, 3, 0, 1)));
+		const __m128i swapped = _mm_shuffle_epi32(data, _MM_SHUFFLE(1, 0, 3, 2));
+		acc[i] = _mm_add_epi64(acc[i], _mm_add_epi64(product, swapped));
+	}
+}
+
+static inline void Scramble(__m128i* acc, const __m128i* keys)
+{
+	// 64 bit multiply by a 32 bit prime, from the products of each half
+	const __m128i prime = _mm_set1_epi32(static_cast<int>(PRIME32_1));
+	for (int i = 0; i < 4; i++) {
+		const __m128i mixed = _mm_xor_si128(_mm_xor_si128(acc[i], _mm_srli_epi64(acc[i], 47)), keys[i]);
+		const __m128i low = _mm_mul_epu32(mixed, prime);
+		const __m128i high = _mm_mul_epu32(_mm_srli_epi64(mixed, 32), prime);
+		acc[i] = _mm_add_epi64(low, _mm_slli_epi64(high, 32));
+	}
+}
+#else
+static inline void AccumulateStripe(uint64_t* acc, const uint8_t* pStripe, const uint64_t* keys)
+{
+	for (int i = 0; i < 8; i++) {
+		const uint64_t data = Read64(pStripe + i * 8);
+		const uint64_t keyed = data ^ keys[i];
+		acc[i ^ 1] += data;
+		acc[i] += (keyed & 0xFFFFFFFF) * (keyed >> 32);
+	}
+}
+
+static inline void Scramble(uint64_t* acc, const uint64_t* keys)
+{
+	for (int i = 0; i < 8; i++)
+		acc[i] = (acc[i] ^ (acc[i] >> 47) ^ keys[i]) * PRIME32_1;
+}
+#endif
+
+uint64_t VTFUtil::Hash64(const void* pData, size_t size, uint64_t seed)
+{
+	const uint8_t* pBytes = static_cast<const uint8_t*>(pData);
+
+	uint64_t keys[8];
+	for (int i = 0; i < 8; i++) keys[i] = SECRET[i] + (i % 2 == 0 ? seed : 0 - seed);
+
+	alignas(16) uint64_t acc[8] = { PRIME32_3, PRIME64_1, PRIME64_2, PRIME64_3, PRIME64_4, PRIME32_2, PRIME64_5, PRIME32_1 };
+
+	// The tail is zero padded to a whole stripe, the length is mixed in at the end so padding can't collide
+	alignas(16) uint8_t tail[HASH_STRIPE_SIZE] = {};
+	const size_t stripeCount = (size + HASH_STRIPE_SIZE - 1) / HASH_STRIPE_SIZE;
+	const size_t tailSize = size - (stripeCount == 0 ? 0 : (stripeCount - 1) * HASH_STRIPE_SIZE);
+	if (stripeCount != 0) memcpy(tail, pBytes + (stripeCount - 1) * HASH_STRIPE_SIZE, tailSize);
+
+#ifdef VTF_SSE2
+	__m128i accVectors[4], keyVectors[4];
+	for (int i = 0; i < 4; i++) {
+		accVectors[i] = _mm_load_si128(reinterpret_cast<const __m128i*>(acc + i * 2));
+		keyVectors[i] = _mm_loadu_si128(reinterpret_cast<const __m128i*>(keys + i * 2));
+	}
+#endif
+
+	for (size_t stripe = 0; stripe < stripeCount; stripe++) {
+		const uint8_t* pStripe = stripe + 1 == stripeCount ? tail : pBytes + stripe * HASH_STRIPE_SIZE;
+#ifdef VTF_SSE2
+		AccumulateStripe(accVectors, pStripe, keyVectors);
+		if ((stripe + 1) % HASH_STRIPES_PER_BLOCK == 0) Scramble(accVectors, keyVectors);
+#else
+		AccumulateStripe(acc, pStripe, keys);
+		if ((stripe + 1) % HASH_STRIPES_PER_BLOCK == 0) Scramble(acc, keys);
+#endif
+	}
+
+#ifdef VTF_SSE2
+	for (int i = 0; i < 4; i++) _mm_store_si128(reinterpret_cast<__m128i*>(acc + i * 2), accVectors[i]);
+#endif
+
+	// Fold the lanes together with XXH64's merge round, then avalanche
+	uint64_t hash = static_cast<uint64_t>(size) * PRIME64_1 + seed;
+	for (int i = 0; i < 8; i++) {
+		const uint64_t lane = RotateLeft(acc[i] * PRIME64_2, 31) * PRIME64_1;
+		hash = RotateLeft(hash ^ lane, 27) * PRIME64_1 + PRIME64_4;
+	}
+
+	hash ^= hash >> 33;
+	hash *= PRIME64_2;
+	hash ^= hash >> 29;
+	hash *= PRIME64_3;
+	hash ^= hash >> 32;
+	return hash;
+}
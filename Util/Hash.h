@@ -0,0 +1,17 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+namespace VTFUtil
+{
+	/// <summary>
+	/// Hashes bytes for content deduplication, structured like XXH3 (64 byte stripes into 8 multiply accumulate lanes,
+	/// scrambled every 1KB) so SSE2 does a stripe in 4 multiplies, but with its own constants and finalisation, so not XXH3 compatible
+	/// The scalar fallback gives the same hash, collisions are possible so equal hashes still need the bytes compared
+	/// </summary>
+	/// <param name="pData">Bytes to hash</param>
+	/// <param name="size">Number of bytes</param>
+	/// <param name="seed">Value mixed into every lane, different seeds give unrelated hashes</param>
+	uint64_t Hash64(const void* pData, size_t size, uint64_t seed = 0);
+}
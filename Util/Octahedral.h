@@ -0,0 +1,50 @@
+#pragma once
+
+#include <cmath>
+#include <cstdint>
+
+namespace VTFUtil
+{
+	/// <summary>
+	/// Encodes a unit vector by projecting it onto an octahedron and unfolding the lower half over the corners,
+	/// stored as 2 16 bit unorms (x in the low half), which is more precise than 8 bit per channel xyz in the same 4 bytes
+	/// </summary>
+	/// <returns>Packed vector, the zero vector encodes as +z</returns>
+	inline uint32_t EncodeOctahedral(float x, float y, float z)
+	{
+		const float length = fabsf(x) + fabsf(y) + fabsf(z);
+		if (!(length > 0.f)) return 0x80008000u;
+
+		x /= length;
+		y /= length;
+		if (z < 0.f) {
+			const float foldedX = (1.f - fabsf(y)) * (x >= 0.f ? 1.f : -1.f);
+			const float foldedY = (1.f - fabsf(x)) * (y >= 0.f ? 1.f : -1.f);
+			x = foldedX;
+			y = foldedY;
+		}
+
+		const uint32_t packedX = static_cast<uint32_t>((x * 0.5f + 0.5f) * 65535.f + 0.5f);
+		const uint32_t packedY = static_cast<uint32_t>((y * 0.5f + 0.5f) * 65535.f + 0.5f);
+		return packedX | (packedY << 16);
+	}
+
+	/// <summary>
+	/// Decodes a vector from EncodeOctahedral, the result has length 1 / sqrt(3) to 1 and is not normalised
+	/// </summary>
+	inline void DecodeOctahedral(uint32_t packed, float* pX, float* pY, float* pZ)
+	{
+		float x = (packed & 0xffff) * (2.f / 65535.f) - 1.f;
+		float y = (packed >> 16) * (2.f / 65535.f) - 1.f;
+		const float z = 1.f - fabsf(x) - fabsf(y);
+
+		// Points outside the inner diamond are the folded lower half
+		const float fold = z < 0.f ? -z : 0.f;
+		x += x >= 0.f ? -fold : fold;
+		y += y >= 0.f ? -fold : fold;
+
+		*pX = x;
+		*pY = y;
+		*pZ = z;
+	}
+}
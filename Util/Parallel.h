@@ -0,0 +1,50 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <system_error>
+#include <thread>
+#include <vector>
+
+namespace VTFUtil
+{
+	/// <summary>
+	/// Splits [0, count) into contiguous ranges and runs fn(begin, end) on each, one range per hardware thread
+	/// Runs inline if there isn't enough work to split, or if threads can't be created
+	/// </summary>
+	/// <param name="count">Number of work items</param>
+	/// <param name="minGrain">Minimum number of work items per range</param>
+	/// <param name="fn">Function taking (size_t begin, size_t end)</param>
+	template<typename F>
+	void ParallelFor(size_t count, size_t minGrain, F&& fn)
+	{
+		if (count == 0) return;
+
+		// Check the grain first, querying the hardware threads isn't free and small calls shouldn't pay for it
+		const size_t maxRanges = (count + std::max<size_t>(minGrain, 1) - 1) / std::max<size_t>(minGrain, 1);
+		const size_t threadCount = maxRanges <= 1 ? 1 : std::min<size_t>(std::max<size_t>(std::thread::hardware_concurrency(), 1), maxRanges);
+		if (threadCount <= 1) {
+			fn(static_cast<size_t>(0), count);
+			return;
+		}
+
+		const size_t rangeSize = (count + threadCount - 1) / threadCount;
+
+		std::vector<std::thread> threads;
+		threads.reserve(threadCount - 1);
+
+		size_t begin = rangeSize;
+		try {
+			for (; begin < count; begin += rangeSize)
+				threads.emplace_back(fn, begin, std::min(begin + rangeSize, count));
+		} catch (const std::system_error&) {
+			// Couldn't spawn any more threads, do the rest on this one
+			for (; begin < count; begin += rangeSize)
+				fn(begin, std::min(begin + rangeSize, count));
+		}
+
+		fn(static_cast<size_t>(0), std::min(rangeSize, count));
+
+		for (std::thread& thread : threads) thread.join();
+	}
+}
@@ -0,0 +1,33 @@
+#pragma once
+
+// SSE2 is baseline on x64 and opt in on x86, everything else falls back to scalar code
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#  define VTF_SSE2 1
+#  include <emmintrin.h>
+#endif
+
+// Hint that a cache line is about to be read
+#if defined(VTF_SSE2)
+#  define VTF_PREFETCH(p) _mm_prefetch(reinterpret_cast<const char*>(p), _MM_HINT_T0)
+#elif defined(__GNUC__) || defined(__clang__)
+#  define VTF_PREFETCH(p) __builtin_prefetch(p)
+#else
+#  define VTF_PREFETCH(p) ((void)(p))
+#endif
+
+#ifdef VTF_SSE2
+namespace VTFUtil
+{
+	/// <summary>
+	/// Rounds 4 floats down to integers (SSE2 has no floor instruction)
+	/// </summary>
+	inline __m128 Floor4(__m128 x)
+	{
+		// Truncate and step down where that rounded up, floats of 2^23 and above are already integers (and may not fit in an int)
+		const __m128 truncated = _mm_cvtepi32_ps(_mm_cvttps_epi32(x));
+		const __m128 floored = _mm_sub_ps(truncated, _mm_and_ps(_mm_cmpgt_ps(truncated, x), _mm_set1_ps(1.f)));
+		const __m128 isInteger = _mm_cmpge_ps(_mm_andnot_ps(_mm_set1_ps(-0.f), x), _mm_set1_ps(8388608.f));
+		return _mm_or_ps(_mm_and_ps(isInteger, x), _mm_andnot_ps(isInteger, floored));
+	}
+}
+#endif
@@ -0,0 +1,101 @@
+#include "Stats.h"
+
+using namespace VTFStats;
+
+const char* VTFStats::GetStageName(STAGE stage)
+{
+	switch (stage) {
+	case STAGE::HEADER:
+		return "header";
+	case STAGE::THUMBNAIL:
+		return "thumbnail";
+	case STAGE::IMAGE_DATA:
+		return "image_data";
+	case STAGE::DECOMPRESS:
+		return "decompress";
+	case STAGE::MIPMAPS:
+		return "mipmaps";
+	case STAGE::LINEARIZE:
+		return "linearize";
+	case STAGE::TRANSCODE:
+		return "transcode";
+	default:
+		return "unknown";
+	}
+}
+
+Snapshot Counters::Merge() const
+{
+	Snapshot snapshot;
+	snapshot.enabled = true;
+
+	for (const Shard& shard : mShards) {
+		for (size_t mip = 0; mip < MAX_MIPS; mip++) {
+			snapshot.samples[mip] += shard.samples[mip].load(std::memory_order_relaxed);
+			snapshot.pixelReads[mip] += shard.pixelReads[mip].load(std::memory_order_relaxed);
+		}
+		snapshot.sampleCalls += shard.sampleCalls.load(std::memory_order_relaxed);
+		snapshot.lodClampedLow += shard.lodClampedLow.load(std::memory_order_relaxed);
+		snapshot.lodClampedHigh += shard.lodClampedHigh.load(std::memory_order_relaxed);
+	}
+
+	for (size_t stage = 0; stage < static_cast<size_t>(STAGE::COUNT); stage++)
+		snapshot.stageNanoseconds[stage] = mStageNanoseconds[stage];
+
+	return snapshot;
+}
+
+void Counters::Reset()
+{
+	for (Shard& shard : mShards) {
+		for (size_t mip = 0; mip < MAX_MIPS; mip++) {
+			shard.samples[mip].store(0, std::memory_order_relaxed);
+			shard.pixelReads[mip].store(0, std::memory_order_relaxed);
+		}
+		shard.sampleCalls.store(0, std::memory_order_relaxed);
+		shard.lodClampedLow.store(0, std::memory_order_relaxed);
+		shard.lodClampedHigh.store(0, std::memory_order_relaxed);
+	}
+}
+
+std::string VTFStats::ExportJSON(const Snapshot& snapshot)
+{
+	std::string json = snapshot.enabled ? "{\"enabled\":true" : "{\"enabled\":false";
+
+	auto appendArray = [&json](const char* pName, const uint64_t* pValues, size_t count) {
+		json += ",\"";
+		json += pName;
+		json += "\":[";
+		for (size_t i = 0; i < count; i++) {
+			if (i != 0) json += ',';
+			json += std::to_string(pValues[i]);
+		}
+		json += ']';
+	};
+	auto appendValue = [&json](const char* pName, uint64_t value) {
+		json += ",\"";
+		json += pName;
+		json += "\":";
+		json += std::to_string(value);
+	};
+
+	appendArray("samples", snapshot.samples, MAX_MIPS);
+	appendArray("pixel_reads", snapshot.pixelReads, MAX_MIPS);
+	appendValue("sample_calls", snapshot.sampleCalls);
+	appendValue("lod_clamped_low", snapshot.lodClampedLow);
+	appendValue("lod_clamped_high", snapshot.lodClampedHigh);
+
+	json += ",\"stage_ns\":{";
+	for (size_t stage = 0; stage < static_cast<size_t>(STAGE::COUNT); stage++) {
+		if (stage != 0) json += ',';
+		json += '"';
+		json += GetStageName(static_cast<STAGE>(stage));
+		json += "\":";
+		json += std::to_string(snapshot.stageNanoseconds[stage]);
+	}
+	json += '}';
+
+	appendValue("bytes_resident", snapshot.bytesResident);
+	json += '}';
+	return json;
+}
@@ -0,0 +1,156 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+// Statistics are compiled in with VTFPARSER_STATS (the VTFPARSER_STATS CMake option), otherwise VTF_STATS() expands to nothing
+#ifdef VTFPARSER_STATS
+#  define VTF_STATS(...) __VA_ARGS__
+#else
+#  define VTF_STATS(...)
+#endif
+
+/// <summary>
+/// Per texture access and load statistics
+/// </summary>
+namespace VTFStats
+{
+	constexpr size_t MAX_MIPS = 16;
+
+	/// <summary>
+	/// Stages of VTFTexture construction that are timed
+	/// </summary>
+	enum class STAGE : uint8_t
+	{
+		HEADER,     // ParseHeader
+		THUMBNAIL,  // Low res image decode
+		IMAGE_DATA, // ParseImageData (copy out of the file buffer)
+		DECOMPRESS, // DXT decode to RGBA8888
+		MIPMAPS,    // Generation of missing MIPs
+		LINEARIZE,  // sRGB decode to linear RGBA16161616
+		TRANSCODE,  // DXT encode of uncompressed image data
+		COUNT
+	};
+
+	/// <summary>
+	/// Merged copy of a texture's counters
+	/// </summary>
+	struct Snapshot
+	{
+		bool enabled = false; // False if the library was built without VTFPARSER_STATS, everything else is then 0
+
+		uint64_t samples[MAX_MIPS] = {};    // Bilinear lookups per MIP, a Sample between two MIPs counts one for each
+		uint64_t pixelReads[MAX_MIPS] = {}; // GetPixel calls per MIP
+		uint64_t sampleCalls = 0;           // Sample calls
+		uint64_t lodClampedLow = 0;         // Sample calls with a MIP level below 0
+		uint64_t lodClampedHigh = 0;        // Sample calls with a MIP level past the smallest MIP
+
+		uint64_t stageNanoseconds[static_cast<size_t>(STAGE::COUNT)] = {};
+
+		size_t bytesResident = 0; // Everything the texture holds, VTFMemoryStats::totalBytes
+	};
+
+	/// <summary>
+	/// Serialises a snapshot to a single line JSON object
+	/// </summary>
+	std::string ExportJSON(const Snapshot& snapshot);
+
+	const char* GetStageName(STAGE stage);
+
+	/// <summary>
+	/// Counters owned by a texture
+	/// Hot counters are split into cache line sized shards, each thread increments its own shard with relaxed atomics
+	/// and shards are only summed when a snapshot is taken, so concurrent samplers don't contend
+	/// (threads are assigned shards round robin, so past SHARD_COUNT threads some share a shard, and its cache lines)
+	/// </summary>
+	class Counters
+	{
+	public:
+		static constexpr size_t SHARD_COUNT = 16;
+
+	private:
+		struct alignas(64) Shard
+		{
+			std::atomic<uint64_t> samples[MAX_MIPS];
+			std::atomic<uint64_t> pixelReads[MAX_MIPS];
+			std::atomic<uint64_t> sampleCalls;
+			std::atomic<uint64_t> lodClampedLow;
+			std::atomic<uint64_t> lodClampedHigh;
+		};
+
+		Shard mShards[SHARD_COUNT];
+
+		// Only written during construction of the texture
+		uint64_t mStageNanoseconds[static_cast<size_t>(STAGE::COUNT)] = {};
+
+		static size_t ThreadShard()
+		{
+			static std::atomic<size_t> nextShard{ 0 };
+			thread_local size_t shard = nextShard.fetch_add(1, std::memory_order_relaxed) % SHARD_COUNT;
+			return shard;
+		}
+
+		static void Increment(std::atomic<uint64_t>& counter)
+		{
+			counter.fetch_add(1, std::memory_order_relaxed);
+		}
+
+	public:
+		Counters() { Reset(); }
+
+		void RecordSample(uint8_t mipLevel)
+		{
+			Increment(mShards[ThreadShard()].samples[mipLevel < MAX_MIPS ? mipLevel : MAX_MIPS - 1]);
+		}
+
+		void RecordPixelRead(uint8_t mipLevel)
+		{
+			Increment(mShards[ThreadShard()].pixelReads[mipLevel < MAX_MIPS ? mipLevel : MAX_MIPS - 1]);
+		}
+
+		/// <param name="lodOffset">Negative if the requested MIP level was below 0, positive if past the smallest MIP, otherwise 0</param>
+		void RecordSampleCall(int lodOffset)
+		{
+			Shard& shard = mShards[ThreadShard()];
+			Increment(shard.sampleCalls);
+			if (lodOffset < 0) Increment(shard.lodClampedLow);
+			else if (lodOffset > 0) Increment(shard.lodClampedHigh);
+		}
+
+		void AddStageTime(STAGE stage, uint64_t nanoseconds)
+		{
+			mStageNanoseconds[static_cast<size_t>(stage)] += nanoseconds;
+		}
+
+		/// <summary>
+		/// Sums every shard, counters incremented concurrently with the snapshot may or may not be included
+		/// </summary>
+		Snapshot Merge() const;
+
+		/// <summary>
+		/// Zeroes the access counters (load timings are kept)
+		/// </summary>
+		void Reset();
+	};
+
+	/// <summary>
+	/// Measures the time between successive laps
+	/// </summary>
+	class Stopwatch
+	{
+	private:
+		std::chrono::steady_clock::time_point mStart = std::chrono::steady_clock::now();
+
+	public:
+		uint64_t Lap()
+		{
+			const std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+			const uint64_t nanoseconds = std::chrono::duration_cast<std::chrono::nanoseconds>(now - mStart).count();
+			mStart = now;
+			return nanoseconds;
+		}
+	};
+}
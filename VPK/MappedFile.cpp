@@ -0,0 +1,94 @@
+#include "MappedFile.h"
+
+#ifdef _WIN32
+#  ifndef WIN32_LEAN_AND_MEAN
+#    define WIN32_LEAN_AND_MEAN
+#  endif
+#  ifndef NOMINMAX
+#    define NOMINMAX
+#  endif
+#  include <Windows.h>
+#else
+#  include <fcntl.h>
+#  include <sys/mman.h>
+#  include <sys/stat.h>
+#  include <unistd.h>
+#endif
+
+#ifdef _WIN32
+
+MappedFile::MappedFile(const std::string& path)
+{
+	HANDLE file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+	if (file == INVALID_HANDLE_VALUE) return;
+
+	LARGE_INTEGER size;
+	if (!GetFileSizeEx(file, &size) || static_cast<uint64_t>(size.QuadPart) > SIZE_MAX) {
+		CloseHandle(file);
+		return;
+	}
+
+	mFile = file;
+	mSize = static_cast<size_t>(size.QuadPart);
+	if (mSize == 0) {
+		mIsValid = true;
+		return;
+	}
+
+	// Can't create a mapping of an empty file, so the mapping is only made for files with data
+	HANDLE mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+	if (mapping == nullptr) return;
+	mMapping = mapping;
+
+	mpData = static_cast<const uint8_t*>(MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0));
+	mIsValid = mpData != nullptr;
+}
+
+MappedFile::~MappedFile()
+{
+	if (mpData != nullptr) UnmapViewOfFile(mpData);
+	if (mMapping != nullptr) CloseHandle(mMapping);
+	if (mFile != nullptr) CloseHandle(mFile);
+}
+
+#else
+
+MappedFile::MappedFile(const std::string& path)
+{
+	int file = open(path.c_str(), O_RDONLY);
+	if (file < 0) return;
+
+	struct stat info;
+	if (fstat(file, &info) != 0 || static_cast<uint64_t>(info.st_size) > SIZE_MAX) {
+		close(file);
+		return;
+	}
+
+	mSize = static_cast<size_t>(info.st_size);
+	if (mSize == 0) {
+		close(file);
+		mIsValid = true;
+		return;
+	}
+
+	// The mapping keeps its own reference to the file, so the descriptor can be closed straight away
+	void* pMapping = mmap(nullptr, mSize, PROT_READ, MAP_SHARED, file, 0);
+	close(file);
+	if (pMapping == MAP_FAILED) return;
+
+	mpData = static_cast<const uint8_t*>(pMapping);
+	mIsValid = true;
+}
+
+MappedFile::~MappedFile()
+{
+	if (mpData != nullptr) munmap(const_cast<uint8_t*>(mpData), mSize);
+}
+
+#endif
+
+bool MappedFile::IsValid() const { return mIsValid; }
+
+const uint8_t* MappedFile::GetData() const { return mpData; }
+
+size_t MappedFile::GetSize() const { return mIsValid ? mSize : 0; }
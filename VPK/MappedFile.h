@@ -0,0 +1,46 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+/// <summary>
+/// Read only memory mapping of a whole file (mmap on POSIX, CreateFileMapping on Windows)
+/// </summary>
+class MappedFile
+{
+private:
+	const uint8_t* mpData = nullptr;
+	size_t mSize = 0;
+	bool mIsValid = false;
+
+#ifdef _WIN32
+	void* mFile = nullptr;
+	void* mMapping = nullptr;
+#endif
+
+public:
+	/// <summary>
+	/// Maps a file into memory
+	/// </summary>
+	/// <param name="path">Path of the file to map</param>
+	explicit MappedFile(const std::string& path);
+	~MappedFile();
+
+	MappedFile(const MappedFile&) = delete;
+	MappedFile& operator=(const MappedFile&) = delete;
+
+	/// <summary>
+	/// Returns whether or not the file was mapped
+	/// </summary>
+	/// <returns>True if the file was opened and mapped (an empty file is valid with no data)</returns>
+	bool IsValid() const;
+
+	/// <summary>
+	/// Gets the mapped contents of the file
+	/// </summary>
+	/// <returns>Readonly pointer to the start of the file, valid for the lifetime of this object</returns>
+	const uint8_t* GetData() const;
+
+	size_t GetSize() const;
+};
@@ -0,0 +1,340 @@
+#include "VPKArchive.h"
+#include "../Util/SIMD.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+
+#define VPK_HEADER_SIZE_V1 12
+#define VPK_HEADER_SIZE_V2 28
+#define VPK_ENTRY_SIZE 18
+#define VPK_ENTRY_TERMINATOR 0xffff
+
+static const uint32_t EMPTY_SLOT = UINT32_MAX;
+
+static inline char NormaliseChar(char c)
+{
+	if (c == '\\') return '/';
+	if (c >= 'A' && c <= 'Z') return static_cast<char>(c - 'A' + 'a');
+	return c;
+}
+
+// FNV-1a over the normalised path
+static uint64_t HashPath(std::string_view path)
+{
+	uint64_t hash = 0xcbf29ce484222325ull;
+	for (char c : path) {
+		hash ^= static_cast<uint8_t>(NormaliseChar(c));
+		hash *= 0x100000001b3ull;
+	}
+	return hash;
+}
+
+template<typename T>
+static T ReadLE(const uint8_t* pData)
+{
+	T value;
+	memcpy(&value, pData, sizeof(T));
+	return value;
+}
+
+// Reads a null terminated string and advances past it, or returns false if it runs off the end of the tree
+static bool ReadString(const uint8_t*& pCursor, const uint8_t* pEnd, std::string_view& str)
+{
+	const uint8_t* pTerminator = static_cast<const uint8_t*>(memchr(pCursor, '\0', pEnd - pCursor));
+	if (pTerminator == nullptr) return false;
+
+	str = std::string_view(reinterpret_cast<const char*>(pCursor), pTerminator - pCursor);
+	pCursor = pTerminator + 1;
+	return true;
+}
+
+VPKArchive::VPKArchive(const std::string& path)
+{
+	mpDirectory = std::make_unique<MappedFile>(path);
+	if (!mpDirectory->IsValid()) return;
+
+	const uint8_t* pData = mpDirectory->GetData();
+	const size_t size = mpDirectory->GetSize();
+	if (size < VPK_HEADER_SIZE_V1 || ReadLE<uint32_t>(pData) != VPK_SIGNATURE) return;
+
+	mVersion = ReadLE<uint32_t>(pData + 4);
+	const uint32_t treeSize = ReadLE<uint32_t>(pData + 8);
+
+	size_t headerSize;
+	switch (mVersion) {
+	case 1:
+		headerSize = VPK_HEADER_SIZE_V1;
+		break;
+	case 2:
+		headerSize = VPK_HEADER_SIZE_V2;
+		break;
+	default:
+		return;
+	}
+	if (size < headerSize || size - headerSize < treeSize) return;
+
+	mDataOffset = headerSize + treeSize;
+	if (!ParseTree(pData + headerSize, treeSize)) return;
+
+	// Map every chunk the tree references, chunks of name_dir.vpk are name_000.vpk, name_001.vpk, etc.
+	uint16_t maxArchiveIndex = 0;
+	bool usesChunks = false;
+	for (const VPKEntry& entry : mEntries) {
+		if (entry.archiveIndex == VPK_DIR_ARCHIVE_INDEX || entry.length == 0) continue;
+		maxArchiveIndex = std::max(maxArchiveIndex, entry.archiveIndex);
+		usesChunks = true;
+	}
+
+	const std::string suffix = "dir.vpk";
+	if (usesChunks && path.size() >= suffix.size()) {
+		std::string prefix = path.substr(0, path.size() - suffix.size());
+		std::string ending = path.substr(prefix.size());
+		std::transform(ending.begin(), ending.end(), ending.begin(), NormaliseChar);
+
+		if (ending == suffix) {
+			std::vector<bool> referenced(maxArchiveIndex + 1, false);
+			for (const VPKEntry& entry : mEntries) {
+				if (entry.archiveIndex != VPK_DIR_ARCHIVE_INDEX && entry.length != 0) referenced[entry.archiveIndex] = true;
+			}
+
+			mChunks.resize(maxArchiveIndex + 1);
+			for (uint16_t i = 0; i <= maxArchiveIndex; i++) {
+				if (!referenced[i]) continue;
+
+				char chunkSuffix[16];
+				snprintf(chunkSuffix, sizeof(chunkSuffix), "%03u.vpk", static_cast<unsigned int>(i));
+
+				std::unique_ptr<MappedFile> pChunk = std::make_unique<MappedFile>(prefix + chunkSuffix);
+				if (pChunk->IsValid()) mChunks[i] = std::move(pChunk);
+			}
+		}
+	}
+
+	BuildIndex();
+	mIsValid = true;
+}
+
+bool VPKArchive::ParseTree(const uint8_t* pTree, size_t treeSize)
+{
+	const uint8_t* pCursor = pTree;
+	const uint8_t* pEnd = pTree + treeSize;
+
+	// Tree is grouped by extension, then directory, each level terminated by an empty string
+	// A single space stands for no extension or the root directory
+	std::string_view extension, directory, name;
+	while (true) {
+		if (!ReadString(pCursor, pEnd, extension)) return false;
+		if (extension.empty()) break;
+
+		while (true) {
+			if (!ReadString(pCursor, pEnd, directory)) return false;
+			if (directory.empty()) break;
+
+			while (true) {
+				if (!ReadString(pCursor, pEnd, name)) return false;
+				if (name.empty()) break;
+
+				if (static_cast<size_t>(pEnd - pCursor) < VPK_ENTRY_SIZE) return false;
+
+				VPKEntry entry;
+				entry.crc = ReadLE<uint32_t>(pCursor);
+				entry.preloadBytes = ReadLE<uint16_t>(pCursor + 4);
+				entry.archiveIndex = ReadLE<uint16_t>(pCursor + 6);
+				entry.offset = ReadLE<uint32_t>(pCursor + 8);
+				entry.length = ReadLE<uint32_t>(pCursor + 12);
+				if (ReadLE<uint16_t>(pCursor + 16) != VPK_ENTRY_TERMINATOR) return false;
+				pCursor += VPK_ENTRY_SIZE;
+
+				if (static_cast<size_t>(pEnd - pCursor) < entry.preloadBytes) return false;
+				entry.pPreload = entry.preloadBytes != 0 ? pCursor : nullptr;
+				pCursor += entry.preloadBytes;
+
+				entry.pathOffset = static_cast<uint32_t>(mPaths.size());
+				if (directory != " ") {
+					mPaths += directory;
+					mPaths += '/';
+				}
+				mPaths += name;
+				if (extension != " ") {
+					mPaths += '.';
+					mPaths += extension;
+				}
+				entry.pathLength = static_cast<uint32_t>(mPaths.size() - entry.pathOffset);
+				std::transform(mPaths.begin() + entry.pathOffset, mPaths.end(), mPaths.begin() + entry.pathOffset, NormaliseChar);
+
+				mEntries.push_back(entry);
+			}
+		}
+	}
+
+	return true;
+}
+
+void VPKArchive::BuildIndex()
+{
+	// Power of two with a load factor of at most 0.5
+	size_t slotCount = 16;
+	while (slotCount < mEntries.size() * 2) slotCount <<= 1;
+
+	mSlots.assign(slotCount, EMPTY_SLOT);
+	mSlotHashes.assign(slotCount, 0);
+
+	const size_t mask = slotCount - 1;
+	for (uint32_t i = 0; i < mEntries.size(); i++) {
+		const std::string_view path = GetPath(mEntries[i]);
+		const uint64_t hash = HashPath(path);
+
+		// First occurrence of a duplicated path wins
+		if (FindHashed(path, hash) != nullptr) continue;
+
+		size_t slot = hash & mask;
+		while (mSlots[slot] != EMPTY_SLOT) slot = (slot + 1) & mask;
+		mSlots[slot] = i;
+		mSlotHashes[slot] = hash;
+	}
+}
+
+const VPKEntry* VPKArchive::FindHashed(std::string_view path, uint64_t hash) const
+{
+	const size_t mask = mSlots.size() - 1;
+	for (size_t slot = hash & mask; mSlots[slot] != EMPTY_SLOT; slot = (slot + 1) & mask) {
+		if (mSlotHashes[slot] != hash) continue;
+
+		const VPKEntry& entry = mEntries[mSlots[slot]];
+		if (entry.pathLength != path.size()) continue;
+
+		const char* pStored = mPaths.data() + entry.pathOffset;
+		size_t i = 0;
+		while (i < path.size() && pStored[i] == NormaliseChar(path[i])) i++;
+		if (i == path.size()) return &entry;
+	}
+	return nullptr;
+}
+
+const uint8_t* VPKArchive::GetArchiveData(const VPKEntry& entry) const
+{
+	const MappedFile* pChunk = nullptr;
+	if (entry.archiveIndex == VPK_DIR_ARCHIVE_INDEX)
+		pChunk = mpDirectory.get();
+	else if (entry.archiveIndex < mChunks.size())
+		pChunk = mChunks[entry.archiveIndex].get();
+	if (pChunk == nullptr) return nullptr;
+
+	// Data in the directory file is relative to the end of the tree
+	const size_t offset = entry.archiveIndex == VPK_DIR_ARCHIVE_INDEX ? mDataOffset + entry.offset : entry.offset;
+	if (offset > pChunk->GetSize() || pChunk->GetSize() - offset < entry.length) return nullptr;
+
+	return pChunk->GetData() + offset;
+}
+
+bool VPKArchive::IsValid() const { return mIsValid; }
+
+uint32_t VPKArchive::GetVersion() const
+{
+	return IsValid() ? mVersion : 0;
+}
+
+size_t VPKArchive::GetCount() const
+{
+	return IsValid() ? mEntries.size() : 0;
+}
+
+const VPKEntry& VPKArchive::Get(size_t index) const
+{
+	return mEntries[index];
+}
+
+std::string_view VPKArchive::GetPath(const VPKEntry& entry) const
+{
+	return std::string_view(mPaths.data() + entry.pathOffset, entry.pathLength);
+}
+
+const VPKEntry* VPKArchive::Find(std::string_view path) const
+{
+	if (!IsValid()) return nullptr;
+	return FindHashed(path, HashPath(path));
+}
+
+size_t VPKArchive::FindMany(const std::string_view* pPaths, size_t count, const VPKEntry** ppEntries) const
+{
+	if (!IsValid()) {
+		std::fill(ppEntries, ppEntries + count, nullptr);
+		return 0;
+	}
+
+	// Hash a group of paths and prefetch their slots so the probes' cache misses overlap
+	const size_t GROUP_SIZE = 16;
+	const size_t mask = mSlots.size() - 1;
+
+	size_t found = 0;
+	uint64_t hashes[GROUP_SIZE];
+	for (size_t groupStart = 0; groupStart < count; groupStart += GROUP_SIZE) {
+		const size_t groupSize = std::min(GROUP_SIZE, count - groupStart);
+
+		for (size_t i = 0; i < groupSize; i++) {
+			hashes[i] = HashPath(pPaths[groupStart + i]);
+			VTF_PREFETCH(&mSlots[hashes[i] & mask]);
+			VTF_PREFETCH(&mSlotHashes[hashes[i] & mask]);
+		}
+
+		for (size_t i = 0; i < groupSize; i++) {
+			ppEntries[groupStart + i] = FindHashed(pPaths[groupStart + i], hashes[i]);
+			if (ppEntries[groupStart + i] != nullptr) found++;
+		}
+	}
+
+	return found;
+}
+
+bool VPKArchive::GetData(const VPKEntry& entry, VPKSpan* pSpan) const
+{
+	if (!IsValid() || pSpan == nullptr) return false;
+
+	if (entry.length == 0) {
+		*pSpan = GetPreload(entry);
+		return true;
+	}
+	if (entry.preloadBytes != 0) return false;
+
+	const uint8_t* pArchiveData = GetArchiveData(entry);
+	if (pArchiveData == nullptr) return false;
+
+	pSpan->pData = pArchiveData;
+	pSpan->size = entry.length;
+	return true;
+}
+
+VPKSpan VPKArchive::GetPreload(const VPKEntry& entry) const
+{
+	return VPKSpan{ entry.pPreload, entry.preloadBytes };
+}
+
+bool VPKArchive::ReadData(const VPKEntry& entry, std::vector<uint8_t>& out) const
+{
+	if (!IsValid()) return false;
+
+	const uint8_t* pArchiveData = nullptr;
+	if (entry.length != 0) {
+		pArchiveData = GetArchiveData(entry);
+		if (pArchiveData == nullptr) return false;
+	}
+
+	out.resize(entry.GetSize());
+	if (entry.preloadBytes != 0) memcpy(out.data(), entry.pPreload, entry.preloadBytes);
+	if (pArchiveData != nullptr) memcpy(out.data() + entry.preloadBytes, pArchiveData, entry.length);
+	return true;
+}
+
+size_t VPKArchive::GetDataMany(const std::string_view* pPaths, size_t count, VPKSpan* pSpans) const
+{
+	std::vector<const VPKEntry*> entries(count);
+	FindMany(pPaths, count, entries.data());
+
+	size_t populated = 0;
+	for (size_t i = 0; i < count; i++) {
+		pSpans[i] = VPKSpan{};
+		if (entries[i] != nullptr && GetData(*entries[i], &pSpans[i])) populated++;
+	}
+	return populated;
+}
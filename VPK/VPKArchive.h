@@ -0,0 +1,164 @@
+#pragma once
+
+#include "MappedFile.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#define VPK_SIGNATURE 0x55aa1234
+#define VPK_DIR_ARCHIVE_INDEX 0x7fff
+
+/// <summary>
+/// Contiguous bytes inside a mapped archive
+/// </summary>
+struct VPKSpan
+{
+	const uint8_t* pData = nullptr;
+	size_t size = 0;
+};
+
+/// <summary>
+/// A single file in a VPK's directory tree
+/// </summary>
+struct VPKEntry
+{
+	uint32_t crc;             // CRC32 of the whole file
+	uint16_t preloadBytes;    // Bytes stored in the directory file straight after the entry
+	uint16_t archiveIndex;    // Chunk the rest of the file is in, VPK_DIR_ARCHIVE_INDEX for the directory file itself
+	uint32_t offset;          // Offset of the rest of the file in its chunk
+	uint32_t length;          // Size of the rest of the file (not including the preload bytes)
+	const uint8_t* pPreload;  // Preload bytes in the directory mapping
+
+	uint32_t pathOffset;      // Offset of the normalised path in the archive's path buffer
+	uint32_t pathLength;
+
+	/// <summary>
+	/// Total size of the file
+	/// </summary>
+	size_t GetSize() const { return static_cast<size_t>(preloadBytes) + length; }
+};
+
+/// <summary>
+/// Reader for version 1 and 2 Valve pak archives
+/// The directory file and every chunk it references are memory mapped for the lifetime of the object, and
+/// entries are returned as spans into the mappings, so a VTFTexture can be constructed without extracting the file first
+/// Paths are matched case insensitively and with either slash direction
+/// Lookups are const and safe to make from multiple threads
+/// </summary>
+class VPKArchive
+{
+private:
+	std::unique_ptr<MappedFile> mpDirectory;
+	std::vector<std::unique_ptr<MappedFile>> mChunks; // Indexed by archive index, nullptr for chunks that couldn't be mapped
+
+	uint32_t mVersion = 0;
+	size_t mDataOffset = 0; // Offset of data stored in the directory file (end of the tree)
+
+	std::vector<VPKEntry> mEntries;
+	std::string mPaths;
+
+	// Open addressing hash table of entry indices, empty slots are UINT32_MAX
+	std::vector<uint32_t> mSlots;
+	std::vector<uint64_t> mSlotHashes;
+
+	bool mIsValid = false;
+
+	bool ParseTree(const uint8_t* pTree, size_t treeSize);
+	void BuildIndex();
+	const VPKEntry* FindHashed(std::string_view path, uint64_t hash) const;
+	const uint8_t* GetArchiveData(const VPKEntry& entry) const; // Part of the file after the preload bytes, nullptr if out of range
+
+public:
+	/// <summary>
+	/// Opens a VPK archive
+	/// </summary>
+	/// <param name="path">Path to the directory file (name_dir.vpk), chunks are expected next to it as name_000.vpk, name_001.vpk, etc.
+	/// A single file archive without chunks can be opened by its own name</param>
+	explicit VPKArchive(const std::string& path);
+
+	VPKArchive(const VPKArchive&) = delete;
+	VPKArchive& operator=(const VPKArchive&) = delete;
+
+	/// <summary>
+	/// Returns whether or not the archive is valid
+	/// </summary>
+	/// <returns>True if the directory file was mapped and its tree parsed successfully (chunks may still be missing)</returns>
+	bool IsValid() const;
+
+	uint32_t GetVersion() const;
+
+	/// <summary>
+	/// Gets the number of files in the archive
+	/// </summary>
+	/// <returns>Number of entries</returns>
+	size_t GetCount() const;
+
+	/// <summary>
+	/// Gets an entry by index
+	/// </summary>
+	/// <param name="index">Index of the entry (must be less than GetCount)</param>
+	/// <returns>Readonly reference to the entry</returns>
+	const VPKEntry& Get(size_t index) const;
+
+	/// <summary>
+	/// Gets the normalised (lowercase, forward slash) path of an entry
+	/// </summary>
+	/// <param name="entry">Entry from this archive</param>
+	/// <returns>View of the path, valid for the lifetime of the archive</returns>
+	std::string_view GetPath(const VPKEntry& entry) const;
+
+	/// <summary>
+	/// Finds a file by path
+	/// </summary>
+	/// <param name="path">Path of the file, e.g. materials/brick/brickwall001a.vtf</param>
+	/// <returns>Readonly pointer to the entry, or nullptr if it isn't in the archive</returns>
+	const VPKEntry* Find(std::string_view path) const;
+
+	/// <summary>
+	/// Finds many files at once, hashing every path and prefetching its slot before probing any of them
+	/// </summary>
+	/// <param name="pPaths">Array of paths</param>
+	/// <param name="count">Number of paths</param>
+	/// <param name="ppEntries">Array of count pointers to populate with the entries (nullptr for paths that aren't in the archive)</param>
+	/// <returns>Number of paths that were found</returns>
+	size_t FindMany(const std::string_view* pPaths, size_t count, const VPKEntry** ppEntries) const;
+
+	/// <summary>
+	/// Gets a span over an entry's data without copying it
+	/// Only possible when the file is stored in one piece, i.e. entirely in the preload bytes or entirely in a chunk
+	/// (true for the files Valve's tools write, which only preload small files), otherwise use ReadData
+	/// </summary>
+	/// <param name="entry">Entry from this archive</param>
+	/// <param name="pSpan">Span to populate, valid for the lifetime of the archive</param>
+	/// <returns>Whether the file is contiguous and its chunk is mapped and large enough</returns>
+	bool GetData(const VPKEntry& entry, VPKSpan* pSpan) const;
+
+	/// <summary>
+	/// Gets the preload bytes of an entry, which are in the directory file and always available without touching a chunk
+	/// (enough for a header only VTFTexture if the archive was built to preload headers)
+	/// </summary>
+	/// <param name="entry">Entry from this archive</param>
+	/// <returns>Span over the preload bytes, empty if there are none</returns>
+	VPKSpan GetPreload(const VPKEntry& entry) const;
+
+	/// <summary>
+	/// Copies an entry's data (preload bytes followed by the rest of the file) into a buffer
+	/// </summary>
+	/// <param name="entry">Entry from this archive</param>
+	/// <param name="out">Vector to replace the contents of with the file</param>
+	/// <returns>Whether the file's chunk is mapped and large enough</returns>
+	bool ReadData(const VPKEntry& entry, std::vector<uint8_t>& out) const;
+
+	/// <summary>
+	/// Gets spans over many entries at once (see GetData)
+	/// </summary>
+	/// <param name="pPaths">Array of paths</param>
+	/// <param name="count">Number of paths</param>
+	/// <param name="pSpans">Array of count spans to populate (empty for paths that weren't found or aren't contiguous)</param>
+	/// <returns>Number of spans that were populated</returns>
+	size_t GetDataMany(const std::string_view* pPaths, size_t count, VPKSpan* pSpans) const;
+};
@@ -1,33 +1,127 @@
 ﻿#include "VTFParser.h"
 #include "FileFormat/Parser.h"
+#include "FileFormat/Resources.h"
+#include "Convert/Convert.h"
 #include "DXTn/DXTn.h"
+#include "Util/ColourSpace.h"
+#include "Util/Octahedral.h"
+#include "Util/Parallel.h"
+#include "Util/SIMD.h"
 
 #include <stdexcept>
+#include <cstring>
 #include <cmath>
 #include <algorithm>
 
-inline int intmod(int a, int b) {
-	return (a % b + b) % b;
+static bool DecompressImage(IMAGE_FORMAT format, const uint8_t* src, uint8_t* dst, uint16_t width, uint16_t height)
+{
+	switch (format) {
+	case IMAGE_FORMAT::DXT1:
+	case IMAGE_FORMAT::DXT1_ONEBITALPHA:
+		DXTn::DecompressDXT1(src, dst, width, height);
+		return true;
+	case IMAGE_FORMAT::DXT3:
+		DXTn::DecompressDXT3(src, dst, width, height);
+		return true;
+	case IMAGE_FORMAT::DXT5:
+		DXTn::DecompressDXT5(src, dst, width, height);
+		return true;
+	case IMAGE_FORMAT::ATI1N:
+		DXTn::DecompressATI1N(src, dst, width, height);
+		return true;
+	case IMAGE_FORMAT::ATI2N:
+		DXTn::DecompressATI2N(src, dst, width, height);
+		return true;
+	default:
+		return false;
+	}
+}
+
+// Uncompressed colour formats transcodeToDXT encodes, 16 bit and float formats would lose range and the rest aren't colours
+// (bluescreen is keyed transparency, which DXT1 would blend into its neighbours)
+static bool CanTranscode(IMAGE_FORMAT format)
+{
+	switch (format) {
+	case IMAGE_FORMAT::RGBA8888:
+	case IMAGE_FORMAT::ABGR8888:
+	case IMAGE_FORMAT::RGB888:
+	case IMAGE_FORMAT::BGR888:
+	case IMAGE_FORMAT::RGB565:
+	case IMAGE_FORMAT::ARGB8888:
+	case IMAGE_FORMAT::BGRA8888:
+	case IMAGE_FORMAT::BGRX8888:
+	case IMAGE_FORMAT::BGR565:
+	case IMAGE_FORMAT::BGRX5551:
+	case IMAGE_FORMAT::BGRA4444:
+	case IMAGE_FORMAT::BGRA5551:
+		return true;
+	default:
+		return false;
+	}
+}
+
+// Alpha masks only cover the largest MIP of 2D textures and cubemaps whose alpha is used
+static bool CanBuildAlphaMask(const VTFHeader* pHeader)
+{
+	const uint32_t alphaFlags = static_cast<uint32_t>(TEXTURE_FLAGS::ONEBITALPHA) | static_cast<uint32_t>(TEXTURE_FLAGS::EIGHTBITALPHA);
+	return pHeader->depth <= 1 && ((pHeader->flags & alphaFlags) != 0 || VTFParser::GetImageFormatInfo(pHeader->highResImageFormat).alphaBitsPerPixel > 0);
+}
+
+static VTFLoadOptions HeaderOnlyOptions(bool headerOnly)
+{
+	VTFLoadOptions options;
+	options.headerOnly = headerOnly;
+	return options;
 }
 
-VTFTexture::VTFTexture(const uint8_t* pData, size_t size, bool headerOnly)
+VTFTexture::VTFTexture(const uint8_t* pData, size_t size, bool headerOnly) : VTFTexture(pData, size, HeaderOnlyOptions(headerOnly)) {}
+
+VTFTexture::VTFTexture(const uint8_t* pData, size_t size, const VTFLoadOptions& options)
 {
 	mpImageData = nullptr;
 	mpHeader = new VTFHeader;
+	VTF_STATS(mpStats = new VTFStats::Counters; VTFStats::Stopwatch stopwatch;)
 
 	mIsValid = VTFParser::ParseHeader(pData, size, mpHeader);
-	if (!mIsValid || headerOnly) return;
+	VTF_STATS(mpStats->AddStageTime(VTFStats::STAGE::HEADER, stopwatch.Lap());)
+	if (!mIsValid) return;
+	CalcSubimageOffsets();
+	mFileImageFormat = mpHeader->highResImageFormat;
+	mFileMipCount = mpHeader->mipmapCount;
+
+	LoadThumbnail(pData, size);
+	VTF_STATS(mpStats->AddStageTime(VTFStats::STAGE::THUMBNAIL, stopwatch.Lap());)
+	if (options.headerOnly) return;
 
 	uint8_t* pCompressedImageData;
 	mIsValid = VTFParser::ParseImageData(pData, size, mpHeader, &pCompressedImageData, &mImageDataSize);
+	VTF_STATS(mpStats->AddStageTime(VTFStats::STAGE::IMAGE_DATA, stopwatch.Lap());)
 	if (!mIsValid) return;
 
-	if (VTFParser::GetImageFormatInfo(mpHeader->highResImageFormat).isCompressed) {
-		mImageDataSize = VTFParser::CalcImageSize(
+	// DXT alpha is read straight from the blocks, unless it's going to be linearized to 16 bits (the mask has to match the final data)
+	const bool buildAlphaMask = options.buildAlphaMask && CanBuildAlphaMask(mpHeader);
+	const bool buildAlphaMaskFromBlocks = buildAlphaMask && !(options.linearizeSRGB && IsSRGB());
+
+	// Transcoding is decided on the format in the file, generating MIPs converts anything to RGBA8888 first
+	const IMAGE_FORMAT fileFormat = mpHeader->highResImageFormat;
+
+	// Blocks can only be kept if nothing after this has to rewrite or read back the pixels
+	mIsBlockCompressed = options.sampleBlocks && VTFParser::CanSampleBlocks(mpHeader->highResImageFormat) && mpHeader->depth <= 1 &&
+		!options.generateMipmaps && !(options.linearizeSRGB && IsSRGB()) && !(options.encodeNormals && IsNormalMap()) && !buildAlphaMask;
+
+	if (VTFParser::GetImageFormatInfo(mpHeader->highResImageFormat).isCompressed && !mIsBlockCompressed) {
+		const uint64_t decompressedSize = VTFParser::CalcImageSize(
 			mpHeader->width, mpHeader->height,
 			mpHeader->depth, mpHeader->mipmapCount,
 			IMAGE_FORMAT::RGBA8888
 		) * mpHeader->frames * VTFParser::GetFaceCount(mpHeader);
+		if (decompressedSize > SIZE_MAX) {
+			mIsValid = false;
+			free(pCompressedImageData);
+			return;
+		}
+
+		mImageDataSize = static_cast<size_t>(decompressedSize);
 		mpImageData = reinterpret_cast<uint8_t*>(malloc(mImageDataSize));
 		if (mpImageData == nullptr) {
 			mIsValid = false;
@@ -40,7 +134,7 @@ VTFTexture::VTFTexture(const uint8_t* pData, size_t size, bool headerOnly)
 		// for each face
 		// for each z slice
 		// decompress image into final data using switch
-		uint32_t compOffset = 0, uncompOffset = 0;
+		size_t compOffset = 0, uncompOffset = 0;
 		for (int16_t mipmap = mpHeader->mipmapCount - 1; mipmap >= 0; mipmap--) {
 			uint16_t depth = mpHeader->depth >> mipmap;
 			if (depth < 1)  depth = 1;
@@ -53,18 +147,7 @@ VTFTexture::VTFTexture(const uint8_t* pData, size_t size, bool headerOnly)
 						if (width < 1)  width = 1;
 						if (height < 1) height = 1;
 
-						switch (mpHeader->highResImageFormat) {
-						case IMAGE_FORMAT::DXT1:
-						case IMAGE_FORMAT::DXT1_ONEBITALPHA:
-							DXTn::DecompressDXT1(pCompressedImageData + compOffset, mpImageData + uncompOffset, width, height);
-							break;
-						case IMAGE_FORMAT::DXT3:
-							DXTn::DecompressDXT3(pCompressedImageData + compOffset, mpImageData + uncompOffset, width, height);
-							break;
-						case IMAGE_FORMAT::DXT5:
-							DXTn::DecompressDXT5(pCompressedImageData + compOffset, mpImageData + uncompOffset, width, height);
-							break;
-						default:
+						if (!DecompressImage(mpHeader->highResImageFormat, pCompressedImageData + compOffset, mpImageData + uncompOffset, width, height)) {
 							mIsValid = false;
 							free(pCompressedImageData);
 							return;
@@ -77,7 +160,11 @@ VTFTexture::VTFTexture(const uint8_t* pData, size_t size, bool headerOnly)
 			}
 		}
 
+		// Subimage offsets are still those of the compressed data
+		if (buildAlphaMaskFromBlocks) BuildAlphaMask(pCompressedImageData, options.alphaMaskThreshold);
+
 		mpHeader->highResImageFormat = IMAGE_FORMAT::RGBA8888;
+		CalcSubimageOffsets();
 		free(pCompressedImageData);
 	} else {
 		mpImageData = reinterpret_cast<uint8_t*>(malloc(mImageDataSize));
@@ -90,25 +177,138 @@ VTFTexture::VTFTexture(const uint8_t* pData, size_t size, bool headerOnly)
 			free(pCompressedImageData);
 		}
 	}
+
+	mIsResident = true;
+	VTF_STATS(mpStats->AddStageTime(VTFStats::STAGE::DECOMPRESS, stopwatch.Lap());)
+
+	if (options.generateMipmaps) {
+		GenerateMissingMipmaps(options.mipmapOptions);
+		VTF_STATS(mpStats->AddStageTime(VTFStats::STAGE::MIPMAPS, stopwatch.Lap());)
+	}
+
+	if (options.linearizeSRGB && IsSRGB()) {
+		LinearizeSRGB();
+		VTF_STATS(mpStats->AddStageTime(VTFStats::STAGE::LINEARIZE, stopwatch.Lap());)
+	}
+
+	if (options.brickVolumes && mpHeader->depth > 1) BrickVolumes();
+
+	mNormalSwizzle = options.normalSwizzle;
+	if (options.encodeNormals && IsNormalMap()) EncodeNormals();
+
+	if (buildAlphaMask && mpAlphaMaskData == nullptr) BuildAlphaMask(nullptr, options.alphaMaskThreshold);
+
+	// Same restrictions as keeping blocks, except MIPs, which are generated before encoding
+	const uint32_t normalFlags = static_cast<uint32_t>(TEXTURE_FLAGS::NORMAL) | static_cast<uint32_t>(TEXTURE_FLAGS::SSBUMP);
+	if (
+		options.transcodeToDXT && CanTranscode(fileFormat) && !(options.linearizeSRGB && IsSRGB()) && mpHeader->depth <= 1 && (mpHeader->flags & normalFlags) == 0 &&
+		static_cast<uint32_t>(mpHeader->width) * mpHeader->height >= options.transcodeMinPixels && !buildAlphaMask
+	) {
+		TranscodeToDXT(options.transcodeQuality);
+		VTF_STATS(mpStats->AddStageTime(VTFStats::STAGE::TRANSCODE, stopwatch.Lap());)
+	}
 }
 
 VTFTexture::VTFTexture(const VTFTexture& src)
 {
 	mpHeader = new VTFHeader;
 	memcpy(mpHeader, src.mpHeader, sizeof(VTFHeader));
+	VTF_STATS(mpStats = new VTFStats::Counters;)
+	mNormalSwizzle = src.mNormalSwizzle;
+	mAlphaMaskLayout = src.mAlphaMaskLayout;
+	mAlphaMaskThreshold = src.mAlphaMaskThreshold;
+	mFileImageFormat = src.mFileImageFormat;
+	mFileMipCount = src.mFileMipCount;
 
 	if (src.mIsValid) {
-		mImageDataSize = src.mImageDataSize;
-		mpImageData = static_cast<uint8_t*>(malloc(mImageDataSize));
-		memcpy(mpImageData, src.mpImageData, mImageDataSize);
 		mIsValid = true;
+		if (src.mIsResident) {
+			mImageDataSize = src.mImageDataSize;
+			mpImageData = static_cast<uint8_t*>(malloc(mImageDataSize));
+			if (mpImageData != nullptr) {
+				memcpy(mpImageData, src.mpImageData, mImageDataSize);
+				mIsResident = true;
+			} else {
+				mIsValid = false;
+			}
+		}
+		mIsLinearized = src.mIsLinearized;
+		mIsBlockCompressed = src.mIsBlockCompressed;
+		mIsTranscoded = src.mIsTranscoded;
+		mTranscodePSNR = src.mTranscodePSNR;
+		memcpy(mMipOffsets, src.mMipOffsets, sizeof(mMipOffsets));
+		memcpy(mFaceSizes, src.mFaceSizes, sizeof(mFaceSizes));
+
+		if (src.mpBrickData != nullptr) {
+			mpBrickData = static_cast<uint8_t*>(malloc(src.mBrickDataSize));
+			if (mpBrickData != nullptr) {
+				memcpy(mpBrickData, src.mpBrickData, src.mBrickDataSize);
+				memcpy(mBrickMipOffsets, src.mBrickMipOffsets, sizeof(mBrickMipOffsets));
+				mBrickDataSize = src.mBrickDataSize;
+			}
+		}
+
+		if (src.mpNormalData != nullptr) {
+			mpNormalData = static_cast<uint32_t*>(malloc(mImageDataSize / GetFormat().bytesPerPixel * 4));
+			if (mpNormalData != nullptr) memcpy(mpNormalData, src.mpNormalData, mImageDataSize / GetFormat().bytesPerPixel * 4);
+		}
+
+		if (src.mpAlphaMaskData != nullptr) {
+			const size_t alphaMaskSize = mAlphaMaskLayout.size * mpHeader->frames * GetFaces();
+			mpAlphaMaskData = static_cast<uint8_t*>(malloc(alphaMaskSize));
+			if (mpAlphaMaskData != nullptr) memcpy(mpAlphaMaskData, src.mpAlphaMaskData, alphaMaskSize);
+		}
+	}
+
+	if (src.mpThumbnailData != nullptr) {
+		size_t thumbnailSize = static_cast<size_t>(mpHeader->lowResImageWidth) * mpHeader->lowResImageHeight * 4;
+		mpThumbnailData = static_cast<uint8_t*>(malloc(thumbnailSize));
+		if (mpThumbnailData != nullptr) memcpy(mpThumbnailData, src.mpThumbnailData, thumbnailSize);
 	}
 }
 
 VTFTexture::~VTFTexture()
 {
 	delete mpHeader;
+	delete mpStats;
 	if (mpImageData != nullptr) free(mpImageData);
+	if (mpThumbnailData != nullptr) free(mpThumbnailData);
+	if (mpBrickData != nullptr) free(mpBrickData);
+	if (mpNormalData != nullptr) free(mpNormalData);
+	if (mpAlphaMaskData != nullptr) free(mpAlphaMaskData);
+}
+
+void VTFTexture::LoadThumbnail(const uint8_t* pData, size_t size)
+{
+	if (mpHeader->lowResImageFormat == IMAGE_FORMAT::NONE || mpHeader->lowResImageWidth == 0 || mpHeader->lowResImageHeight == 0)
+		return;
+
+	VTFResources resources(pData, size, mpHeader);
+	if (!resources.IsValid()) return;
+
+	const VTFResource* pLowRes = resources.Find(RESOURCE_TYPE::LOWRES_IMAGE);
+	if (pLowRes == nullptr || pLowRes->pData == nullptr) return;
+
+	uint8_t width = mpHeader->lowResImageWidth, height = mpHeader->lowResImageHeight;
+	mpThumbnailData = static_cast<uint8_t*>(malloc(static_cast<size_t>(width) * height * 4));
+	if (mpThumbnailData == nullptr) return;
+
+	if (VTFParser::GetImageFormatInfo(mpHeader->lowResImageFormat).isCompressed) {
+		if (DecompressImage(mpHeader->lowResImageFormat, pLowRes->pData, mpThumbnailData, width, height)) return;
+	} else if (VTFParser::GetImageFormatInfo(mpHeader->lowResImageFormat).isSupported) {
+		uint32_t pixelSize = VTFParser::GetImageFormatInfo(mpHeader->lowResImageFormat).bytesPerPixel;
+		for (uint32_t i = 0; i < static_cast<uint32_t>(width) * height; i++) {
+			VTFPixel pixel = VTFParser::ParsePixel(pLowRes->pData + i * pixelSize, mpHeader->lowResImageFormat);
+			mpThumbnailData[i * 4 + 0] = static_cast<uint8_t>(std::clamp(pixel.r, 0.f, 1.f) * 255.f + 0.5f);
+			mpThumbnailData[i * 4 + 1] = static_cast<uint8_t>(std::clamp(pixel.g, 0.f, 1.f) * 255.f + 0.5f);
+			mpThumbnailData[i * 4 + 2] = static_cast<uint8_t>(std::clamp(pixel.b, 0.f, 1.f) * 255.f + 0.5f);
+			mpThumbnailData[i * 4 + 3] = static_cast<uint8_t>(std::clamp(pixel.a, 0.f, 1.f) * 255.f + 0.5f);
+		}
+		return;
+	}
+
+	free(mpThumbnailData);
+	mpThumbnailData = nullptr;
 }
 
 bool VTFTexture::IsValid() const { return mIsValid; }
@@ -164,167 +364,1244 @@ uint16_t VTFTexture::GetFirstFrame() const
 	return IsValid() ? mpHeader->firstFrame : 0;
 }
 
-VTFPixel VTFTexture::GetPixel(uint16_t x, uint16_t y, uint16_t z, uint8_t mipLevel, uint16_t frame, uint8_t face) const
+uint32_t VTFTexture::GetFlags() const
 {
-	if (!IsValid()) return VTFPixel{};
+	return IsValid() ? mpHeader->flags : 0;
+}
 
-	// Image data offset
-	uint32_t offset = 0;
+IMAGE_FORMAT VTFTexture::GetImageFormat() const
+{
+	return IsValid() ? mpHeader->highResImageFormat : IMAGE_FORMAT::NONE;
+}
 
-	uint16_t width = mpHeader->width >> mipLevel;
-	uint16_t height = mpHeader->height >> mipLevel;
-	uint16_t depth = mpHeader->depth >> mipLevel;
+bool VTFTexture::IsBlockCompressed() const { return mIsBlockCompressed; }
+bool VTFTexture::IsTranscoded() const { return mIsTranscoded; }
+float VTFTexture::GetTranscodePSNR() const { return mTranscodePSNR; }
+
+const uint8_t* VTFTexture::GetImageData() const
+{
+	return IsValid() ? mpImageData : nullptr;
+}
 
-	for (uint8_t i = mipLevel + 1; i < mpHeader->mipmapCount; i++) {
-		width >>= 1;
-		height >>= 1;
-		depth >>= 1;
+size_t VTFTexture::GetImageDataSize() const
+{
+	return IsValid() && mpImageData != nullptr ? mImageDataSize : 0;
+}
 
-		if (width < 1)  width = 1;
-		if (height < 1) height = 1;
-		if (depth < 1)  depth = 1;
+VTFMemoryStats VTFTexture::GetMemoryStats() const
+{
+	VTFMemoryStats stats;
+	stats.headerBytes = sizeof(VTFHeader);
+	if (mpStats != nullptr) stats.statsBytes = sizeof(VTFStats::Counters);
+	stats.totalBytes = stats.headerBytes + stats.statsBytes;
+	if (mFileImageFormat == IMAGE_FORMAT::NONE) return stats;
 
-		offset += VTFParser::CalcImageSize(width, height, depth, mpHeader->highResImageFormat) * VTFParser::GetFaceCount(mpHeader) * mpHeader->frames;
+	stats.isResident = IsValid() && mIsResident;
+	stats.mipCount = static_cast<uint8_t>(mpHeader->mipmapCount);
+	stats.subimagesPerMip = static_cast<uint32_t>(mpHeader->frames) * VTFParser::GetFaceCount(mpHeader);
+
+	for (uint8_t mip = 0; mip < stats.mipCount; mip++) {
+		// Sizes come from the header so they're still reported if the image data failed to load
+		VTFMemoryStats::Mip& mipStats = stats.mips[mip];
+		if (mip < mFileMipCount) {
+			const uint16_t width = std::max(mpHeader->width >> mip, 1), height = std::max(mpHeader->height >> mip, 1), depth = std::max(mpHeader->depth >> mip, 1);
+			mipStats.fileBytes = static_cast<size_t>(VTFParser::CalcImageSize(width, height, depth, mFileImageFormat));
+		}
+		mipStats.isResident = stats.isResident;
+		if (stats.isResident) mipStats.loadedBytes = mFaceSizes[mip];
+
+		stats.fileImageDataBytes += mipStats.fileBytes * stats.subimagesPerMip;
 	}
 
-	width = mpHeader->width >> mipLevel;
-	height = mpHeader->height >> mipLevel;
-	depth = mpHeader->depth >> mipLevel;
+	if (mpThumbnailData != nullptr) stats.thumbnailBytes = static_cast<size_t>(mpHeader->lowResImageWidth) * mpHeader->lowResImageHeight * 4;
+	if (stats.isResident) stats.imageDataBytes = mImageDataSize;
+	stats.brickBytes = mBrickDataSize;
+	if (mpNormalData != nullptr) stats.normalBytes = mImageDataSize / GetFormat().bytesPerPixel * 4;
+	if (mpAlphaMaskData != nullptr) stats.alphaMaskBytes = mAlphaMaskLayout.size * mpHeader->frames * GetFaces();
 
-	if (width < 1)  width = 1;
-	if (height < 1) height = 1;
-	if (depth < 1)  depth = 1;
+	stats.totalBytes =
+		stats.headerBytes + stats.thumbnailBytes + stats.imageDataBytes + stats.brickBytes +
+		stats.normalBytes + stats.alphaMaskBytes + stats.statsBytes;
+	return stats;
+}
+
+size_t VTFTexture::GetSubimageOffset(uint8_t mipLevel, uint16_t frame, uint8_t face) const
+{
+	return IsValid() && mipLevel < mpHeader->mipmapCount ? CalcSubimageOffset(mipLevel, frame, face) : 0;
+}
+
+bool VTFTexture::ConvertToRGBA8888()
+{
+	const ImageFormatInfo info = VTFParser::GetImageFormatInfo(mpHeader->highResImageFormat);
+	if (mpHeader->highResImageFormat == IMAGE_FORMAT::RGBA8888) return true;
+	if (info.isCompressed || !info.isSupported || info.bytesPerPixel > 4) return false;
+
+	const size_t pixelCount = mImageDataSize / info.bytesPerPixel;
+	uint8_t* pConverted = static_cast<uint8_t*>(malloc(pixelCount * 4));
+	if (pConverted == nullptr) return false;
+
+	for (size_t i = 0; i < pixelCount; i++) {
+		VTFPixel pixel = VTFParser::ParsePixel(mpImageData + i * info.bytesPerPixel, mpHeader->highResImageFormat);
+		pConverted[i * 4 + 0] = static_cast<uint8_t>(std::clamp(pixel.r, 0.f, 1.f) * 255.f + 0.5f);
+		pConverted[i * 4 + 1] = static_cast<uint8_t>(std::clamp(pixel.g, 0.f, 1.f) * 255.f + 0.5f);
+		pConverted[i * 4 + 2] = static_cast<uint8_t>(std::clamp(pixel.b, 0.f, 1.f) * 255.f + 0.5f);
+		pConverted[i * 4 + 3] = static_cast<uint8_t>(std::clamp(pixel.a, 0.f, 1.f) * 255.f + 0.5f);
+	}
+
+	free(mpImageData);
+	mpImageData = pConverted;
+	mImageDataSize = pixelCount * 4;
+	mpHeader->highResImageFormat = IMAGE_FORMAT::RGBA8888;
+	CalcSubimageOffsets();
+	return true;
+}
+
+bool VTFTexture::GenerateMissingMipmaps(Mipmaps::Options options)
+{
+	const uint8_t fullCount = Mipmaps::CalcFullChainLength(mpHeader->width, mpHeader->height, mpHeader->depth);
+	const uint8_t oldCount = mpHeader->mipmapCount;
+	if (oldCount == 0 || oldCount >= fullCount) return true;
+	if (!ConvertToRGBA8888()) return false;
+
+	options.sRGB |= (mpHeader->flags & static_cast<uint32_t>(TEXTURE_FLAGS::PRE_SRGB)) != 0;
+	options.clampS |= IsClampedX();
+	options.clampT |= IsClampedY();
+	options.preserveAlphaCoverage |= (mpHeader->flags & static_cast<uint32_t>(TEXTURE_FLAGS::ONEBITALPHA)) != 0;
+
+	const uint64_t newSize = VTFParser::CalcImageSize(
+		mpHeader->width, mpHeader->height,
+		mpHeader->depth, fullCount,
+		IMAGE_FORMAT::RGBA8888
+	) * mpHeader->frames * GetFaces();
+	if (newSize > SIZE_MAX) return false;
+
+	uint8_t* pNewData = static_cast<uint8_t*>(malloc(static_cast<size_t>(newSize)));
+	if (pNewData == nullptr) return false;
+
+	// MIPs are stored smallest first, so the existing levels are the tail of the new data
+	memcpy(pNewData + (newSize - mImageDataSize), mpImageData, mImageDataSize);
+	free(mpImageData);
+	mpImageData = pNewData;
+	mImageDataSize = static_cast<size_t>(newSize);
+	mpHeader->mipmapCount = fullCount;
+	CalcSubimageOffsets();
+
+	uint8_t* ppLevels[16];
+	for (uint16_t frame = 0; frame < mpHeader->frames; frame++) {
+		for (uint8_t face = 0; face < GetFaces(); face++) {
+			for (uint8_t mip = oldCount; mip < fullCount; mip++)
+				ppLevels[mip - oldCount] = mpImageData + CalcSubimageOffset(mip, frame, face);
+
+			Mipmaps::GenerateChain(
+				mpImageData + CalcSubimageOffset(oldCount - 1, frame, face),
+				GetWidth(oldCount - 1), GetHeight(oldCount - 1), GetDepth(oldCount - 1),
+				fullCount - oldCount, ppLevels, options
+			);
+		}
+	}
+
+	return true;
+}
+
+bool VTFTexture::LinearizeSRGB()
+{
+	if (!ConvertToRGBA8888()) return false;
+
+	const size_t pixelCount = mImageDataSize / 4;
+	uint16_t* pLinear = static_cast<uint16_t*>(malloc(pixelCount * 8));
+	if (pLinear == nullptr) return false;
+
+	const VTFUtil::ColourTables& tables = VTFUtil::GetColourTables();
+	const uint8_t* pSrc = mpImageData;
+	VTFUtil::ParallelFor(pixelCount, 1 << 16, [&](size_t begin, size_t end) {
+		for (size_t i = begin; i < end; i++) {
+			pLinear[i * 4 + 0] = tables.toLinear16[pSrc[i * 4 + 0]];
+			pLinear[i * 4 + 1] = tables.toLinear16[pSrc[i * 4 + 1]];
+			pLinear[i * 4 + 2] = tables.toLinear16[pSrc[i * 4 + 2]];
+			pLinear[i * 4 + 3] = static_cast<uint16_t>(pSrc[i * 4 + 3] * 257);
+		}
+	});
+
+	free(mpImageData);
+	mpImageData = reinterpret_cast<uint8_t*>(pLinear);
+	mImageDataSize = pixelCount * 8;
+	mpHeader->highResImageFormat = IMAGE_FORMAT::RGBA16161616;
+	mIsLinearized = true;
+	CalcSubimageOffsets();
+	return true;
+}
+
+bool VTFTexture::BrickVolumes()
+{
+	if (GetFaces() != 1) return false;
+
+	const IMAGE_FORMAT format = mpHeader->highResImageFormat;
+	size_t size = 0;
+	for (uint8_t mip = 0; mip < mpHeader->mipmapCount; mip++) {
+		mBrickMipOffsets[mip] = size;
+		size += Volume::CalcBrickedSize(GetWidth(mip), GetHeight(mip), GetDepth(mip), format) * mpHeader->frames;
+	}
+
+	mpBrickData = static_cast<uint8_t*>(malloc(size));
+	if (mpBrickData == nullptr) return false;
+	mBrickDataSize = size;
+
+	for (uint8_t mip = 0; mip < mpHeader->mipmapCount; mip++) {
+		const size_t frameSize = Volume::CalcBrickedSize(GetWidth(mip), GetHeight(mip), GetDepth(mip), format);
+		for (uint16_t frame = 0; frame < mpHeader->frames; frame++) {
+			Volume::Brick(
+				mpImageData + CalcSubimageOffset(mip, frame, 0), GetWidth(mip), GetHeight(mip), GetDepth(mip), format,
+				mpBrickData + mBrickMipOffsets[mip] + frame * frameSize
+			);
+		}
+	}
+
+	return true;
+}
+
+bool VTFTexture::EncodeNormals()
+{
+	const IMAGE_FORMAT format = mpHeader->highResImageFormat;
+	const uint32_t pixelSize = VTFParser::GetImageFormatInfo(format).bytesPerPixel;
+	const size_t texelCount = mImageDataSize / pixelSize;
+
+	mpNormalData = static_cast<uint32_t*>(malloc(texelCount * 4));
+	if (mpNormalData == nullptr) return false;
+
+	const uint8_t* pSrc = mpImageData;
+	uint32_t* pDst = mpNormalData;
+	const NORMAL_SWIZZLE swizzle = mNormalSwizzle;
+	VTFUtil::ParallelFor(texelCount, 1 << 16, [&](size_t begin, size_t end) {
+		for (size_t i = begin; i < end; i++) {
+			const VTFNormal normal = VTFParser::UnpackNormal(pSrc + i * pixelSize, format, swizzle);
+			pDst[i] = VTFUtil::EncodeOctahedral(normal.x, normal.y, normal.z);
+		}
+	});
+
+	return true;
+}
+
+bool VTFTexture::BuildAlphaMask(const uint8_t* pCompressedImageData, float threshold)
+{
+	const AlphaMask::Layout layout = AlphaMask::CalcLayout(mpHeader->width, mpHeader->height);
+	const size_t subimageCount = static_cast<size_t>(mpHeader->frames) * GetFaces();
+
+	uint8_t* pMaskData = static_cast<uint8_t*>(malloc(layout.size * subimageCount));
+	if (pMaskData == nullptr) return false;
+
+	// Subimages are in frame then face order in both the image data and the masks
+	for (size_t subimage = 0; subimage < subimageCount; subimage++) {
+		const uint16_t frame = static_cast<uint16_t>(subimage / GetFaces());
+		const uint8_t face = static_cast<uint8_t>(subimage % GetFaces());
+		const size_t offset = CalcSubimageOffset(0, frame, face);
+		uint8_t* pDst = pMaskData + subimage * layout.size;
+
+		if (pCompressedImageData != nullptr) {
+			if (!AlphaMask::BuildFromBlocks(pCompressedImageData + offset, mpHeader->highResImageFormat, layout, threshold, pDst)) {
+				free(pMaskData);
+				return false;
+			}
+		} else {
+			AlphaMask::BuildFromPixels(mpImageData + offset, mpHeader->highResImageFormat, layout, threshold, pDst);
+		}
+	}
+
+	mpAlphaMaskData = pMaskData;
+	mAlphaMaskLayout = layout;
+	mAlphaMaskThreshold = threshold;
+	return true;
+}
+
+bool VTFTexture::TranscodeToDXT(DXTn::QUALITY quality)
+{
+	if (!ConvertToRGBA8888()) return false;
+
+	// DXT1's 1 bit alpha would posterise anything but a cutout, so only fully opaque textures use it
+	bool isOpaque = true;
+	for (size_t i = 3; i < mImageDataSize && isOpaque; i += 4) isOpaque = mpImageData[i] == 0xFF;
+	const IMAGE_FORMAT format = isOpaque ? IMAGE_FORMAT::DXT1 : IMAGE_FORMAT::DXT5;
+
+	const size_t subimageCount = static_cast<size_t>(mpHeader->frames) * GetFaces();
+	const uint64_t encodedSize = VTFParser::CalcImageSize(mpHeader->width, mpHeader->height, 1, mpHeader->mipmapCount, format) * subimageCount;
+	if (encodedSize > SIZE_MAX) return false;
+
+	uint8_t* pEncoded = static_cast<uint8_t*>(malloc(static_cast<size_t>(encodedSize)));
+	if (pEncoded == nullptr) return false;
+
+	size_t srcOffsets[VTF_MAX_MIPMAPS], srcFaceSizes[VTF_MAX_MIPMAPS];
+	memcpy(srcOffsets, mMipOffsets, sizeof(srcOffsets));
+	memcpy(srcFaceSizes, mFaceSizes, sizeof(srcFaceSizes));
+	mpHeader->highResImageFormat = format;
+	CalcSubimageOffsets();
+
+	// Each subimage is decoded again as soon as it's encoded to measure the error
+	std::vector<uint8_t> decoded(static_cast<size_t>(GetWidth()) * GetHeight() * 4);
+	const uint32_t channels = isOpaque ? 3 : 4;
+	uint64_t squaredError = 0, sampleCount = 0;
+	for (uint8_t mip = 0; mip < mpHeader->mipmapCount; mip++) {
+		const uint16_t width = GetWidth(mip), height = GetHeight(mip);
+		const size_t pixelCount = static_cast<size_t>(width) * height;
+
+		for (size_t subimage = 0; subimage < subimageCount; subimage++) {
+			const uint8_t* pSrc = mpImageData + srcOffsets[mip] + subimage * srcFaceSizes[mip];
+			uint8_t* pDst = pEncoded + mMipOffsets[mip] + subimage * mFaceSizes[mip];
+
+			if (isOpaque)
+				DXTn::CompressDXT1(pSrc, pDst, width, height, quality);
+			else
+				DXTn::CompressDXT5(pSrc, pDst, width, height, quality);
+
+			DecompressImage(format, pDst, decoded.data(), width, height);
+			for (size_t i = 0; i < pixelCount; i++) {
+				for (uint32_t channel = 0; channel < channels; channel++) {
+					const int32_t difference = static_cast<int32_t>(pSrc[i * 4 + channel]) - decoded[i * 4 + channel];
+					squaredError += static_cast<uint64_t>(difference * difference);
+				}
+			}
+			sampleCount += pixelCount * channels;
+		}
+	}
+
+	free(mpImageData);
+	mpImageData = pEncoded;
+	mImageDataSize = static_cast<size_t>(encodedSize);
+	mIsBlockCompressed = true;
+	mIsTranscoded = true;
+	mTranscodePSNR = squaredError == 0 ?
+		INFINITY :
+		static_cast<float>(10.0 * log10(255.0 * 255.0 * static_cast<double>(sampleCount) / static_cast<double>(squaredError)));
+	return true;
+}
+
+void VTFTexture::CalcSubimageOffsets()
+{
+	// MIPs are stored smallest first
+	size_t offset = 0;
+	for (int16_t mip = mpHeader->mipmapCount - 1; mip >= 0; mip--) {
+		mMipOffsets[mip] = offset;
+		mFaceSizes[mip] = static_cast<size_t>(VTFParser::CalcImageSize(GetWidth(mip), GetHeight(mip), GetDepth(mip), mpHeader->highResImageFormat));
+		offset += mFaceSizes[mip] * VTFParser::GetFaceCount(mpHeader) * mpHeader->frames;
+	}
+}
+
+size_t VTFTexture::CalcSubimageOffset(uint8_t mipLevel, uint16_t frame, uint8_t face) const
+{
+	return mMipOffsets[mipLevel] + (static_cast<size_t>(frame) * VTFParser::GetFaceCount(mpHeader) + face) * mFaceSizes[mipLevel];
+}
+
+VTFPixel VTFTexture::GetPixel(uint16_t x, uint16_t y, uint16_t z, uint8_t mipLevel, uint16_t frame, uint8_t face) const
+{
+	if (!IsValid()) return VTFPixel{};
+
+	uint16_t width = GetWidth(mipLevel);
+	uint16_t height = GetHeight(mipLevel);
+
+	VTF_STATS(mpStats->RecordPixelRead(mipLevel);)
+	if (mIsBlockCompressed)
+		return VTFParser::FetchBlockTexel(mpImageData + CalcSubimageOffset(mipLevel, frame, face), width, x, y, mpHeader->highResImageFormat);
 
 	uint32_t pixelSize = VTFParser::GetImageFormatInfo(mpHeader->highResImageFormat).bytesPerPixel;
-	uint32_t sliceSize = width * height * pixelSize;
-	uint32_t faceSize = sliceSize * depth;
-	uint32_t frameSize = faceSize * VTFParser::GetFaceCount(mpHeader);
-	offset += frame * frameSize + face * faceSize + z * sliceSize + y * width * pixelSize + x * pixelSize;
+	uint32_t index = (static_cast<uint32_t>(z) * height + y) * width + x;
+	size_t offset = CalcSubimageOffset(mipLevel, frame, face) + static_cast<size_t>(index) * pixelSize;
 
 	return VTFParser::ParsePixel(mpImageData + offset, mpHeader->highResImageFormat);
 }
 
-VTFPixel VTFTexture::SampleBilinear(float u, float v, uint16_t z, uint8_t mipLevel, uint16_t frame, uint8_t face) const
+bool VTFTexture::ReadRegion(
+	uint8_t mipLevel, uint16_t frame, uint8_t face, uint16_t z,
+	uint16_t x, uint16_t y, uint16_t width, uint16_t height,
+	PIXEL_FORMAT format, uint8_t* pDst, size_t dstPitch
+) const
+{
+	if (!IsValid() || mpImageData == nullptr || pDst == nullptr) return false;
+	if (mipLevel >= mpHeader->mipmapCount || frame >= mpHeader->frames || face >= GetFaces() || z >= GetDepth(mipLevel)) return false;
+
+	const uint16_t mipWidth = GetWidth(mipLevel), mipHeight = GetHeight(mipLevel);
+	if (static_cast<uint32_t>(x) + width > mipWidth || static_cast<uint32_t>(y) + height > mipHeight) return false;
+
+	const uint32_t dstPixelSize = Convert::GetPixelSize(format);
+	if (dstPixelSize == 0) return false;
+	if (dstPitch == 0) dstPitch = static_cast<size_t>(width) * dstPixelSize;
+	if (dstPitch < static_cast<size_t>(width) * dstPixelSize) return false;
+
+	IMAGE_FORMAT srcFormat = mpHeader->highResImageFormat;
+	uint32_t pixelSize = VTFParser::GetImageFormatInfo(srcFormat).bytesPerPixel;
+	const uint8_t* pSlice = mpImageData + CalcSubimageOffset(mipLevel, frame, face) + static_cast<size_t>(static_cast<uint32_t>(z) * mipWidth * mipHeight) * pixelSize;
+
+	// Kept blocks are decompressed a row of blocks at a time, only the rows covering the region
+	std::vector<uint8_t> decompressed;
+	uint32_t firstRow = 0;
+	if (mIsBlockCompressed) {
+		firstRow = y / 4 * 4;
+		const uint32_t rows = std::min<uint32_t>((static_cast<uint32_t>(y) + height + 3) / 4 * 4, mipHeight) - firstRow;
+		const size_t blockRowSize = static_cast<size_t>(VTFParser::CalcImageSize(mipWidth, 4, 1, srcFormat));
+
+		decompressed.resize(static_cast<size_t>(mipWidth) * rows * 4);
+		DecompressImage(srcFormat, pSlice + firstRow / 4 * blockRowSize, decompressed.data(), mipWidth, rows);
+
+		pSlice = decompressed.data();
+		srcFormat = IMAGE_FORMAT::RGBA8888;
+		pixelSize = 4;
+	}
+
+	// Rows are independent, so split them between threads in ranges of at least 64K pixels
+	const size_t minRows = std::max<size_t>((1 << 16) / std::max<uint16_t>(width, 1), 1);
+	VTFUtil::ParallelFor(height, minRows, [&](size_t begin, size_t end) {
+		for (size_t row = begin; row < end; row++) {
+			Convert::ConvertPixels(
+				pSlice + ((y - firstRow + row) * mipWidth + x) * pixelSize, srcFormat,
+				pDst + row * dstPitch, format, width
+			);
+		}
+	});
+
+	return true;
+}
+
+bool VTFTexture::ConvertTo(PIXEL_FORMAT format, std::vector<uint8_t>& out) const
+{
+	if (!IsValid() || mpImageData == nullptr) return false;
+
+	const uint32_t dstPixelSize = Convert::GetPixelSize(format);
+	if (dstPixelSize == 0) return false;
+
+	if (mIsBlockCompressed) {
+		// Decompress one subimage at a time, in the order they're stored
+		const size_t subimageCount = static_cast<size_t>(mpHeader->frames) * GetFaces();
+		out.resize(static_cast<size_t>(VTFParser::CalcImageSize(GetWidth(), GetHeight(), 1, mpHeader->mipmapCount, IMAGE_FORMAT::RGBA8888)) / 4 * subimageCount * dstPixelSize);
+		std::vector<uint8_t> decompressed(static_cast<size_t>(GetWidth()) * GetHeight() * 4);
+
+		uint8_t* pDst = out.data();
+		for (int mip = mpHeader->mipmapCount - 1; mip >= 0; mip--) {
+			const uint16_t width = GetWidth(mip), height = GetHeight(mip);
+			const size_t pixelCount = static_cast<size_t>(width) * height;
+
+			for (size_t subimage = 0; subimage < subimageCount; subimage++) {
+				DecompressImage(mpHeader->highResImageFormat, mpImageData + mMipOffsets[mip] + subimage * mFaceSizes[mip], decompressed.data(), width, height);
+				VTFUtil::ParallelFor(pixelCount, 1 << 16, [&](size_t begin, size_t end) {
+					Convert::ConvertPixels(decompressed.data() + begin * 4, IMAGE_FORMAT::RGBA8888, pDst + begin * dstPixelSize, format, end - begin);
+				});
+				pDst += pixelCount * dstPixelSize;
+			}
+		}
+		return true;
+	}
+
+	// Every subimage is in the same format, so the image data is one run of pixels
+	const IMAGE_FORMAT srcFormat = mpHeader->highResImageFormat;
+	const uint32_t pixelSize = VTFParser::GetImageFormatInfo(srcFormat).bytesPerPixel;
+	const size_t pixelCount = mImageDataSize / pixelSize;
+	out.resize(pixelCount * dstPixelSize);
+
+	uint8_t* pDst = out.data();
+	VTFUtil::ParallelFor(pixelCount, 1 << 16, [&](size_t begin, size_t end) {
+		Convert::ConvertPixels(mpImageData + begin * pixelSize, srcFormat, pDst + begin * dstPixelSize, format, end - begin);
+	});
+
+	return true;
+}
+
+VTFPixel VTFTexture::SampleBilinear(float u, float v, uint16_t z, uint8_t mipLevel, uint16_t frame, uint8_t face, bool decodeSRGB) const
 {
 	if (!IsValid()) return VTFPixel{};
 
-	// Image data offset
-	uint32_t offset = 0;
+	uint16_t width = GetWidth(mipLevel);
+	uint16_t height = GetHeight(mipLevel);
 
-	uint16_t width = mpHeader->width >> mipLevel;
-	uint16_t height = mpHeader->height >> mipLevel;
-	uint16_t depth = mpHeader->depth >> mipLevel;
+	uint32_t pixelSize = VTFParser::GetImageFormatInfo(mpHeader->highResImageFormat).bytesPerPixel;
+	uint32_t index = static_cast<uint32_t>(z) * width * height;
+	size_t offset = CalcSubimageOffset(mipLevel, frame, face) + static_cast<size_t>(index) * pixelSize;
+
+	VTF_STATS(mpStats->RecordSample(mipLevel);)
+	return (decodeSRGB ? VTFParser::FilterBilinearSRGB : VTFParser::FilterBilinear)(
+		mpImageData + offset, width, height, mpHeader->highResImageFormat,
+		IsClampedX(), IsClampedY(), u, v
+	);
+}
+
+VTFPixel VTFTexture::SampleTrilinear(float u, float v, uint16_t z, float mipLevel, uint16_t frame, uint8_t face, bool decodeSRGB) const
+{
+	VTF_STATS(if (IsValid()) mpStats->RecordSampleCall(mipLevel < 0.f ? -1 : (mipLevel > mpHeader->mipmapCount - 1 ? 1 : 0));)
+	if (IsPointSampled()) return SampleNearestMip(u, v, z, mipLevel, frame, face, decodeSRGB);
+
+	mipLevel = std::clamp(mipLevel, 0.f, static_cast<float>(mpHeader->mipmapCount - 1));
+	float mipHigh = floorf(mipLevel), mipLow = ceilf(mipLevel);
+
+	VTFPixel high = SampleBilinear(u, v, z, mipHigh, frame, face, decodeSRGB);
+	if (mipLow == mipHigh) return high;
+
+	VTFPixel low = SampleBilinear(u, v, z, mipLow, frame, face, decodeSRGB);
+
+	return VTFParser::LerpPixel(high, low, mipLevel - mipHigh);
+}
+
+VTFPixel VTFTexture::Sample(float u, float v, uint16_t z, float mipLevel, uint16_t frame, uint8_t face) const
+{
+	return SampleTrilinear(u, v, z, mipLevel, frame, face, false);
+}
+
+VTFPixel VTFTexture::SampleLinear(float u, float v, uint16_t z, float mipLevel, uint16_t frame, uint8_t face) const
+{
+	// Pre linearised data is already in linear space
+	return SampleTrilinear(u, v, z, mipLevel, frame, face, IsSRGB() && !mIsLinearized);
+}
+
+void VTFTexture::Prefetch(float u, float v, uint16_t z, float mipLevel, uint16_t frame, uint8_t face) const
+{
+	if (!IsValid() || mpImageData == nullptr || frame >= mpHeader->frames || face >= GetFaces()) return;
 
-	// TODO: Cache these mip offsets on image load and perform a lookup here
-	for (uint8_t i = mipLevel + 1; i < mpHeader->mipmapCount; i++) {
-		width >>= 1;
-		height >>= 1;
-		depth >>= 1;
+	// Both MIPs a trilinear lookup blends, one of which is the MIP point sampling rounds to
+	mipLevel = std::clamp(mipLevel, 0.f, static_cast<float>(mpHeader->mipmapCount - 1));
+	const uint8_t mips[2] = { static_cast<uint8_t>(floorf(mipLevel)), static_cast<uint8_t>(ceilf(mipLevel)) };
 
-		if (width < 1)  width = 1;
-		if (height < 1) height = 1;
-		if (depth < 1)  depth = 1;
+	const uint32_t pixelSize = VTFParser::GetImageFormatInfo(mpHeader->highResImageFormat).bytesPerPixel;
+	for (int i = 0; i < (mips[0] == mips[1] ? 1 : 2); i++) {
+		const uint8_t mip = mips[i];
+		if (z >= GetDepth(mip)) continue;
 
-		offset += VTFParser::CalcImageSize(width, height, depth, mpHeader->highResImageFormat) * VTFParser::GetFaceCount(mpHeader) * mpHeader->frames;
+		const uint16_t width = GetWidth(mip), height = GetHeight(mip);
+		VTFParser::PrefetchBilinear(
+			mpImageData + CalcSubimageOffset(mip, frame, face) + static_cast<size_t>(static_cast<uint32_t>(z) * width * height) * pixelSize,
+			width, height, mpHeader->highResImageFormat,
+			IsClampedX(), IsClampedY(), u, v
+		);
 	}
+}
 
-	width = mpHeader->width >> mipLevel;
-	height = mpHeader->height >> mipLevel;
-	depth = mpHeader->depth >> mipLevel;
+bool VTFTexture::IsPointSampled() const
+{
+	return IsValid() && (mpHeader->flags & static_cast<uint32_t>(TEXTURE_FLAGS::POINTSAMPLE)) != 0;
+}
 
-	if (width < 1)  width = 1;
-	if (height < 1) height = 1;
-	if (depth < 1)  depth = 1;
+bool VTFTexture::IsClampedX() const { return (mpHeader->flags & static_cast<uint32_t>(TEXTURE_FLAGS::CLAMPS)) != 0; }
+bool VTFTexture::IsClampedY() const { return (mpHeader->flags & static_cast<uint32_t>(TEXTURE_FLAGS::CLAMPT)) != 0; }
+bool VTFTexture::IsClampedZ() const { return (mpHeader->flags & static_cast<uint32_t>(TEXTURE_FLAGS::CLAMPU)) != 0; }
+
+VTFPixel VTFTexture::SampleNearestMip(float u, float v, uint16_t z, float mipLevel, uint16_t frame, uint8_t face, bool decodeSRGB) const
+{
+	if (!IsValid() || mpImageData == nullptr) return VTFPixel{};
+
+	mipLevel = std::clamp(mipLevel, 0.f, static_cast<float>(mpHeader->mipmapCount - 1));
+	const uint8_t mip = static_cast<uint8_t>(mipLevel + 0.5f);
+
+	uint16_t width = GetWidth(mip);
+	uint16_t height = GetHeight(mip);
 
 	uint32_t pixelSize = VTFParser::GetImageFormatInfo(mpHeader->highResImageFormat).bytesPerPixel;
-	uint32_t sliceSize = width * height * pixelSize;
-	uint32_t faceSize = sliceSize * depth;
-	uint32_t frameSize = faceSize * VTFParser::GetFaceCount(mpHeader);
-	offset += frame * frameSize + face * faceSize + z * sliceSize;// +y * width * pixelSize + x * pixelSize;
-
-	VTFPixel filtered{};
-
-	bool clampX = (mpHeader->flags & static_cast<uint32_t>(TEXTURE_FLAGS::CLAMPS)) != 0;
-	bool clampY = (mpHeader->flags & static_cast<uint32_t>(TEXTURE_FLAGS::CLAMPT)) != 0;
-
-	// Remap to 0-1
-	if (clampX)
-		u = std::clamp(u, 0.f, 0.9999f);
-	else
-		u -= floorf(u);
-
-	if (clampY)
-		v = std::clamp(v, 0.f, 0.9999f);
-	else
-		v -= floorf(v);
-
-	// Remap to pixel centres
-	u = u * width - 0.5f;
-	v = v * height - 0.5f;
-
-	// Floor to nearest pixel
-	int x = floorf(u);
-	int y = floorf(v);
-
-	// Calculate fractional coordinate and inverse
-	float uFract = u - x;
-	float vFract = v - y;
-	float uFractInv = 1.f - uFract;
-	float vFractInv = 1.f - vFract;
-
-	VTFPixel corners[2][2];
-	for (int xOff = 0; xOff < 2; xOff++) {
-		for (int yOff = 0; yOff < 2; yOff++) {
-			int xCorner = x + xOff, yCorner = y + yOff;
-			if (clampX)
-				xCorner = std::clamp(xCorner, 0, static_cast<int>(width) - 1);
-			else
-				xCorner = intmod(xCorner, width);
+	uint32_t index = static_cast<uint32_t>(z) * width * height;
+	size_t offset = CalcSubimageOffset(mip, frame, face) + static_cast<size_t>(index) * pixelSize;
 
-			if (clampY)
-				yCorner = std::clamp(yCorner, 0, static_cast<int>(height) - 1);
-			else
-				yCorner = intmod(yCorner, height);
+	VTF_STATS(mpStats->RecordSample(mip);)
+	VTFPixel pixel = VTFParser::FilterNearest(
+		mpImageData + offset, width, height, mpHeader->highResImageFormat,
+		IsClampedX(), IsClampedY(), u, v
+	);
+	if (!decodeSRGB) return pixel;
+
+	const VTFUtil::ColourTables& tables = VTFUtil::GetColourTables();
+	return VTFPixel{ VTFUtil::DecodeSRGB(tables, pixel.r), VTFUtil::DecodeSRGB(tables, pixel.g), VTFUtil::DecodeSRGB(tables, pixel.b), pixel.a };
+}
+
+VTFPixel VTFTexture::SampleNearest(float u, float v, uint16_t z, float mipLevel, uint16_t frame, uint8_t face) const
+{
+	VTF_STATS(if (IsValid()) mpStats->RecordSampleCall(mipLevel < 0.f ? -1 : (mipLevel > mpHeader->mipmapCount - 1 ? 1 : 0));)
+	return SampleNearestMip(u, v, z, mipLevel, frame, face, false);
+}
+
+void VTFTexture::SampleNearestBatch(const float* pU, const float* pV, float mipLevel, uint16_t frame, size_t count, VTFPixel* pOut) const
+{
+	if (!IsValid() || mpImageData == nullptr) {
+		std::fill(pOut, pOut + count, VTFPixel{});
+		return;
+	}
+
+	VTF_STATS(
+		for (size_t i = 0; i < count; i++)
+			mpStats->RecordSampleCall(mipLevel < 0.f ? -1 : (mipLevel > mpHeader->mipmapCount - 1 ? 1 : 0));
+	)
+	mipLevel = std::clamp(mipLevel, 0.f, static_cast<float>(mpHeader->mipmapCount - 1));
+	const uint8_t mip = static_cast<uint8_t>(mipLevel + 0.5f);
+	VTF_STATS(for (size_t i = 0; i < count; i++) mpStats->RecordSample(mip);)
+
+	VTFParser::FilterNearestBatch(
+		mpImageData + CalcSubimageOffset(mip, frame, 0), GetWidth(mip), GetHeight(mip), mpHeader->highResImageFormat,
+		IsClampedX(), IsClampedY(), pU, pV, count, pOut
+	);
+}
+
+bool VTFTexture::IsSRGB() const
+{
+	return IsValid() && (mpHeader->flags & static_cast<uint32_t>(TEXTURE_FLAGS::PRE_SRGB)) != 0;
+}
 
-			corners[xOff][yOff] = VTFParser::ParsePixel(
-				mpImageData + offset + yCorner * width * pixelSize + xCorner * pixelSize,
-				mpHeader->highResImageFormat
+bool VTFTexture::IsLinearized() const { return mIsLinearized; }
+
+void VTFTexture::CalcAnimationFrames(float time, float fps, bool interpolate, uint16_t* pFrame, uint16_t* pNextFrame, float* pBlend) const
+{
+	const uint16_t frames = mpHeader->frames;
+
+	// firstFrame is -1 in 6 face envmaps older than 7.5 rather than a frame index
+	const uint16_t firstFrame = mpHeader->firstFrame < frames ? mpHeader->firstFrame : 0;
+
+	// Wrap before converting to an index so large times can't overflow it
+	float position = time * fps;
+	if (!std::isfinite(position)) position = 0.f;
+	position = fmodf(position, frames);
+	if (position < 0.f) position += frames;
+
+	const float whole = floorf(position);
+	*pFrame = static_cast<uint16_t>((firstFrame + static_cast<uint32_t>(whole)) % frames);
+	*pNextFrame = static_cast<uint16_t>((*pFrame + 1) % frames);
+	*pBlend = interpolate ? position - whole : 0.f;
+}
+
+VTFPixel VTFTexture::SampleAnimatedTrilinear(float u, float v, float mipLevel, uint16_t frame, uint16_t nextFrame, float blend) const
+{
+	VTF_STATS(mpStats->RecordSampleCall(mipLevel < 0.f ? -1 : (mipLevel > mpHeader->mipmapCount - 1 ? 1 : 0));)
+	if (IsPointSampled()) {
+		const VTFPixel pixel = SampleNearestMip(u, v, 0, mipLevel, frame, 0, false);
+		if (blend <= 0.f) return pixel;
+
+		// Frames still blend when interpolating, only the filtering within each is point
+		const VTFPixel next = SampleNearestMip(u, v, 0, mipLevel, nextFrame, 0, false);
+		return VTFParser::LerpPixel(pixel, next, blend);
+	}
+
+	mipLevel = std::clamp(mipLevel, 0.f, static_cast<float>(mpHeader->mipmapCount - 1));
+	const uint8_t mips[2] = { static_cast<uint8_t>(floorf(mipLevel)), static_cast<uint8_t>(ceilf(mipLevel)) };
+
+	const bool clampX = IsClampedX();
+	const bool clampY = IsClampedY();
+
+	VTFPixel pixels[2];
+	for (int i = 0; i < (mips[0] == mips[1] ? 1 : 2); i++) {
+		const uint8_t mip = mips[i];
+		VTF_STATS(mpStats->RecordSample(mip);)
+		pixels[i] = VTFParser::FilterBilinearBlend(
+			mpImageData + CalcSubimageOffset(mip, frame, 0), mpImageData + CalcSubimageOffset(mip, nextFrame, 0),
+			GetWidth(mip), GetHeight(mip), mpHeader->highResImageFormat,
+			clampX, clampY, u, v, blend
+		);
+	}
+	if (mips[0] == mips[1]) return pixels[0];
+
+	const VTFPixel& high = pixels[0];
+	const VTFPixel& low = pixels[1];
+
+	return VTFParser::LerpPixel(high, low, mipLevel - mips[0]);
+}
+
+VTFPixel VTFTexture::SampleAnimated(float u, float v, float mipLevel, float time, float fps, bool interpolate) const
+{
+	if (!IsValid() || mpImageData == nullptr || mpHeader->frames == 0) return VTFPixel{};
+
+	uint16_t frame, nextFrame;
+	float blend;
+	CalcAnimationFrames(time, fps, interpolate, &frame, &nextFrame, &blend);
+
+	return SampleAnimatedTrilinear(u, v, mipLevel, frame, nextFrame, blend);
+}
+
+void VTFTexture::SampleAnimatedBatch(
+	const float* pU, const float* pV, const float* pMipLevels, const float* pTimes,
+	float fps, bool interpolate, size_t count, VTFPixel* pOut
+) const
+{
+	if (!IsValid() || mpImageData == nullptr || mpHeader->frames == 0) {
+		std::fill(pOut, pOut + count, VTFPixel{});
+		return;
+	}
+
+	// Each chunk of lanes has its frames worked out and texels prefetched before any is sampled, so the misses overlap
+	const size_t PREFETCH_CHUNK = 16;
+	uint16_t frames[PREFETCH_CHUNK], nextFrames[PREFETCH_CHUNK];
+	float blends[PREFETCH_CHUNK];
+	for (size_t begin = 0; begin < count; begin += PREFETCH_CHUNK) {
+		const size_t chunk = std::min(PREFETCH_CHUNK, count - begin);
+
+		for (size_t i = 0; i < chunk; i++) {
+			CalcAnimationFrames(pTimes[begin + i], fps, interpolate, &frames[i], &nextFrames[i], &blends[i]);
+
+			const float mipLevel = pMipLevels != nullptr ? pMipLevels[begin + i] : 0.f;
+			Prefetch(pU[begin + i], pV[begin + i], 0, mipLevel, frames[i], 0);
+			if (blends[i] > 0.f) Prefetch(pU[begin + i], pV[begin + i], 0, mipLevel, nextFrames[i], 0);
+		}
+
+		for (size_t i = 0; i < chunk; i++) {
+			pOut[begin + i] = SampleAnimatedTrilinear(
+				pU[begin + i], pV[begin + i], pMipLevels != nullptr ? pMipLevels[begin + i] : 0.f, frames[i], nextFrames[i], blends[i]
 			);
 		}
 	}
+}
 
-	return VTFPixel{
-		(corners[0][0].r * uFractInv + corners[1][0].r * uFract) * vFractInv +
-		(corners[0][1].r * uFractInv + corners[1][1].r * uFract) * vFract,
+bool VTFTexture::IsBricked() const { return mpBrickData != nullptr; }
 
-		(corners[0][0].g * uFractInv + corners[1][0].g * uFract)* vFractInv +
-		(corners[0][1].g * uFractInv + corners[1][1].g * uFract) * vFract,
+Volume::Image VTFTexture::GetVolumeImage(uint8_t mipLevel, uint16_t frame) const
+{
+	const uint16_t width = GetWidth(mipLevel), height = GetHeight(mipLevel), depth = GetDepth(mipLevel);
 
-		(corners[0][0].b * uFractInv + corners[1][0].b * uFract)* vFractInv +
-		(corners[0][1].b * uFractInv + corners[1][1].b * uFract) * vFract,
+	if (mpBrickData != nullptr) {
+		const size_t frameSize = Volume::CalcBrickedSize(width, height, depth, mpHeader->highResImageFormat);
+		return Volume::MakeBrickedImage(
+			mpBrickData + mBrickMipOffsets[mipLevel] + frame * frameSize, width, height, depth, mpHeader->highResImageFormat
+		);
+	}
 
-		(corners[0][0].a * uFractInv + corners[1][0].a * uFract)* vFractInv +
-		(corners[0][1].a * uFractInv + corners[1][1].a * uFract) * vFract,
-	};
+	return Volume::MakeLinearImage(
+		mpImageData + CalcSubimageOffset(mipLevel, frame, 0), width, height, depth, mpHeader->highResImageFormat
+	);
 }
 
-VTFPixel VTFTexture::Sample(float u, float v, uint16_t z, float mipLevel, uint16_t frame, uint8_t face) const
+VTFPixel VTFTexture::SampleVolume(float u, float v, float w, uint8_t mipLevel, uint16_t frame) const
+{
+	// Kept blocks are only ever 2D, which sample as a single slice anyway
+	if (mIsBlockCompressed) return SampleBilinear(u, v, 0, mipLevel, frame, 0, false);
+
+	VTF_STATS(mpStats->RecordSample(mipLevel);)
+	return Volume::FilterTrilinear(
+		GetVolumeImage(mipLevel, frame),
+		IsClampedX(), IsClampedY(), IsClampedZ(), u, v, w
+	);
+}
+
+VTFPixel VTFTexture::SampleVolumeNearestMip(float u, float v, float w, float mipLevel, uint16_t frame) const
+{
+	mipLevel = std::clamp(mipLevel, 0.f, static_cast<float>(mpHeader->mipmapCount - 1));
+	const uint8_t mip = static_cast<uint8_t>(mipLevel + 0.5f);
+	if (mIsBlockCompressed) return SampleNearestMip(u, v, 0, mip, frame, 0, false);
+
+	VTF_STATS(mpStats->RecordSample(mip);)
+	return Volume::FilterNearest(
+		GetVolumeImage(mip, frame),
+		IsClampedX(), IsClampedY(), IsClampedZ(), u, v, w
+	);
+}
+
+VTFPixel VTFTexture::Sample3D(float u, float v, float w, float mipLevel, uint16_t frame) const
 {
+	if (!IsValid() || mpImageData == nullptr) return VTFPixel{};
+
+	VTF_STATS(mpStats->RecordSampleCall(mipLevel < 0.f ? -1 : (mipLevel > mpHeader->mipmapCount - 1 ? 1 : 0));)
+	if (IsPointSampled()) return SampleVolumeNearestMip(u, v, w, mipLevel, frame);
+
 	mipLevel = std::clamp(mipLevel, 0.f, static_cast<float>(mpHeader->mipmapCount - 1));
 	float mipHigh = floorf(mipLevel), mipLow = ceilf(mipLevel);
 
-	VTFPixel high = SampleBilinear(u, v, z, mipHigh, frame, face);
+	VTFPixel high = SampleVolume(u, v, w, mipHigh, frame);
 	if (mipLow == mipHigh) return high;
 
-	VTFPixel low = SampleBilinear(u, v, z, mipLow, frame, face);
+	VTFPixel low = SampleVolume(u, v, w, mipLow, frame);
+
+	return VTFParser::LerpPixel(high, low, mipLevel - mipHigh);
+}
+
+void VTFTexture::Sample3DBatch(const float* pU, const float* pV, const float* pW, float mipLevel, uint16_t frame, size_t count, VTFPixel* pOut) const
+{
+	if (!IsValid() || mpImageData == nullptr) {
+		std::fill(pOut, pOut + count, VTFPixel{});
+		return;
+	}
+
+	// Kept blocks sample as a single 2D slice, and point sampling is one fetch per lane with no weights to compute 4 at a time
+	if (mIsBlockCompressed || IsPointSampled()) {
+		for (size_t i = 0; i < count; i++) pOut[i] = Sample3D(pU[i], pV[i], pW[i], mipLevel, frame);
+		return;
+	}
+
+	VTF_STATS(
+		for (size_t i = 0; i < count; i++)
+			mpStats->RecordSampleCall(mipLevel < 0.f ? -1 : (mipLevel > mpHeader->mipmapCount - 1 ? 1 : 0));
+	)
+	mipLevel = std::clamp(mipLevel, 0.f, static_cast<float>(mpHeader->mipmapCount - 1));
+	const uint8_t mipHigh = static_cast<uint8_t>(floorf(mipLevel)), mipLow = static_cast<uint8_t>(ceilf(mipLevel));
+
+	const bool clampX = IsClampedX();
+	const bool clampY = IsClampedY();
+	const bool clampZ = IsClampedZ();
+
+	const Volume::Image high = GetVolumeImage(mipHigh, frame);
+	VTF_STATS(for (size_t i = 0; i < count; i++) mpStats->RecordSample(mipHigh);)
+	if (mipLow == mipHigh) {
+		Volume::FilterTrilinearBatch(high, clampX, clampY, clampZ, pU, pV, pW, count, pOut);
+		return;
+	}
+
+	// Blend the lower MIP in through a small stack buffer
+	const Volume::Image low = GetVolumeImage(mipLow, frame);
+	VTF_STATS(for (size_t i = 0; i < count; i++) mpStats->RecordSample(mipLow);)
+
+	const float fract = mipLevel - mipHigh;
+
+	const size_t CHUNK_SIZE = 64;
+	VTFPixel lows[CHUNK_SIZE];
+	for (size_t begin = 0; begin < count; begin += CHUNK_SIZE) {
+		const size_t chunk = std::min(CHUNK_SIZE, count - begin);
+		Volume::FilterTrilinearBatch(high, clampX, clampY, clampZ, pU + begin, pV + begin, pW + begin, chunk, pOut + begin);
+		Volume::FilterTrilinearBatch(low, clampX, clampY, clampZ, pU + begin, pV + begin, pW + begin, chunk, lows);
+
+		for (size_t i = 0; i < chunk; i++) pOut[begin + i] = VTFParser::LerpPixel(pOut[begin + i], lows[i], fract);
+	}
+}
+
+bool VTFTexture::IsNormalMap() const
+{
+	return IsValid() && (mpHeader->flags & static_cast<uint32_t>(TEXTURE_FLAGS::NORMAL)) != 0;
+}
+
+bool VTFTexture::IsSSBump() const
+{
+	return IsValid() && (mpHeader->flags & static_cast<uint32_t>(TEXTURE_FLAGS::SSBUMP)) != 0;
+}
+
+bool VTFTexture::HasEncodedNormals() const { return mpNormalData != nullptr; }
+
+VTFNormal VTFTexture::SampleNormalBilinear(float u, float v, uint16_t z, uint8_t mipLevel, uint16_t frame, uint8_t face) const
+{
+	const uint16_t width = GetWidth(mipLevel);
+	const uint16_t height = GetHeight(mipLevel);
+	const bool clampX = IsClampedX();
+	const bool clampY = IsClampedY();
+
+	const uint32_t pixelSize = VTFParser::GetImageFormatInfo(mpHeader->highResImageFormat).bytesPerPixel;
+	const uint32_t index = static_cast<uint32_t>(z) * width * height;
+	const size_t offset = CalcSubimageOffset(mipLevel, frame, face) + static_cast<size_t>(index) * pixelSize;
+
+	VTF_STATS(mpStats->RecordSample(mipLevel);)
+
+	// Basis weights are plain colours
+	if (IsSSBump()) {
+		const VTFPixel pixel = VTFParser::FilterBilinear(mpImageData + offset, width, height, mpHeader->highResImageFormat, clampX, clampY, u, v);
+		return VTFNormal{ pixel.r, pixel.g, pixel.b };
+	}
+
+	// Encoded normals are at the same texel index as the image data
+	if (mpNormalData != nullptr)
+		return VTFParser::FilterBilinearOctahedral(mpNormalData + offset / pixelSize, width, height, clampX, clampY, u, v);
+
+	return VTFParser::FilterBilinearNormal(mpImageData + offset, width, height, mpHeader->highResImageFormat, mNormalSwizzle, clampX, clampY, u, v);
+}
+
+VTFNormal VTFTexture::SampleNormalNearest(float u, float v, uint16_t z, uint8_t mipLevel, uint16_t frame, uint8_t face) const
+{
+	const uint16_t width = GetWidth(mipLevel);
+	const uint16_t height = GetHeight(mipLevel);
+	const bool clampX = IsClampedX();
+	const bool clampY = IsClampedY();
+
+	const uint32_t pixelSize = VTFParser::GetImageFormatInfo(mpHeader->highResImageFormat).bytesPerPixel;
+	const uint32_t index = static_cast<uint32_t>(z) * width * height;
+	const size_t offset = CalcSubimageOffset(mipLevel, frame, face) + static_cast<size_t>(index) * pixelSize;
+
+	VTF_STATS(mpStats->RecordSample(mipLevel);)
+
+	if (IsSSBump()) {
+		const VTFPixel pixel = VTFParser::FilterNearest(mpImageData + offset, width, height, mpHeader->highResImageFormat, clampX, clampY, u, v);
+		return VTFNormal{ pixel.r, pixel.g, pixel.b };
+	}
+
+	if (mpNormalData != nullptr)
+		return VTFParser::FilterNearestOctahedral(mpNormalData + offset / pixelSize, width, height, clampX, clampY, u, v);
+
+	return VTFParser::FilterNearestNormal(mpImageData + offset, width, height, mpHeader->highResImageFormat, mNormalSwizzle, clampX, clampY, u, v);
+}
+
+VTFNormal VTFTexture::SampleNormal(float u, float v, uint16_t z, float mipLevel, uint16_t frame, uint8_t face) const
+{
+	if (!IsValid() || mpImageData == nullptr) return VTFNormal{};
+
+	VTF_STATS(mpStats->RecordSampleCall(mipLevel < 0.f ? -1 : (mipLevel > mpHeader->mipmapCount - 1 ? 1 : 0));)
+	mipLevel = std::clamp(mipLevel, 0.f, static_cast<float>(mpHeader->mipmapCount - 1));
+
+	VTFNormal normal;
+	if (IsPointSampled()) {
+		normal = SampleNormalNearest(u, v, z, static_cast<uint8_t>(mipLevel + 0.5f), frame, face);
+	} else {
+		float mipHigh = floorf(mipLevel), mipLow = ceilf(mipLevel);
+
+		normal = SampleNormalBilinear(u, v, z, mipHigh, frame, face);
+		if (mipLow != mipHigh)
+			normal = VTFParser::LerpNormal(normal, SampleNormalBilinear(u, v, z, mipLow, frame, face), mipLevel - mipHigh);
+	}
+	if (IsSSBump()) return normal;
+
+	// Renormalise once after both MIPs are blended (or the octahedral texel is decoded)
+	const float lengthSquared = normal.x * normal.x + normal.y * normal.y + normal.z * normal.z;
+	if (!(lengthSquared > 0.f)) return VTFNormal{};
+
+	const float lengthInv = 1.f / sqrtf(lengthSquared);
+	return VTFNormal{ normal.x * lengthInv, normal.y * lengthInv, normal.z * lengthInv };
+}
+
+bool VTFTexture::HasThumbnail() const { return mpThumbnailData != nullptr; }
+
+uint8_t VTFTexture::GetThumbnailWidth() const
+{
+	return HasThumbnail() ? mpHeader->lowResImageWidth : 0;
+}
+uint8_t VTFTexture::GetThumbnailHeight() const
+{
+	return HasThumbnail() ? mpHeader->lowResImageHeight : 0;
+}
+
+const uint8_t* VTFTexture::GetThumbnail() const { return mpThumbnailData; }
+
+VTFPixel VTFTexture::SampleThumbnail(float u, float v) const
+{
+	if (!HasThumbnail()) return VTFPixel{};
+
+	return VTFParser::FilterBilinear(
+		mpThumbnailData, mpHeader->lowResImageWidth, mpHeader->lowResImageHeight, IMAGE_FORMAT::RGBA8888,
+		IsClampedX(), IsClampedY(), u, v
+	);
+}
+
+VTFPixel VTFTexture::GetReflectivity() const
+{
+	if (!IsValid()) return VTFPixel{};
+	return VTFPixel{ mpHeader->reflectivity[0], mpHeader->reflectivity[1], mpHeader->reflectivity[2] };
+}
+
+float VTFTexture::GetBumpmapScale() const
+{
+	return IsValid() ? mpHeader->bumpmapScale : 0.f;
+}
+
+// Adds up each channel of RGBA8888 texels
+static void SumRGBA8888(const uint8_t* pData, uint64_t pixelCount, uint64_t* pSums)
+{
+	uint64_t i = 0;
+
+#ifdef VTF_SSE2
+	// 32 bit lanes can hold at least 2^24 channel values before overflowing, so flush to 64 bit per chunk
+	const __m128i zero = _mm_setzero_si128();
+	const uint64_t vectorCount = pixelCount & ~static_cast<uint64_t>(3);
+	while (i < vectorCount) {
+		uint64_t chunkEnd = std::min(vectorCount, i + (1 << 24));
+		__m128i acc = _mm_setzero_si128();
+		for (; i < chunkEnd; i += 4) {
+			__m128i pixels = _mm_loadu_si128(reinterpret_cast<const __m128i*>(pData + i * 4));
+			__m128i lo = _mm_unpacklo_epi8(pixels, zero);
+			__m128i hi = _mm_unpackhi_epi8(pixels, zero);
+			__m128i sum16 = _mm_add_epi16(lo, hi);
+			acc = _mm_add_epi32(acc, _mm_unpacklo_epi16(sum16, zero));
+			acc = _mm_add_epi32(acc, _mm_unpackhi_epi16(sum16, zero));
+		}
+
+		alignas(16) uint32_t lanes[4];
+		_mm_store_si128(reinterpret_cast<__m128i*>(lanes), acc);
+		for (int c = 0; c < 4; c++) pSums[c] += lanes[c];
+	}
+#endif
+
+	for (; i < pixelCount; i++) {
+		for (int c = 0; c < 4; c++) pSums[c] += pData[i * 4 + c];
+	}
+}
 
-	float fract = mipLevel - mipHigh;
-	float fractInv = 1.f - fract;
+VTFPixel VTFTexture::ComputeAverage(uint8_t mipLevel, uint16_t frame, uint8_t face) const
+{
+	if (!IsValid() || mpImageData == nullptr) return VTFPixel{};
+	if (mipLevel >= mpHeader->mipmapCount || frame >= mpHeader->frames || face >= GetFaces()) return VTFPixel{};
+
+	const uint8_t* pData = mpImageData + CalcSubimageOffset(mipLevel, frame, face);
+	const uint64_t pixelCount = static_cast<uint64_t>(GetWidth(mipLevel)) * GetHeight(mipLevel) * GetDepth(mipLevel);
+	const IMAGE_FORMAT format = mpHeader->highResImageFormat;
+
+	if (!mIsBlockCompressed && format != IMAGE_FORMAT::RGBA8888) {
+		double sum[4] = { 0, 0, 0, 0 };
+		uint32_t pixelSize = VTFParser::GetImageFormatInfo(format).bytesPerPixel;
+		for (uint64_t i = 0; i < pixelCount; i++) {
+			VTFPixel pixel = VTFParser::ParsePixel(pData + i * pixelSize, format);
+			sum[0] += pixel.r;
+			sum[1] += pixel.g;
+			sum[2] += pixel.b;
+			sum[3] += pixel.a;
+		}
 
+		return VTFPixel{
+			static_cast<float>(sum[0] / pixelCount),
+			static_cast<float>(sum[1] / pixelCount),
+			static_cast<float>(sum[2] / pixelCount),
+			static_cast<float>(sum[3] / pixelCount)
+		};
+	}
+
+	uint64_t sum[4] = { 0, 0, 0, 0 };
+	if (!mIsBlockCompressed) {
+		// Compressed formats are decompressed to RGBA8888 on load unless kept, so this is the common case
+		SumRGBA8888(pData, pixelCount, sum);
+	} else if (!VTFParser::SumBlockTexels(pData, GetWidth(mipLevel), GetHeight(mipLevel), format, sum)) {
+		// Kept blocks are summed without decompressing where possible, otherwise decompressed a row of blocks at a time
+		const uint16_t width = GetWidth(mipLevel), height = GetHeight(mipLevel);
+		const size_t blockRowSize = static_cast<size_t>(VTFParser::CalcImageSize(width, 4, 1, format));
+		std::vector<uint8_t> strip(static_cast<size_t>(width) * 4 * 4);
+
+		for (uint32_t y = 0; y < height; y += 4, pData += blockRowSize) {
+			const uint16_t rows = static_cast<uint16_t>(std::min(height - y, 4u));
+			DecompressImage(format, pData, strip.data(), width, rows);
+			SumRGBA8888(strip.data(), static_cast<uint64_t>(width) * rows, sum);
+		}
+	}
+
+	const double scale = 1.0 / (255.0 * pixelCount);
 	return VTFPixel{
-		low.r * fract + high.r * fractInv,
-		low.g * fract + high.g * fractInv,
-		low.b * fract + high.b * fractInv,
-		low.a * fract + high.a * fractInv
+		static_cast<float>(sum[0] * scale),
+		static_cast<float>(sum[1] * scale),
+		static_cast<float>(sum[2] * scale),
+		static_cast<float>(sum[3] * scale)
 	};
 }
+
+VTFPixel VTFTexture::EstimateAverage(uint16_t frame, uint8_t face, uint32_t texelBudget) const
+{
+	if (!IsValid()) return VTFPixel{};
+
+	// Largest MIP within the budget, falling back to the smallest
+	uint8_t mipLevel = 0;
+	while (
+		mipLevel + 1 < mpHeader->mipmapCount &&
+		static_cast<uint64_t>(GetWidth(mipLevel)) * GetHeight(mipLevel) * GetDepth(mipLevel) > texelBudget
+	) mipLevel++;
+
+	return ComputeAverage(mipLevel, frame, face);
+}
+
+bool VTFTexture::HasAlphaMask() const { return mpAlphaMaskData != nullptr; }
+
+AlphaMask::Image VTFTexture::GetAlphaMaskImage(uint16_t frame, uint8_t face) const
+{
+	AlphaMask::Image image;
+	image.pLayout = &mAlphaMaskLayout;
+	image.pData = mpAlphaMaskData + (static_cast<size_t>(frame) * GetFaces() + face) * mAlphaMaskLayout.size;
+	image.maskThreshold = mAlphaMaskThreshold;
+	image.tolerance = AlphaMask::GetTolerance(mpHeader->highResImageFormat);
+	return image;
+}
+
+float VTFTexture::SampleAlpha(float u, float v, uint16_t frame, uint8_t face) const
+{
+	// Same filter Sample uses at MIP 0
+	if (IsPointSampled()) return SampleNearestMip(u, v, 0, 0.f, frame, face, false).a;
+	return SampleBilinear(u, v, 0, 0, frame, face, false).a;
+}
+
+ALPHA_COVERAGE VTFTexture::ClassifyAlpha(float u, float v, float threshold, uint16_t frame, uint8_t face) const
+{
+	if (mpAlphaMaskData == nullptr || frame >= mpHeader->frames || face >= GetFaces()) return ALPHA_COVERAGE::MIXED;
+
+	// The bit mask holds bilinear taps, a point sample is only one of them
+	return AlphaMask::ClassifyLookup(
+		GetAlphaMaskImage(frame, face),
+		IsClampedX(), IsClampedY(), u, v, threshold, !IsPointSampled()
+	);
+}
+
+ALPHA_COVERAGE VTFTexture::ClassifyAlpha(float uMin, float vMin, float uMax, float vMax, float threshold, uint16_t frame, uint8_t face) const
+{
+	if (mpAlphaMaskData == nullptr || frame >= mpHeader->frames || face >= GetFaces()) return ALPHA_COVERAGE::MIXED;
+
+	return AlphaMask::ClassifyFootprint(
+		GetAlphaMaskImage(frame, face),
+		IsClampedX(), IsClampedY(), uMin, vMin, uMax, vMax, threshold
+	);
+}
+
+bool VTFTexture::AlphaTest(float u, float v, float threshold, uint16_t frame, uint8_t face) const
+{
+	if (!IsValid() || mpImageData == nullptr) return false;
+
+	const ALPHA_COVERAGE coverage = ClassifyAlpha(u, v, threshold, frame, face);
+	if (coverage != ALPHA_COVERAGE::MIXED) return coverage == ALPHA_COVERAGE::ALL_OPAQUE;
+
+	return SampleAlpha(u, v, frame, face) >= threshold;
+}
+
+void VTFTexture::AlphaTestBatch(const float* pU, const float* pV, float threshold, uint16_t frame, size_t count, bool* pOut) const
+{
+	if (!IsValid() || mpImageData == nullptr) {
+		for (size_t i = 0; i < count; i++) pOut[i] = false;
+		return;
+	}
+
+	if (mpAlphaMaskData == nullptr || frame >= mpHeader->frames) {
+		for (size_t i = 0; i < count; i++) pOut[i] = SampleAlpha(pU[i], pV[i], frame, 0) >= threshold;
+		return;
+	}
+
+	// Everything but the lookups themselves is the same for every lane
+	const AlphaMask::Image image = GetAlphaMaskImage(frame, 0);
+	const bool clampX = IsClampedX();
+	const bool clampY = IsClampedY();
+	const bool useBitMask = !IsPointSampled();
+
+	for (size_t i = 0; i < count; i++) {
+		const ALPHA_COVERAGE coverage = AlphaMask::ClassifyLookup(image, clampX, clampY, pU[i], pV[i], threshold, useBitMask);
+		pOut[i] = coverage == ALPHA_COVERAGE::MIXED ? SampleAlpha(pU[i], pV[i], frame, 0) >= threshold : coverage == ALPHA_COVERAGE::ALL_OPAQUE;
+	}
+}
+
+bool VTFTexture::IsEnvmap() const
+{
+	return IsValid() && GetFaces() >= ENVMAP_FACES && mpHeader->width == mpHeader->height && mpHeader->depth <= 1;
+}
+
+VTFPixel VTFTexture::SampleCubeBilinear(float u, float v, uint8_t mipLevel, uint16_t frame, uint8_t face, bool decodeSRGB) const
+{
+	VTF_STATS(mpStats->RecordSample(mipLevel);)
+	return (decodeSRGB ? VTFParser::FilterBilinearSRGB : VTFParser::FilterBilinear)(
+		mpImageData + CalcSubimageOffset(mipLevel, frame, face), GetWidth(mipLevel), GetHeight(mipLevel), mpHeader->highResImageFormat,
+		true, true, u, v
+	);
+}
+
+VTFPixel VTFTexture::SampleCubeTrilinear(float x, float y, float z, float mipLevel, uint16_t frame, bool decodeSRGB) const
+{
+	if (!IsEnvmap() || mpImageData == nullptr || frame >= mpHeader->frames) return VTFPixel{};
+
+	float u, v;
+	const uint8_t face = Envmap::DirectionToFace(x, y, z, &u, &v);
+
+	mipLevel = std::clamp(mipLevel, 0.f, static_cast<float>(mpHeader->mipmapCount - 1));
+	if (IsPointSampled()) {
+		const uint8_t mip = static_cast<uint8_t>(mipLevel + 0.5f);
+
+		VTF_STATS(mpStats->RecordSample(mip);)
+		VTFPixel pixel = VTFParser::FilterNearest(
+			mpImageData + CalcSubimageOffset(mip, frame, face), GetWidth(mip), GetHeight(mip), mpHeader->highResImageFormat,
+			true, true, u, v
+		);
+		if (!decodeSRGB) return pixel;
+
+		const VTFUtil::ColourTables& tables = VTFUtil::GetColourTables();
+		return VTFPixel{ VTFUtil::DecodeSRGB(tables, pixel.r), VTFUtil::DecodeSRGB(tables, pixel.g), VTFUtil::DecodeSRGB(tables, pixel.b), pixel.a };
+	}
+
+	float mipHigh = floorf(mipLevel), mipLow = ceilf(mipLevel);
+
+	VTFPixel high = SampleCubeBilinear(u, v, mipHigh, frame, face, decodeSRGB);
+	if (mipLow == mipHigh) return high;
+
+	VTFPixel low = SampleCubeBilinear(u, v, mipLow, frame, face, decodeSRGB);
+
+	return VTFParser::LerpPixel(high, low, mipLevel - mipHigh);
+}
+
+VTFPixel VTFTexture::SampleCube(float x, float y, float z, float mipLevel, uint16_t frame) const
+{
+	return SampleCubeTrilinear(x, y, z, mipLevel, frame, false);
+}
+
+VTFPixel VTFTexture::SampleCubeLinear(float x, float y, float z, float mipLevel, uint16_t frame) const
+{
+	// Pre linearised data is already in linear space
+	return SampleCubeTrilinear(x, y, z, mipLevel, frame, IsSRGB() && !mIsLinearized);
+}
+
+bool VTFTexture::ReadEnvmapFace(uint8_t mipLevel, uint16_t frame, uint8_t face, std::vector<float>& out) const
+{
+	const uint16_t size = GetWidth(mipLevel);
+	out.resize(static_cast<size_t>(size) * size * 4);
+	if (!ReadRegion(mipLevel, frame, face, 0, 0, 0, size, size, PIXEL_FORMAT::RGBA32F, reinterpret_cast<uint8_t*>(out.data()), 0)) return false;
+
+	// Lighting is integrated in linear space
+	if (IsSRGB() && !mIsLinearized) {
+		const VTFUtil::ColourTables& tables = VTFUtil::GetColourTables();
+		for (size_t i = 0; i < out.size(); i += 4) {
+			for (int c = 0; c < 3; c++) out[i + c] = VTFUtil::DecodeSRGB(tables, out[i + c]);
+		}
+	}
+
+	return true;
+}
+
+bool VTFTexture::ProjectSH(uint8_t mipLevel, uint16_t frame, uint8_t order, Envmap::SH& out) const
+{
+	if (!IsEnvmap() || mpImageData == nullptr) return false;
+	if (mipLevel >= mpHeader->mipmapCount || frame >= mpHeader->frames || order < 1 || order > ENVMAP_MAX_SH_ORDER) return false;
+
+	const uint32_t size = GetWidth(mipLevel);
+	const size_t sumCount = static_cast<size_t>(order) * order * 3 + 1;
+
+	// Every row gets its own sums, added up in order at the end
+	std::vector<double> rowSums(ENVMAP_FACES * size * sumCount, 0.0);
+	std::vector<float> pixels;
+	for (uint8_t face = 0; face < ENVMAP_FACES; face++) {
+		if (!ReadEnvmapFace(mipLevel, frame, face, pixels)) return false;
+
+		VTFUtil::ParallelFor(size, std::max<size_t>((1 << 14) / size, 1), [&](size_t begin, size_t end) {
+			for (size_t y = begin; y < end; y++)
+				Envmap::ProjectRow(pixels.data() + y * size * 4, face, size, static_cast<uint32_t>(y), order, rowSums.data() + (face * size + y) * sumCount);
+		});
+	}
+
+	std::vector<double> sums(sumCount, 0.0);
+	for (size_t row = 0; row < static_cast<size_t>(ENVMAP_FACES) * size; row++) {
+		for (size_t i = 0; i < sumCount; i++) sums[i] += rowSums[row * sumCount + i];
+	}
+
+	out = Envmap::ResolveProjection(sums.data(), order);
+	return true;
+}
+
+bool VTFTexture::PrefilterEnvmap(const Envmap::PrefilterOptions& options, uint16_t frame, std::vector<float>& out) const
+{
+	if (!IsEnvmap() || mpImageData == nullptr || frame >= mpHeader->frames) return false;
+
+	// Read the smallest MIP that is still large enough
+	const uint16_t minSize = options.filter == Envmap::FILTER::GGX ? options.size : 32;
+	uint8_t mipLevel = 0;
+	while (mipLevel + 1 < mpHeader->mipmapCount && GetWidth(mipLevel + 1) >= minSize) mipLevel++;
+
+	Envmap::SH sh;
+	Envmap::Cube source;
+	std::vector<float> faces[ENVMAP_FACES];
+	if (options.filter == Envmap::FILTER::GGX) {
+		source.size = GetWidth(mipLevel);
+		for (uint8_t face = 0; face < ENVMAP_FACES; face++) {
+			if (!ReadEnvmapFace(mipLevel, frame, face, faces[face])) return false;
+			source.ppFaces[face] = faces[face].data();
+		}
+	} else if (!ProjectSH(mipLevel, frame, 3, sh)) {
+		return false;
+	}
+
+	out.resize(Envmap::CalcPrefilteredSize(options.size, options.levelCount));
+	return Envmap::Prefilter(source, sh, options, out.data());
+}
+
+bool VTFTexture::UnwrapEnvmap(const Envmap::UnwrapOptions& options, uint8_t mipLevel, uint16_t frame, float* pDst) const
+{
+	if (!IsEnvmap() || mpImageData == nullptr || pDst == nullptr) return false;
+	if (mipLevel >= mpHeader->mipmapCount || frame >= mpHeader->frames) return false;
+
+	Envmap::Cube source;
+	source.size = GetWidth(mipLevel);
+	std::vector<float> faces[ENVMAP_FACES];
+	for (uint8_t face = 0; face < ENVMAP_FACES; face++) {
+		if (!ReadEnvmapFace(mipLevel, frame, face, faces[face])) return false;
+		source.ppFaces[face] = faces[face].data();
+	}
+
+	return Envmap::Unwrap(source, options, pDst);
+}
+
+bool VTFTexture::UnwrapEnvmap(const Envmap::UnwrapOptions& options, uint8_t mipLevel, uint16_t frame, std::vector<float>& out) const
+{
+	out.resize(static_cast<size_t>(options.width) * options.height * 4);
+	return UnwrapEnvmap(options, mipLevel, frame, out.data());
+}
+
+VTFStats::Snapshot VTFTexture::GetStats() const
+{
+	if (mpStats == nullptr) return VTFStats::Snapshot{};
+
+	VTFStats::Snapshot snapshot = mpStats->Merge();
+	snapshot.bytesResident = GetMemoryStats().totalBytes;
+	return snapshot;
+}
+
+void VTFTexture::ResetStats()
+{
+	if (mpStats != nullptr) mpStats->Reset();
+}
@@ -1,19 +1,166 @@
 ﻿#pragma once
 
 #include "FileFormat/Structs.h"
+#include "AlphaMask/AlphaMask.h"
+#include "DXTn/DXTn.h"
+#include "Envmap/Envmap.h"
+#include "Mipmaps/Mipmaps.h"
+#include "Util/Stats.h"
+#include "Volume/Volume.h"
 
+#include <cstddef>
 #include <cstdint>
+#include <vector>
 
+/// <summary>
+/// Options controlling how a VTFTexture is loaded
+/// </summary>
+struct VTFLoadOptions
+{
+	bool headerOnly = false;        // Only parse the header (and thumbnail if present)
+
+	bool generateMipmaps = false;   // Generate any MIP levels missing from the full chain (8 bit per channel formats only)
+	Mipmaps::Options mipmapOptions; // Filtering of generated MIPs, sRGB, clamping and alpha coverage are also enabled by the texture's flags
+
+	bool linearizeSRGB = false;     // Decode PRE_SRGB textures to linear RGBA16161616 once at load, so SampleLinear doesn't decode per texel
+	                                // (doubles the memory of 8 bit formats, and every other accessor then returns linear values too)
+
+	bool brickVolumes = false;      // Also store each MIP of volumetric textures in 4x4x4 texel bricks, which Sample3D then reads from
+	                                // (adds the size of the image data again, GetImageData and GetPixel are unaffected)
+
+	NORMAL_SWIZZLE normalSwizzle = NORMAL_SWIZZLE::XYZ; // Channels SampleNormal reads the vector of NORMAL textures from
+	bool encodeNormals = false;     // Unpack NORMAL textures once at load into 4 byte octahedral vectors, which SampleNormal then reads from
+	                                // (no swizzling or z reconstruction per texel, adds 4 bytes per texel, GetImageData and GetPixel are unaffected)
+
+	bool buildAlphaMask = false;    // Build a bit mask and min/max pyramid of the largest MIP's alpha for 2D textures with alpha, which AlphaTest and ClassifyAlpha
+	                                // use to skip sampling opaque and transparent regions (DXT is read straight from its blocks, adds about 0.3 bytes per texel)
+	float alphaMaskThreshold = 0.5f; // Alpha test threshold the bit mask is built for, other thresholds only use the pyramid
+
+	bool sampleBlocks = false;      // Keep DXT, ATI1N and ATI2N 2D textures compressed and decode each texel as it's read, at an eighth (DXT1 and ATI1N)
+	                                // or a quarter of the memory of RGBA8888 (ignored if any option above has to rewrite or read back the pixels, GetImageData then returns the blocks)
+
+	bool transcodeToDXT = false;    // Encode 8 bit and smaller colour 2D textures to DXT1, or DXT5 if any texel isn't opaque, and keep the blocks as sampleBlocks does
+	                                // (lossy, see GetTranscodePSNR, skips normal maps, bluescreen and single channel formats, and anything sampleBlocks would be ignored for)
+	uint32_t transcodeMinPixels = 256 * 256; // Smallest largest MIP, in texels, worth transcoding
+	DXTn::QUALITY transcodeQuality = DXTn::QUALITY::RANGE_FIT; // Endpoint search of the encoder, BOUNDING_BOX is the fastest
+};
+
+/// <summary>
+/// Memory held by a VTFTexture, see VTFTexture::GetMemoryStats
+/// </summary>
+struct VTFMemoryStats
+{
+	/// <summary>
+	/// Size of one subimage (every z slice of a frame and face) of a MIP, every frame and face of a MIP being the same size
+	/// </summary>
+	struct Mip
+	{
+		size_t fileBytes = 0;   // In the file's format (compressed for DXT and ATI formats), 0 for MIPs generated at load
+		size_t loadedBytes = 0; // As loaded (decompressed, converted, or kept as blocks), 0 if the image data isn't resident
+		bool isResident = false;
+	};
+
+	bool isResident = false;      // Whether the image data is loaded, false for header only and invalid textures
+	uint8_t mipCount = 0;         // Number of entries of mips, largest MIP first
+	uint32_t subimagesPerMip = 0; // Frames times faces
+	Mip mips[VTF_MAX_MIPMAPS];
+
+	size_t headerBytes = 0;       // Heap allocated header (the VTFTexture object itself isn't counted)
+	size_t thumbnailBytes = 0;
+	size_t fileImageDataBytes = 0; // Every subimage of the MIPs in the file, in the file's format
+	size_t imageDataBytes = 0;    // Every resident subimage as loaded
+	size_t brickBytes = 0;        // See VTFLoadOptions::brickVolumes
+	size_t normalBytes = 0;       // See VTFLoadOptions::encodeNormals
+	size_t alphaMaskBytes = 0;    // See VTFLoadOptions::buildAlphaMask
+	size_t statsBytes = 0;        // Access counters, only allocated when built with VTFPARSER_STATS
+	size_t totalBytes = 0;        // Everything above except fileImageDataBytes
+};
+
+/// <summary>
+/// A loaded VTF and everything that reads it
+/// Const methods are safe to call from any number of threads at once on the same texture: nothing loaded is written after construction,
+/// and the only shared state they touch is lookup tables built once on first use and, with VTFPARSER_STATS, counters sharded per thread
+/// ReadRegion, ConvertTo, ProjectSH, PrefilterEnvmap and UnwrapEnvmap split large inputs across threads of their own
+/// Construction, destruction and ResetStats must not overlap other calls on the same texture
+/// </summary>
 class VTFTexture
 {
 private:
 	VTFHeader* mpHeader;
-	uint8_t* mpImageData;
-	uint32_t mImageDataSize = 0;
+	uint8_t* mpImageData = nullptr;
+	size_t mImageDataSize = 0;
+
+	// Format and MIP count of the image data in the file, before any decompression, conversion or generated MIPs
+	IMAGE_FORMAT mFileImageFormat = IMAGE_FORMAT::NONE;
+	uint8_t mFileMipCount = 0;
+
+	// Offset of each MIP's first subimage and size of one face, so a subimage offset is a lookup and a multiply
+	// Only offsets of subimages are 64 bit, texels within one are addressed with 32 bit indices
+	size_t mMipOffsets[VTF_MAX_MIPMAPS] = {};
+	size_t mFaceSizes[VTF_MAX_MIPMAPS] = {};
+
+	uint8_t* mpThumbnailData = nullptr;
+
+	// Bricked copy of volumetric image data, MIPs largest first then frames, see VTFLoadOptions::brickVolumes
+	uint8_t* mpBrickData = nullptr;
+	size_t mBrickDataSize = 0;
+	size_t mBrickMipOffsets[VTF_MAX_MIPMAPS] = {};
+
+	// Octahedral encoded copy of a normal map's image data, one per texel at the same texel index, see VTFLoadOptions::encodeNormals
+	uint32_t* mpNormalData = nullptr;
+	NORMAL_SWIZZLE mNormalSwizzle = NORMAL_SWIZZLE::XYZ;
+
+	// Alpha bounds of the largest MIP of each frame then face, mAlphaMaskLayout.size bytes each, see VTFLoadOptions::buildAlphaMask
+	uint8_t* mpAlphaMaskData = nullptr;
+	AlphaMask::Layout mAlphaMaskLayout;
+	float mAlphaMaskThreshold = 0.5f;
+
+	// Only allocated when built with VTFPARSER_STATS, always declared so the layout doesn't depend on the define
+	VTFStats::Counters* mpStats = nullptr;
 
 	bool mIsValid = false;
+	bool mIsResident = false;        // Whether the image data was loaded (false for header only textures and their copies)
+	bool mIsLinearized = false;
+	bool mIsBlockCompressed = false; // See VTFLoadOptions::sampleBlocks
+	bool mIsTranscoded = false;      // See VTFLoadOptions::transcodeToDXT
+	float mTranscodePSNR = 0.f;
+
+	void LoadThumbnail(const uint8_t* pData, size_t size);
+	bool ConvertToRGBA8888();
+	bool GenerateMissingMipmaps(Mipmaps::Options options);
+	bool LinearizeSRGB();
+	bool BrickVolumes();
+	bool EncodeNormals();
+	bool BuildAlphaMask(const uint8_t* pCompressedImageData, float threshold);
+	bool TranscodeToDXT(DXTn::QUALITY quality);
+
+	void CalcSubimageOffsets();
+	size_t CalcSubimageOffset(uint8_t mipLevel, uint16_t frame, uint8_t face) const;
+
+	bool IsClampedX() const; // CLAMPS, the header must be present
+	bool IsClampedY() const; // CLAMPT
+	bool IsClampedZ() const; // CLAMPU
+
+	VTFPixel SampleBilinear(float u, float v, uint16_t z, uint8_t mipLevel, uint16_t frame, uint8_t face, bool decodeSRGB) const;
+	VTFPixel SampleTrilinear(float u, float v, uint16_t z, float mipLevel, uint16_t frame, uint8_t face, bool decodeSRGB) const;
+	VTFPixel SampleNearestMip(float u, float v, uint16_t z, float mipLevel, uint16_t frame, uint8_t face, bool decodeSRGB) const;
 
-	VTFPixel SampleBilinear(float u, float v, uint16_t z, uint8_t mipLevel, uint16_t frame, uint8_t face) const;
+	void CalcAnimationFrames(float time, float fps, bool interpolate, uint16_t* pFrame, uint16_t* pNextFrame, float* pBlend) const;
+	VTFPixel SampleAnimatedTrilinear(float u, float v, float mipLevel, uint16_t frame, uint16_t nextFrame, float blend) const;
+
+	Volume::Image GetVolumeImage(uint8_t mipLevel, uint16_t frame) const;
+	VTFPixel SampleVolume(float u, float v, float w, uint8_t mipLevel, uint16_t frame) const;
+	VTFPixel SampleVolumeNearestMip(float u, float v, float w, float mipLevel, uint16_t frame) const;
+
+	VTFNormal SampleNormalBilinear(float u, float v, uint16_t z, uint8_t mipLevel, uint16_t frame, uint8_t face) const;
+	VTFNormal SampleNormalNearest(float u, float v, uint16_t z, uint8_t mipLevel, uint16_t frame, uint8_t face) const;
+
+	AlphaMask::Image GetAlphaMaskImage(uint16_t frame, uint8_t face) const;
+	float SampleAlpha(float u, float v, uint16_t frame, uint8_t face) const;
+
+	VTFPixel SampleCubeBilinear(float u, float v, uint8_t mipLevel, uint16_t frame, uint8_t face, bool decodeSRGB) const;
+	VTFPixel SampleCubeTrilinear(float x, float y, float z, float mipLevel, uint16_t frame, bool decodeSRGB) const;
+	bool ReadEnvmapFace(uint8_t mipLevel, uint16_t frame, uint8_t face, std::vector<float>& out) const;
 
 public:
 	/// <summary>
@@ -21,9 +168,17 @@ public:
 	/// </summary>
 	/// <param name="pData">Pointer to char buffer that represents a VTF image</param>
 	/// <param name="size">Size of the buffer</param>
-	/// <param name="headerOnly">Whether to just parse the header or not (default: false)</param>
+	/// <param name="headerOnly">Whether to just parse the header (and thumbnail if present) or not (default: false)</param>
 	VTFTexture(const uint8_t* pData, size_t size, bool headerOnly = false);
 
+	/// <summary>
+	/// VTFTexture class
+	/// </summary>
+	/// <param name="pData">Pointer to char buffer that represents a VTF image</param>
+	/// <param name="size">Size of the buffer</param>
+	/// <param name="options">Options controlling how the texture is loaded</param>
+	VTFTexture(const uint8_t* pData, size_t size, const VTFLoadOptions& options);
+
 	~VTFTexture();
 
 	/// <summary>
@@ -74,6 +229,91 @@ public:
 	uint16_t GetFrames() const;
 	uint16_t GetFirstFrame() const;
 
+	/// <summary>
+	/// Gets the TEXTURE_FLAGS of the image
+	/// </summary>
+	/// <returns>Bitwise or of TEXTURE_FLAGS</returns>
+	uint32_t GetFlags() const;
+
+	/// <summary>
+	/// Gets the format the image data is stored in after loading
+	/// (block compressed formats are decompressed to RGBA8888, unless VTFLoadOptions::sampleBlocks kept them compressed)
+	/// </summary>
+	/// <returns>Format of the data returned by GetImageData</returns>
+	IMAGE_FORMAT GetImageFormat() const;
+
+	/// <summary>
+	/// Returns whether the image data was kept block compressed at load (see VTFLoadOptions::sampleBlocks)
+	/// </summary>
+	bool IsBlockCompressed() const;
+
+	/// <summary>
+	/// Returns whether the image data was encoded to DXT at load (see VTFLoadOptions::transcodeToDXT)
+	/// </summary>
+	bool IsTranscoded() const;
+
+	/// <summary>
+	/// Gets the peak signal to noise ratio of the transcoded image data against the pixels it was encoded from,
+	/// over every texel of every subimage and the channels the format stores (RGB for DXT1, RGBA for DXT5)
+	/// </summary>
+	/// <returns>PSNR in decibels, infinity if the encoding was lossless, or 0 if the texture wasn't transcoded</returns>
+	float GetTranscodePSNR() const;
+
+	/// <summary>
+	/// Gets the loaded image data, laid out as in the file (MIPs smallest to largest, then frames, faces and z slices)
+	/// </summary>
+	/// <returns>Readonly pointer to the image data, or nullptr if the texture is invalid or header only</returns>
+	const uint8_t* GetImageData() const;
+
+	size_t GetImageDataSize() const;
+
+	/// <summary>
+	/// Gets the offset of a subimage (every z slice of a MIP, frame and face) in the image data
+	/// </summary>
+	/// <param name="mipLevel">MIP level of the subimage</param>
+	/// <param name="frame">Frame of the subimage</param>
+	/// <param name="face">Face of the subimage</param>
+	/// <returns>Offset in bytes from GetImageData</returns>
+	size_t GetSubimageOffset(uint8_t mipLevel, uint16_t frame, uint8_t face) const;
+
+	/// <summary>
+	/// Gets the memory held by the texture, per MIP in the file's format and as loaded, and per structure built at load
+	/// Only reads sizes kept since load, so it's cheap enough to call every frame (e.g. by a streaming budget)
+	/// Loaded textures hold every subimage for their whole lifetime, so each MIP is resident exactly when the image data is
+	/// </summary>
+	/// <returns>VTFMemoryStats struct, with only the header and counters if the header couldn't be parsed</returns>
+	VTFMemoryStats GetMemoryStats() const;
+
+	/// <summary>
+	/// Copies a rectangle of one z slice of a subimage into a buffer, converting every pixel to the given layout
+	/// (identical to GetPixel per pixel, but swizzled and widened in bulk with SSE2 where possible, on multiple threads for large regions)
+	/// </summary>
+	/// <param name="mipLevel">MIP level to read</param>
+	/// <param name="frame">Frame of the image (animated textures only)</param>
+	/// <param name="face">Face of the image (envmaps only)</param>
+	/// <param name="z">Z slice to read (volumetric textures only)</param>
+	/// <param name="x">Left edge of the region</param>
+	/// <param name="y">Top edge of the region</param>
+	/// <param name="width">Width of the region</param>
+	/// <param name="height">Height of the region</param>
+	/// <param name="format">Layout to convert the pixels to</param>
+	/// <param name="pDst">Buffer of height rows to write to</param>
+	/// <param name="dstPitch">Bytes between the starts of rows in the buffer, or 0 for tightly packed rows</param>
+	/// <returns>Whether the region is inside the subimage and the buffer was written</returns>
+	bool ReadRegion(
+		uint8_t mipLevel, uint16_t frame, uint8_t face, uint16_t z,
+		uint16_t x, uint16_t y, uint16_t width, uint16_t height,
+		PIXEL_FORMAT format, uint8_t* pDst, size_t dstPitch
+	) const;
+
+	/// <summary>
+	/// Converts all of the image data to the given layout, keeping the layout of GetImageData (MIPs smallest to largest, then frames, faces and z slices)
+	/// </summary>
+	/// <param name="format">Layout to convert the pixels to</param>
+	/// <param name="out">Vector to replace the contents of with the converted pixels</param>
+	/// <returns>Whether the texture has image data to convert</returns>
+	bool ConvertTo(PIXEL_FORMAT format, std::vector<uint8_t>& out) const;
+
 	/// <summary>
 	/// Gets a pixel from the image at the specified coordinate, MIP level, frame, and face
 	/// </summary>
@@ -113,6 +353,7 @@ public:
 
 	/// <summary>
 	/// Samples the texture at a given uv and performs filtering
+	/// Textures with the POINTSAMPLE flag are point sampled instead (see SampleNearest)
 	/// </summary>
 	/// <param name="u">U coordinate</param>
 	/// <param name="v">V coordinate</param>
@@ -147,4 +388,458 @@ public:
 	{
 		return Sample(u, v, mipLevel, 0);
 	}
+
+	/// <summary>
+	/// Hints that Sample, SampleLinear or SampleNearest is about to be called with the same arguments, prefetching the cache lines it will read
+	/// Calling this for a batch of lookups before sampling any of them overlaps their cache misses instead of waiting on each in turn
+	/// (nothing is read or recorded in the stats, and out of range frames, faces and slices are ignored)
+	/// </summary>
+	/// <param name="u">U coordinate</param>
+	/// <param name="v">V coordinate</param>
+	/// <param name="z">Coordinate of the pixel on the z axis (volumetric textures only)</param>
+	/// <param name="mipLevel">MIP level that will be read</param>
+	/// <param name="frame">Frame of the image (animated textures only)</param>
+	/// <param name="face">Face of the image (envmaps only)</param>
+	void Prefetch(float u, float v, uint16_t z, float mipLevel, uint16_t frame, uint8_t face) const;
+
+	/// <summary>
+	/// Hints that a standard 2D texture is about to be sampled at a given uv
+	/// </summary>
+	/// <param name="u">U coordinate</param>
+	/// <param name="v">V coordinate</param>
+	/// <param name="mipLevel">MIP level that will be read</param>
+	inline void Prefetch(float u, float v, float mipLevel) const
+	{
+		Prefetch(u, v, 0, mipLevel, 0, 0);
+	}
+
+	/// <summary>
+	/// Returns whether the texture should be point sampled (the POINTSAMPLE flag), which Sample and SampleLinear then do
+	/// </summary>
+	bool IsPointSampled() const;
+
+	/// <summary>
+	/// Samples the texture at a given uv without filtering, fetching the single texel containing it from the nearest MIP level
+	/// Much cheaper than Sample, for pixel art, UI and lookup textures regardless of their flags
+	/// </summary>
+	/// <param name="u">U coordinate</param>
+	/// <param name="v">V coordinate</param>
+	/// <param name="z">Coordinate of the pixel on the z axis (volumetric textures only)</param>
+	/// <param name="mipLevel">MIP level to read (rounded to the nearest level)</param>
+	/// <param name="frame">Frame of the image (animated textures only)</param>
+	/// <param name="face">Face of the image (envmaps only)</param>
+	/// <returns>VTFPixel struct with the pixel data</returns>
+	VTFPixel SampleNearest(float u, float v, uint16_t z, float mipLevel, uint16_t frame, uint8_t face) const;
+
+	/// <summary>
+	/// Samples a standard 2D texture at a given uv without filtering
+	/// </summary>
+	/// <param name="u">U coordinate</param>
+	/// <param name="v">V coordinate</param>
+	/// <param name="mipLevel">MIP level to read (rounded to the nearest level)</param>
+	/// <returns>VTFPixel struct with the pixel data</returns>
+	inline VTFPixel SampleNearest(float u, float v, float mipLevel) const
+	{
+		return SampleNearest(u, v, 0, mipLevel, 0, 0);
+	}
+
+	/// <summary>
+	/// Samples many uvs of a 2D texture at once without filtering, identical to calling SampleNearest for each
+	/// Texel indices are computed 4 lanes at a time with SSE2, and every texel of a chunk of lanes is prefetched before any is read
+	/// </summary>
+	/// <param name="pU">Array of count U coordinates</param>
+	/// <param name="pV">Array of count V coordinates</param>
+	/// <param name="mipLevel">MIP level to read for every lane (rounded to the nearest level)</param>
+	/// <param name="frame">Frame of the image for every lane</param>
+	/// <param name="count">Number of lanes</param>
+	/// <param name="pOut">Array of count pixels to populate</param>
+	void SampleNearestBatch(const float* pU, const float* pV, float mipLevel, uint16_t frame, size_t count, VTFPixel* pOut) const;
+
+	/// <summary>
+	/// Returns whether the colour channels are sRGB encoded (the PRE_SRGB flag)
+	/// </summary>
+	bool IsSRGB() const;
+
+	/// <summary>
+	/// Returns whether an sRGB texture was decoded to linear at load (see VTFLoadOptions::linearizeSRGB)
+	/// </summary>
+	bool IsLinearized() const;
+
+	/// <summary>
+	/// Samples the texture at a given uv and performs filtering in linear space
+	/// Texels of sRGB textures are decoded through a lookup table before filtering, so the result is linear
+	/// (Sample filters the stored values directly); other textures sample identically to Sample
+	/// </summary>
+	/// <param name="u">U coordinate</param>
+	/// <param name="v">V coordinate</param>
+	/// <param name="z">Coordinate of the pixel on the z axis (volumetric textures only)</param>
+	/// <param name="mipLevel">MIP level to read</param>
+	/// <param name="frame">Frame of the image (animated textures only)</param>
+	/// <param name="face">Face of the image (envmaps only)</param>
+	/// <returns>VTFPixel struct with the linear pixel data</returns>
+	VTFPixel SampleLinear(float u, float v, uint16_t z, float mipLevel, uint16_t frame, uint8_t face) const;
+
+	/// <summary>
+	/// Samples a standard 2D texture at a given uv and performs filtering in linear space
+	/// </summary>
+	/// <param name="u">U coordinate</param>
+	/// <param name="v">V coordinate</param>
+	/// <param name="mipLevel">MIP level to read</param>
+	/// <returns>VTFPixel struct with the linear pixel data</returns>
+	inline VTFPixel SampleLinear(float u, float v, float mipLevel) const
+	{
+		return SampleLinear(u, v, 0, mipLevel, 0, 0);
+	}
+
+	/// <summary>
+	/// Samples an animated 2D texture at a given uv and time, looping from the first frame (GetFirstFrame) through every frame
+	/// The texel offsets are computed once and fetched from both frames when interpolating
+	/// Textures with the POINTSAMPLE flag fetch the nearest texel of the nearest MIP from each frame instead
+	/// </summary>
+	/// <param name="u">U coordinate</param>
+	/// <param name="v">V coordinate</param>
+	/// <param name="mipLevel">MIP level to read</param>
+	/// <param name="time">Time in seconds, may be negative</param>
+	/// <param name="fps">Frames per second of the animation</param>
+	/// <param name="interpolate">Blend linearly between the current and next frame instead of holding each frame</param>
+	/// <returns>VTFPixel struct with the pixel data</returns>
+	VTFPixel SampleAnimated(float u, float v, float mipLevel, float time, float fps, bool interpolate) const;
+
+	/// <summary>
+	/// Samples many lanes of an animated 2D texture at once, each with its own time (e.g. motion blur samples)
+	/// Lanes are done in chunks, prefetching every texel of a chunk (see Prefetch) before sampling any of it
+	/// </summary>
+	/// <param name="pU">Array of count U coordinates</param>
+	/// <param name="pV">Array of count V coordinates</param>
+	/// <param name="pMipLevels">Array of count MIP levels, or nullptr to sample the largest MIP</param>
+	/// <param name="pTimes">Array of count times in seconds</param>
+	/// <param name="fps">Frames per second of the animation</param>
+	/// <param name="interpolate">Blend linearly between the current and next frame instead of holding each frame</param>
+	/// <param name="count">Number of lanes</param>
+	/// <param name="pOut">Array of count pixels to populate</param>
+	void SampleAnimatedBatch(
+		const float* pU, const float* pV, const float* pMipLevels, const float* pTimes,
+		float fps, bool interpolate, size_t count, VTFPixel* pOut
+	) const;
+
+	/// <summary>
+	/// Returns whether volumetric image data was also stored in bricks at load (see VTFLoadOptions::brickVolumes)
+	/// </summary>
+	bool IsBricked() const;
+
+	/// <summary>
+	/// Samples a volumetric texture at a given uvw, blending the 8 texels around it on each MIP level (and the 2 nearest MIPs)
+	/// Wraps or clamps each axis according to the CLAMPS, CLAMPT and CLAMPU flags; 2D textures sample as a single slice
+	/// Textures with the POINTSAMPLE flag fetch the texel containing the uvw from the nearest MIP instead
+	/// </summary>
+	/// <param name="u">U coordinate</param>
+	/// <param name="v">V coordinate</param>
+	/// <param name="w">W coordinate</param>
+	/// <param name="mipLevel">MIP level to read</param>
+	/// <param name="frame">Frame of the image (animated textures only)</param>
+	/// <returns>VTFPixel struct with the pixel data</returns>
+	VTFPixel Sample3D(float u, float v, float w, float mipLevel, uint16_t frame) const;
+
+	/// <summary>
+	/// Samples a volumetric texture at a given uvw and performs filtering
+	/// </summary>
+	/// <param name="u">U coordinate</param>
+	/// <param name="v">V coordinate</param>
+	/// <param name="w">W coordinate</param>
+	/// <param name="mipLevel">MIP level to read</param>
+	/// <returns>VTFPixel struct with the pixel data</returns>
+	inline VTFPixel Sample3D(float u, float v, float w, float mipLevel) const
+	{
+		return Sample3D(u, v, w, mipLevel, 0);
+	}
+
+	/// <summary>
+	/// Samples many uvws at once, identical to calling Sample3D for each (e.g. a colour grading LUT lookup per pixel)
+	/// Texel coordinates and weights are computed 4 lanes at a time with SSE2, and texels are prefetched a chunk of lanes ahead of filtering
+	/// </summary>
+	/// <param name="pU">Array of count U coordinates</param>
+	/// <param name="pV">Array of count V coordinates</param>
+	/// <param name="pW">Array of count W coordinates</param>
+	/// <param name="mipLevel">MIP level to read for every lane</param>
+	/// <param name="frame">Frame of the image for every lane</param>
+	/// <param name="count">Number of lanes</param>
+	/// <param name="pOut">Array of count pixels to populate</param>
+	void Sample3DBatch(const float* pU, const float* pV, const float* pW, float mipLevel, uint16_t frame, size_t count, VTFPixel* pOut) const;
+
+	/// <summary>
+	/// Returns whether the texture is a tangent space normal map (the NORMAL flag)
+	/// </summary>
+	bool IsNormalMap() const;
+
+	/// <summary>
+	/// Returns whether the texture is a self shadowing bumpmap (the SSBUMP flag), which stores the weight of 3 fixed basis vectors per texel
+	/// </summary>
+	bool IsSSBump() const;
+
+	/// <summary>
+	/// Returns whether a normal map was unpacked to octahedral vectors at load (see VTFLoadOptions::encodeNormals)
+	/// </summary>
+	bool HasEncodedNormals() const;
+
+	/// <summary>
+	/// Samples the texture as a normal map at a given uv, unpacking each texel to a -1 to 1 vector (see VTFLoadOptions::normalSwizzle)
+	/// before filtering and renormalising the result, so callers don't unpack per tap
+	/// SSBUMP textures instead return the filtered weights of their 3 basis vectors in x, y and z (not unpacked or normalised)
+	/// Textures with the POINTSAMPLE flag unpack only the texel containing the uv from the nearest MIP instead
+	/// </summary>
+	/// <param name="u">U coordinate</param>
+	/// <param name="v">V coordinate</param>
+	/// <param name="z">Coordinate of the pixel on the z axis (volumetric textures only)</param>
+	/// <param name="mipLevel">MIP level to read</param>
+	/// <param name="frame">Frame of the image (animated textures only)</param>
+	/// <param name="face">Face of the image (envmaps only)</param>
+	/// <returns>VTFNormal struct with the unit tangent space vector (+z where the filtered vector has no length), or the basis weights</returns>
+	VTFNormal SampleNormal(float u, float v, uint16_t z, float mipLevel, uint16_t frame, uint8_t face) const;
+
+	/// <summary>
+	/// Samples a standard 2D normal map at a given uv (see above)
+	/// </summary>
+	/// <param name="u">U coordinate</param>
+	/// <param name="v">V coordinate</param>
+	/// <param name="mipLevel">MIP level to read</param>
+	/// <returns>VTFNormal struct with the unit tangent space vector, or the basis weights of SSBUMP textures</returns>
+	inline VTFNormal SampleNormal(float u, float v, float mipLevel) const
+	{
+		return SampleNormal(u, v, 0, mipLevel, 0, 0);
+	}
+
+	/// <summary>
+	/// Returns whether alpha bounds were built at load (see VTFLoadOptions::buildAlphaMask)
+	/// </summary>
+	bool HasAlphaMask() const;
+
+	/// <summary>
+	/// Classifies the alpha test of the lookup at a uv of the largest MIP without sampling it, from the bounds of its block
+	/// and, if the threshold is VTFLoadOptions::alphaMaskThreshold, the bit mask of its taps
+	/// </summary>
+	/// <param name="u">U coordinate</param>
+	/// <param name="v">V coordinate</param>
+	/// <param name="threshold">Alpha at or above which a sample passes</param>
+	/// <param name="frame">Frame of the image (animated textures only)</param>
+	/// <param name="face">Face of the image (envmaps only)</param>
+	/// <returns>Whether the lookup passes, fails, or has to be sampled (always MIXED without an alpha mask)</returns>
+	ALPHA_COVERAGE ClassifyAlpha(float u, float v, float threshold, uint16_t frame, uint8_t face) const;
+
+	/// <summary>
+	/// Classifies the alpha test of every lookup of the largest MIP inside a rectangle of uvs, e.g. a ray's footprint, from the min/max pyramid
+	/// </summary>
+	/// <param name="uMin">Lowest U coordinate</param>
+	/// <param name="vMin">Lowest V coordinate</param>
+	/// <param name="uMax">Highest U coordinate</param>
+	/// <param name="vMax">Highest V coordinate</param>
+	/// <param name="threshold">Alpha at or above which a sample passes</param>
+	/// <param name="frame">Frame of the image (animated textures only)</param>
+	/// <param name="face">Face of the image (envmaps only)</param>
+	/// <returns>Whether every lookup passes, fails, or they have to be sampled (always MIXED without an alpha mask)</returns>
+	ALPHA_COVERAGE ClassifyAlpha(float uMin, float vMin, float uMax, float vMax, float threshold, uint16_t frame, uint8_t face) const;
+
+	/// <summary>
+	/// Tests the alpha of the largest MIP at a uv against a threshold, identical to comparing the alpha of Sample at MIP 0,
+	/// but only samples where ClassifyAlpha can't tell
+	/// </summary>
+	/// <param name="u">U coordinate</param>
+	/// <param name="v">V coordinate</param>
+	/// <param name="threshold">Alpha at or above which the test passes</param>
+	/// <param name="frame">Frame of the image (animated textures only)</param>
+	/// <param name="face">Face of the image (envmaps only)</param>
+	/// <returns>Whether the sampled alpha is at or above the threshold</returns>
+	bool AlphaTest(float u, float v, float threshold, uint16_t frame, uint8_t face) const;
+
+	/// <summary>
+	/// Tests the alpha of a standard 2D texture at a uv against a threshold (see above)
+	/// </summary>
+	/// <param name="u">U coordinate</param>
+	/// <param name="v">V coordinate</param>
+	/// <param name="threshold">Alpha at or above which the test passes</param>
+	/// <returns>Whether the sampled alpha is at or above the threshold</returns>
+	inline bool AlphaTest(float u, float v, float threshold) const
+	{
+		return AlphaTest(u, v, threshold, 0, 0);
+	}
+
+	/// <summary>
+	/// Alpha tests many uvs of one frame at once, identical to calling AlphaTest for each
+	/// </summary>
+	/// <param name="pU">Array of count U coordinates</param>
+	/// <param name="pV">Array of count V coordinates</param>
+	/// <param name="threshold">Alpha at or above which a test passes</param>
+	/// <param name="frame">Frame of the image for every lane</param>
+	/// <param name="count">Number of lanes</param>
+	/// <param name="pOut">Array of count results to populate</param>
+	void AlphaTestBatch(const float* pU, const float* pV, float threshold, uint16_t frame, size_t count, bool* pOut) const;
+
+	/// <summary>
+	/// Returns whether the texture is a cubemap envmap (6 or 7 square faces), which SampleCube, SampleCubeLinear, ProjectSH, PrefilterEnvmap and UnwrapEnvmap read
+	/// </summary>
+	bool IsEnvmap() const;
+
+	/// <summary>
+	/// Samples an envmap in a direction and performs filtering, see Envmap for the orientation of the faces
+	/// Each face is filtered on its own and clamped at its edges, regardless of the CLAMPS and CLAMPT flags
+	/// The stored values are filtered directly, so sRGB envmaps are not linearised (see SampleCubeLinear)
+	/// Textures with the POINTSAMPLE flag fetch the texel containing the direction from the nearest MIP instead
+	/// </summary>
+	/// <param name="x">X component of the direction (doesn't need to be normalised)</param>
+	/// <param name="y">Y component of the direction</param>
+	/// <param name="z">Z component of the direction</param>
+	/// <param name="mipLevel">MIP level to read (e.g. roughness times the last MIP of a chain from PrefilterEnvmap)</param>
+	/// <param name="frame">Frame of the image (animated textures only)</param>
+	/// <returns>VTFPixel struct with the pixel data, or an empty pixel if the texture isn't an envmap</returns>
+	VTFPixel SampleCube(float x, float y, float z, float mipLevel, uint16_t frame) const;
+
+	/// <summary>
+	/// Samples an envmap in a direction and performs filtering
+	/// </summary>
+	/// <param name="x">X component of the direction (doesn't need to be normalised)</param>
+	/// <param name="y">Y component of the direction</param>
+	/// <param name="z">Z component of the direction</param>
+	/// <param name="mipLevel">MIP level to read</param>
+	/// <returns>VTFPixel struct with the pixel data</returns>
+	inline VTFPixel SampleCube(float x, float y, float z, float mipLevel) const
+	{
+		return SampleCube(x, y, z, mipLevel, 0);
+	}
+
+	/// <summary>
+	/// Samples an envmap in a direction and performs filtering in linear space
+	/// Texels of sRGB envmaps are decoded before filtering, as ProjectSH, PrefilterEnvmap and UnwrapEnvmap read them;
+	/// other envmaps sample identically to SampleCube
+	/// </summary>
+	/// <param name="x">X component of the direction (doesn't need to be normalised)</param>
+	/// <param name="y">Y component of the direction</param>
+	/// <param name="z">Z component of the direction</param>
+	/// <param name="mipLevel">MIP level to read</param>
+	/// <param name="frame">Frame of the image (animated textures only)</param>
+	/// <returns>VTFPixel struct with the linear pixel data, or an empty pixel if the texture isn't an envmap</returns>
+	VTFPixel SampleCubeLinear(float x, float y, float z, float mipLevel, uint16_t frame) const;
+
+	/// <summary>
+	/// Samples an envmap in a direction and performs filtering in linear space
+	/// </summary>
+	/// <param name="x">X component of the direction (doesn't need to be normalised)</param>
+	/// <param name="y">Y component of the direction</param>
+	/// <param name="z">Z component of the direction</param>
+	/// <param name="mipLevel">MIP level to read</param>
+	/// <returns>VTFPixel struct with the linear pixel data</returns>
+	inline VTFPixel SampleCubeLinear(float x, float y, float z, float mipLevel) const
+	{
+		return SampleCubeLinear(x, y, z, mipLevel, 0);
+	}
+
+	/// <summary>
+	/// Projects a MIP of an envmap onto spherical harmonics, weighting each texel by its solid angle (in linear space, sRGB envmaps are decoded first)
+	/// Rows of each face are accumulated with SSE2 across threads and summed in a fixed order, so the result doesn't depend on the thread count
+	/// Evaluate the result with Envmap::EvalIrradiance for diffuse lighting in O(1) per shading point
+	/// </summary>
+	/// <param name="mipLevel">MIP level to project, order 3 only holds low frequencies so a small MIP (e.g. 32x32) is as accurate and much cheaper</param>
+	/// <param name="frame">Frame of the image (animated textures only)</param>
+	/// <param name="order">Number of bands, 2 (4 coefficients) or 3 (9 coefficients)</param>
+	/// <param name="out">Coefficients to populate</param>
+	/// <returns>Whether the texture is an envmap with image data and the arguments are valid</returns>
+	bool ProjectSH(uint8_t mipLevel, uint16_t frame, uint8_t order, Envmap::SH& out) const;
+
+	/// <summary>
+	/// Builds a small chain of prefiltered irradiance or GGX faces from an envmap (in linear space), so diffuse and glossy lookups are one SampleCube each
+	/// GGX reads the smallest MIP at least options.size wide, irradiance projects the smallest MIP at least 32 wide onto order 3 spherical harmonics
+	/// Write the result with a VTFWriter in RGBA32323232F to keep HDR values, and load it back to sample it
+	/// </summary>
+	/// <param name="options">Size and filter of the chain</param>
+	/// <param name="frame">Frame of the image (animated textures only)</param>
+	/// <param name="out">Vector to replace the contents of with float RGBA faces, largest level first then faces (as VTFWriter::SetImage takes them)</param>
+	/// <returns>Whether the texture is an envmap with image data and the options are valid</returns>
+	bool PrefilterEnvmap(const Envmap::PrefilterOptions& options, uint16_t frame, std::vector<float>& out) const;
+
+	/// <summary>
+	/// Resamples a MIP of an envmap into one equirectangular or octahedral image (in linear space, sRGB envmaps are decoded first), see Envmap::Unwrap
+	/// 6 and 7 face envmaps are read alike, the spheremap face is never used
+	/// Write the result with a VTFWriter in RGBA32323232F as a single face to load it back as a 2D VTFTexture
+	/// </summary>
+	/// <param name="options">Layout, size and filter of the image</param>
+	/// <param name="mipLevel">MIP level to read, box filtering reads every texel under each output texel so a MIP near the output's size is cheapest</param>
+	/// <param name="frame">Frame of the image (animated textures only)</param>
+	/// <param name="pDst">Buffer of options.width * options.height * 4 floats to write RGBA rows to</param>
+	/// <returns>Whether the texture is an envmap with image data and the arguments are valid</returns>
+	bool UnwrapEnvmap(const Envmap::UnwrapOptions& options, uint8_t mipLevel, uint16_t frame, float* pDst) const;
+
+	/// <summary>
+	/// Resamples a MIP of an envmap into one equirectangular or octahedral image
+	/// </summary>
+	/// <param name="options">Layout, size and filter of the image</param>
+	/// <param name="mipLevel">MIP level to read</param>
+	/// <param name="frame">Frame of the image (animated textures only)</param>
+	/// <param name="out">Vector to replace the contents of with float RGBA rows (as VTFWriter::SetImage takes them)</param>
+	/// <returns>Whether the texture is an envmap with image data and the arguments are valid</returns>
+	bool UnwrapEnvmap(const Envmap::UnwrapOptions& options, uint8_t mipLevel, uint16_t frame, std::vector<float>& out) const;
+
+	/// <summary>
+	/// Returns whether the low resolution thumbnail was present and decoded
+	/// The thumbnail only needs the data up to the end of the low res image resource, so a header only texture
+	/// can be constructed from a partial read (see VTFResources for the offset and size of the resource)
+	/// </summary>
+	/// <returns>True if the thumbnail is available</returns>
+	bool HasThumbnail() const;
+
+	uint8_t GetThumbnailWidth() const;
+	uint8_t GetThumbnailHeight() const;
+
+	/// <summary>
+	/// Gets the decoded thumbnail
+	/// </summary>
+	/// <returns>Readonly pointer to RGBA8888 pixel data, or nullptr if there is no thumbnail</returns>
+	const uint8_t* GetThumbnail() const;
+
+	/// <summary>
+	/// Samples the thumbnail at a given uv and performs filtering
+	/// </summary>
+	/// <param name="u">U coordinate</param>
+	/// <param name="v">V coordinate</param>
+	/// <returns>VTFPixel struct with the pixel data</returns>
+	VTFPixel SampleThumbnail(float u, float v) const;
+
+	/// <summary>
+	/// Gets the precomputed reflectivity vector stored in the header
+	/// </summary>
+	/// <returns>VTFPixel struct with the reflectivity in rgb</returns>
+	VTFPixel GetReflectivity() const;
+
+	float GetBumpmapScale() const;
+
+	/// <summary>
+	/// Computes the average colour of a subimage (including every z slice of volumetric textures)
+	/// Cost is linear in the size of the MIP level (kept blocks are averaged from their palettes, without decompressing),
+	/// so pass the smallest MIP that is sufficient for the query, or let EstimateAverage pick one
+	/// </summary>
+	/// <param name="mipLevel">MIP level to average</param>
+	/// <param name="frame">Frame of the image (animated textures only)</param>
+	/// <param name="face">Face of the image (envmaps only)</param>
+	/// <returns>VTFPixel struct with the average colour</returns>
+	VTFPixel ComputeAverage(uint8_t mipLevel, uint16_t frame, uint8_t face) const;
+
+	/// <summary>
+	/// Averages the largest MIP with at most texelBudget texels (or the smallest MIP if none fit) with ComputeAverage
+	/// Exact for box filtered chains, other filters and missing MIPs make it an approximation of the full resolution average
+	/// </summary>
+	/// <param name="frame">Frame of the image (animated textures only)</param>
+	/// <param name="face">Face of the image (envmaps only)</param>
+	/// <param name="texelBudget">Most texels to read</param>
+	/// <returns>VTFPixel struct with the average colour</returns>
+	VTFPixel EstimateAverage(uint16_t frame, uint8_t face, uint32_t texelBudget = 64 * 64) const;
+
+	/// <summary>
+	/// Takes a snapshot of the texture's access counters and load timings
+	/// Counters are only recorded when the library is built with VTFPARSER_STATS, otherwise the snapshot is empty and not enabled
+	/// Safe to call while other threads sample the texture
+	/// </summary>
+	/// <returns>Snapshot of the merged counters, see VTFStats::ExportJSON for serialisation</returns>
+	VTFStats::Snapshot GetStats() const;
+
+	/// <summary>
+	/// Zeroes the access counters (load timings are kept)
+	/// </summary>
+	void ResetStats();
 };
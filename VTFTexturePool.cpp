@@ -0,0 +1,400 @@
+﻿#include "VTFTexturePool.h"
+#include "FileFormat/Parser.h"
+#include "Util/Hash.h"
+#include "Util/SIMD.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+
+#define VTF_POOL_ALIGNMENT 64
+
+static size_t AlignUp(size_t value)
+{
+	return (value + VTF_POOL_ALIGNMENT - 1) & ~static_cast<size_t>(VTF_POOL_ALIGNMENT - 1);
+}
+
+static bool IsClampedX(const VTFPoolDescriptor& descriptor)
+{
+	return (descriptor.flags & static_cast<uint32_t>(TEXTURE_FLAGS::CLAMPS)) != 0;
+}
+
+static bool IsClampedY(const VTFPoolDescriptor& descriptor)
+{
+	return (descriptor.flags & static_cast<uint32_t>(TEXTURE_FLAGS::CLAMPT)) != 0;
+}
+
+VTFTexturePool::~VTFTexturePool()
+{
+	if (mpAllocation != nullptr) free(mpAllocation);
+}
+
+bool VTFTexturePool::Reallocate(size_t capacity)
+{
+	uint8_t* pAllocation = static_cast<uint8_t*>(malloc(capacity + VTF_POOL_ALIGNMENT - 1));
+	if (pAllocation == nullptr) return false;
+
+	uint8_t* pArena = reinterpret_cast<uint8_t*>(AlignUp(reinterpret_cast<uintptr_t>(pAllocation)));
+	if (mArenaSize != 0) memcpy(pArena, mpArena, mArenaSize);
+	if (mpAllocation != nullptr) free(mpAllocation);
+
+	mpAllocation = pAllocation;
+	mpArena = pArena;
+	mArenaCapacity = capacity;
+	return true;
+}
+
+bool VTFTexturePool::Reserve(size_t arenaBytes, size_t textureCount)
+{
+	mDescriptors.reserve(textureCount);
+	mSubimages.reserve(textureCount * 4);
+	mSubimageBlocks.reserve(textureCount * 4);
+
+	if (arenaBytes <= mArenaCapacity) return true;
+	return Reallocate(arenaBytes);
+}
+
+VTFPoolHandle VTFTexturePool::Add(const VTFTexture& texture)
+{
+	const uint8_t* pImageData = texture.GetImageData();
+	const size_t imageDataSize = texture.GetImageDataSize();
+	if (pImageData == nullptr || imageDataSize == 0) return VTF_POOL_INVALID_HANDLE;
+	if (mDescriptors.size() >= VTF_POOL_INVALID_HANDLE) return VTF_POOL_INVALID_HANDLE;
+
+	const IMAGE_FORMAT format = texture.GetImageFormat();
+	const ImageFormatInfo info = VTFParser::GetImageFormatInfo(format);
+	if (!info.isSupported || (info.isCompressed && !texture.IsBlockCompressed())) return VTF_POOL_INVALID_HANDLE;
+
+	// Every texture starts on its own cache line, and reserves enough for none of its subimages to be shared
+	const size_t offset = AlignUp(mArenaSize);
+	if (offset + imageDataSize > mArenaCapacity) {
+		if (!Reallocate(std::max(offset + imageDataSize, mArenaCapacity * 2))) return VTF_POOL_INVALID_HANDLE;
+	}
+
+	VTFPoolDescriptor descriptor;
+	descriptor.offset = offset;
+	descriptor.flags = texture.GetFlags();
+	descriptor.format = format;
+	descriptor.width = texture.GetWidth();
+	descriptor.height = texture.GetHeight();
+	descriptor.depth = texture.GetDepth();
+	descriptor.frames = texture.GetFrames();
+	descriptor.mipmapCount = static_cast<uint8_t>(texture.GetMIPLevels());
+	descriptor.faces = texture.GetFaces();
+	descriptor.pixelSize = static_cast<uint8_t>(info.bytesPerPixel);
+	descriptor.padding = 0;
+	descriptor.firstSubimage = static_cast<uint32_t>(mSubimages.size());
+	mSubimages.resize(mSubimages.size() + static_cast<size_t>(descriptor.mipmapCount) * descriptor.frames * descriptor.faces);
+	mSubimageBlocks.resize(mSubimages.size());
+
+	// Subimages are copied in the order they're stored (smallest MIP first), so a texture with nothing shared is laid out as it was loaded
+	size_t arenaSize = offset;
+	for (int16_t mip = descriptor.mipmapCount - 1; mip >= 0; mip--) {
+		const size_t faceSize = static_cast<size_t>(VTFParser::CalcImageSize(texture.GetWidth(mip), texture.GetHeight(mip), texture.GetDepth(mip), format));
+
+		for (uint16_t frame = 0; frame < descriptor.frames; frame++) {
+			for (uint8_t face = 0; face < descriptor.faces; face++) {
+				const uint8_t* pSubimage = pImageData + texture.GetSubimageOffset(static_cast<uint8_t>(mip), frame, face);
+				const uint64_t hash = VTFUtil::Hash64(pSubimage, faceSize);
+
+				// Equal hashes are only candidates, the bytes decide
+				uint32_t blockIndex = UINT32_MAX;
+				const auto candidates = mBlockIndex.equal_range(hash);
+				for (auto it = candidates.first; it != candidates.second; ++it) {
+					VTFPoolBlock& block = mBlocks[it->second];
+					if (block.size == faceSize && memcmp(mpArena + block.offset, pSubimage, faceSize) == 0) {
+						block.references++;
+						mSavedBytes += faceSize;
+						blockIndex = it->second;
+						break;
+					}
+				}
+
+				if (blockIndex == UINT32_MAX) {
+					memcpy(mpArena + arenaSize, pSubimage, faceSize);
+					blockIndex = static_cast<uint32_t>(mBlocks.size());
+					mBlockIndex.emplace(hash, blockIndex);
+					mBlocks.push_back(VTFPoolBlock{ arenaSize, faceSize, 1 });
+					arenaSize += faceSize;
+				}
+
+				const size_t subimage = descriptor.firstSubimage + (static_cast<size_t>(mip) * descriptor.frames + frame) * descriptor.faces + face;
+				mSubimages[subimage] = mBlocks[blockIndex].offset;
+				mSubimageBlocks[subimage] = blockIndex;
+			}
+		}
+	}
+
+	// A texture made entirely of shared subimages takes no space, not even alignment
+	if (arenaSize != offset) mArenaSize = arenaSize;
+
+	mDescriptors.push_back(descriptor);
+	return static_cast<VTFPoolHandle>(mDescriptors.size() - 1);
+}
+
+VTFPoolHandle VTFTexturePool::Add(const uint8_t* pData, size_t size, const VTFLoadOptions& options)
+{
+	VTFLoadOptions loadOptions = options;
+	loadOptions.headerOnly = false;
+
+	VTFTexture texture(pData, size, loadOptions);
+	if (!texture.IsValid()) return VTF_POOL_INVALID_HANDLE;
+	return Add(texture);
+}
+
+bool VTFTexturePool::Remove(VTFPoolHandle handle)
+{
+	if (GetDescriptor(handle) == nullptr) return false;
+	VTFPoolDescriptor& descriptor = mDescriptors[handle];
+
+	const size_t first = descriptor.firstSubimage;
+	const size_t count = static_cast<size_t>(descriptor.mipmapCount) * descriptor.frames * descriptor.faces;
+	bool freed = false;
+	for (size_t i = first; i < first + count; i++) {
+		const uint32_t blockIndex = mSubimageBlocks[i];
+		VTFPoolBlock& block = mBlocks[blockIndex];
+		if (--block.references != 0) {
+			mSavedBytes -= block.size;
+			continue;
+		}
+
+		// Unindex the block before it's overwritten, so nothing added later can match it
+		const auto candidates = mBlockIndex.equal_range(VTFUtil::Hash64(mpArena + block.offset, block.size));
+		for (auto it = candidates.first; it != candidates.second; ++it) {
+			if (it->second == blockIndex) {
+				mBlockIndex.erase(it);
+				break;
+			}
+		}
+		freed = true;
+	}
+
+	// Close the texture's run of the subimage table
+	mSubimages.erase(mSubimages.begin() + first, mSubimages.begin() + first + count);
+	mSubimageBlocks.erase(mSubimageBlocks.begin() + first, mSubimageBlocks.begin() + first + count);
+	for (VTFPoolDescriptor& other : mDescriptors) {
+		if (other.firstSubimage > first) other.firstSubimage -= static_cast<uint32_t>(count);
+	}
+
+	descriptor.mipmapCount = 0;
+	mRemovedCount++;
+
+	if (freed) ReclaimBlocks();
+	return true;
+}
+
+void VTFTexturePool::ReclaimBlocks()
+{
+	// Blocks are in arena order, so the live ones can be moved down in place, each keeping its offset within a cache line
+	std::vector<uint64_t> oldOffsets(mBlocks.size());
+	std::vector<uint32_t> remap(mBlocks.size(), UINT32_MAX);
+	size_t arenaSize = 0;
+	uint32_t kept = 0;
+	for (uint32_t i = 0; i < mBlocks.size(); i++) {
+		const VTFPoolBlock block = mBlocks[i];
+		oldOffsets[i] = block.offset;
+		if (block.references == 0) continue;
+
+		const size_t offset = arenaSize + ((block.offset - arenaSize) & (VTF_POOL_ALIGNMENT - 1));
+		if (offset != block.offset) memmove(mpArena + offset, mpArena + block.offset, block.size);
+
+		remap[i] = kept;
+		mBlocks[kept++] = VTFPoolBlock{ offset, block.size, block.references };
+		arenaSize = offset + block.size;
+	}
+	mBlocks.resize(kept);
+	mArenaSize = arenaSize;
+
+	for (size_t i = 0; i < mSubimages.size(); i++) {
+		mSubimageBlocks[i] = remap[mSubimageBlocks[i]];
+		mSubimages[i] = mBlocks[mSubimageBlocks[i]].offset;
+	}
+	for (auto& entry : mBlockIndex) entry.second = remap[entry.second];
+
+	// Textures start where the first block at or after their old start now is (exactly their first block if they copied any)
+	for (VTFPoolDescriptor& descriptor : mDescriptors) {
+		if (descriptor.mipmapCount == 0) continue;
+
+		size_t i = std::lower_bound(oldOffsets.begin(), oldOffsets.end(), descriptor.offset) - oldOffsets.begin();
+		while (i < remap.size() && remap[i] == UINT32_MAX) i++;
+		descriptor.offset = i < remap.size() ? mBlocks[remap[i]].offset : mArenaSize;
+	}
+}
+
+void VTFTexturePool::Clear()
+{
+	mDescriptors.clear();
+	mSubimages.clear();
+	mSubimageBlocks.clear();
+	mBlocks.clear();
+	mBlockIndex.clear();
+	mSavedBytes = 0;
+	mArenaSize = 0;
+	mRemovedCount = 0;
+}
+
+VTFPoolDedupStats VTFTexturePool::GetDedupStats() const
+{
+	VTFPoolDedupStats stats;
+	stats.subimages = mSubimages.size();
+	stats.uniqueSubimages = mBlocks.size();
+	stats.savedBytes = mSavedBytes;
+	return stats;
+}
+
+const std::vector<VTFPoolBlock>& VTFTexturePool::GetBlocks() const { return mBlocks; }
+
+size_t VTFTexturePool::GetCount() const { return mDescriptors.size() - mRemovedCount; }
+
+size_t VTFTexturePool::GetArenaSize() const { return mArenaSize; }
+
+const VTFPoolDescriptor* VTFTexturePool::GetDescriptor(VTFPoolHandle handle) const
+{
+	return handle < mDescriptors.size() && mDescriptors[handle].mipmapCount != 0 ? &mDescriptors[handle] : nullptr;
+}
+
+const uint8_t* VTFTexturePool::GetSubimage(const VTFPoolDescriptor& descriptor, uint8_t mipLevel, uint16_t frame, uint8_t face) const
+{
+	return mpArena + mSubimages[descriptor.firstSubimage + (static_cast<size_t>(mipLevel) * descriptor.frames + frame) * descriptor.faces + face];
+}
+
+VTFPixel VTFTexturePool::GetPixel(VTFPoolHandle handle, uint16_t x, uint16_t y, uint16_t z, uint8_t mipLevel, uint16_t frame, uint8_t face) const
+{
+	const VTFPoolDescriptor* pDescriptor = GetDescriptor(handle);
+	if (pDescriptor == nullptr || mipLevel >= pDescriptor->mipmapCount) return VTFPixel{};
+
+	const uint32_t width = std::max(pDescriptor->width >> mipLevel, 1);
+	const uint32_t height = std::max(pDescriptor->height >> mipLevel, 1);
+
+	const uint8_t* pSubimage = GetSubimage(*pDescriptor, mipLevel, frame, face);
+	if (pDescriptor->pixelSize == 0) return VTFParser::FetchBlockTexel(pSubimage, static_cast<uint16_t>(width), x, y, pDescriptor->format);
+
+	return VTFParser::ParsePixel(
+		pSubimage + static_cast<size_t>((static_cast<uint32_t>(z) * height + y) * width + x) * pDescriptor->pixelSize,
+		pDescriptor->format
+	);
+}
+
+VTFPixel VTFTexturePool::SampleBilinear(const VTFPoolDescriptor& descriptor, float u, float v, uint16_t z, uint8_t mipLevel, uint16_t frame, uint8_t face) const
+{
+	const uint16_t width = std::max(descriptor.width >> mipLevel, 1);
+	const uint16_t height = std::max(descriptor.height >> mipLevel, 1);
+
+	const uint8_t* pSubimage = GetSubimage(descriptor, mipLevel, frame, face);
+	return VTFParser::FilterBilinear(
+		pSubimage + static_cast<size_t>(static_cast<uint32_t>(z) * width * height) * descriptor.pixelSize, width, height, descriptor.format,
+		IsClampedX(descriptor), IsClampedY(descriptor), u, v
+	);
+}
+
+VTFPixel VTFTexturePool::SampleNearest(const VTFPoolDescriptor& descriptor, float u, float v, uint16_t z, uint8_t mipLevel, uint16_t frame, uint8_t face) const
+{
+	const uint16_t width = std::max(descriptor.width >> mipLevel, 1);
+	const uint16_t height = std::max(descriptor.height >> mipLevel, 1);
+
+	const uint8_t* pSubimage = GetSubimage(descriptor, mipLevel, frame, face);
+	return VTFParser::FilterNearest(
+		pSubimage + static_cast<size_t>(static_cast<uint32_t>(z) * width * height) * descriptor.pixelSize, width, height, descriptor.format,
+		IsClampedX(descriptor), IsClampedY(descriptor), u, v
+	);
+}
+
+VTFPixel VTFTexturePool::SampleDescriptor(const VTFPoolDescriptor& descriptor, float u, float v, uint16_t z, float mipLevel, uint16_t frame, uint8_t face) const
+{
+	mipLevel = std::clamp(mipLevel, 0.f, static_cast<float>(descriptor.mipmapCount - 1));
+	if ((descriptor.flags & static_cast<uint32_t>(TEXTURE_FLAGS::POINTSAMPLE)) != 0)
+		return SampleNearest(descriptor, u, v, z, static_cast<uint8_t>(mipLevel + 0.5f), frame, face);
+
+	float mipHigh = floorf(mipLevel), mipLow = ceilf(mipLevel);
+
+	VTFPixel high = SampleBilinear(descriptor, u, v, z, mipHigh, frame, face);
+	if (mipLow == mipHigh) return high;
+
+	VTFPixel low = SampleBilinear(descriptor, u, v, z, mipLow, frame, face);
+
+	return VTFParser::LerpPixel(high, low, mipLevel - mipHigh);
+}
+
+void VTFTexturePool::PrefetchDescriptor(const VTFPoolDescriptor& descriptor, float u, float v, uint16_t z, float mipLevel, uint16_t frame, uint8_t face) const
+{
+	// Both MIPs SampleDescriptor may blend, one of which is the MIP point sampling rounds to
+	mipLevel = std::clamp(mipLevel, 0.f, static_cast<float>(descriptor.mipmapCount - 1));
+	const uint8_t mips[2] = { static_cast<uint8_t>(floorf(mipLevel)), static_cast<uint8_t>(ceilf(mipLevel)) };
+
+	for (int i = 0; i < (mips[0] == mips[1] ? 1 : 2); i++) {
+		const uint8_t mip = mips[i];
+		const uint16_t width = std::max(descriptor.width >> mip, 1);
+		const uint16_t height = std::max(descriptor.height >> mip, 1);
+		const uint16_t depth = std::max(descriptor.depth >> mip, 1);
+		if (z >= depth) continue;
+
+		VTFParser::PrefetchBilinear(
+			GetSubimage(descriptor, mip, frame, face) + static_cast<size_t>(static_cast<uint32_t>(z) * width * height) * descriptor.pixelSize,
+			width, height, descriptor.format,
+			IsClampedX(descriptor), IsClampedY(descriptor), u, v
+		);
+	}
+}
+
+void VTFTexturePool::Prefetch(VTFPoolHandle handle, float u, float v, uint16_t z, float mipLevel, uint16_t frame, uint8_t face) const
+{
+	const VTFPoolDescriptor* pDescriptor = GetDescriptor(handle);
+	if (pDescriptor == nullptr || frame >= pDescriptor->frames || face >= pDescriptor->faces) return;
+
+	PrefetchDescriptor(*pDescriptor, u, v, z, mipLevel, frame, face);
+}
+
+VTFPixel VTFTexturePool::Sample(VTFPoolHandle handle, float u, float v, uint16_t z, float mipLevel, uint16_t frame, uint8_t face) const
+{
+	const VTFPoolDescriptor* pDescriptor = GetDescriptor(handle);
+	if (pDescriptor == nullptr) return VTFPixel{};
+
+	return SampleDescriptor(*pDescriptor, u, v, z, mipLevel, frame, face);
+}
+
+void VTFTexturePool::SampleBatch(const VTFPoolHandle* pHandles, const float* pU, const float* pV, const float* pMipLevels, size_t count, VTFPixel* pOut) const
+{
+	// Each chunk of lanes goes through three passes, so the misses of a pass overlap: descriptors are prefetched,
+	// then read to prefetch the texels they locate, then the lanes are filtered
+	const size_t PREFETCH_CHUNK = 16;
+	for (size_t begin = 0; begin < count; begin += PREFETCH_CHUNK) {
+		const size_t end = std::min(begin + PREFETCH_CHUNK, count);
+
+		for (size_t i = begin; i < end; i++) {
+			if (pHandles[i] < mDescriptors.size()) VTF_PREFETCH(&mDescriptors[pHandles[i]]);
+		}
+
+		for (size_t i = begin; i < end; i++) {
+			const VTFPoolDescriptor* pDescriptor = GetDescriptor(pHandles[i]);
+			if (pDescriptor != nullptr) PrefetchDescriptor(*pDescriptor, pU[i], pV[i], 0, pMipLevels != nullptr ? pMipLevels[i] : 0.f, 0, 0);
+		}
+
+		for (size_t i = begin; i < end; i++) {
+			const VTFPoolDescriptor* pDescriptor = GetDescriptor(pHandles[i]);
+			pOut[i] = pDescriptor != nullptr ?
+				SampleDescriptor(*pDescriptor, pU[i], pV[i], 0, pMipLevels != nullptr ? pMipLevels[i] : 0.f, 0, 0) :
+				VTFPixel{};
+		}
+	}
+}
+
+void VTFTexturePool::SampleBatch(VTFPoolHandle handle, const float* pU, const float* pV, const float* pMipLevels, size_t count, VTFPixel* pOut) const
+{
+	const VTFPoolDescriptor* pDescriptor = GetDescriptor(handle);
+	if (pDescriptor == nullptr) {
+		std::fill(pOut, pOut + count, VTFPixel{});
+		return;
+	}
+
+	const size_t PREFETCH_CHUNK = 16;
+	for (size_t begin = 0; begin < count; begin += PREFETCH_CHUNK) {
+		const size_t end = std::min(begin + PREFETCH_CHUNK, count);
+
+		for (size_t i = begin; i < end; i++)
+			PrefetchDescriptor(*pDescriptor, pU[i], pV[i], 0, pMipLevels != nullptr ? pMipLevels[i] : 0.f, 0, 0);
+
+		for (size_t i = begin; i < end; i++)
+			pOut[i] = SampleDescriptor(*pDescriptor, pU[i], pV[i], 0, pMipLevels != nullptr ? pMipLevels[i] : 0.f, 0, 0);
+	}
+}
@@ -0,0 +1,245 @@
+#pragma once
+
+#include "VTFParser.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+
+typedef uint32_t VTFPoolHandle;
+#define VTF_POOL_INVALID_HANDLE UINT32_MAX
+
+/// <summary>
+/// Where a texture lives in the pool's arena and how to address it
+/// </summary>
+struct VTFPoolDescriptor
+{
+	uint64_t offset;      // Offset in the arena of the subimages the texture added (64 byte aligned), those shared with other textures are elsewhere
+	uint32_t flags;       // TEXTURE_FLAGS (wrap modes etc.)
+	IMAGE_FORMAT format;  // Format of the image data (block compressed for textures that kept their blocks, see VTFTexture::IsBlockCompressed)
+	uint16_t width;
+	uint16_t height;
+	uint16_t depth;
+	uint16_t frames;
+	uint8_t mipmapCount;  // 0 once the texture is removed
+	uint8_t faces;
+	uint8_t pixelSize;    // Bytes per pixel of the format, 0 for kept blocks (which are 2D only, so never offset by z)
+	uint8_t padding;
+	uint32_t firstSubimage; // Index of the texture's first subimage in the pool's subimage table, MIPs largest first then frames then faces
+};
+
+/// <summary>
+/// A run of bytes in the arena referenced by one or more subimages
+/// </summary>
+struct VTFPoolBlock
+{
+	uint64_t offset;     // Offset in the arena
+	uint64_t size;       // Size of the subimage (every z slice) in bytes
+	uint32_t references; // Number of subimages, of any texture, stored in it (the block is freed when the last is removed)
+};
+
+/// <summary>
+/// Memory the pool saved by storing identical subimages once
+/// </summary>
+struct VTFPoolDedupStats
+{
+	size_t subimages = 0;       // Subimages added
+	size_t uniqueSubimages = 0; // Subimages that had to be copied into the arena
+	size_t savedBytes = 0;      // Bytes of image data referenced more than once, which would otherwise have been copied again
+};
+
+/// <summary>
+/// Stores the image data of many textures in one contiguous, 64 byte aligned arena addressed by integer handles,
+/// with a flat descriptor table in place of per texture headers, so a lookup is an index into the table and an offset into the arena
+/// Subimages (each MIP of each frame and face) are hashed as they're added, and any byte identical to one already in the arena
+/// references it instead of being copied again, so repeated frames and duplicate textures are stored once
+/// Blocks count the subimages referencing them, and are freed once every texture using them is removed
+/// Adding or removing textures may move the arena, so populate the pool first; sampling is const and can then be shared between threads
+/// </summary>
+class VTFTexturePool
+{
+private:
+	uint8_t* mpAllocation = nullptr; // Unaligned allocation backing the arena
+	uint8_t* mpArena = nullptr;
+	size_t mArenaSize = 0;
+	size_t mArenaCapacity = 0;
+
+	std::vector<VTFPoolDescriptor> mDescriptors;
+	std::vector<uint64_t> mSubimages; // Arena offset of each subimage, see VTFPoolDescriptor::firstSubimage
+	std::vector<uint32_t> mSubimageBlocks; // Block each subimage is stored in
+	size_t mRemovedCount = 0;
+
+	// Every block copied into the arena, and an index of them by hash of their contents
+	std::vector<VTFPoolBlock> mBlocks;
+	std::unordered_multimap<uint64_t, uint32_t> mBlockIndex;
+	size_t mSavedBytes = 0;
+
+	bool Reallocate(size_t capacity);
+	void ReclaimBlocks();
+	const uint8_t* GetSubimage(const VTFPoolDescriptor& descriptor, uint8_t mipLevel, uint16_t frame, uint8_t face) const;
+
+	VTFPixel SampleBilinear(const VTFPoolDescriptor& descriptor, float u, float v, uint16_t z, uint8_t mipLevel, uint16_t frame, uint8_t face) const;
+	VTFPixel SampleNearest(const VTFPoolDescriptor& descriptor, float u, float v, uint16_t z, uint8_t mipLevel, uint16_t frame, uint8_t face) const;
+	VTFPixel SampleDescriptor(const VTFPoolDescriptor& descriptor, float u, float v, uint16_t z, float mipLevel, uint16_t frame, uint8_t face) const;
+	void PrefetchDescriptor(const VTFPoolDescriptor& descriptor, float u, float v, uint16_t z, float mipLevel, uint16_t frame, uint8_t face) const;
+
+public:
+	VTFTexturePool() = default;
+	~VTFTexturePool();
+
+	VTFTexturePool(const VTFTexturePool&) = delete;
+	VTFTexturePool& operator=(const VTFTexturePool&) = delete;
+
+	/// <summary>
+	/// Preallocates the arena and descriptor table, avoiding reallocations while adding textures
+	/// </summary>
+	/// <param name="arenaBytes">Total bytes of image data that will be added</param>
+	/// <param name="textureCount">Number of textures that will be added</param>
+	/// <returns>Whether the arena could be allocated</returns>
+	bool Reserve(size_t arenaBytes, size_t textureCount);
+
+	/// <summary>
+	/// Copies a loaded texture's image data into the pool, sharing subimages identical to ones already in it
+	/// Textures that kept their blocks (sampleBlocks or transcodeToDXT) are stored as blocks and decoded per texel when sampled
+	/// </summary>
+	/// <param name="texture">Valid, fully loaded texture (it isn't referenced after this call)</param>
+	/// <returns>Handle of the texture, or VTF_POOL_INVALID_HANDLE if it couldn't be added</returns>
+	VTFPoolHandle Add(const VTFTexture& texture);
+
+	/// <summary>
+	/// Loads a VTF into the pool
+	/// </summary>
+	/// <param name="pData">Pointer to binary VTF data</param>
+	/// <param name="size">Size of the data in bytes</param>
+	/// <param name="options">Options controlling how the texture is loaded (headerOnly is ignored, sampleBlocks and transcodeToDXT keep the pool's copy compressed)</param>
+	/// <returns>Handle of the texture, or VTF_POOL_INVALID_HANDLE if it couldn't be loaded</returns>
+	VTFPoolHandle Add(const uint8_t* pData, size_t size, const VTFLoadOptions& options = VTFLoadOptions{});
+
+	/// <summary>
+	/// Removes a texture, releasing its references to the blocks it uses
+	/// Blocks no other texture references are freed, and the arena after them is moved down over the space (keeping alignment)
+	/// </summary>
+	/// <param name="handle">Handle returned by Add (the other handles stay valid, this one is never reused)</param>
+	/// <returns>False if the handle is invalid or was already removed</returns>
+	bool Remove(VTFPoolHandle handle);
+
+	/// <summary>
+	/// Removes every texture, keeping the arena's allocation
+	/// </summary>
+	void Clear();
+
+	/// <summary>
+	/// Gets how many subimages were shared instead of copied, and the memory that saved
+	/// </summary>
+	VTFPoolDedupStats GetDedupStats() const;
+
+	/// <summary>
+	/// Gets the blocks of the arena, in the order they were copied in
+	/// </summary>
+	const std::vector<VTFPoolBlock>& GetBlocks() const;
+
+	/// <summary>
+	/// Gets the number of textures in the pool (added and not removed)
+	/// </summary>
+	size_t GetCount() const;
+
+	/// <summary>
+	/// Gets the bytes of image data in the arena (including alignment padding, and shared subimages only once)
+	/// </summary>
+	size_t GetArenaSize() const;
+
+	/// <summary>
+	/// Gets the descriptor of a texture
+	/// </summary>
+	/// <param name="handle">Handle returned by Add</param>
+	/// <returns>Readonly pointer to the descriptor, or nullptr if the handle is invalid or removed</returns>
+	const VTFPoolDescriptor* GetDescriptor(VTFPoolHandle handle) const;
+
+	/// <summary>
+	/// Gets a pixel from a texture at the specified coordinate, MIP level, frame, and face
+	/// </summary>
+	/// <param name="handle">Handle of the texture</param>
+	/// <param name="x">Coordinate of the pixel on the x axis</param>
+	/// <param name="y">Coordinate of the pixel on the y axis</param>
+	/// <param name="z">Coordinate of the pixel on the z axis (volumetric textures only)</param>
+	/// <param name="mipLevel">MIP level to read</param>
+	/// <param name="frame">Frame of the image (animated textures only)</param>
+	/// <param name="face">Face of the image (envmaps only)</param>
+	/// <returns>VTFPixel struct with the pixel data</returns>
+	VTFPixel GetPixel(VTFPoolHandle handle, uint16_t x, uint16_t y, uint16_t z, uint8_t mipLevel, uint16_t frame, uint8_t face) const;
+
+	/// <summary>
+	/// Samples a texture at a given uv and performs filtering, identical to VTFTexture::Sample
+	/// </summary>
+	/// <param name="handle">Handle of the texture</param>
+	/// <param name="u">U coordinate</param>
+	/// <param name="v">V coordinate</param>
+	/// <param name="z">Coordinate of the pixel on the z axis (volumetric textures only)</param>
+	/// <param name="mipLevel">MIP level to read</param>
+	/// <param name="frame">Frame of the image (animated textures only)</param>
+	/// <param name="face">Face of the image (envmaps only)</param>
+	/// <returns>VTFPixel struct with the pixel data</returns>
+	VTFPixel Sample(VTFPoolHandle handle, float u, float v, uint16_t z, float mipLevel, uint16_t frame, uint8_t face) const;
+
+	/// <summary>
+	/// Samples a standard 2D texture at a given uv and performs filtering
+	/// </summary>
+	/// <param name="handle">Handle of the texture</param>
+	/// <param name="u">U coordinate</param>
+	/// <param name="v">V coordinate</param>
+	/// <param name="mipLevel">MIP level to read</param>
+	/// <returns>VTFPixel struct with the pixel data</returns>
+	inline VTFPixel Sample(VTFPoolHandle handle, float u, float v, float mipLevel) const
+	{
+		return Sample(handle, u, v, 0, mipLevel, 0, 0);
+	}
+
+	/// <summary>
+	/// Hints that a texture is about to be sampled with the same arguments, prefetching the cache lines Sample will read (see VTFTexture::Prefetch)
+	/// </summary>
+	/// <param name="handle">Handle of the texture</param>
+	/// <param name="u">U coordinate</param>
+	/// <param name="v">V coordinate</param>
+	/// <param name="z">Coordinate of the pixel on the z axis (volumetric textures only)</param>
+	/// <param name="mipLevel">MIP level that will be read</param>
+	/// <param name="frame">Frame of the image (animated textures only)</param>
+	/// <param name="face">Face of the image (envmaps only)</param>
+	void Prefetch(VTFPoolHandle handle, float u, float v, uint16_t z, float mipLevel, uint16_t frame, uint8_t face) const;
+
+	/// <summary>
+	/// Hints that a standard 2D texture is about to be sampled at a given uv
+	/// </summary>
+	/// <param name="handle">Handle of the texture</param>
+	/// <param name="u">U coordinate</param>
+	/// <param name="v">V coordinate</param>
+	/// <param name="mipLevel">MIP level that will be read</param>
+	inline void Prefetch(VTFPoolHandle handle, float u, float v, float mipLevel) const
+	{
+		Prefetch(handle, u, v, 0, mipLevel, 0, 0);
+	}
+
+	/// <summary>
+	/// Samples many lanes at once, each with its own texture (2D, first frame and face)
+	/// Lanes are done in chunks: every descriptor of a chunk is prefetched, then every texel, then the lanes are filtered
+	/// </summary>
+	/// <param name="pHandles">Array of count handles</param>
+	/// <param name="pU">Array of count U coordinates</param>
+	/// <param name="pV">Array of count V coordinates</param>
+	/// <param name="pMipLevels">Array of count MIP levels, or nullptr to sample the largest MIP</param>
+	/// <param name="count">Number of lanes</param>
+	/// <param name="pOut">Array of count pixels to populate</param>
+	void SampleBatch(const VTFPoolHandle* pHandles, const float* pU, const float* pV, const float* pMipLevels, size_t count, VTFPixel* pOut) const;
+
+	/// <summary>
+	/// Samples many lanes at once from one texture (2D, first frame and face)
+	/// Lanes are done in chunks, prefetching every texel of a chunk before filtering any of it
+	/// </summary>
+	/// <param name="handle">Handle of the texture</param>
+	/// <param name="pU">Array of count U coordinates</param>
+	/// <param name="pV">Array of count V coordinates</param>
+	/// <param name="pMipLevels">Array of count MIP levels, or nullptr to sample the largest MIP</param>
+	/// <param name="count">Number of lanes</param>
+	/// <param name="pOut">Array of count pixels to populate</param>
+	void SampleBatch(VTFPoolHandle handle, const float* pU, const float* pV, const float* pMipLevels, size_t count, VTFPixel* pOut) const;
+};
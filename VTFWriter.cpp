@@ -0,0 +1,465 @@
+#include "VTFWriter.h"
+#include "FileFormat/Parser.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+#define LOWRES_MAX_SIZE 16
+
+static bool IsWritableFormat(IMAGE_FORMAT format)
+{
+	switch (format) {
+	case IMAGE_FORMAT::RGBA8888:
+	case IMAGE_FORMAT::ABGR8888:
+	case IMAGE_FORMAT::RGB888:
+	case IMAGE_FORMAT::BGR888:
+	case IMAGE_FORMAT::I8:
+	case IMAGE_FORMAT::IA88:
+	case IMAGE_FORMAT::A8:
+	case IMAGE_FORMAT::RGB888_BLUESCREEN:
+	case IMAGE_FORMAT::BGR888_BLUESCREEN:
+	case IMAGE_FORMAT::ARGB8888:
+	case IMAGE_FORMAT::BGRA8888:
+	case IMAGE_FORMAT::DXT1:
+	case IMAGE_FORMAT::DXT3:
+	case IMAGE_FORMAT::DXT5:
+	case IMAGE_FORMAT::BGRX8888:
+	case IMAGE_FORMAT::DXT1_ONEBITALPHA:
+	case IMAGE_FORMAT::UV88:
+	case IMAGE_FORMAT::UVWQ8888:
+	case IMAGE_FORMAT::RGBA16161616:
+	case IMAGE_FORMAT::UVLX8888:
+	case IMAGE_FORMAT::RGBA32323232F:
+		return true;
+	default:
+		return false;
+	}
+}
+
+// Inverse of VTFParser::ParsePixel for the uncompressed writable formats
+static void EncodePixel(const uint8_t* rgba, IMAGE_FORMAT format, uint8_t* dst)
+{
+	switch (format) {
+	case IMAGE_FORMAT::RGBA8888:
+	case IMAGE_FORMAT::UVWQ8888:
+	case IMAGE_FORMAT::UVLX8888:
+		memcpy(dst, rgba, 4);
+		break;
+	case IMAGE_FORMAT::ABGR8888:
+		dst[0] = rgba[3]; dst[1] = rgba[2]; dst[2] = rgba[1]; dst[3] = rgba[0];
+		break;
+	case IMAGE_FORMAT::RGB888_BLUESCREEN:
+	case IMAGE_FORMAT::RGB888:
+		memcpy(dst, rgba, 3);
+		break;
+	case IMAGE_FORMAT::BGR888_BLUESCREEN:
+	case IMAGE_FORMAT::BGR888:
+		dst[0] = rgba[2]; dst[1] = rgba[1]; dst[2] = rgba[0];
+		break;
+	case IMAGE_FORMAT::I8:
+		dst[0] = static_cast<uint8_t>((rgba[0] * 77 + rgba[1] * 150 + rgba[2] * 29 + 128) >> 8);
+		break;
+	case IMAGE_FORMAT::IA88:
+		dst[0] = static_cast<uint8_t>((rgba[0] * 77 + rgba[1] * 150 + rgba[2] * 29 + 128) >> 8);
+		dst[1] = rgba[3];
+		break;
+	case IMAGE_FORMAT::A8:
+		dst[0] = rgba[3];
+		break;
+	case IMAGE_FORMAT::ARGB8888:
+		dst[0] = rgba[3]; dst[1] = rgba[0]; dst[2] = rgba[1]; dst[3] = rgba[2];
+		break;
+	case IMAGE_FORMAT::BGRX8888:
+	case IMAGE_FORMAT::BGRA8888:
+		dst[0] = rgba[2]; dst[1] = rgba[1]; dst[2] = rgba[0]; dst[3] = rgba[3];
+		break;
+	case IMAGE_FORMAT::UV88:
+		dst[0] = rgba[0]; dst[1] = rgba[1];
+		break;
+	case IMAGE_FORMAT::RGBA16161616:
+		for (int c = 0; c < 4; c++) {
+			uint16_t value = rgba[c] * 257;
+			memcpy(dst + c * 2, &value, 2);
+		}
+		break;
+	case IMAGE_FORMAT::RGBA32323232F:
+		for (int c = 0; c < 4; c++) {
+			float value = rgba[c] / 255.f;
+			memcpy(dst + c * 4, &value, 4);
+		}
+		break;
+	default:
+		break;
+	}
+}
+
+static void AppendResourceEntry(std::vector<uint8_t>& out, RESOURCE_TYPE type, uint8_t flags, uint32_t data)
+{
+	ResourceEntryInfo entry;
+	entry.tag[0] = static_cast<uint8_t>(static_cast<uint32_t>(type));
+	entry.tag[1] = static_cast<uint8_t>(static_cast<uint32_t>(type) >> 8);
+	entry.tag[2] = static_cast<uint8_t>(static_cast<uint32_t>(type) >> 16);
+	entry.flags = flags;
+	entry.data = data;
+
+	const uint8_t* pEntry = reinterpret_cast<const uint8_t*>(&entry);
+	out.insert(out.end(), pEntry, pEntry + sizeof(ResourceEntryInfo));
+}
+
+VTFWriter::VTFWriter(uint16_t width, uint16_t height, IMAGE_FORMAT format, uint8_t mipmapCount, uint16_t frames, uint8_t faces, uint16_t depth)
+{
+	memset(&mHeader, 0, sizeof(VTFHeader));
+	memcpy(mHeader.signature, "VTF\0", 4);
+	mHeader.version[0] = 7;
+	mHeader.version[1] = 5;
+
+	mHeader.width = width;
+	mHeader.height = height;
+	mHeader.depth = depth;
+	mHeader.frames = frames;
+	mHeader.mipmapCount = mipmapCount;
+	mHeader.highResImageFormat = format;
+	mHeader.lowResImageFormat = IMAGE_FORMAT::NONE;
+	mHeader.bumpmapScale = 1.f;
+	mFaces = faces;
+
+	if (width == 0 || height == 0 || depth == 0 || frames == 0 || mipmapCount == 0) return;
+	if (faces != 1 && faces != 6 && faces != 7) return;
+	if (faces != 1 && depth != 1) return;
+	if (!IsWritableFormat(format)) return;
+
+	if (mipmapCount > Mipmaps::CalcFullChainLength(width, height, depth)) return;
+
+	if (faces != 1) mHeader.flags |= static_cast<uint32_t>(TEXTURE_FLAGS::ENVMAP);
+
+	mImageData.resize(
+		static_cast<size_t>(VTFParser::CalcImageSize(width, height, depth, mipmapCount, format)) * frames * faces
+	);
+	mSources.resize(static_cast<size_t>(frames) * faces);
+	mIsValid = true;
+}
+
+bool VTFWriter::IsValid() const { return mIsValid; }
+
+bool VTFWriter::SetVersion(uint32_t minor)
+{
+	if (minor < 2 || minor > 5) return false;
+	if (mFaces == 7 && minor >= 5) return false;
+
+	mHeader.version[1] = minor;
+	return true;
+}
+
+void VTFWriter::SetFlags(uint32_t flags)
+{
+	mHeader.flags = flags & ~static_cast<uint32_t>(TEXTURE_FLAGS::ENVMAP);
+	if (mFaces != 1) mHeader.flags |= static_cast<uint32_t>(TEXTURE_FLAGS::ENVMAP);
+}
+
+void VTFWriter::SetFirstFrame(uint16_t firstFrame) { mHeader.firstFrame = firstFrame; }
+
+void VTFWriter::SetReflectivity(float r, float g, float b)
+{
+	mHeader.reflectivity[0] = r;
+	mHeader.reflectivity[1] = g;
+	mHeader.reflectivity[2] = b;
+	mHasReflectivity = true;
+}
+
+void VTFWriter::SetBumpmapScale(float scale) { mHeader.bumpmapScale = scale; }
+
+void VTFWriter::SetQuality(DXTn::QUALITY quality) { mQuality = quality; }
+
+void VTFWriter::SetCRC(uint32_t crc)
+{
+	mCRC = crc;
+	mHasCRC = true;
+}
+
+void VTFWriter::SetLODClamp(uint8_t clampU, uint8_t clampV)
+{
+	mLODClamp[0] = clampU;
+	mLODClamp[1] = clampV;
+	mHasLODClamp = true;
+}
+
+void VTFWriter::SetTextureSettings(uint32_t flags)
+{
+	mTextureSettings = flags;
+	mHasTextureSettings = true;
+}
+
+void VTFWriter::SetKeyValues(const char* pText, size_t length)
+{
+	if (pText == nullptr) {
+		mKeyValues.clear();
+		return;
+	}
+	mKeyValues.assign(pText, pText + length);
+}
+
+size_t VTFWriter::CalcSubimageOffset(uint8_t mipLevel, uint16_t frame, uint8_t face) const
+{
+	// MIPs are stored smallest to largest, then frames, faces, and z slices
+	size_t offset = 0;
+	for (uint8_t mip = mHeader.mipmapCount - 1; mip > mipLevel; mip--) {
+		offset += static_cast<size_t>(VTFParser::CalcImageSize(
+			std::max(mHeader.width >> mip, 1), std::max(mHeader.height >> mip, 1),
+			std::max(mHeader.depth >> mip, 1), mHeader.highResImageFormat
+		)) * mHeader.frames * mFaces;
+	}
+
+	size_t faceSize = static_cast<size_t>(VTFParser::CalcImageSize(
+		std::max(mHeader.width >> mipLevel, 1), std::max(mHeader.height >> mipLevel, 1),
+		std::max(mHeader.depth >> mipLevel, 1), mHeader.highResImageFormat
+	));
+	return offset + (static_cast<size_t>(frame) * mFaces + face) * faceSize;
+}
+
+bool VTFWriter::EncodeImage(const uint8_t* pRGBA, uint8_t* pDst, uint16_t width, uint16_t height, uint16_t depth) const
+{
+	const size_t slicePixels = static_cast<size_t>(width) * height;
+	const size_t sliceSize = static_cast<size_t>(VTFParser::CalcImageSize(width, height, 1, mHeader.highResImageFormat));
+
+	for (uint16_t slice = 0; slice < depth; slice++) {
+		const uint8_t* pSrc = pRGBA + slice * slicePixels * 4;
+		uint8_t* pSliceDst = pDst + slice * sliceSize;
+
+		switch (mHeader.highResImageFormat) {
+		case IMAGE_FORMAT::DXT1:
+			DXTn::CompressDXT1(pSrc, pSliceDst, width, height, mQuality, false);
+			break;
+		case IMAGE_FORMAT::DXT1_ONEBITALPHA:
+			DXTn::CompressDXT1(pSrc, pSliceDst, width, height, mQuality, true);
+			break;
+		case IMAGE_FORMAT::DXT3:
+			DXTn::CompressDXT3(pSrc, pSliceDst, width, height, mQuality);
+			break;
+		case IMAGE_FORMAT::DXT5:
+			DXTn::CompressDXT5(pSrc, pSliceDst, width, height, mQuality);
+			break;
+		default:
+		{
+			uint32_t pixelSize = VTFParser::GetImageFormatInfo(mHeader.highResImageFormat).bytesPerPixel;
+			for (size_t i = 0; i < slicePixels; i++)
+				EncodePixel(pSrc + i * 4, mHeader.highResImageFormat, pSliceDst + i * pixelSize);
+			break;
+		}
+		}
+	}
+
+	return true;
+}
+
+bool VTFWriter::SetImage(const uint8_t* pRGBA, uint8_t mipLevel, uint16_t frame, uint8_t face)
+{
+	if (!mIsValid || pRGBA == nullptr) return false;
+	if (mipLevel >= mHeader.mipmapCount || frame >= mHeader.frames || face >= mFaces) return false;
+
+	uint16_t width = std::max(mHeader.width >> mipLevel, 1);
+	uint16_t height = std::max(mHeader.height >> mipLevel, 1);
+	uint16_t depth = std::max(mHeader.depth >> mipLevel, 1);
+
+	if (mipLevel == 0) {
+		mSources[static_cast<size_t>(frame) * mFaces + face].assign(
+			pRGBA, pRGBA + static_cast<size_t>(width) * height * depth * 4
+		);
+	}
+
+	return EncodeImage(pRGBA, mImageData.data() + CalcSubimageOffset(mipLevel, frame, face), width, height, depth);
+}
+
+bool VTFWriter::SetImage(const float* pRGBA, uint8_t mipLevel, uint16_t frame, uint8_t face)
+{
+	if (!mIsValid || pRGBA == nullptr) return false;
+	if (mipLevel >= mHeader.mipmapCount || frame >= mHeader.frames || face >= mFaces) return false;
+
+	const size_t pixelCount = static_cast<size_t>(std::max(mHeader.width >> mipLevel, 1)) *
+		std::max(mHeader.height >> mipLevel, 1) * std::max(mHeader.depth >> mipLevel, 1);
+
+	std::vector<uint8_t> rgba(pixelCount * 4);
+	for (size_t i = 0; i < pixelCount * 4; i++)
+		rgba[i] = static_cast<uint8_t>(std::clamp(pRGBA[i], 0.f, 1.f) * 255.f + 0.5f);
+
+	if (!SetImage(rgba.data(), mipLevel, frame, face)) return false;
+
+	// Keep the extra precision for 16 bit formats
+	if (mHeader.highResImageFormat == IMAGE_FORMAT::RGBA16161616) {
+		uint8_t* pDst = mImageData.data() + CalcSubimageOffset(mipLevel, frame, face);
+		for (size_t i = 0; i < pixelCount * 4; i++) {
+			uint16_t value = static_cast<uint16_t>(std::clamp(pRGBA[i], 0.f, 1.f) * 65535.f + 0.5f);
+			memcpy(pDst + i * 2, &value, 2);
+		}
+	}
+
+	// Float formats keep the values as they are, including HDR values above 1
+	if (mHeader.highResImageFormat == IMAGE_FORMAT::RGBA32323232F)
+		memcpy(mImageData.data() + CalcSubimageOffset(mipLevel, frame, face), pRGBA, pixelCount * 4 * sizeof(float));
+
+	return true;
+}
+
+bool VTFWriter::SetEncodedImage(const uint8_t* pData, uint8_t mipLevel, uint16_t frame, uint8_t face)
+{
+	if (!mIsValid || pData == nullptr) return false;
+	if (mipLevel >= mHeader.mipmapCount || frame >= mHeader.frames || face >= mFaces) return false;
+
+	size_t size = static_cast<size_t>(VTFParser::CalcImageSize(
+		std::max(mHeader.width >> mipLevel, 1), std::max(mHeader.height >> mipLevel, 1),
+		std::max(mHeader.depth >> mipLevel, 1), mHeader.highResImageFormat
+	));
+	memcpy(mImageData.data() + CalcSubimageOffset(mipLevel, frame, face), pData, size);
+	return true;
+}
+
+bool VTFWriter::GenerateMipmaps(const Mipmaps::Options& options)
+{
+	if (!mIsValid) return false;
+	if (mHeader.mipmapCount == 1) return true;
+
+	std::vector<std::vector<uint8_t>> levels(mHeader.mipmapCount - 1);
+	uint8_t* ppLevels[16];
+	for (uint8_t mip = 1; mip < mHeader.mipmapCount; mip++) {
+		levels[mip - 1].resize(
+			static_cast<size_t>(std::max(mHeader.width >> mip, 1)) * std::max(mHeader.height >> mip, 1) * std::max(mHeader.depth >> mip, 1) * 4
+		);
+		ppLevels[mip - 1] = levels[mip - 1].data();
+	}
+
+	for (uint16_t frame = 0; frame < mHeader.frames; frame++) {
+		for (uint8_t face = 0; face < mFaces; face++) {
+			const std::vector<uint8_t>& source = mSources[static_cast<size_t>(frame) * mFaces + face];
+			if (source.empty()) return false;
+
+			Mipmaps::GenerateChain(source.data(), mHeader.width, mHeader.height, mHeader.depth, mHeader.mipmapCount - 1, ppLevels, options);
+			for (uint8_t mip = 1; mip < mHeader.mipmapCount; mip++) {
+				if (!SetImage(ppLevels[mip - 1], mip, frame, face)) return false;
+			}
+		}
+	}
+
+	return true;
+}
+
+void VTFWriter::BuildThumbnail(std::vector<uint8_t>& lowResData, VTFHeader& header) const
+{
+	uint16_t frame = header.firstFrame < header.frames ? header.firstFrame : 0;
+	const std::vector<uint8_t>& source = mSources[static_cast<size_t>(frame) * mFaces];
+	if (source.empty()) return;
+
+	// Fit within LOWRES_MAX_SIZE while keeping the aspect ratio
+	uint16_t lowWidth = header.width, lowHeight = header.height;
+	while (lowWidth > LOWRES_MAX_SIZE || lowHeight > LOWRES_MAX_SIZE) {
+		lowWidth = std::max(lowWidth >> 1, 1);
+		lowHeight = std::max(lowHeight >> 1, 1);
+	}
+
+	// Box filter the first z slice down to the thumbnail size
+	const uint32_t boxWidth = header.width / lowWidth, boxHeight = header.height / lowHeight;
+	std::vector<uint8_t> thumbnail(static_cast<size_t>(lowWidth) * lowHeight * 4);
+	for (uint32_t y = 0; y < lowHeight; y++) {
+		for (uint32_t x = 0; x < lowWidth; x++) {
+			uint32_t sum[4] = { 0, 0, 0, 0 };
+			for (uint32_t by = 0; by < boxHeight; by++) {
+				const uint8_t* pRow = source.data() + ((static_cast<size_t>(y) * boxHeight + by) * header.width + x * boxWidth) * 4;
+				for (uint32_t bx = 0; bx < boxWidth * 4; bx++) sum[bx & 3] += pRow[bx];
+			}
+
+			const uint32_t boxArea = boxWidth * boxHeight;
+			for (int c = 0; c < 4; c++)
+				thumbnail[(static_cast<size_t>(y) * lowWidth + x) * 4 + c] = static_cast<uint8_t>((sum[c] + boxArea / 2) / boxArea);
+		}
+	}
+
+	lowResData.resize(static_cast<size_t>(VTFParser::CalcImageSize(lowWidth, lowHeight, 1, IMAGE_FORMAT::DXT1)));
+	DXTn::CompressDXT1(thumbnail.data(), lowResData.data(), lowWidth, lowHeight, mQuality);
+
+	header.lowResImageFormat = IMAGE_FORMAT::DXT1;
+	header.lowResImageWidth = static_cast<uint8_t>(lowWidth);
+	header.lowResImageHeight = static_cast<uint8_t>(lowHeight);
+}
+
+bool VTFWriter::Write(std::vector<uint8_t>& out) const
+{
+	if (!mIsValid) return false;
+
+	VTFHeader header = mHeader;
+	if (mFaces == 7) {
+		if (header.version[1] >= 5 || header.firstFrame == 0xffff) return false;
+	} else if (mFaces == 6 && header.version[1] < 5) {
+		// Older versions mark envmaps without a spheremap by a first frame of -1
+		header.firstFrame = 0xffff;
+	}
+	if (VTFParser::GetFaceCount(&header) != mFaces) return false;
+
+	std::vector<uint8_t> lowResData;
+	BuildThumbnail(lowResData, header);
+
+	if (!mHasReflectivity) {
+		uint16_t frame = header.firstFrame < header.frames ? header.firstFrame : 0;
+		const std::vector<uint8_t>& source = mSources[static_cast<size_t>(frame) * mFaces];
+
+		// Average in linear space, as the engine does
+		double sum[3] = { 0, 0, 0 };
+		float linear[256];
+		for (int i = 0; i < 256; i++) linear[i] = powf(i / 255.f, 2.2f);
+		for (size_t i = 0; i < source.size(); i += 4) {
+			for (int c = 0; c < 3; c++) sum[c] += linear[source[i + c]];
+		}
+
+		const size_t pixelCount = std::max<size_t>(source.size() / 4, 1);
+		for (int c = 0; c < 3; c++) header.reflectivity[c] = static_cast<float>(sum[c] / pixelCount);
+	}
+
+	const bool hasResources = header.version[1] >= 3;
+	const size_t baseHeaderSize = sizeof(VTFHeaderFullAligned);
+
+	uint32_t numResources = 0;
+	if (hasResources) {
+		numResources = 1 + (lowResData.empty() ? 0 : 1) + (mHasCRC ? 1 : 0) + (mHasLODClamp ? 1 : 0) +
+			(mHasTextureSettings ? 1 : 0) + (mKeyValues.empty() ? 0 : 1);
+		header.numResources = numResources;
+	} else {
+		header.numResources = 0;
+	}
+
+	header.headerSize = static_cast<uint32_t>(baseHeaderSize + numResources * sizeof(ResourceEntryInfo));
+
+	const uint32_t lowResOffset = header.headerSize;
+	const uint32_t highResOffset = lowResOffset + static_cast<uint32_t>(lowResData.size());
+	const uint64_t keyValuesOffset = static_cast<uint64_t>(highResOffset) + mImageData.size();
+
+	// Resource offsets are 32 bit, the high res image can run past 4 GiB but nothing can start after it
+	if (hasResources && !mKeyValues.empty() && keyValuesOffset > UINT32_MAX) return false;
+
+	out.clear();
+	out.reserve(static_cast<size_t>(keyValuesOffset) + (mKeyValues.empty() ? 0 : sizeof(uint32_t) + mKeyValues.size()));
+
+	const uint8_t* pHeader = reinterpret_cast<const uint8_t*>(&header);
+	out.insert(out.end(), pHeader, pHeader + baseHeaderSize);
+
+	if (hasResources) {
+		// Low res image first so thumbnails can be read with the header
+		if (!lowResData.empty()) AppendResourceEntry(out, RESOURCE_TYPE::LOWRES_IMAGE, 0, lowResOffset);
+		AppendResourceEntry(out, RESOURCE_TYPE::HIGHRES_IMAGE, 0, highResOffset);
+
+		const uint8_t noData = static_cast<uint8_t>(RESOURCE_FLAGS::NO_DATA_CHUNK);
+		if (mHasCRC) AppendResourceEntry(out, RESOURCE_TYPE::CRC, noData, mCRC);
+		if (mHasLODClamp) AppendResourceEntry(out, RESOURCE_TYPE::LOD, noData, mLODClamp[0] | (mLODClamp[1] << 8));
+		if (mHasTextureSettings) AppendResourceEntry(out, RESOURCE_TYPE::TSO, noData, mTextureSettings);
+		if (!mKeyValues.empty()) AppendResourceEntry(out, RESOURCE_TYPE::KVD, 0, static_cast<uint32_t>(keyValuesOffset));
+	}
+
+	out.insert(out.end(), lowResData.begin(), lowResData.end());
+	out.insert(out.end(), mImageData.begin(), mImageData.end());
+
+	if (hasResources && !mKeyValues.empty()) {
+		uint32_t length = static_cast<uint32_t>(mKeyValues.size());
+		const uint8_t* pLength = reinterpret_cast<const uint8_t*>(&length);
+		out.insert(out.end(), pLength, pLength + sizeof(uint32_t));
+		out.insert(out.end(), mKeyValues.begin(), mKeyValues.end());
+	}
+
+	return true;
+}
@@ -0,0 +1,135 @@
+#pragma once
+
+#include "FileFormat/Structs.h"
+#include "DXTn/DXTn.h"
+#include "Mipmaps/Mipmaps.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+class VTFWriter
+{
+private:
+	VTFHeader mHeader;
+	uint8_t mFaces;
+
+	std::vector<uint8_t> mImageData;
+
+	// RGBA8888 copies of MIP 0 for each frame and face, used to build the thumbnail and reflectivity
+	std::vector<std::vector<uint8_t>> mSources;
+
+	DXTn::QUALITY mQuality = DXTn::QUALITY::RANGE_FIT;
+	bool mHasReflectivity = false;
+
+	bool mHasCRC = false;
+	uint32_t mCRC = 0;
+	bool mHasLODClamp = false;
+	uint8_t mLODClamp[2] = { 0, 0 };
+	bool mHasTextureSettings = false;
+	uint32_t mTextureSettings = 0;
+	std::vector<char> mKeyValues;
+
+	bool mIsValid = false;
+
+	size_t CalcSubimageOffset(uint8_t mipLevel, uint16_t frame, uint8_t face) const;
+	bool EncodeImage(const uint8_t* pRGBA, uint8_t* pDst, uint16_t width, uint16_t height, uint16_t depth) const;
+	void BuildThumbnail(std::vector<uint8_t>& lowResData, VTFHeader& header) const;
+
+public:
+	/// <summary>
+	/// VTFWriter class, builds a version 7.2 to 7.5 VTF from RGBA8888 or float RGBA data
+	/// </summary>
+	/// <param name="width">Width of the largest MIP</param>
+	/// <param name="height">Height of the largest MIP</param>
+	/// <param name="format">Format to store the high res image data in</param>
+	/// <param name="mipmapCount">Number of MIP levels (default: 1)</param>
+	/// <param name="frames">Number of frames (default: 1)</param>
+	/// <param name="faces">Number of faces, 6 or 7 makes an envmap (default: 1)</param>
+	/// <param name="depth">Depth of the largest MIP (default: 1)</param>
+	VTFWriter(uint16_t width, uint16_t height, IMAGE_FORMAT format, uint8_t mipmapCount = 1, uint16_t frames = 1, uint8_t faces = 1, uint16_t depth = 1);
+
+	/// <summary>
+	/// Returns whether or not the writer is valid
+	/// </summary>
+	/// <returns>True if the dimensions and format can be written</returns>
+	bool IsValid() const;
+
+	/// <summary>
+	/// Sets the minor version to write (default: 5)
+	/// </summary>
+	/// <param name="minor">Minor version, 2 to 5</param>
+	/// <returns>Whether the version is supported (7 face envmaps need a version below 5)</returns>
+	bool SetVersion(uint32_t minor);
+
+	/// <summary>
+	/// Sets the TEXTURE_FLAGS of the image (ENVMAP is managed from the face count)
+	/// </summary>
+	void SetFlags(uint32_t flags);
+
+	void SetFirstFrame(uint16_t firstFrame);
+
+	/// <summary>
+	/// Overrides the reflectivity, which is otherwise the linear average of the first frame's largest MIP
+	/// </summary>
+	void SetReflectivity(float r, float g, float b);
+
+	void SetBumpmapScale(float scale);
+
+	/// <summary>
+	/// Sets the endpoint search used by the DXT encoder (default: RANGE_FIT)
+	/// </summary>
+	void SetQuality(DXTn::QUALITY quality);
+
+	/// <summary>
+	/// Sets resources to write into the resource directory (7.3+ only)
+	/// </summary>
+	void SetCRC(uint32_t crc);
+	void SetLODClamp(uint8_t clampU, uint8_t clampV);
+	void SetTextureSettings(uint32_t flags);
+	void SetKeyValues(const char* pText, size_t length);
+
+	/// <summary>
+	/// Encodes a subimage from RGBA8888 pixels
+	/// </summary>
+	/// <param name="pRGBA">Pixels of every z slice of the subimage, tightly packed</param>
+	/// <param name="mipLevel">MIP level to set</param>
+	/// <param name="frame">Frame to set</param>
+	/// <param name="face">Face to set</param>
+	/// <returns>Whether the subimage exists and was encoded</returns>
+	bool SetImage(const uint8_t* pRGBA, uint8_t mipLevel, uint16_t frame, uint8_t face);
+
+	/// <summary>
+	/// Encodes a subimage from float RGBA pixels in the range 0-1 (RGBA32323232F stores them unclamped)
+	/// </summary>
+	/// <param name="pRGBA">Pixels of every z slice of the subimage, tightly packed</param>
+	/// <param name="mipLevel">MIP level to set</param>
+	/// <param name="frame">Frame to set</param>
+	/// <param name="face">Face to set</param>
+	/// <returns>Whether the subimage exists and was encoded</returns>
+	bool SetImage(const float* pRGBA, uint8_t mipLevel, uint16_t frame, uint8_t face);
+
+	/// <summary>
+	/// Copies a subimage that is already in the output format
+	/// </summary>
+	/// <param name="pData">Image data of every z slice of the subimage</param>
+	/// <param name="mipLevel">MIP level to set</param>
+	/// <param name="frame">Frame to set</param>
+	/// <param name="face">Face to set</param>
+	/// <returns>Whether the subimage exists</returns>
+	bool SetEncodedImage(const uint8_t* pData, uint8_t mipLevel, uint16_t frame, uint8_t face);
+
+	/// <summary>
+	/// Generates every MIP below the largest from the RGBA sources passed to SetImage
+	/// </summary>
+	/// <param name="options">Filtering options</param>
+	/// <returns>Whether every frame and face had a largest MIP set from RGBA data</returns>
+	bool GenerateMipmaps(const Mipmaps::Options& options);
+
+	/// <summary>
+	/// Writes the VTF
+	/// </summary>
+	/// <param name="out">Vector to replace the contents of with the file</param>
+	/// <returns>Whether the file could be written</returns>
+	bool Write(std::vector<uint8_t>& out) const;
+};
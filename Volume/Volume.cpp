@@ -0,0 +1,301 @@
+#include "Volume.h"
+#include "../FileFormat/Parser.h"
+#include "../Util/SIMD.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+#define BRICK_TEXELS (VOLUME_BRICK_SIZE * VOLUME_BRICK_SIZE * VOLUME_BRICK_SIZE)
+
+using namespace Volume;
+
+namespace
+{
+	// Texels either side of a coordinate on one axis, and the weight of the second
+	struct AxisTaps
+	{
+		uint32_t i0, i1;
+		float fract;
+	};
+}
+
+static uint32_t CalcBrickCount(uint16_t size)
+{
+	return (static_cast<uint32_t>(size) + VOLUME_BRICK_SIZE - 1) / VOLUME_BRICK_SIZE;
+}
+
+Image Volume::MakeLinearImage(const uint8_t* pData, uint16_t width, uint16_t height, uint16_t depth, IMAGE_FORMAT format)
+{
+	const uint32_t pixelSize = VTFParser::GetImageFormatInfo(format).bytesPerPixel;
+
+	Image image;
+	image.pData = pData;
+	image.format = format;
+	image.width = width;
+	image.height = height;
+	image.depth = depth;
+
+	image.texelStrides[0] = pixelSize;
+	image.texelStrides[1] = static_cast<size_t>(pixelSize) * width;
+	image.texelStrides[2] = static_cast<size_t>(pixelSize) * width * height;
+	for (int axis = 0; axis < 3; axis++)
+		image.brickStrides[axis] = image.texelStrides[axis] * VOLUME_BRICK_SIZE;
+
+	return image;
+}
+
+Image Volume::MakeBrickedImage(const uint8_t* pData, uint16_t width, uint16_t height, uint16_t depth, IMAGE_FORMAT format)
+{
+	const uint32_t pixelSize = VTFParser::GetImageFormatInfo(format).bytesPerPixel;
+	const size_t brickSize = static_cast<size_t>(pixelSize) * BRICK_TEXELS;
+
+	Image image;
+	image.pData = pData;
+	image.format = format;
+	image.width = width;
+	image.height = height;
+	image.depth = depth;
+
+	image.texelStrides[0] = pixelSize;
+	image.texelStrides[1] = pixelSize * VOLUME_BRICK_SIZE;
+	image.texelStrides[2] = pixelSize * VOLUME_BRICK_SIZE * VOLUME_BRICK_SIZE;
+	image.brickStrides[0] = brickSize;
+	image.brickStrides[1] = brickSize * CalcBrickCount(width);
+	image.brickStrides[2] = brickSize * CalcBrickCount(width) * CalcBrickCount(height);
+
+	return image;
+}
+
+size_t Volume::CalcBrickedSize(uint16_t width, uint16_t height, uint16_t depth, IMAGE_FORMAT format)
+{
+	return static_cast<size_t>(CalcBrickCount(width)) * CalcBrickCount(height) * CalcBrickCount(depth) *
+		BRICK_TEXELS * VTFParser::GetImageFormatInfo(format).bytesPerPixel;
+}
+
+void Volume::Brick(const uint8_t* pSrc, uint16_t width, uint16_t height, uint16_t depth, IMAGE_FORMAT format, uint8_t* pDst)
+{
+	const Image src = MakeLinearImage(pSrc, width, height, depth, format);
+	const Image dst = MakeBrickedImage(pDst, width, height, depth, format);
+	const size_t pixelSize = src.texelStrides[0];
+
+	// Padding texels of partial bricks are never read, but zero them so the buffer is deterministic
+	memset(pDst, 0, CalcBrickedSize(width, height, depth, format));
+
+	// Each row of a brick is contiguous in both layouts
+	for (uint32_t z = 0; z < depth; z++) {
+		for (uint32_t y = 0; y < height; y++) {
+			for (uint32_t x = 0; x < width; x += VOLUME_BRICK_SIZE) {
+				const uint32_t rowTexels = std::min<uint32_t>(VOLUME_BRICK_SIZE, width - x);
+				memcpy(pDst + dst.GetOffset(x, y, z), pSrc + src.GetOffset(x, y, z), rowTexels * pixelSize);
+			}
+		}
+	}
+}
+
+static AxisTaps CalcAxisTaps(float t, uint16_t size, bool clamp)
+{
+	// Remap to 0-1
+	if (clamp)
+		t = std::clamp(t, 0.f, 0.9999f);
+	else
+		t -= floorf(t);
+
+	// Remap to texel centres, the first texel is then -1 to size - 1
+	t = t * size - 0.5f;
+	const int i = static_cast<int>(floorf(t));
+
+	AxisTaps taps;
+	taps.fract = t - i;
+	if (clamp) {
+		taps.i0 = std::max(i, 0);
+		taps.i1 = std::min(i + 1, size - 1);
+	} else {
+		taps.i0 = i < 0 ? size - 1 : i;
+		taps.i1 = i + 1 >= size ? 0 : i + 1;
+	}
+
+	return taps;
+}
+
+#ifdef VTF_SSE2
+static inline __m128 LoadTexel(const uint8_t* pTexel, IMAGE_FORMAT format)
+{
+	if (format == IMAGE_FORMAT::RGBA8888) {
+		int32_t packed;
+		memcpy(&packed, pTexel, 4);
+
+		const __m128i zero = _mm_setzero_si128();
+		const __m128i channels = _mm_unpacklo_epi16(_mm_unpacklo_epi8(_mm_cvtsi32_si128(packed), zero), zero);
+		return _mm_div_ps(_mm_cvtepi32_ps(channels), _mm_set1_ps(255.f));
+	}
+
+	const VTFPixel pixel = VTFParser::ParsePixel(pTexel, format);
+	return _mm_setr_ps(pixel.r, pixel.g, pixel.b, pixel.a);
+}
+
+static inline __m128 Lerp(__m128 a, __m128 b, float fract)
+{
+	return _mm_add_ps(_mm_mul_ps(a, _mm_set1_ps(1.f - fract)), _mm_mul_ps(b, _mm_set1_ps(fract)));
+}
+#else
+static inline VTFPixel Lerp(const VTFPixel& a, const VTFPixel& b, float fract)
+{
+	const float fractInv = 1.f - fract;
+	return VTFPixel{
+		a.r * fractInv + b.r * fract,
+		a.g * fractInv + b.g * fract,
+		a.b * fractInv + b.b * fract,
+		a.a * fractInv + b.a * fract
+	};
+}
+#endif
+
+static VTFPixel BlendTrilinear(const Image& image, const AxisTaps& x, const AxisTaps& y, const AxisTaps& z)
+{
+	const size_t xOffsets[2] = { image.GetAxisOffset(0, x.i0), image.GetAxisOffset(0, x.i1) };
+	const size_t yOffsets[2] = { image.GetAxisOffset(1, y.i0), image.GetAxisOffset(1, y.i1) };
+	const size_t zOffsets[2] = { image.GetAxisOffset(2, z.i0), image.GetAxisOffset(2, z.i1) };
+
+#ifdef VTF_SSE2
+	__m128 planes[2];
+	for (int zOff = 0; zOff < 2; zOff++) {
+		__m128 rows[2];
+		for (int yOff = 0; yOff < 2; yOff++) {
+			const uint8_t* pRow = image.pData + zOffsets[zOff] + yOffsets[yOff];
+			rows[yOff] = Lerp(LoadTexel(pRow + xOffsets[0], image.format), LoadTexel(pRow + xOffsets[1], image.format), x.fract);
+		}
+		planes[zOff] = Lerp(rows[0], rows[1], y.fract);
+	}
+
+	alignas(16) float result[4];
+	_mm_store_ps(result, Lerp(planes[0], planes[1], z.fract));
+	return VTFPixel{ result[0], result[1], result[2], result[3] };
+#else
+	VTFPixel planes[2];
+	for (int zOff = 0; zOff < 2; zOff++) {
+		VTFPixel rows[2];
+		for (int yOff = 0; yOff < 2; yOff++) {
+			const uint8_t* pRow = image.pData + zOffsets[zOff] + yOffsets[yOff];
+			rows[yOff] = Lerp(VTFParser::ParsePixel(pRow + xOffsets[0], image.format), VTFParser::ParsePixel(pRow + xOffsets[1], image.format), x.fract);
+		}
+		planes[zOff] = Lerp(rows[0], rows[1], y.fract);
+	}
+	return Lerp(planes[0], planes[1], z.fract);
+#endif
+}
+
+VTFPixel Volume::FilterTrilinear(const Image& image, bool clampX, bool clampY, bool clampZ, float u, float v, float w)
+{
+	return BlendTrilinear(
+		image,
+		CalcAxisTaps(u, image.width, clampX),
+		CalcAxisTaps(v, image.height, clampY),
+		CalcAxisTaps(w, image.depth, clampZ)
+	);
+}
+
+static uint32_t CalcNearestTexel(float t, uint16_t size, bool clamp)
+{
+	// Remap to 0-1 as CalcAxisTaps does, then take the texel the coordinate falls in
+	if (clamp)
+		t = std::clamp(t, 0.f, 0.9999f);
+	else
+		t -= floorf(t);
+
+	// Wrapping may round up to exactly 1, which is texel 0 again
+	const uint32_t texel = static_cast<uint32_t>(t * size);
+	return texel < size ? texel : 0;
+}
+
+VTFPixel Volume::FilterNearest(const Image& image, bool clampX, bool clampY, bool clampZ, float u, float v, float w)
+{
+	return VTFParser::ParsePixel(
+		image.pData + image.GetOffset(
+			CalcNearestTexel(u, image.width, clampX),
+			CalcNearestTexel(v, image.height, clampY),
+			CalcNearestTexel(w, image.depth, clampZ)
+		),
+		image.format
+	);
+}
+
+#ifdef VTF_SSE2
+// Same as CalcAxisTaps for 4 lanes
+static void CalcAxisTaps4(const float* pT, uint16_t size, bool clamp, AxisTaps* pTaps)
+{
+	__m128 t = _mm_loadu_ps(pT);
+	if (clamp)
+		t = _mm_min_ps(_mm_max_ps(t, _mm_setzero_ps()), _mm_set1_ps(0.9999f));
+	else
+		t = _mm_sub_ps(t, VTFUtil::Floor4(t));
+
+	t = _mm_sub_ps(_mm_mul_ps(t, _mm_set1_ps(static_cast<float>(size))), _mm_set1_ps(0.5f));
+	const __m128 floored = VTFUtil::Floor4(t);
+
+	const __m128i i = _mm_cvttps_epi32(floored);
+	const __m128i last = _mm_set1_epi32(size - 1);
+	__m128i i0 = i, i1 = _mm_add_epi32(i, _mm_set1_epi32(1));
+
+	const __m128i below = _mm_cmplt_epi32(i0, _mm_setzero_si128());
+	const __m128i above = _mm_cmpgt_epi32(i1, last);
+	if (clamp) {
+		i0 = _mm_andnot_si128(below, i0);
+		i1 = _mm_or_si128(_mm_and_si128(above, last), _mm_andnot_si128(above, i1));
+	} else {
+		i0 = _mm_or_si128(_mm_and_si128(below, last), _mm_andnot_si128(below, i0));
+		i1 = _mm_andnot_si128(above, i1);
+	}
+
+	alignas(16) int32_t i0s[4], i1s[4];
+	alignas(16) float fracts[4];
+	_mm_store_si128(reinterpret_cast<__m128i*>(i0s), i0);
+	_mm_store_si128(reinterpret_cast<__m128i*>(i1s), i1);
+	_mm_store_ps(fracts, _mm_sub_ps(t, floored));
+
+	for (int lane = 0; lane < 4; lane++)
+		pTaps[lane] = AxisTaps{ static_cast<uint32_t>(i0s[lane]), static_cast<uint32_t>(i1s[lane]), fracts[lane] };
+}
+#endif
+
+void Volume::FilterTrilinearBatch(
+	const Image& image, bool clampX, bool clampY, bool clampZ,
+	const float* pU, const float* pV, const float* pW, size_t count, VTFPixel* pOut
+)
+{
+	// Each chunk of lanes has its taps calculated and all 8 texels of each prefetched before any is blended
+	// (a multiple of 4 lanes, so the same lanes use SSE2 as if there were no chunks)
+	const size_t PREFETCH_CHUNK = 16;
+	AxisTaps taps[3][PREFETCH_CHUNK];
+	for (size_t begin = 0; begin < count; begin += PREFETCH_CHUNK) {
+		const size_t chunk = std::min(PREFETCH_CHUNK, count - begin);
+		size_t i = 0;
+
+#ifdef VTF_SSE2
+		for (; i + 4 <= chunk; i += 4) {
+			CalcAxisTaps4(pU + begin + i, image.width, clampX, taps[0] + i);
+			CalcAxisTaps4(pV + begin + i, image.height, clampY, taps[1] + i);
+			CalcAxisTaps4(pW + begin + i, image.depth, clampZ, taps[2] + i);
+		}
+#endif
+
+		for (; i < chunk; i++) {
+			taps[0][i] = CalcAxisTaps(pU[begin + i], image.width, clampX);
+			taps[1][i] = CalcAxisTaps(pV[begin + i], image.height, clampY);
+			taps[2][i] = CalcAxisTaps(pW[begin + i], image.depth, clampZ);
+		}
+
+		for (i = 0; i < chunk; i++) {
+			const size_t xOffsets[2] = { image.GetAxisOffset(0, taps[0][i].i0), image.GetAxisOffset(0, taps[0][i].i1) };
+			for (uint32_t z : { taps[2][i].i0, taps[2][i].i1 }) {
+				for (uint32_t y : { taps[1][i].i0, taps[1][i].i1 }) {
+					const uint8_t* pRow = image.pData + image.GetAxisOffset(2, z) + image.GetAxisOffset(1, y);
+					VTF_PREFETCH(pRow + xOffsets[0]);
+					VTF_PREFETCH(pRow + xOffsets[1]);
+				}
+			}
+		}
+
+		for (i = 0; i < chunk; i++) pOut[begin + i] = BlendTrilinear(image, taps[0][i], taps[1][i], taps[2][i]);
+	}
+}
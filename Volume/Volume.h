@@ -0,0 +1,114 @@
+#pragma once
+
+#include "../FileFormat/Structs.h"
+
+#include <cstddef>
+#include <cstdint>
+
+#define VOLUME_BRICK_SIZE 4
+
+/// <summary>
+/// Trilinear and point filtering of volumetric images, stored either as linear z slices or in 4x4x4 texel bricks
+/// </summary>
+namespace Volume
+{
+	/// <summary>
+	/// A single volumetric image and how its texels are addressed
+	/// The byte offset of texel (x, y, z) is the sum of each axis' (i / 4) * brickStride + (i % 4) * texelStride,
+	/// which covers both layouts (linear slices are just bricks whose strides line up)
+	/// </summary>
+	struct Image
+	{
+		const uint8_t* pData = nullptr;
+		IMAGE_FORMAT format = IMAGE_FORMAT::NONE;
+		uint16_t width = 0;
+		uint16_t height = 0;
+		uint16_t depth = 0;
+
+		size_t brickStrides[3] = {};
+		size_t texelStrides[3] = {};
+
+		size_t GetAxisOffset(int axis, uint32_t i) const
+		{
+			return (i / VOLUME_BRICK_SIZE) * brickStrides[axis] + (i % VOLUME_BRICK_SIZE) * texelStrides[axis];
+		}
+
+		size_t GetOffset(uint32_t x, uint32_t y, uint32_t z) const
+		{
+			return GetAxisOffset(0, x) + GetAxisOffset(1, y) + GetAxisOffset(2, z);
+		}
+	};
+
+	/// <summary>
+	/// Describes an image stored as z slices of rows, as in a VTF
+	/// </summary>
+	/// <param name="pData">Pointer to the image's pixel data</param>
+	/// <param name="width">Width of the image</param>
+	/// <param name="height">Height of the image</param>
+	/// <param name="depth">Depth of the image</param>
+	/// <param name="format">Format of the pixel data (must not be block compressed)</param>
+	Image MakeLinearImage(const uint8_t* pData, uint16_t width, uint16_t height, uint16_t depth, IMAGE_FORMAT format);
+
+	/// <summary>
+	/// Describes an image stored in bricks (see Brick)
+	/// </summary>
+	Image MakeBrickedImage(const uint8_t* pData, uint16_t width, uint16_t height, uint16_t depth, IMAGE_FORMAT format);
+
+	/// <summary>
+	/// Calculates the size of an image stored in bricks, partial bricks at the edges are padded to a full brick
+	/// </summary>
+	/// <returns>Size of the bricked image in bytes</returns>
+	size_t CalcBrickedSize(uint16_t width, uint16_t height, uint16_t depth, IMAGE_FORMAT format);
+
+	/// <summary>
+	/// Copies an image from linear slices into 4x4x4 texel bricks, each brick is contiguous and bricks are ordered x, y, then z,
+	/// so the 8 texels of a trilinear lookup are usually in one or two bricks instead of spread over 2 slices and 4 rows
+	/// </summary>
+	/// <param name="pSrc">Linear pixel data</param>
+	/// <param name="width">Width of the image</param>
+	/// <param name="height">Height of the image</param>
+	/// <param name="depth">Depth of the image</param>
+	/// <param name="format">Format of the pixel data (must not be block compressed)</param>
+	/// <param name="pDst">Buffer of CalcBrickedSize bytes to write the bricks to</param>
+	void Brick(const uint8_t* pSrc, uint16_t width, uint16_t height, uint16_t depth, IMAGE_FORMAT format, uint8_t* pDst);
+
+	/// <summary>
+	/// Trilinearly filters a single volumetric image, blending the 8 texels around the coordinate
+	/// </summary>
+	/// <param name="image">Image to filter</param>
+	/// <param name="clampX">Clamp instead of wrapping at the horizontal edges</param>
+	/// <param name="clampY">Clamp instead of wrapping at the vertical edges</param>
+	/// <param name="clampZ">Clamp instead of wrapping at the front and back</param>
+	/// <param name="u">U coordinate</param>
+	/// <param name="v">V coordinate</param>
+	/// <param name="w">W coordinate</param>
+	/// <returns>VTFPixel struct with the filtered pixel</returns>
+	VTFPixel FilterTrilinear(const Image& image, bool clampX, bool clampY, bool clampZ, float u, float v, float w);
+
+	/// <summary>
+	/// Point samples a single volumetric image, fetching only the texel containing the coordinate
+	/// </summary>
+	/// <param name="image">Image to sample</param>
+	/// <param name="clampX">Clamp instead of wrapping at the horizontal edges</param>
+	/// <param name="clampY">Clamp instead of wrapping at the vertical edges</param>
+	/// <param name="clampZ">Clamp instead of wrapping at the front and back</param>
+	/// <param name="u">U coordinate</param>
+	/// <param name="v">V coordinate</param>
+	/// <param name="w">W coordinate</param>
+	/// <returns>VTFPixel struct with the texel</returns>
+	VTFPixel FilterNearest(const Image& image, bool clampX, bool clampY, bool clampZ, float u, float v, float w);
+
+	/// <summary>
+	/// Trilinearly filters many coordinates at once, identical to calling FilterTrilinear for each
+	/// Texel coordinates and weights are computed 4 lanes at a time with SSE2, and the 8 texels of every lane in a chunk of 16 are prefetched before any are blended
+	/// </summary>
+	/// <param name="pU">Array of count U coordinates</param>
+	/// <param name="pV">Array of count V coordinates</param>
+	/// <param name="pW">Array of count W coordinates</param>
+	/// <param name="count">Number of lanes</param>
+	/// <param name="pOut">Array of count pixels to populate</param>
+	void FilterTrilinearBatch(
+		const Image& image, bool clampX, bool clampY, bool clampZ,
+		const float* pU, const float* pV, const float* pW, size_t count, VTFPixel* pOut
+	);
+}
@@ -6,6 +6,7 @@ language("C++")
 targetdir("premakeout/%{cfg.buildcfg}")
 
 files({ "**.h", "**.cpp" })
+removefiles({ "Benchmarks/**" })
 
 filter("configurations:ReleaseWithSymbols")
 defines("NDEBUG")